@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "VulkanMain.hpp"
+#include <assetPack.hpp>
 #include <vulkan_wrapper.h>
 
 #include <android/log.h>
@@ -92,6 +93,40 @@ VulkanRenderInfo render;
 // Android Native App pointer...
 android_app* androidAppCtx = nullptr;
 
+// Optional assets.pak built by vulkanTesting/tools/assetPacker.  The AAsset
+// stays open so the pack can point straight into its buffer.
+struct VulkanAssetInfo {
+  AAsset* packAsset_;
+  assetPack pack_;
+  bool opened_;
+};
+VulkanAssetInfo assets;
+
+assetPack* openAssetPack(void) {
+  if (!assets.opened_) {
+    assets.opened_ = true;
+    assets.packAsset_ = AAssetManager_open(
+        androidAppCtx->activity->assetManager, "assets.pak", AASSET_MODE_BUFFER);
+    if (assets.packAsset_ &&
+        !assets.pack_.open(AAsset_getBuffer(assets.packAsset_),
+                           AAsset_getLength(assets.packAsset_))) {
+      LOGW("assets.pak is not a valid asset pack, ignoring it");
+      AAsset_close(assets.packAsset_);
+      assets.packAsset_ = nullptr;
+    }
+  }
+  return assets.pack_.isOpen() ? &assets.pack_ : nullptr;
+}
+
+void closeAssetPack(void) {
+  assets.pack_.close();
+  if (assets.packAsset_) {
+    AAsset_close(assets.packAsset_);
+    assets.packAsset_ = nullptr;
+  }
+  assets.opened_ = false;
+}
+
 /*
  * setImageLayout():
  *    Helper function to transition color buffer layout
@@ -415,8 +450,28 @@ void DeleteBuffers(void) {
 enum ShaderType { VERTEX_SHADER, FRAGMENT_SHADER };
 VkResult loadShaderFromFile(const char* filePath, VkShaderModule* shaderOut,
                             ShaderType type) {
-  // Read the file
   assert(androidAppCtx);
+
+  // Use the asset pack when there is one, no copy for stored entries
+  const uint8_t* packedCode = nullptr;
+  size_t packedSize = 0;
+  std::vector<uint8_t> scratch;
+  assetPack* pack = openAssetPack();
+  if (pack && pack->get(filePath, packedCode, packedSize, scratch)) {
+    VkShaderModuleCreateInfo shaderModuleCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .pNext = nullptr,
+        .codeSize = packedSize,
+        .pCode = (const uint32_t*)packedCode,
+        .flags = 0,
+    };
+    VkResult result = vkCreateShaderModule(
+        device.device_, &shaderModuleCreateInfo, nullptr, shaderOut);
+    assert(result == VK_SUCCESS);
+    return result;
+  }
+
+  // Read the file
   AAsset* file = AAssetManager_open(androidAppCtx->activity->assetManager,
                                     filePath, AASSET_MODE_BUFFER);
   size_t fileLength = AAsset_getLength(file);
@@ -824,6 +879,7 @@ void DeleteVulkan(void) {
   DeleteSwapChain();
   DeleteGraphicsPipeline();
   DeleteBuffers();
+  closeAssetPack();
 
   vkDestroyDevice(device.device_, nullptr);
   vkDestroyInstance(device.instance_, nullptr);
@@ -28,6 +28,33 @@ GraphicsApplication::GraphicsApplication() : _app(),
 
     // initialize the graphics
     _app.initializeGraphics();
+
+    glfwSetWindowUserPointer(_window.getWindow(), this);
+    glfwSetKeyCallback(_window.getWindow(), keyCallback);
+}
+
+void GraphicsApplication::keyCallback(GLFWwindow * aWindow, int key, int, int action, int)
+{
+    if (action != GLFW_PRESS)
+    {
+        return;
+    }
+
+    GraphicsApplication * application = static_cast<GraphicsApplication *>(glfwGetWindowUserPointer(aWindow));
+    HelloTriangleApplication & app = application->_app;
+    if (key == GLFW_KEY_UP)
+    {
+        app.setInstanceCount(app.getInstanceCount() * 2);
+    }
+    else if (key == GLFW_KEY_DOWN)
+    {
+        app.setInstanceCount(app.getInstanceCount() / 2);
+    }
+    else
+    {
+        return;
+    }
+    std::cout << "Drawing " << app.getInstanceCount() << " instances" << std::endl;
 }
 
 void GraphicsApplication::run() {
@@ -24,6 +24,9 @@ public:
     
 private:
     void initWindow();
+
+    // up and down double and halve the number of instances drawn
+    static void keyCallback(GLFWwindow * aWindow, int key, int scancode, int action, int mods);
     
 private:
     HelloTriangleApplication _app;
@@ -5,7 +5,9 @@
 //  Created by Paul Premakumar on 9/7/18.
 //  Copyright © 2018 Paul Premakumar. All rights reserved.
 //
+#include <algorithm>
 #include <array>
+#include <cstring>
 #include <iostream>
 #include <functional>
 #include <chrono>
@@ -19,6 +21,7 @@
 
 #include "HelloTriangleApplication.h"
 #include "shaderReader.hpp"
+#include "memory.hpp"
 
 namespace
 {
@@ -73,9 +76,17 @@ namespace
         {{0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}},
         {{-0.5f, 0.5f}, {1.0f, 0.0f, 1.0f}}
     };
+
+    const std::vector<uint16_t> indices = {0, 1, 2};
+
+    // copies of the triangle drawn by the instanced pipeline, a square grid
+    const uint32_t INSTANCE_GRID = 4;
+    const uint32_t INSTANCE_COUNT = INSTANCE_GRID * INSTANCE_GRID;
 }
 
 void HelloTriangleApplication::initializeGraphics() {
+    // this thread stays the main thread of the task workers
+    _jobs.create();
     createInstance();
     setupDebugCallback();
     createSurface();
@@ -88,17 +99,30 @@ void HelloTriangleApplication::initializeGraphics() {
     // compile the shaders
     std::unordered_map< std::string, std::string> shaderSources ({
         {"vs-red", "/Users/ppremakumar/Documents/vulkansdk-macos-1.1.82.0/myVulkan/helloVulkan/twoShadersExample/vulkanTesting/shaders/red.spv"},
-        {"vs-twoUniforms", "/Users/ppremakumar/Documents/vulkansdk-macos-1.1.82.0/myVulkan/helloVulkan/vulkanTesting/vulkanTesting/shaders/twoUniformVert.spv"} ,
+        {"vs-instanced", "/Users/ppremakumar/Documents/vulkansdk-macos-1.1.82.0/myVulkan/helloVulkan/twoShadersExample/vulkanTesting/shaders/instanced.spv"} ,
+        {"cs-objectCull", "/Users/ppremakumar/Documents/vulkansdk-macos-1.1.82.0/myVulkan/helloVulkan/twoShadersExample/vulkanTesting/shaders/objectCull.spv"} ,
         {"fs-color", "/Users/ppremakumar/Documents/vulkansdk-macos-1.1.82.0/myVulkan/helloVulkan/vulkanTesting/vulkanTesting/shaders/frag.spv"} });
-    for (auto & shaderSource : shaderSources)
+    // read as tasks, inserted here in order
+    std::vector<std::pair<std::string, std::string>> sources(shaderSources.begin(), shaderSources.end());
+    std::vector<std::vector<char>> shaderCode(sources.size());
+    jobSystem::counter shadersRead;
+    for (size_t i = 0; i < sources.size(); ++i)
     {
-        insertShaderSPIRV(shaderSource.first, shaderReader::readFile(shaderSource.second));
+        _jobs.run([&, i]() { shaderCode[i] = shaderReader::readFile(sources[i].second); }, &shadersRead);
     }
-    createGraphicsPipeline("two-Uniforms", "vs-twoUniforms", "fs-color");
+    _jobs.wait(shadersRead);
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        insertShaderSPIRV(sources[i].first, shaderCode[i]);
+    }
+    createGraphicsPipeline("instanced", "vs-instanced", "fs-color", 1.0, true);
     createSecondGraphicsPipeline("red", "vs-red", "fs-color");
     createFrameBuffers();
     createCommandPool();
     createVertexBuffer();
+    createIndexBuffer();
+    createInstanceBuffer();
+    createObjectCulling();
     createUniformBuffers();
     createDescriptorPool();
     createDescriptorSets();
@@ -119,17 +143,36 @@ namespace {
 
 void HelloTriangleApplication::drawFrame()
 {
+    // tasks that asked for the main thread since the last frame
+    _jobs.runMainThreadJobs();
 
     vkWaitForFences(_device, 1, &_inFlightFences[_currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
-    vkResetFences(_device, 1, &_inFlightFences[_currentFrame]);
+
+    // The fence was last used by frame _frameNumber + 1 - MAX_FRAMES_IN_FLIGHT, so it
+    // and every frame before it have finished
+    uint64_t completedFrame = _frameNumber + 1 >= MAX_FRAMES_IN_FLIGHT ? _frameNumber + 1 - MAX_FRAMES_IN_FLIGHT : 0;
+    _deletionQueue.collect(completedFrame);
 
     // Acquire an image from the swap chain
     uint32_t imageIndex;
     vkAcquireNextImageKHR(_device, _swapChain, std::numeric_limits<uint64_t>::max(), _imageAvailableSemaphores[_currentFrame], VK_NULL_HANDLE, &imageIndex);
 
+    // the image's last submission may have come from the other frame slot
+    if (_imagesInFlight[imageIndex] != VK_NULL_HANDLE)
+    {
+        vkWaitForFences(_device, 1, &_imagesInFlight[imageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
+    }
+    _imagesInFlight[imageIndex] = _inFlightFences[_currentFrame];
+
     // update uniforms
     updateUniformBuffer(imageIndex);
 
+    // last time's commands are reused unless the draw list changed since
+    if (_recordedDrawListVersions[imageIndex] != _drawListVersion)
+    {
+        recordCommandBuffer(imageIndex);
+    }
+
     // Execute the command buffer with that image as attachment in the frame buffer
     // submit the command buffer
     VkSubmitInfo submitInfo = {};
@@ -148,9 +191,12 @@ void HelloTriangleApplication::drawFrame()
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
+    // reset only now, the image wait above may have been on this same fence
+    vkResetFences(_device, 1, &_inFlightFences[_currentFrame]);
     if (vkQueueSubmit(_graphicsQueue, 1, &submitInfo, _inFlightFences[_currentFrame]) != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
+    _frameNumber++;
 
     // Return the image to the swap chain for presentation
     VkPresentInfoKHR presentInfo = {};
@@ -367,6 +413,24 @@ namespace
         return requiredExtensions.empty();
     }
 
+    bool isDeviceExtensionSupported(const VkPhysicalDevice& physicalDevice, const char * extensionName)
+    {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+        for (const auto& extension : availableExtensions)
+        {
+            if (strcmp(extension.extensionName, extensionName) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
     bool isDeviceSuitable(const VkPhysicalDevice& physicalDevice, const VkSurfaceKHR& surface)
     {
         QueueFamilyIndices indices = findQueueFamilies(physicalDevice, surface);
@@ -519,6 +583,12 @@ namespace
     }
 }
 
+void HelloTriangleApplication::retire(std::function<void()> destroy)
+{
+    // the last frame that can use the objects is the last one submitted
+    _deletionQueue.push(_frameNumber, destroy);
+}
+
 void HelloTriangleApplication::cleanup()
 {
     // wait until we finish all the operations before cleanup
@@ -528,6 +598,9 @@ void HelloTriangleApplication::cleanup()
 
 void HelloTriangleApplication::doCleanup()
 {
+    // retired objects the frames in flight were still holding
+    _deletionQueue.flush();
+
     // semaphores
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
@@ -536,8 +609,14 @@ void HelloTriangleApplication::doCleanup()
         vkDestroyFence(_device, _inFlightFences[i], nullptr);
     }
 
-    // command pool
+    // command pools
     vkDestroyCommandPool(_device, _commandPool, nullptr);
+    for (auto commandPool : _frameCommandPools)
+    {
+        vkDestroyCommandPool(_device, commandPool, nullptr);
+    }
+    _recorder.destroy(_device);
+    _jobs.destroy();
 
     // delete frame buffers before the image views and renderpass
     for (auto framebuffer : _swapChainBuffers) {
@@ -573,6 +652,15 @@ void HelloTriangleApplication::doCleanup()
     // Vertex buffer and memory
     vkDestroyBuffer(_device, _vertexBuffer, nullptr);
     vkFreeMemory(_device, _vertexBufferMemory, nullptr);
+    vkDestroyBuffer(_device, _indexBuffer, nullptr);
+    vkFreeMemory(_device, _indexBufferMemory, nullptr);
+    _objectCulling.destroy(_device);
+    for (size_t i = 0; i < _drawIndirectBuffers.size(); i++)
+    {
+        vkDestroyBuffer(_device, _drawIndirectBuffers[i], nullptr);
+        vkFreeMemory(_device, _drawIndirectBuffersMemory[i], nullptr);
+    }
+    _instances.destroy(_device);
 
     // destroy image views
     for (auto imageView : _swapChainImageViews)
@@ -682,7 +770,22 @@ void HelloTriangleApplication::createLogicalDevice()
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    // GPU culling issues every object from one indirect draw, each with its own first instance
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(_physicalDevice, &supportedFeatures);
+    _gpuCulling = supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+
+    std::vector<const char*> extensions(deviceExtensions);
+    _drawIndirectCount = _gpuCulling && isDeviceExtensionSupported(_physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    if (_drawIndirectCount)
+    {
+        extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+    std::cout << "GPU culling " << _gpuCulling << " draw indirect count " << _drawIndirectCount << std::endl;
+
     VkPhysicalDeviceFeatures deviceFeatures = {};
+    deviceFeatures.multiDrawIndirect = _gpuCulling ? VK_TRUE : VK_FALSE;
+    deviceFeatures.drawIndirectFirstInstance = _gpuCulling ? VK_TRUE : VK_FALSE;
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -693,8 +796,8 @@ void HelloTriangleApplication::createLogicalDevice()
     createInfo.enabledExtensionCount = 0;
 
     // required extensions
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
 
     if (vkCreateDevice(_physicalDevice, &createInfo, nullptr, &_device) != VK_SUCCESS) {
         throw std::runtime_error("failed to create logical device!");
@@ -739,6 +842,9 @@ void HelloTriangleApplication::createCommandPool()
     {
         std::cout << "Created Command Pool " << std::endl;
     }
+
+    // secondaries for the draws, recorded as tasks with one pool per chunk
+    _recorder.create(_device, static_cast<uint32_t>(queueFamilyIndices.graphicsFamily), 0, static_cast<uint32_t>(_swapChainImages.size()), &_jobs);
 }
 
 void HelloTriangleApplication::createBuffer(VkDeviceSize size,
@@ -747,29 +853,7 @@ void HelloTriangleApplication::createBuffer(VkDeviceSize size,
                                             VkBuffer& buffer,
                                             VkDeviceMemory& bufferMemory)
 {
-    VkBufferCreateInfo bufferInfo = {};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = size;
-    bufferInfo.usage = usage;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    if (vkCreateBuffer(_device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create buffer!");
-    }
-
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(_device, buffer, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(_device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate buffer memory!");
-    }
-
-    vkBindBufferMemory(_device, buffer, bufferMemory, 0);
+    memory::createBuffer(_device, _physicalDevice, size, usage, properties, buffer, bufferMemory);
 }
 
 void HelloTriangleApplication::copyBuffer(VkBuffer srcBuffer,
@@ -848,21 +932,105 @@ void HelloTriangleApplication::createVertexBuffer()
     vkFreeMemory(_device, stagingBufferMemory, nullptr);
 }
 
-uint32_t HelloTriangleApplication::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+void HelloTriangleApplication::createIndexBuffer()
 {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(_physicalDevice, &memProperties);
+    VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+    void* data;
+    vkMapMemory(_device, stagingBufferMemory, 0, bufferSize, 0, &data);
+    memcpy(data, indices.data(), (size_t) bufferSize);
+    vkUnmapMemory(_device, stagingBufferMemory);
+
+    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _indexBuffer, _indexBufferMemory);
 
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+    copyBuffer(stagingBuffer, _indexBuffer, bufferSize);
+
+    vkDestroyBuffer(_device, stagingBuffer, nullptr);
+    vkFreeMemory(_device, stagingBufferMemory, nullptr);
+}
+
+void HelloTriangleApplication::createInstanceBuffer()
+{
+    // Rewritten every frame, so it stays host visible and mapped rather than staged
+    _instances.create(_device, _physicalDevice, INSTANCE_COUNT, static_cast<uint32_t>(_swapChainImages.size()));
+    _instanceCount = _instances.capacity();
+
+    // a grid of triangles in the z = 0 plane under one root, each one spinning in place
+    _objectInstances.resize(_instances.capacity());
+    uint32_t root = _transforms.add(transformHierarchy::noParent);
+    for (uint32_t i = 0; i < _instances.capacity(); ++i)
     {
-        if (typeFilter & (1 << i) &&
-            (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-        {
-            return i;
-        }
+        uint32_t column = i % INSTANCE_GRID;
+        uint32_t row = i / INSTANCE_GRID;
+        glm::vec3 position((column + 0.5f) / INSTANCE_GRID * 2.0f - 1.0f, (row + 0.5f) / INSTANCE_GRID * 2.0f - 1.0f, 0.0f);
+
+        uint32_t node = _transforms.add(root, static_cast<int32_t>(i));
+        _transforms.setTranslation(node, position);
+        _transforms.setScale(node, glm::vec3(1.5f / INSTANCE_GRID));
+        _instanceNodes.push_back(node);
+
+        _objectInstances[i].model = glm::mat4(1.0f);
+        _objectInstances[i].color = glm::vec4((column + 1.0f) / INSTANCE_GRID, (row + 1.0f) / INSTANCE_GRID, 1.0f, 1.0f);
+        _objectInstances[i].materialId = 0;
     }
 
-    throw std::runtime_error("failed to find suitable memory type!");
+    // colors never change, only the model matrices are written per frame
+    for (uint32_t segment = 0; segment < _swapChainImages.size(); ++segment)
+    {
+        std::copy(_objectInstances.begin(), _objectInstances.end(), _instances.getInstances(segment));
+    }
+    _instanceTransformFrames.assign(_swapChainImages.size(), 0);
+}
+
+void HelloTriangleApplication::createObjectCulling()
+{
+    // Bounding sphere of the mesh around the centroid of its vertices
+    glm::vec2 center(0.0f);
+    for (const Vertex & vertex : vertices)
+    {
+        center += vertex.pos / static_cast<float>(vertices.size());
+    }
+    float radius = 0.0f;
+    for (const Vertex & vertex : vertices)
+    {
+        radius = std::max(radius, glm::length(vertex.pos - center));
+    }
+    _meshSphere = glm::vec4(center.x, center.y, 0.0f, radius);
+
+    if (!_gpuCulling)
+    {
+        createDrawIndirectBuffers();
+        return;
+    }
+
+    // Every instance is an object drawing the whole mesh
+    objectCulling::object object = {};
+    object.sphere[0] = _meshSphere.x;
+    object.sphere[1] = _meshSphere.y;
+    object.sphere[2] = _meshSphere.z;
+    object.sphere[3] = _meshSphere.w;
+    object.indexCount = static_cast<uint32_t>(indices.size());
+    std::vector<objectCulling::object> objects(_instances.capacity(), object);
+
+    _objectCulling.create(_device, _physicalDevice, _shaders["cs-objectCull"].getShaderModule(), objects,
+                          _instances.getBuffer(), static_cast<uint32_t>(_swapChainImages.size()), _drawIndirectCount);
+}
+
+void HelloTriangleApplication::createDrawIndirectBuffers()
+{
+    // One draw per image whose instance count the CPU culling writes each frame
+    _drawIndirectBuffers.resize(_swapChainImages.size());
+    _drawIndirectBuffersMemory.resize(_swapChainImages.size());
+
+    for (size_t i = 0; i < _swapChainImages.size(); i++) {
+        createBuffer(sizeof(VkDrawIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     _drawIndirectBuffers[i], _drawIndirectBuffersMemory[i]);
+    }
 }
 
 void HelloTriangleApplication::createSynchronizationObjects()
@@ -889,88 +1057,176 @@ void HelloTriangleApplication::createSynchronizationObjects()
         }
     }
 
+    // no image has been submitted yet
+    _imagesInFlight.assign(_swapChainImages.size(), VK_NULL_HANDLE);
+
     std::cout << "Created semaphores " << std::endl;
 }
 
 void HelloTriangleApplication::createCommandBuffers()
 {
     // Because one of the drawing commands involves binding the right VkFramebuffer,
-    // we'll actually have to record a command buffer for every image in the swap chain
-    // once again.
+    // we'll actually have to record a command buffer for every image in the swap chain.
+    // Each comes from its own pool, which is reset whole when the image is recorded again.
+    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(_physicalDevice, _surface);
+
+    _frameCommandPools.resize(_swapChainBuffers.size());
     _commandBuffers.resize(_swapChainBuffers.size());
+    _recordedDrawListVersions.assign(_swapChainBuffers.size(), 0);
 
-    VkCommandBufferAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = _commandPool;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = static_cast<uint32_t>(_commandBuffers.size());
+    for (size_t i = 0; i < _commandBuffers.size(); ++i)
+    {
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = static_cast<uint32_t>(queueFamilyIndices.graphicsFamily);
+        poolInfo.flags = 0;
+
+        if (vkCreateCommandPool(_device, &poolInfo, nullptr, &_frameCommandPools[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create frame command pool!");
+        }
+
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = _frameCommandPools[i];
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
 
-    if (vkAllocateCommandBuffers(_device, &allocInfo, _commandBuffers.data()) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate command buffers!");
+        if (vkAllocateCommandBuffers(_device, &allocInfo, &_commandBuffers[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
     }
-    else
+    std::cout << "Number of command buffers created " << _commandBuffers.size() << std::endl;
+
+    // record every image up front, frames only record again when the draw list changes
+    uint32_t bindsSkipped = 0;
+    for (size_t i = 0; i < _commandBuffers.size(); ++i)
     {
-        std::cout << "Number of command buffers created " << _commandBuffers.size() << std::endl;
+        recordCommandBuffer(static_cast<uint32_t>(i));
+
+        const drawQueue::statistics & statistics = _recorder.getStatistics();
+        bindsSkipped += statistics.pipelineBindsSkipped + statistics.descriptorSetBindsSkipped +
+                        statistics.vertexBufferBindsSkipped + statistics.indexBufferBindsSkipped;
     }
+    std::cout << "Recorded command buffers, draw queue skipped " << bindsSkipped << " redundant binds" << std::endl;
+}
 
-    // begin command buffer recording
-    for (size_t i = 0; i < _commandBuffers.size(); ++i)
+void HelloTriangleApplication::markDrawListDirty()
+{
+    ++_drawListVersion;
+}
+
+void HelloTriangleApplication::setInstanceCount(uint32_t count)
+{
+    count = std::max(1u, std::min(count, _instances.capacity()));
+    if (count == _instanceCount)
     {
-        VkCommandBufferBeginInfo beginInfo = {};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-        beginInfo.pInheritanceInfo = nullptr; // Optional
+        return;
+    }
+    _instanceCount = count;
 
-        if (vkBeginCommandBuffer(_commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-            throw std::runtime_error("failed to begin recording command buffer!");
-        }
+    // The CPU path writes the count into the indirect draw each frame, but the
+    // GPU path records its dispatch and draw sized by it
+    if (_gpuCulling)
+    {
+        _objectCulling.setObjectCount(count);
+        markDrawListDirty();
+    }
+}
 
-        // Start the render pass
-        VkRenderPassBeginInfo renderPassInfo = {};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = _renderPass;
-        renderPassInfo.framebuffer = _swapChainBuffers[i];
+uint32_t HelloTriangleApplication::getInstanceCount() const
+{
+    return _instanceCount;
+}
 
-        renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = _swapChainExtent;
+void HelloTriangleApplication::recordCommandBuffer(uint32_t imageIndex)
+{
+    // the image's last submission has finished, so its commands go back to the pool
+    vkResetCommandPool(_device, _frameCommandPools[imageIndex], 0);
+    VkCommandBuffer commandBuffer = _commandBuffers[imageIndex];
 
-        VkClearValue clearColor = {0.f, 0.f, 0.f, 1.f};
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = 0; // resubmitted until the draw list changes, never while pending
+    beginInfo.pInheritanceInfo = nullptr; // Optional
 
-        vkCmdBeginRenderPass(_commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
 
-        // basic drawing commands
-        // two-uniforms
-        {
-            pipeline & aPipeline = _graphicsPipeLines["two-Uniforms"];
-            vkCmdBindPipeline(_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, aPipeline.getPipeline());
+    // Start the render pass
+    VkRenderPassBeginInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = _renderPass;
+    renderPassInfo.framebuffer = _swapChainBuffers[imageIndex];
 
-            VkBuffer vertexBuffers[] = {_vertexBuffer};
-            VkDeviceSize offsets[] = {0};
-            vkCmdBindVertexBuffers(_commandBuffers[i], 0 , 1 , vertexBuffers, offsets);
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = _swapChainExtent;
 
-            vkCmdBindDescriptorSets(_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, aPipeline.getPipeineLayout(), 0, 1, &_descriptorSets[i], 0, nullptr);
-            vkCmdDraw(_commandBuffers[i], static_cast<uint32_t>(vertices.size()), 1, 0, 0);
-        }
-        {
-            // red
-            pipeline & graphicsPipeline = _graphicsPipeLines["red"];
-            vkCmdBindPipeline(_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline.getPipeline());
-            vkCmdDraw(_commandBuffers[i], 3, 1, 0, 0);
-        }
+    VkClearValue clearColor = {0.f, 0.f, 0.f, 1.f};
+    renderPassInfo.clearValueCount = 1;
+    renderPassInfo.pClearValues = &clearColor;
 
-        vkCmdEndRenderPass(_commandBuffers[i]);
+    // Compute work has to be recorded outside the render pass
+    if (_gpuCulling)
+    {
+        _objectCulling.recordCulling(commandBuffer, imageIndex);
+    }
+
+    // the draws come in secondary command buffers
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-        if (vkEndCommandBuffer(_commandBuffers[i]) != VK_SUCCESS)
+    // basic drawing commands, submitted in any order and recorded sorted by state
+    _drawQueue.clear();
+    {
+        // instanced, every copy of the triangle in one draw
+        pipeline & aPipeline = _graphicsPipeLines["instanced"];
+        drawQueue::draw instanced;
+        instanced.pipeline = aPipeline.getPipeline();
+        instanced.pipelineLayout = aPipeline.getPipeineLayout();
+        instanced.descriptorSet = _descriptorSets[imageIndex];
+        instanced.vertexBufferCount = 2;
+        instanced.vertexBuffers[0] = _vertexBuffer;
+        instanced.vertexBuffers[1] = _instances.getBuffer();
+
+        if (_gpuCulling)
         {
-            throw std::runtime_error("failed to record command buffer!");
+            // the culled commands address this image's segment through firstInstance
+            instanced.indexBuffer = _indexBuffer;
+            instanced.indexType = VK_INDEX_TYPE_UINT16;
+            instanced.record = [this, imageIndex](VkCommandBuffer commandBuffer) {
+                _objectCulling.recordDraw(commandBuffer, imageIndex);
+            };
         }
         else
         {
-            std::cout << "Recorded command buffer" << std::endl;
+            // binding 1 reads this image's segment, where only the visible instances were packed
+            instanced.vertexOffsets[1] = _instances.getOffset(imageIndex);
+            VkBuffer drawIndirectBuffer = _drawIndirectBuffers[imageIndex];
+            instanced.record = [drawIndirectBuffer](VkCommandBuffer commandBuffer) {
+                vkCmdDrawIndirect(commandBuffer, drawIndirectBuffer, 0, 1, sizeof(VkDrawIndirectCommand));
+            };
         }
+        _drawQueue.submit(0, 0.0f, instanced);
+    }
+    {
+        // red
+        drawQueue::draw red;
+        red.pipeline = _graphicsPipeLines["red"].getPipeline();
+        red.pipelineLayout = _graphicsPipeLines["red"].getPipeineLayout();
+        red.record = [](VkCommandBuffer commandBuffer) {
+            vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+        };
+        _drawQueue.submit(0, 0.0f, red);
+    }
+    _recorder.record(_device, commandBuffer, imageIndex, _renderPass, 0, _swapChainBuffers[imageIndex], _drawQueue);
+
+    vkCmdEndRenderPass(commandBuffer);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to record command buffer!");
     }
+    _recordedDrawListVersions[imageIndex] = _drawListVersion;
 }
 
 void HelloTriangleApplication::createFrameBuffers()
@@ -1082,7 +1338,8 @@ void HelloTriangleApplication::createSecondGraphicsPipeline(std::string pipeline
 void HelloTriangleApplication::createGraphicsPipeline(std::string pipelineName,
                                                       std::string vertexShader,
                                                       std::string fragmentShader,
-                                                      float viewFactor)
+                                                      float viewFactor,
+                                                      bool instanced)
 {
     pipeline aPipeline = {};
 
@@ -1092,12 +1349,20 @@ void HelloTriangleApplication::createGraphicsPipeline(std::string pipelineName,
 
     // Vertex Input
     VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions = {Vertex::getBindingDescription()};
+    auto vertexAttributes = Vertex::getAttributeDescriptions();
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions(vertexAttributes.begin(), vertexAttributes.end());
+    if (instanced)
+    {
+        // per instance attributes follow the vertex ones
+        bindingDescriptions.push_back(instanceData::getBindingDescription(1));
+        auto instanceAttributes = instanceData::getAttributeDescriptions(1, static_cast<uint32_t>(vertexAttributes.size()));
+        attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
+    }
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription; // Optional
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data(); // Optional
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data(); // Optional
 
     aPipeline.vertexInputInfo = vertexInputInfo;
@@ -1412,6 +1677,51 @@ void HelloTriangleApplication::updateUniformBuffer(uint32_t currentImage) {
     vkMapMemory(_device, _uniformBuffersMemory2[currentImage], 0, sizeof(proj), 0, &data2);
     memcpy(data2, &proj, sizeof(proj));
     vkUnmapMemory(_device, _uniformBuffersMemory2[currentImage]);
+
+    // instances spin with the model rotation; only the dirty nodes are recomputed
+    glm::quat spin = glm::angleAxis(time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    for (uint32_t node : _instanceNodes)
+    {
+        _transforms.setRotation(node, spin);
+    }
+    _transforms.update(&_jobs);
+
+    if (_gpuCulling)
+    {
+        // straight into this image's mapped segment, which the GPU culls in place
+        _instanceTransformFrames[currentImage] = _transforms.write(_instances.getInstances(currentImage), _instanceTransformFrames[currentImage]);
+        _objectCulling.update(_device, currentImage, proj.matrix * ubo.view, currentImage * _instances.capacity());
+        return;
+    }
+
+    // CPU culling: the survivors are copied out of the full list, so that is where the matrices go
+    std::vector<instanceData> & instances = _objectInstances;
+    _objectTransformFrame = _transforms.write(instances.data(), _objectTransformFrame);
+
+    // world space spheres of the drawn instances against the frustum of the same projection * view
+    _objectBounds.resize(_instanceCount);
+    for (size_t i = 0; i < _instanceCount; ++i)
+    {
+        const glm::mat4 & model = instances[i].model;
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        _objectBounds.set(i, glm::vec3(model * glm::vec4(glm::vec3(_meshSphere), 1.0f)), _meshSphere.w * scale);
+    }
+    frustumCulling::cullParallel(_objectBounds, frustumCulling::extractPlanes(proj.matrix * ubo.view), _visibleObjects, _jobs);
+
+    instanceData * visibleInstances = _instances.getInstances(currentImage);
+    for (size_t i = 0; i < _visibleObjects.size(); ++i)
+    {
+        visibleInstances[i] = instances[_visibleObjects[i]];
+    }
+
+    VkDrawIndirectCommand draw = {};
+    draw.vertexCount = static_cast<uint32_t>(vertices.size());
+    draw.instanceCount = static_cast<uint32_t>(_visibleObjects.size());
+
+    void* data3;
+    vkMapMemory(_device, _drawIndirectBuffersMemory[currentImage], 0, sizeof(draw), 0, &data3);
+    memcpy(data3, &draw, sizeof(draw));
+    vkUnmapMemory(_device, _drawIndirectBuffersMemory[currentImage]);
 }
 
 void HelloTriangleApplication::createDescriptorPool() {
@@ -9,13 +9,22 @@
 #ifndef HelloTriangleApplication_h
 #define HelloTriangleApplication_h
 
+#include <functional>
 #include <vector>
 #include <string>
 #include <unordered_map>
 
 #include "window.hpp"
+#include "deletionQueue.hpp"
 #include "shaderModule.hpp"
 #include "pipeline.hpp"
+#include "instanceBuffer.hpp"
+#include "objectCulling.hpp"
+#include "frustumCulling.hpp"
+#include "transformHierarchy.hpp"
+#include "drawQueue.hpp"
+#include "parallelRecorder.hpp"
+#include "jobSystem.hpp"
 
 class HelloTriangleApplication {
 
@@ -35,6 +44,18 @@ public:
 
     void updateUniformBuffer(uint32_t currentImage);
 
+    // the draws changed, every image records its commands again before its next frame
+    void markDrawListDirty();
+
+    // draw only the first count instances of the grid, at least one and at most all
+    void setInstanceCount(uint32_t count);
+
+    uint32_t getInstanceCount() const;
+
+    // destroy runs once no frame submitted before this call can still be using the
+    // objects it frees, so they can go mid-run without waiting for the device to idle
+    void retire(std::function<void()> destroy);
+
     void insertShaderSPIRV(const std::string shaderName, const std::vector<char> & vertexShader);
 
     // sets the SPIR-V vertex shader code
@@ -69,7 +90,8 @@ private:
 
     void createDescriptorSetLayout();
 
-    void createGraphicsPipeline(std::string pipelineName, std::string vertexShader, std::string fragmentShader, float viewFactor = 1.0);
+    // instanced pipelines read instanceData from a second vertex binding
+    void createGraphicsPipeline(std::string pipelineName, std::string vertexShader, std::string fragmentShader, float viewFactor = 1.0, bool instanced = false);
 
     void createSecondGraphicsPipeline(std::string pipelineName, std::string vertexShader, std::string fragmentShader);
 
@@ -95,14 +117,21 @@ private:
 
     void createVertexBuffer();
 
-    void createUniformBuffers();
+    void createIndexBuffer();
+
+    void createInstanceBuffer();
 
-    uint32_t findMemoryType(uint32_t typeFilter,
-                            VkMemoryPropertyFlags properties);
+    // GPU driven path, one object per instance, see objectCulling.hpp
+    void createObjectCulling();
 
+    void createDrawIndirectBuffers();
+
+    void createUniformBuffers();
 
     void createCommandBuffers();
 
+    void recordCommandBuffer(uint32_t imageIndex);
+
     void createSynchronizationObjects();
 
     VkShaderModule createShaderModule(const std::vector<char> & shaderBytes);
@@ -125,6 +154,34 @@ private:
     VkBuffer _vertexBuffer;
     VkDeviceMemory _vertexBufferMemory;
 
+    VkBuffer _indexBuffer;
+    VkDeviceMemory _indexBufferMemory;
+
+    // per instance data, one segment per swap chain image
+    instanceBuffer _instances;
+    // how many of them are drawn, from the front
+    uint32_t _instanceCount = 0;
+
+    // instance placement; the frame each destination last received world matrices
+    transformHierarchy _transforms;
+    std::vector<uint32_t> _instanceNodes;
+    std::vector<uint64_t> _instanceTransformFrames;
+    uint64_t _objectTransformFrame = 0;
+
+    // compute culled indirect draws, when the device can draw many commands from one call
+    bool _gpuCulling = false;
+    bool _drawIndirectCount = false;
+    objectCulling _objectCulling;
+
+    // otherwise culled on the CPU: model space sphere of the mesh, every instance,
+    // their world spheres, and the survivors packed to the front of the image's segment
+    glm::vec4 _meshSphere = glm::vec4(0.0f);
+    std::vector<instanceData> _objectInstances;
+    frustumCulling::spheres _objectBounds;
+    std::vector<uint32_t> _visibleObjects;
+    std::vector<VkBuffer> _drawIndirectBuffers;
+    std::vector<VkDeviceMemory> _drawIndirectBuffersMemory;
+
     // debug callback
     VkDebugUtilsMessengerEXT _callback;
 
@@ -167,16 +224,34 @@ private:
     VkDescriptorPool _descriptorPool;
     std::vector<VkDescriptorSet> _descriptorSets;
 
-    // commands
+    // commands; one pool per swap chain image for its command buffer
     VkCommandPool _commandPool;
+    std::vector<VkCommandPool> _frameCommandPools;
     std::vector<VkCommandBuffer> _commandBuffers;
 
+    // an image records again when its version is behind the draw list's
+    uint64_t _drawListVersion = 1;
+    std::vector<uint64_t> _recordedDrawListVersions;
+
+    // draws of one command buffer, sorted to skip redundant binds and recorded
+    // across threads into secondary command buffers
+    drawQueue _drawQueue;
+    parallelRecorder _recorder;
+
+    // workers for culling, recording and loading; this object's thread is the main one
+    jobSystem _jobs;
+
     // semaphores
     std::vector<VkSemaphore> _imageAvailableSemaphores;
     std::vector<VkSemaphore> _renderFinishedSemaphores;
     std::vector<VkFence> _inFlightFences;
+    std::vector<VkFence> _imagesInFlight; // fence of each image's last submission
     // current frame
     size_t _currentFrame = 0;
+    // frames submitted so far, retired objects are stamped with it
+    uint64_t _frameNumber = 0;
+    // destroys waiting on the frames in flight, collected after each fence wait
+    deletionQueue _deletionQueue;
 };
 
 #endif /* HelloTriangleApplication_h */
@@ -0,0 +1,50 @@
+//
+//  deletionQueue.hpp
+//  vulkanTesting
+//
+
+#ifndef deletionQueue_hpp
+#define deletionQueue_hpp
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+// Destroys objects once the GPU is done with them, without waiting for the
+// device to idle.  Each destroy is tagged with the last frame that may still
+// use its objects, and runs when the caller reports that frame complete,
+// normally right after waiting on a frame fence.  Frames are any increasing
+// count: frames submitted so far, or the value a timeline semaphore reaches
+// when the frame finishes.
+//
+// Destroys run in the order they were pushed, so objects can be pushed before
+// the ones they depend on (frame buffers before their image views).
+class deletionQueue
+{
+public:
+    deletionQueue();
+
+    // destroy runs once frame has completed.  A frame older than one already
+    // pushed waits for that one, destruction only ever runs late.
+    void push(uint64_t frame, std::function<void()> destroy);
+
+    // Runs the destroys of every frame up to and including completedFrame
+    void collect(uint64_t completedFrame);
+
+    // Runs every destroy, once the device has gone idle
+    void flush();
+
+    size_t size() const;
+
+    bool empty() const;
+
+private:
+    struct entry {
+        uint64_t frame;
+        std::function<void()> destroy;
+    };
+
+    std::deque<entry> _entries; // oldest frame first
+};
+
+#endif /* deletionQueue_hpp */
@@ -0,0 +1,254 @@
+//
+//  drawQueue.cpp
+//  vulkanTesting
+//
+
+#include "drawQueue.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    // Dispatchable and non-dispatchable handles are pointers or 64 bit integers
+    // depending on the platform
+    template<typename T>
+    uint64_t handleValue(T handle)
+    {
+        uint64_t value = 0;
+        std::memcpy(&value, &handle, sizeof(handle));
+        return value;
+    }
+
+    const uint32_t idBits = 12;
+    const uint32_t depthBits = 24;
+}
+
+const uint32_t drawQueue::maxVertexBuffers;
+
+drawQueue::drawQueue() : _sorted(true)
+{
+}
+
+void drawQueue::clear()
+{
+    _draws.clear();
+    _keys.clear();
+    _order.clear();
+    _sorted = true;
+    _statistics = statistics();
+
+    // Handles of destroyed objects would otherwise hold on to their ids until the
+    // 12 bits ran out; the same submissions get the same ids again
+    _pipelineIds.clear();
+    _descriptorSetIds.clear();
+    _meshIds.clear();
+}
+
+uint64_t drawQueue::makeKey(uint32_t pass, uint32_t pipeline, uint32_t descriptorSet, uint32_t mesh, float depth)
+{
+    const uint32_t idMask = (1u << idBits) - 1;
+
+    // Non negative floats order like their bits, the top 24 keep the exponent and
+    // most of the mantissa
+    uint32_t depthValue;
+    float clamped = std::max(depth, 0.0f);
+    std::memcpy(&depthValue, &clamped, sizeof(depthValue));
+    depthValue >>= 32 - depthBits;
+
+    return (static_cast<uint64_t>(pass & 0xF) << 60) |
+           (static_cast<uint64_t>(pipeline & idMask) << 48) |
+           (static_cast<uint64_t>(descriptorSet & idMask) << 36) |
+           (static_cast<uint64_t>(mesh & idMask) << 24) |
+           depthValue;
+}
+
+uint32_t drawQueue::getId(std::unordered_map<uint64_t, uint32_t> & ids, uint64_t handle)
+{
+    auto found = ids.find(handle);
+    if (found != ids.end())
+    {
+        return found->second;
+    }
+    uint32_t id = static_cast<uint32_t>(ids.size());
+    if (id >= (1u << idBits))
+    {
+        // a wrapped id would sort the state in with another one
+        throw std::runtime_error("more than 4096 pipelines, descriptor sets or meshes in one draw queue!");
+    }
+    ids[handle] = id;
+    return id;
+}
+
+void drawQueue::submit(uint32_t pass, float depth, const draw & aDraw)
+{
+    uint32_t pipelineId = getId(_pipelineIds, handleValue(aDraw.pipeline));
+    uint32_t descriptorSetId = getId(_descriptorSetIds, handleValue(aDraw.descriptorSet));
+    uint32_t meshId = getId(_meshIds, handleValue(aDraw.vertexBufferCount > 0 ? aDraw.vertexBuffers[0] : VK_NULL_HANDLE));
+
+    _keys.push_back(makeKey(pass, pipelineId, descriptorSetId, meshId, depth));
+    _draws.push_back(aDraw);
+    _sorted = false;
+}
+
+void drawQueue::sort()
+{
+    size_t count = _keys.size();
+    _order.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        _order[i] = i;
+    }
+
+    if (count == 0)
+    {
+        _sorted = true;
+        return;
+    }
+
+    std::vector<uint32_t> sorted(count);
+    for (uint32_t shift = 0; shift < 64; shift += 8)
+    {
+        size_t histogram[256] = {};
+        for (uint32_t index : _order)
+        {
+            histogram[(_keys[index] >> shift) & 0xFF]++;
+        }
+
+        // every key has the same byte here, the pass would not move anything
+        if (histogram[(_keys[_order[0]] >> shift) & 0xFF] == count)
+        {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t & bucket : histogram)
+        {
+            size_t bucketCount = bucket;
+            bucket = offset;
+            offset += bucketCount;
+        }
+        for (uint32_t index : _order)
+        {
+            sorted[histogram[(_keys[index] >> shift) & 0xFF]++] = index;
+        }
+        _order.swap(sorted);
+    }
+    _sorted = true;
+}
+
+void drawQueue::record(VkCommandBuffer commandBuffer)
+{
+    if (!_sorted)
+    {
+        sort();
+    }
+    record(commandBuffer, 0, _order.size(), _statistics);
+}
+
+void drawQueue::record(VkCommandBuffer commandBuffer, size_t first, size_t last, statistics & counts) const
+{
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+    VkDescriptorSet boundDescriptorSet = VK_NULL_HANDLE;
+    uint32_t boundVertexBufferCount = 0;
+    VkBuffer boundVertexBuffers[maxVertexBuffers] = {};
+    VkDeviceSize boundVertexOffsets[maxVertexBuffers] = {};
+    VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+    VkIndexType boundIndexType = VK_INDEX_TYPE_UINT16;
+
+    for (size_t i = first; i < last; ++i)
+    {
+        const draw & aDraw = _draws[_order[i]];
+
+        if (aDraw.pipeline != boundPipeline)
+        {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, aDraw.pipeline);
+            boundPipeline = aDraw.pipeline;
+            counts.pipelineBinds++;
+        }
+        else
+        {
+            counts.pipelineBindsSkipped++;
+        }
+
+        // a set bound through another layout is not guaranteed to stay usable
+        if (aDraw.descriptorSet != VK_NULL_HANDLE)
+        {
+            if (aDraw.descriptorSet != boundDescriptorSet || aDraw.pipelineLayout != boundLayout)
+            {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, aDraw.pipelineLayout, 0, 1, &aDraw.descriptorSet, 0, nullptr);
+                boundDescriptorSet = aDraw.descriptorSet;
+                boundLayout = aDraw.pipelineLayout;
+                counts.descriptorSetBinds++;
+            }
+            else
+            {
+                counts.descriptorSetBindsSkipped++;
+            }
+        }
+
+        if (aDraw.vertexBufferCount > 0)
+        {
+            bool bound = aDraw.vertexBufferCount <= boundVertexBufferCount;
+            for (uint32_t binding = 0; bound && binding < aDraw.vertexBufferCount; ++binding)
+            {
+                bound = aDraw.vertexBuffers[binding] == boundVertexBuffers[binding] && aDraw.vertexOffsets[binding] == boundVertexOffsets[binding];
+            }
+            if (!bound)
+            {
+                vkCmdBindVertexBuffers(commandBuffer, 0, aDraw.vertexBufferCount, aDraw.vertexBuffers, aDraw.vertexOffsets);
+                std::copy(aDraw.vertexBuffers, aDraw.vertexBuffers + aDraw.vertexBufferCount, boundVertexBuffers);
+                std::copy(aDraw.vertexOffsets, aDraw.vertexOffsets + aDraw.vertexBufferCount, boundVertexOffsets);
+                boundVertexBufferCount = std::max(boundVertexBufferCount, aDraw.vertexBufferCount);
+                counts.vertexBufferBinds++;
+            }
+            else
+            {
+                counts.vertexBufferBindsSkipped++;
+            }
+        }
+
+        if (aDraw.indexBuffer != VK_NULL_HANDLE)
+        {
+            if (aDraw.indexBuffer != boundIndexBuffer || aDraw.indexType != boundIndexType)
+            {
+                vkCmdBindIndexBuffer(commandBuffer, aDraw.indexBuffer, 0, aDraw.indexType);
+                boundIndexBuffer = aDraw.indexBuffer;
+                boundIndexType = aDraw.indexType;
+                counts.indexBufferBinds++;
+            }
+            else
+            {
+                counts.indexBufferBindsSkipped++;
+            }
+        }
+
+        aDraw.record(commandBuffer);
+        counts.draws++;
+    }
+}
+
+size_t drawQueue::size() const
+{
+    return _draws.size();
+}
+
+const drawQueue::statistics & drawQueue::getStatistics() const
+{
+    return _statistics;
+}
+
+void drawQueue::statistics::add(const statistics & other)
+{
+    draws += other.draws;
+    pipelineBinds += other.pipelineBinds;
+    pipelineBindsSkipped += other.pipelineBindsSkipped;
+    descriptorSetBinds += other.descriptorSetBinds;
+    descriptorSetBindsSkipped += other.descriptorSetBindsSkipped;
+    vertexBufferBinds += other.vertexBufferBinds;
+    vertexBufferBindsSkipped += other.vertexBufferBindsSkipped;
+    indexBufferBinds += other.indexBufferBinds;
+    indexBufferBindsSkipped += other.indexBufferBindsSkipped;
+}
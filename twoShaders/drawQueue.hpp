@@ -0,0 +1,104 @@
+//
+//  drawQueue.hpp
+//  vulkanTesting
+//
+
+#ifndef drawQueue_hpp
+#define drawQueue_hpp
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "window.hpp"
+
+// Draws are submitted in any order with the state they need, then sorted by a
+// 64 bit key so draws sharing a pipeline, descriptor set and mesh end up next to
+// each other.  Recording walks the sorted draws and only binds what differs from
+// the previous draw.
+//
+// key, most significant first:
+//   pass 4 | pipeline 12 | descriptor set 12 | mesh 12 | depth 24
+class drawQueue
+{
+public:
+    static const uint32_t maxVertexBuffers = 2;
+
+    struct draw {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE; // none when VK_NULL_HANDLE
+
+        uint32_t vertexBufferCount = 0;
+        VkBuffer vertexBuffers[maxVertexBuffers] = {};
+        VkDeviceSize vertexOffsets[maxVertexBuffers] = {};
+
+        VkBuffer indexBuffer = VK_NULL_HANDLE; // none when VK_NULL_HANDLE
+        VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+
+        // the draw command itself, everything above is bound when it runs
+        std::function<void(VkCommandBuffer)> record;
+    };
+
+    // Binds recorded and binds skipped because the state was already bound
+    struct statistics {
+        uint32_t draws = 0;
+        uint32_t pipelineBinds = 0;
+        uint32_t pipelineBindsSkipped = 0;
+        uint32_t descriptorSetBinds = 0;
+        uint32_t descriptorSetBindsSkipped = 0;
+        uint32_t vertexBufferBinds = 0;
+        uint32_t vertexBufferBindsSkipped = 0;
+        uint32_t indexBufferBinds = 0;
+        uint32_t indexBufferBindsSkipped = 0;
+
+        void add(const statistics & other);
+    };
+
+    drawQueue();
+
+    // Drops the draws and the handle ids, at most 4096 of each kind of handle can
+    // be submitted in between
+    void clear();
+
+    // depth is view space distance, nearer draws sort first within the same state
+    void submit(uint32_t pass, float depth, const draw & aDraw);
+
+    // LSD radix sort of the keys, 8 bits per pass
+    void sort();
+
+    // Inside a render pass.  Sorts first if anything was submitted since.
+    void record(VkCommandBuffer commandBuffer);
+
+    // Draws [first, last) of the sorted order, binding everything the first one
+    // needs.  Call sort() first.  Several ranges can be recorded at once into
+    // different command buffers, counting into different statistics.
+    void record(VkCommandBuffer commandBuffer, size_t first, size_t last, statistics & counts) const;
+
+    size_t size() const;
+
+    const statistics & getStatistics() const;
+
+    static uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t descriptorSet, uint32_t mesh, float depth);
+
+private:
+    // small id for a handle, for the key, numbered in the order handles are first
+    // submitted after clear()
+    uint32_t getId(std::unordered_map<uint64_t, uint32_t> & ids, uint64_t handle);
+
+private:
+    std::vector<draw> _draws;
+    std::vector<uint64_t> _keys;
+    std::vector<uint32_t> _order;
+    bool _sorted;
+
+    // the same submissions get the same ids every frame, so the order is stable too
+    std::unordered_map<uint64_t, uint32_t> _pipelineIds;
+    std::unordered_map<uint64_t, uint32_t> _descriptorSetIds;
+    std::unordered_map<uint64_t, uint32_t> _meshIds;
+
+    statistics _statistics;
+};
+
+#endif /* drawQueue_hpp */
@@ -0,0 +1,322 @@
+//
+//  frustumCulling.cpp
+//  vulkanTesting
+//
+
+#include "frustumCulling.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FRUSTUM_CULLING_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define FRUSTUM_CULLING_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    // Below this many objects per thread, starting a thread costs more than it saves
+    const size_t minimumObjectsPerThread = 16384;
+
+    // Visible indices are written through a pointer into space reserved up front
+    size_t cullRangeScalar(const frustumCulling::spheres & bounds,
+                           const frustumCulling::frustum & view,
+                           size_t first,
+                           size_t last,
+                           uint32_t * out)
+    {
+        uint32_t * start = out;
+        for (size_t i = first; i < last; ++i)
+        {
+            bool inside = true;
+            for (const glm::vec4 & plane : view.planes)
+            {
+                float distance = plane.x * bounds.x[i] + plane.y * bounds.y[i] + plane.z * bounds.z[i] + plane.w;
+                inside = inside && distance >= -bounds.radius[i];
+            }
+            *out = static_cast<uint32_t>(i);
+            out += inside ? 1 : 0;
+        }
+        return static_cast<size_t>(out - start);
+    }
+
+    // One bit per lane, lowest lane first
+    uint32_t * appendLanes(uint32_t mask, size_t base, uint32_t * out)
+    {
+        while (mask != 0)
+        {
+            *out++ = static_cast<uint32_t>(base + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+        return out;
+    }
+
+#ifdef FRUSTUM_CULLING_X86
+    bool cpuHasAvx2()
+    {
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        {
+            return false;
+        }
+        // VEX encoded instructions also need the OS to save the AVX registers
+        if ((ecx & bit_FMA) == 0 || (ecx & bit_OSXSAVE) == 0 || (ecx & bit_AVX) == 0)
+        {
+            return false;
+        }
+        unsigned xcrLow, xcrHigh;
+        __asm__("xgetbv" : "=a"(xcrLow), "=d"(xcrHigh) : "c"(0));
+        if ((xcrLow & 6u) != 6u)
+        {
+            return false;
+        }
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        {
+            return false;
+        }
+        return (ebx & bit_AVX2) != 0;
+    }
+
+    const bool hasAvx2 = cpuHasAvx2();
+
+    __attribute__((target("avx2,fma")))
+    size_t cullRangeAvx2(const frustumCulling::spheres & bounds,
+                         const frustumCulling::frustum & view,
+                         size_t first,
+                         size_t last,
+                         uint32_t * out)
+    {
+        uint32_t * start = out;
+
+        __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+        for (int p = 0; p < 6; ++p)
+        {
+            planeX[p] = _mm256_set1_ps(view.planes[p].x);
+            planeY[p] = _mm256_set1_ps(view.planes[p].y);
+            planeZ[p] = _mm256_set1_ps(view.planes[p].z);
+            planeW[p] = _mm256_set1_ps(view.planes[p].w);
+        }
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+        size_t i = first;
+        for (; i + 8 <= last; i += 8)
+        {
+            __m256 x = _mm256_loadu_ps(&bounds.x[i]);
+            __m256 y = _mm256_loadu_ps(&bounds.y[i]);
+            __m256 z = _mm256_loadu_ps(&bounds.z[i]);
+            __m256 negativeRadius = _mm256_xor_ps(_mm256_loadu_ps(&bounds.radius[i]), signMask);
+
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p = 0; p < 6; ++p)
+            {
+                __m256 distance = _mm256_fmadd_ps(planeX[p], x, _mm256_fmadd_ps(planeY[p], y, _mm256_fmadd_ps(planeZ[p], z, planeW[p])));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+            }
+            out = appendLanes(static_cast<uint32_t>(_mm256_movemask_ps(inside)), i, out);
+        }
+
+        out += cullRangeScalar(bounds, view, i, last, out);
+        return static_cast<size_t>(out - start);
+    }
+#endif
+
+#ifdef FRUSTUM_CULLING_NEON
+    // Two four lane halves per iteration, 8 objects like the AVX2 kernel
+    size_t cullRangeNeon(const frustumCulling::spheres & bounds,
+                         const frustumCulling::frustum & view,
+                         size_t first,
+                         size_t last,
+                         uint32_t * out)
+    {
+        uint32_t * start = out;
+        const uint32x4_t laneBits = {1u, 2u, 4u, 8u};
+
+        size_t i = first;
+        for (; i + 8 <= last; i += 8)
+        {
+            uint32_t mask = 0;
+            for (size_t half = 0; half < 8; half += 4)
+            {
+                float32x4_t x = vld1q_f32(&bounds.x[i + half]);
+                float32x4_t y = vld1q_f32(&bounds.y[i + half]);
+                float32x4_t z = vld1q_f32(&bounds.z[i + half]);
+                float32x4_t negativeRadius = vnegq_f32(vld1q_f32(&bounds.radius[i + half]));
+
+                uint32x4_t inside = vdupq_n_u32(0xFFFFFFFFu);
+                for (const glm::vec4 & plane : view.planes)
+                {
+                    float32x4_t distance = vfmaq_n_f32(vfmaq_n_f32(vfmaq_n_f32(vdupq_n_f32(plane.w), z, plane.z), y, plane.y), x, plane.x);
+                    inside = vandq_u32(inside, vcgeq_f32(distance, negativeRadius));
+                }
+                mask |= vaddvq_u32(vandq_u32(inside, laneBits)) << half;
+            }
+            out = appendLanes(mask, i, out);
+        }
+
+        out += cullRangeScalar(bounds, view, i, last, out);
+        return static_cast<size_t>(out - start);
+    }
+#endif
+
+    size_t cullRange(const frustumCulling::spheres & bounds,
+                     const frustumCulling::frustum & view,
+                     size_t first,
+                     size_t last,
+                     uint32_t * out)
+    {
+#if defined(FRUSTUM_CULLING_X86)
+        if (hasAvx2)
+        {
+            return cullRangeAvx2(bounds, view, first, last, out);
+        }
+#elif defined(FRUSTUM_CULLING_NEON)
+        return cullRangeNeon(bounds, view, first, last, out);
+#endif
+        return cullRangeScalar(bounds, view, first, last, out);
+    }
+
+    // Chunks are a multiple of 8 objects long and cull straight into their own
+    // part of visible; closeUp then moves the parts together in order
+    size_t chunkLength(size_t count, size_t chunkCount)
+    {
+        return ((count + chunkCount - 1) / chunkCount + 7) & ~static_cast<size_t>(7);
+    }
+
+    void closeUp(size_t count, size_t perChunk, const std::vector<size_t> & found, std::vector<uint32_t> & visible)
+    {
+        size_t total = found[0];
+        for (size_t c = 1; c < found.size(); ++c)
+        {
+            size_t first = std::min(count, c * perChunk);
+            std::copy(visible.begin() + first, visible.begin() + first + found[c], visible.begin() + total);
+            total += found[c];
+        }
+        visible.resize(total);
+    }
+}
+
+void frustumCulling::spheres::resize(size_t count)
+{
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    radius.resize(count);
+}
+
+size_t frustumCulling::spheres::size() const
+{
+    return radius.size();
+}
+
+void frustumCulling::spheres::set(size_t index, const glm::vec3 & center, float sphereRadius)
+{
+    x[index] = center.x;
+    y[index] = center.y;
+    z[index] = center.z;
+    radius[index] = sphereRadius;
+}
+
+frustumCulling::frustum frustumCulling::extractPlanes(const glm::mat4 & viewProjection)
+{
+    // Each plane is the last row of the matrix plus or minus another row
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+
+    frustum view;
+    view.planes[0] = rows[3] + rows[0]; // left
+    view.planes[1] = rows[3] - rows[0]; // right
+    view.planes[2] = rows[3] + rows[1]; // bottom
+    view.planes[3] = rows[3] - rows[1]; // top
+    view.planes[4] = rows[3] + rows[2]; // near
+    view.planes[5] = rows[3] - rows[2]; // far
+
+    for (glm::vec4 & plane : view.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return view;
+}
+
+void frustumCulling::cull(const spheres & bounds, const frustum & view, size_t first, size_t last, std::vector<uint32_t> & visible)
+{
+    size_t start = visible.size();
+    visible.resize(start + (last - first));
+    visible.resize(start + cullRange(bounds, view, first, last, visible.data() + start));
+}
+
+void frustumCulling::cullScalar(const spheres & bounds, const frustum & view, size_t first, size_t last, std::vector<uint32_t> & visible)
+{
+    size_t start = visible.size();
+    visible.resize(start + (last - first));
+    visible.resize(start + cullRangeScalar(bounds, view, first, last, visible.data() + start));
+}
+
+void frustumCulling::cullParallel(const spheres & bounds, const frustum & view, std::vector<uint32_t> & visible, unsigned threadCount)
+{
+    size_t count = bounds.size();
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threadCount, count / minimumObjectsPerThread)));
+
+    // every thread culls a contiguous range, the calling thread the first
+    visible.resize(count);
+    size_t perThread = chunkLength(count, threadCount);
+    std::vector<size_t> found(threadCount, 0);
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < threadCount; ++t)
+    {
+        size_t first = std::min(count, t * perThread);
+        size_t last = std::min(count, first + perThread);
+        threads.emplace_back([&, t, first, last]() {
+            found[t] = cullRange(bounds, view, first, last, visible.data() + first);
+        });
+    }
+    found[0] = cullRange(bounds, view, 0, std::min(count, perThread), visible.data());
+
+    for (std::thread & thread : threads)
+    {
+        thread.join();
+    }
+
+    closeUp(count, perThread, found, visible);
+}
+
+void frustumCulling::cullParallel(const spheres & bounds, const frustum & view, std::vector<uint32_t> & visible, jobSystem & jobs)
+{
+    size_t count = bounds.size();
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(jobs.threadCount(), count / minimumObjectsPerThread));
+
+    visible.resize(count);
+    size_t perChunk = chunkLength(count, chunkCount);
+    std::vector<size_t> found(chunkCount, 0);
+    jobSystem::counter done;
+    for (size_t c = 0; c < chunkCount; ++c)
+    {
+        size_t first = std::min(count, c * perChunk);
+        size_t last = std::min(count, first + perChunk);
+        jobs.run([&, c, first, last]() {
+            found[c] = cullRange(bounds, view, first, last, visible.data() + first);
+        }, &done);
+    }
+    jobs.wait(done);
+
+    closeUp(count, perChunk, found, visible);
+}
+
+const char * frustumCulling::kernelName()
+{
+#if defined(FRUSTUM_CULLING_X86)
+    return hasAvx2 ? "avx2" : "scalar";
+#elif defined(FRUSTUM_CULLING_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,64 @@
+//
+//  frustumCulling.hpp
+//  vulkanTesting
+//
+
+#ifndef frustumCulling_hpp
+#define frustumCulling_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "jobSystem.hpp"
+
+// CPU visibility for devices without the GPU culling path.  Bounding spheres are
+// stored as a structure of arrays so one AVX2 register (two NEON registers) holds
+// the same component of 8 objects, and each plane is tested against 8 objects
+// with three fused multiply adds.
+namespace frustumCulling {
+
+    // World space bounding spheres
+    struct spheres {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        std::vector<float> radius;
+
+        void resize(size_t count);
+
+        size_t size() const;
+
+        void set(size_t index, const glm::vec3 & center, float sphereRadius);
+    };
+
+    // Normalized planes pointing inwards: left, right, bottom, top, near, far
+    struct frustum {
+        glm::vec4 planes[6];
+    };
+
+    // Gribb & Hartmann extraction from the projection * view the vertex shader uses.
+    // The near plane assumes -1..1 depth, which is conservative for 0..1.
+    frustum extractPlanes(const glm::mat4 & viewProjection);
+
+    // Appends the indices in [first, last) of the spheres that touch the frustum,
+    // in ascending order.  Uses AVX2 or NEON when the CPU has it.
+    void cull(const spheres & bounds, const frustum & view, size_t first, size_t last, std::vector<uint32_t> & visible);
+
+    // Same result without SIMD, the reference for the kernels
+    void cullScalar(const spheres & bounds, const frustum & view, size_t first, size_t last, std::vector<uint32_t> & visible);
+
+    // All spheres, split across threadCount threads (0 means one per hardware
+    // thread).  Small inputs stay on the calling thread.  visible is replaced.
+    void cullParallel(const spheres & bounds, const frustum & view, std::vector<uint32_t> & visible, unsigned threadCount = 0);
+
+    // Same, with the ranges run as tasks of jobs
+    void cullParallel(const spheres & bounds, const frustum & view, std::vector<uint32_t> & visible, jobSystem & jobs);
+
+    // "avx2", "neon" or "scalar", whichever cull runs on this CPU
+    const char * kernelName();
+}
+
+#endif /* frustumCulling_hpp */
@@ -0,0 +1,108 @@
+//
+//  instanceBuffer.cpp
+//  vulkanTesting
+//
+
+#include <cstddef>
+#include <stdexcept>
+
+#include "instanceBuffer.hpp"
+#include "memory.hpp"
+
+VkVertexInputBindingDescription instanceData::getBindingDescription(uint32_t binding)
+{
+    VkVertexInputBindingDescription bindingDescription = {};
+
+    bindingDescription.binding = binding;
+    bindingDescription.stride = sizeof(instanceData);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    return bindingDescription;
+}
+
+std::array<VkVertexInputAttributeDescription, 6> instanceData::getAttributeDescriptions(uint32_t binding, uint32_t firstLocation)
+{
+    std::array<VkVertexInputAttributeDescription, 6> attributeDescriptions = {};
+
+    // a mat4 attribute is four vec4 columns at consecutive locations
+    for (uint32_t column = 0; column < 4; ++column)
+    {
+        attributeDescriptions[column].binding = binding;
+        attributeDescriptions[column].location = firstLocation + column;
+        attributeDescriptions[column].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributeDescriptions[column].offset = static_cast<uint32_t>(offsetof(instanceData, model) + column * sizeof(glm::vec4));
+    }
+
+    attributeDescriptions[4].binding = binding;
+    attributeDescriptions[4].location = firstLocation + 4;
+    attributeDescriptions[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    attributeDescriptions[4].offset = offsetof(instanceData, color);
+
+    attributeDescriptions[5].binding = binding;
+    attributeDescriptions[5].location = firstLocation + 5;
+    attributeDescriptions[5].format = VK_FORMAT_R32_UINT;
+    attributeDescriptions[5].offset = offsetof(instanceData, materialId);
+
+    return attributeDescriptions;
+}
+
+instanceBuffer::instanceBuffer() : _buffer(VK_NULL_HANDLE),
+                                   _bufferMemory(VK_NULL_HANDLE),
+                                   _mapped(nullptr),
+                                   _capacity(0),
+                                   _segmentCount(0)
+{
+}
+
+void instanceBuffer::create(VkDevice & device, VkPhysicalDevice & physicalDevice, uint32_t capacity, uint32_t segmentCount)
+{
+    _capacity = capacity;
+    _segmentCount = segmentCount;
+
+    // Coherent, so writes through the mapping need no flush before the submit.
+    // Also a storage buffer, so a culling pass can read the transforms.
+    VkDeviceSize size = getOffset(segmentCount);
+    memory::createBuffer(device, physicalDevice, size,
+                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                         _buffer, _bufferMemory);
+
+    // Mapped once for the lifetime of the buffer instead of every frame
+    void * data;
+    if (vkMapMemory(device, _bufferMemory, 0, size, 0, &data) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map instance buffer!");
+    }
+    _mapped = static_cast<instanceData *>(data);
+}
+
+void instanceBuffer::destroy(VkDevice & device)
+{
+    if (_buffer != VK_NULL_HANDLE)
+    {
+        vkUnmapMemory(device, _bufferMemory);
+        vkDestroyBuffer(device, _buffer, nullptr);
+        vkFreeMemory(device, _bufferMemory, nullptr);
+        _buffer = VK_NULL_HANDLE;
+        _mapped = nullptr;
+    }
+}
+
+instanceData * instanceBuffer::getInstances(uint32_t segment)
+{
+    return _mapped + static_cast<size_t>(segment % _segmentCount) * _capacity;
+}
+
+VkDeviceSize instanceBuffer::getOffset(uint32_t segment) const
+{
+    return static_cast<VkDeviceSize>(segment) * _capacity * sizeof(instanceData);
+}
+
+VkBuffer & instanceBuffer::getBuffer()
+{
+    return _buffer;
+}
+
+uint32_t instanceBuffer::capacity() const
+{
+    return _capacity;
+}
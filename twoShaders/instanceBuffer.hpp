@@ -0,0 +1,59 @@
+//
+//  instanceBuffer.hpp
+//  vulkanTesting
+//
+
+#ifndef instanceBuffer_hpp
+#define instanceBuffer_hpp
+
+#include <array>
+
+#include <glm/glm.hpp>
+
+#include "window.hpp"
+
+// Per instance vertex attributes, read with VK_VERTEX_INPUT_RATE_INSTANCE
+struct instanceData {
+    glm::mat4 model;
+    glm::vec4 color;
+    uint32_t materialId;
+    uint32_t padding[3]; // keeps every instance 16 byte aligned
+
+    static VkVertexInputBindingDescription getBindingDescription(uint32_t binding);
+
+    // the model matrix takes one location per column, then color and material id
+    static std::array<VkVertexInputAttributeDescription, 6> getAttributeDescriptions(uint32_t binding, uint32_t firstLocation);
+};
+
+// A persistently mapped, host visible ring of instance data with one segment per
+// frame, so the CPU fills one frame's instances while the GPU reads another's.
+// N copies of a mesh are then a single draw with instanceCount N and the
+// segment's offset bound as the instance vertex buffer.
+class instanceBuffer
+{
+public:
+    instanceBuffer();
+
+    void create(VkDevice & device, VkPhysicalDevice & physicalDevice, uint32_t capacity, uint32_t segmentCount);
+
+    void destroy(VkDevice & device);
+
+    // the mapped instances of a segment, capacity() of them
+    instanceData * getInstances(uint32_t segment);
+
+    // offset to bind for a segment
+    VkDeviceSize getOffset(uint32_t segment) const;
+
+    VkBuffer & getBuffer();
+
+    uint32_t capacity() const;
+
+private:
+    VkBuffer _buffer;
+    VkDeviceMemory _bufferMemory;
+    instanceData * _mapped;
+    uint32_t _capacity;
+    uint32_t _segmentCount;
+};
+
+#endif /* instanceBuffer_hpp */
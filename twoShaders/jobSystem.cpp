@@ -0,0 +1,455 @@
+//
+//  jobSystem.cpp
+//  vulkanTesting
+//
+
+#include "jobSystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    // per worker, a power of two; a worker whose deque is full shares the overflow
+    const size_t queueCapacity = 4096;
+
+    // failed searches before an idle worker sleeps
+    const int spinsBeforeSleep = 64;
+
+    // A push can miss a worker that is just going to sleep, so sleeps are short
+    const std::chrono::milliseconds sleepTimeout(1);
+
+    thread_local const jobSystem * currentSystem = nullptr;
+    thread_local int currentWorker = -1;
+    thread_local uint32_t stealSeed = 0x9E3779B9u;
+
+    uint32_t nextRandom()
+    {
+        // xorshift, only spreads the victims
+        stealSeed ^= stealSeed << 13;
+        stealSeed ^= stealSeed >> 17;
+        stealSeed ^= stealSeed << 5;
+        return stealSeed;
+    }
+}
+
+struct jobSystem::job {
+    std::function<void()> task;
+    counter * done;
+    bool mainThread;
+};
+
+jobSystem::counter::counter() : _pending(0)
+{
+}
+
+uint32_t jobSystem::counter::pending() const
+{
+    return _pending.load(std::memory_order_acquire);
+}
+
+jobSystem::workQueue::workQueue(size_t capacity) : _ring(new std::atomic<job *>[capacity]),
+                                                   _mask(static_cast<int64_t>(capacity) - 1),
+                                                   _top(0),
+                                                   _bottom(0)
+{
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        _ring[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+bool jobSystem::workQueue::push(job * aJob)
+{
+    int64_t bottom = _bottom.load(std::memory_order_relaxed);
+    int64_t top = _top.load(std::memory_order_acquire);
+    if (bottom - top > _mask)
+    {
+        return false;
+    }
+    // published to thieves by the release of the new bottom
+    _ring[bottom & _mask].store(aJob, std::memory_order_relaxed);
+    _bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+}
+
+jobSystem::job * jobSystem::workQueue::pop()
+{
+    int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = _top.load(std::memory_order_relaxed);
+
+    if (top > bottom)
+    {
+        // empty
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    job * aJob = _ring[bottom & _mask].load(std::memory_order_relaxed);
+    if (top == bottom)
+    {
+        // the last one, a thief may be taking it too
+        if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            aJob = nullptr;
+        }
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return aJob;
+}
+
+jobSystem::job * jobSystem::workQueue::steal()
+{
+    int64_t top = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = _bottom.load(std::memory_order_acquire);
+    if (top >= bottom)
+    {
+        return nullptr;
+    }
+
+    job * aJob = _ring[top & _mask].load(std::memory_order_relaxed);
+    if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+    {
+        // lost to the owner or another thief
+        return nullptr;
+    }
+    return aJob;
+}
+
+jobSystem::jobSystem() : _running(false),
+                         _sharedCount(0),
+                         _sleeping(0)
+{
+}
+
+jobSystem::~jobSystem()
+{
+    if (_running.load())
+    {
+        destroy();
+    }
+}
+
+void jobSystem::create(unsigned threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    _mainThread = std::this_thread::get_id();
+    _running.store(true);
+    for (unsigned i = 0; i < threadCount; ++i)
+    {
+        _queues.emplace_back(new workQueue(queueCapacity));
+    }
+
+    // the calling thread is worker 0 and works while it waits
+    currentSystem = this;
+    currentWorker = 0;
+    for (unsigned worker = 1; worker < threadCount; ++worker)
+    {
+        _threads.emplace_back(&jobSystem::workerLoop, this, static_cast<int>(worker));
+    }
+}
+
+void jobSystem::destroy()
+{
+    _running.store(false);
+    {
+        std::lock_guard<std::mutex> lock(_sleepLock);
+        _wake.notify_all();
+    }
+    for (std::thread & thread : _threads)
+    {
+        thread.join();
+    }
+    _threads.clear();
+
+    for (std::unique_ptr<workQueue> & queue : _queues)
+    {
+        while (job * aJob = queue->pop())
+        {
+            delete aJob;
+        }
+    }
+    _queues.clear();
+    for (job * aJob : _shared)
+    {
+        delete aJob;
+    }
+    for (job * aJob : _mainThreadJobs)
+    {
+        delete aJob;
+    }
+    _shared.clear();
+    _mainThreadJobs.clear();
+    _sharedCount.store(0);
+
+    if (currentSystem == this)
+    {
+        currentSystem = nullptr;
+        currentWorker = -1;
+    }
+}
+
+void jobSystem::run(std::function<void()> task, counter * done, counter * after)
+{
+    if (done != nullptr)
+    {
+        done->_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    submit(new job{std::move(task), done, false}, after);
+}
+
+void jobSystem::runOnMainThread(std::function<void()> task, counter * done, counter * after)
+{
+    if (done != nullptr)
+    {
+        done->_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    submit(new job{std::move(task), done, true}, after);
+}
+
+void jobSystem::submit(job * aJob, counter * after)
+{
+    if (after != nullptr)
+    {
+        // checked under the lock the last task of after takes to release its waiters
+        std::lock_guard<std::mutex> lock(after->_lock);
+        if (after->_pending.load(std::memory_order_acquire) > 0)
+        {
+            after->_waiting.push_back(aJob);
+            return;
+        }
+    }
+    schedule(aJob);
+}
+
+void jobSystem::schedule(job * aJob)
+{
+    bool queued = false;
+    if (!aJob->mainThread && currentSystem == this && currentWorker >= 0)
+    {
+        queued = _queues[currentWorker]->push(aJob);
+    }
+    if (!queued)
+    {
+        std::lock_guard<std::mutex> lock(_sharedLock);
+        if (aJob->mainThread)
+        {
+            _mainThreadJobs.push_back(aJob);
+        }
+        else
+        {
+            _shared.push_back(aJob);
+        }
+        _sharedCount.fetch_add(1, std::memory_order_release);
+    }
+
+    if (_sleeping.load(std::memory_order_acquire) > 0)
+    {
+        _wake.notify_one();
+    }
+}
+
+void jobSystem::execute(job * aJob)
+{
+    counter * done = aJob->done;
+    std::exception_ptr error;
+    try
+    {
+        aJob->task();
+    }
+    catch (...)
+    {
+        if (done == nullptr)
+        {
+            throw;
+        }
+        error = std::current_exception();
+    }
+    delete aJob;
+
+    if (done == nullptr)
+    {
+        return;
+    }
+
+    // under the lock, so a waiter that sees the counter drain cannot destroy it
+    // while it is still being used here
+    std::vector<job *> released;
+    {
+        std::lock_guard<std::mutex> lock(done->_lock);
+        if (error && !done->_error)
+        {
+            done->_error = error;
+        }
+        if (done->_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            released.swap(done->_waiting);
+        }
+    }
+    for (job * waiting : released)
+    {
+        schedule(waiting);
+    }
+}
+
+jobSystem::job * jobSystem::find(int worker)
+{
+    if (worker >= 0)
+    {
+        if (job * aJob = _queues[worker]->pop())
+        {
+            return aJob;
+        }
+    }
+
+    if (_sharedCount.load(std::memory_order_acquire) > 0)
+    {
+        std::lock_guard<std::mutex> lock(_sharedLock);
+        std::deque<job *> * source = nullptr;
+        if (!_mainThreadJobs.empty() && isMainThread())
+        {
+            source = &_mainThreadJobs;
+        }
+        else if (!_shared.empty())
+        {
+            source = &_shared;
+        }
+        if (source != nullptr)
+        {
+            job * aJob = source->front();
+            source->pop_front();
+            _sharedCount.fetch_sub(1, std::memory_order_relaxed);
+            return aJob;
+        }
+    }
+
+    size_t queueCount = _queues.size();
+    size_t start = nextRandom() % queueCount;
+    for (size_t i = 0; i < queueCount; ++i)
+    {
+        size_t victim = (start + i) % queueCount;
+        if (static_cast<int>(victim) == worker)
+        {
+            continue;
+        }
+        if (job * aJob = _queues[victim]->steal())
+        {
+            return aJob;
+        }
+    }
+    return nullptr;
+}
+
+void jobSystem::workerLoop(int worker)
+{
+    currentSystem = this;
+    currentWorker = worker;
+    stealSeed ^= static_cast<uint32_t>(worker) * 0x85EBCA6Bu;
+
+    int idle = 0;
+    while (_running.load(std::memory_order_acquire))
+    {
+        if (job * aJob = find(worker))
+        {
+            execute(aJob);
+            idle = 0;
+            continue;
+        }
+        if (++idle < spinsBeforeSleep)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_sleepLock);
+        _sleeping.fetch_add(1, std::memory_order_acq_rel);
+        _wake.wait_for(lock, sleepTimeout);
+        _sleeping.fetch_sub(1, std::memory_order_acq_rel);
+        idle = 0;
+    }
+}
+
+void jobSystem::wait(counter & done)
+{
+    int worker = (currentSystem == this) ? currentWorker : -1;
+    while (done._pending.load(std::memory_order_acquire) > 0)
+    {
+        if (job * aJob = find(worker))
+        {
+            execute(aJob);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    // the last task may still hold the lock while it releases the waiters
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(done._lock);
+        std::swap(error, done._error);
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void jobSystem::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> & body)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // a few chunks per thread so stealing can even out uneven chunks
+    grain = std::max<size_t>(1, grain);
+    size_t chunkCount = std::min<size_t>((count + grain - 1) / grain, 4 * threadCount());
+    chunkCount = std::max<size_t>(1, chunkCount);
+    size_t perChunk = (count + chunkCount - 1) / chunkCount;
+
+    counter done;
+    for (size_t first = 0; first < count; first += perChunk)
+    {
+        size_t last = std::min(count, first + perChunk);
+        run([&body, first, last]() { body(first, last); }, &done);
+    }
+    wait(done);
+}
+
+void jobSystem::runMainThreadJobs()
+{
+    while (true)
+    {
+        job * aJob = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(_sharedLock);
+            if (_mainThreadJobs.empty())
+            {
+                return;
+            }
+            aJob = _mainThreadJobs.front();
+            _mainThreadJobs.pop_front();
+            _sharedCount.fetch_sub(1, std::memory_order_relaxed);
+        }
+        execute(aJob);
+    }
+}
+
+unsigned jobSystem::threadCount() const
+{
+    return static_cast<unsigned>(_queues.size());
+}
+
+bool jobSystem::isMainThread() const
+{
+    return std::this_thread::get_id() == _mainThread;
+}
@@ -0,0 +1,136 @@
+//
+//  jobSystem.hpp
+//  vulkanTesting
+//
+
+#ifndef jobSystem_hpp
+#define jobSystem_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work stealing task scheduler.  Every worker, the main thread included, owns a
+// Chase-Lev deque: it pushes and pops its own end without locking and idle
+// workers steal from the other end.  Tasks report to a counter when they finish
+// and can be held back until another counter drains, which is how dependencies
+// are expressed.  wait() runs other tasks until its counter drains instead of
+// blocking, so waiting inside a task cannot deadlock the pool.
+//
+// The thread that calls create() is the main thread.  Tasks given to
+// runOnMainThread() only run there, for work tied to it such as window calls.
+class jobSystem
+{
+    struct job;
+
+public:
+    // Outstanding tasks.  Must outlive every task that reports to it or waits on it.
+    class counter
+    {
+    public:
+        counter();
+
+        uint32_t pending() const;
+
+    private:
+        friend class jobSystem;
+
+        std::atomic<uint32_t> _pending;
+
+        // tasks held back until _pending drains, and the first exception a task threw
+        std::mutex _lock;
+        std::vector<job *> _waiting;
+        std::exception_ptr _error;
+    };
+
+    jobSystem();
+
+    ~jobSystem();
+
+    // threadCount includes the calling thread, 0 means one per hardware thread
+    void create(unsigned threadCount = 0);
+
+    // Waits for the workers to finish what they are running; queued tasks are dropped
+    void destroy();
+
+    // done, if given, counts the task until it has run and keeps the first
+    // exception a task throws for wait() to rethrow; a task without one must not
+    // throw.  after, if given, holds the task back until that counter drains.
+    void run(std::function<void()> task, counter * done = nullptr, counter * after = nullptr);
+
+    void runOnMainThread(std::function<void()> task, counter * done = nullptr, counter * after = nullptr);
+
+    // Runs tasks, and on the main thread main thread tasks, until done drains.
+    // Rethrows the first exception of a task that counted on done.
+    void wait(counter & done);
+
+    // body(first, last) over [0, count) in chunks of at least grain, returns when all ran
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> & body);
+
+    // Main thread only: runs the queued main thread tasks, e.g. once per frame
+    void runMainThreadJobs();
+
+    unsigned threadCount() const;
+
+    bool isMainThread() const;
+
+private:
+    // Chase-Lev deque over a fixed ring; push fails when it is full
+    class workQueue
+    {
+    public:
+        explicit workQueue(size_t capacity);
+
+        bool push(job * aJob);
+
+        // owner only, newest first
+        job * pop();
+
+        // any thread, oldest first
+        job * steal();
+
+    private:
+        std::unique_ptr<std::atomic<job *>[]> _ring;
+        int64_t _mask;
+        std::atomic<int64_t> _top;
+        std::atomic<int64_t> _bottom;
+    };
+
+    void schedule(job * aJob);
+
+    void submit(job * aJob, counter * after);
+
+    void execute(job * aJob);
+
+    // one task from anywhere this thread may take it from, or nullptr
+    job * find(int worker);
+
+    void workerLoop(int worker);
+
+private:
+    std::vector<std::unique_ptr<workQueue>> _queues;
+    std::vector<std::thread> _threads;
+    std::thread::id _mainThread;
+    std::atomic<bool> _running;
+
+    // tasks from threads that are not workers, and main thread tasks
+    std::mutex _sharedLock;
+    std::deque<job *> _shared;
+    std::deque<job *> _mainThreadJobs;
+    std::atomic<size_t> _sharedCount; // both, read without the lock
+
+    // idle workers sleep here after spinning for a while
+    std::mutex _sleepLock;
+    std::condition_variable _wake;
+    std::atomic<uint32_t> _sleeping;
+};
+
+#endif /* jobSystem_hpp */
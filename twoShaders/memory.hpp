@@ -0,0 +1,25 @@
+//
+//  memory.hpp
+//  vulkanTesting
+//
+
+#ifndef memory_hpp
+#define memory_hpp
+
+#include "window.hpp"
+
+// Buffer allocation shared by the classes that own their own buffers
+namespace memory {
+
+    uint32_t findMemoryType(VkPhysicalDevice & physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+    void createBuffer(VkDevice & device,
+                      VkPhysicalDevice & physicalDevice,
+                      VkDeviceSize size,
+                      VkBufferUsageFlags usage,
+                      VkMemoryPropertyFlags properties,
+                      VkBuffer & buffer,
+                      VkDeviceMemory & bufferMemory);
+}
+
+#endif /* memory_hpp */
@@ -0,0 +1,297 @@
+//
+//  objectCulling.cpp
+//  vulkanTesting
+//
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#include "objectCulling.hpp"
+#include "frustumCulling.hpp"
+#include "memory.hpp"
+
+namespace
+{
+    // Matches ObjectCullingUniformBufferObject in objectCull.comp
+    struct ObjectCullingUniformBufferObject {
+        glm::vec4 planes[6];
+        uint32_t objectCount;
+        uint32_t instanceOffset;
+        uint32_t compact;
+        uint32_t padding;
+    };
+
+    const uint32_t workgroupSize = 64;
+}
+
+objectCulling::objectCulling() : _objectCount(0),
+                                 _objectCapacity(0),
+                                 _drawIndirectCount(false),
+                                 _cmdDrawIndexedIndirectCount(nullptr),
+                                 _objectBuffer(VK_NULL_HANDLE),
+                                 _objectBufferMemory(VK_NULL_HANDLE),
+                                 _descriptorSetLayout(VK_NULL_HANDLE),
+                                 _descriptorPool(VK_NULL_HANDLE),
+                                 _pipelineLayout(VK_NULL_HANDLE),
+                                 _pipeline(VK_NULL_HANDLE)
+{
+}
+
+void objectCulling::create(VkDevice & device,
+                           VkPhysicalDevice & physicalDevice,
+                           VkShaderModule & computeShader,
+                           const std::vector<object> & objects,
+                           VkBuffer & instanceBuffer,
+                           uint32_t imageCount,
+                           bool drawIndirectCount)
+{
+    _objectCount = static_cast<uint32_t>(objects.size());
+    _objectCapacity = _objectCount;
+    _drawIndirectCount = drawIndirectCount;
+
+    if (_drawIndirectCount)
+    {
+        // An extension command on a 1.0 device, so it comes through the loader
+        _cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+            vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+        if (_cmdDrawIndexedIndirectCount == nullptr)
+        {
+            throw std::runtime_error("failed to load vkCmdDrawIndexedIndirectCountKHR!");
+        }
+    }
+
+    createBuffers(device, physicalDevice, objects, imageCount);
+    createPipeline(device, computeShader);
+    createDescriptorSets(device, instanceBuffer, imageCount);
+}
+
+void objectCulling::createBuffers(VkDevice & device, VkPhysicalDevice & physicalDevice, const std::vector<object> & objects, uint32_t imageCount)
+{
+    // Objects do not change after creation; small enough to read from host memory
+    VkDeviceSize objectsSize = sizeof(object) * objects.size();
+    memory::createBuffer(device, physicalDevice, objectsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                         _objectBuffer, _objectBufferMemory);
+
+    void * data;
+    vkMapMemory(device, _objectBufferMemory, 0, objectsSize, 0, &data);
+    memcpy(data, objects.data(), static_cast<size_t>(objectsSize));
+    vkUnmapMemory(device, _objectBufferMemory);
+
+    _uniformBuffers.resize(imageCount);
+    _uniformBuffersMemory.resize(imageCount);
+    _drawCommandBuffers.resize(imageCount);
+    _drawCommandBuffersMemory.resize(imageCount);
+    _drawCountBuffers.resize(imageCount);
+    _drawCountBuffersMemory.resize(imageCount);
+
+    for (uint32_t i = 0; i < imageCount; i++) {
+        memory::createBuffer(device, physicalDevice, sizeof(ObjectCullingUniformBufferObject), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             _uniformBuffers[i], _uniformBuffersMemory[i]);
+
+        // only the GPU touches the commands and the count
+        memory::createBuffer(device, physicalDevice, sizeof(VkDrawIndexedIndirectCommand) * objects.size(),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             _drawCommandBuffers[i], _drawCommandBuffersMemory[i]);
+
+        memory::createBuffer(device, physicalDevice, sizeof(uint32_t),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             _drawCountBuffers[i], _drawCountBuffersMemory[i]);
+    }
+}
+
+void objectCulling::createPipeline(VkDevice & device, VkShaderModule & computeShader)
+{
+    // 0 culling uniform, 1 instances, 2 objects, 3 draw commands, 4 draw count
+    std::array<VkDescriptorSetLayoutBinding, 5> bindings = {};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = (i == 0) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create object culling descriptor set layout!");
+    }
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &_descriptorSetLayout;
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create object culling pipeline layout!");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = computeShader;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = _pipelineLayout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create object culling pipeline!");
+    }
+}
+
+void objectCulling::createDescriptorSets(VkDevice & device, VkBuffer & instanceBuffer, uint32_t imageCount)
+{
+    std::array<VkDescriptorPoolSize, 2> poolSizes;
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount = imageCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = 4 * imageCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = imageCount;
+
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create object culling descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(imageCount, _descriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _descriptorPool;
+    allocInfo.descriptorSetCount = imageCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    _descriptorSets.resize(imageCount);
+    if (vkAllocateDescriptorSets(device, &allocInfo, _descriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate object culling descriptor sets!");
+    }
+
+    for (uint32_t i = 0; i < imageCount; i++)
+    {
+        // the whole instance ring, the uniform says where this image's segment starts
+        std::array<VkDescriptorBufferInfo, 5> bufferInfos = {};
+        bufferInfos[0] = {_uniformBuffers[i], 0, sizeof(ObjectCullingUniformBufferObject)};
+        bufferInfos[1] = {instanceBuffer, 0, VK_WHOLE_SIZE};
+        bufferInfos[2] = {_objectBuffer, 0, VK_WHOLE_SIZE};
+        bufferInfos[3] = {_drawCommandBuffers[i], 0, VK_WHOLE_SIZE};
+        bufferInfos[4] = {_drawCountBuffers[i], 0, VK_WHOLE_SIZE};
+
+        std::array<VkWriteDescriptorSet, 5> descriptorWrites = {};
+        for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+            descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet = _descriptorSets[i];
+            descriptorWrites[binding].dstBinding = binding;
+            descriptorWrites[binding].dstArrayElement = 0;
+            descriptorWrites[binding].descriptorType = (binding == 0) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[binding].descriptorCount = 1;
+            descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+        }
+
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+void objectCulling::destroy(VkDevice & device)
+{
+    if (_pipeline == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    vkDestroyPipeline(device, _pipeline, nullptr);
+    vkDestroyPipelineLayout(device, _pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(device, _descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, _descriptorSetLayout, nullptr);
+    _pipeline = VK_NULL_HANDLE;
+
+    for (size_t i = 0; i < _uniformBuffers.size(); i++) {
+        vkDestroyBuffer(device, _uniformBuffers[i], nullptr);
+        vkFreeMemory(device, _uniformBuffersMemory[i], nullptr);
+        vkDestroyBuffer(device, _drawCommandBuffers[i], nullptr);
+        vkFreeMemory(device, _drawCommandBuffersMemory[i], nullptr);
+        vkDestroyBuffer(device, _drawCountBuffers[i], nullptr);
+        vkFreeMemory(device, _drawCountBuffersMemory[i], nullptr);
+    }
+
+    vkDestroyBuffer(device, _objectBuffer, nullptr);
+    vkFreeMemory(device, _objectBufferMemory, nullptr);
+}
+
+void objectCulling::setObjectCount(uint32_t count)
+{
+    _objectCount = std::min(count, _objectCapacity);
+}
+
+uint32_t objectCulling::getObjectCount() const
+{
+    return _objectCount;
+}
+
+void objectCulling::update(VkDevice & device, uint32_t image, const glm::mat4 & viewProjection, uint32_t instanceOffset)
+{
+    ObjectCullingUniformBufferObject culling = {};
+    frustumCulling::frustum view = frustumCulling::extractPlanes(viewProjection);
+    std::copy(view.planes, view.planes + 6, culling.planes);
+    culling.objectCount = _objectCount;
+    culling.instanceOffset = instanceOffset;
+    culling.compact = _drawIndirectCount ? 1 : 0;
+
+    void * data;
+    vkMapMemory(device, _uniformBuffersMemory[image], 0, sizeof(culling), 0, &data);
+    memcpy(data, &culling, sizeof(culling));
+    vkUnmapMemory(device, _uniformBuffersMemory[image]);
+}
+
+void objectCulling::recordCulling(VkCommandBuffer commandBuffer, uint32_t image)
+{
+    // The shader appends to the count, so it starts from zero every frame
+    vkCmdFillBuffer(commandBuffer, _drawCountBuffers[image], 0, sizeof(uint32_t), 0);
+
+    VkMemoryBarrier resetBarrier = {};
+    resetBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &resetBarrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &_descriptorSets[image], 0, nullptr);
+    vkCmdDispatch(commandBuffer, (_objectCount + workgroupSize - 1) / workgroupSize, 1, 1);
+
+    // The draw reads the commands and the count the dispatch wrote
+    VkMemoryBarrier cullBarrier = {};
+    cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                         0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+}
+
+void objectCulling::recordDraw(VkCommandBuffer commandBuffer, uint32_t image)
+{
+    if (_drawIndirectCount)
+    {
+        _cmdDrawIndexedIndirectCount(commandBuffer, _drawCommandBuffers[image], 0, _drawCountBuffers[image], 0,
+                                     _objectCount, sizeof(VkDrawIndexedIndirectCommand));
+    }
+    else
+    {
+        vkCmdDrawIndexedIndirect(commandBuffer, _drawCommandBuffers[image], 0, _objectCount, sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
@@ -0,0 +1,98 @@
+//
+//  objectCulling.hpp
+//  vulkanTesting
+//
+
+#ifndef objectCulling_hpp
+#define objectCulling_hpp
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "window.hpp"
+
+// GPU driven drawing: object bounds and draw arguments live in storage buffers, a
+// compute pass (shaders/objectCull.comp) culls the objects against the frustum and
+// writes the draw commands, and one indirect draw issues whatever survived.  Each
+// frame the CPU only writes the frustum, so its cost does not grow with the number
+// of objects.  The dispatch and the draw are sized by the object count, so a
+// setObjectCount change marks the application's draw list dirty and each image's
+// command buffer is recorded again before its next submission.
+//
+// Object i is drawn as instance instanceOffset + i of the instance buffer, so the
+// instance vertex binding is bound at offset 0.
+class objectCulling
+{
+public:
+    // One drawable, laid out like Object in objectCull.comp
+    struct object {
+        float sphere[4]; // model space center and radius
+        uint32_t indexCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        uint32_t padding;
+    };
+
+    objectCulling();
+
+    // instanceBuffer holds one instanceData per object per image.  With
+    // drawIndirectCount the draw is compacted and sized by the GPU's count
+    // (VK_KHR_draw_indirect_count), otherwise culled objects draw 0 instances.
+    void create(VkDevice & device,
+                VkPhysicalDevice & physicalDevice,
+                VkShaderModule & computeShader,
+                const std::vector<object> & objects,
+                VkBuffer & instanceBuffer,
+                uint32_t imageCount,
+                bool drawIndirectCount);
+
+    void destroy(VkDevice & device);
+
+    // Cull and draw only the first count objects, at most as many as were created.
+    // The dispatch and the draw are recorded with it, so record them again after.
+    void setObjectCount(uint32_t count);
+
+    uint32_t getObjectCount() const;
+
+    // Frustum from the same projection * view the vertex shader uses
+    void update(VkDevice & device, uint32_t image, const glm::mat4 & viewProjection, uint32_t instanceOffset);
+
+    // Outside a render pass: reset the count and dispatch the culling
+    void recordCulling(VkCommandBuffer commandBuffer, uint32_t image);
+
+    // Inside the render pass, with the pipeline, index and vertex buffers bound
+    void recordDraw(VkCommandBuffer commandBuffer, uint32_t image);
+
+private:
+    void createBuffers(VkDevice & device, VkPhysicalDevice & physicalDevice, const std::vector<object> & objects, uint32_t imageCount);
+
+    void createPipeline(VkDevice & device, VkShaderModule & computeShader);
+
+    void createDescriptorSets(VkDevice & device, VkBuffer & instanceBuffer, uint32_t imageCount);
+
+private:
+    uint32_t _objectCount;
+    uint32_t _objectCapacity;
+    bool _drawIndirectCount;
+    PFN_vkCmdDrawIndexedIndirectCountKHR _cmdDrawIndexedIndirectCount;
+
+    VkBuffer _objectBuffer;
+    VkDeviceMemory _objectBufferMemory;
+
+    // per swap chain image
+    std::vector<VkBuffer> _uniformBuffers;
+    std::vector<VkDeviceMemory> _uniformBuffersMemory;
+    std::vector<VkBuffer> _drawCommandBuffers;
+    std::vector<VkDeviceMemory> _drawCommandBuffersMemory;
+    std::vector<VkBuffer> _drawCountBuffers;
+    std::vector<VkDeviceMemory> _drawCountBuffersMemory;
+
+    VkDescriptorSetLayout _descriptorSetLayout;
+    VkDescriptorPool _descriptorPool;
+    std::vector<VkDescriptorSet> _descriptorSets;
+    VkPipelineLayout _pipelineLayout;
+    VkPipeline _pipeline;
+};
+
+#endif /* objectCulling_hpp */
@@ -0,0 +1,209 @@
+//
+//  parallelRecorder.cpp
+//  vulkanTesting
+//
+
+#include "parallelRecorder.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    // Below this many draws per chunk, starting a thread costs more than it saves
+    const size_t minimumDrawsPerChunk = 256;
+
+    void recordChunk(VkCommandBuffer secondary,
+                     VkCommandBufferInheritanceInfo inheritance,
+                     VkCommandBufferUsageFlags usage,
+                     const drawQueue & queue,
+                     size_t first,
+                     size_t last,
+                     drawQueue::statistics & counts)
+    {
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | usage;
+        beginInfo.pInheritanceInfo = &inheritance;
+
+        if (vkBeginCommandBuffer(secondary, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording secondary command buffer!");
+        }
+
+        counts = drawQueue::statistics();
+        queue.record(secondary, first, last, counts);
+
+        if (vkEndCommandBuffer(secondary) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record secondary command buffer!");
+        }
+    }
+}
+
+parallelRecorder::parallelRecorder() : _threadCount(0),
+                                       _jobs(nullptr)
+{
+}
+
+void parallelRecorder::create(VkDevice & device, uint32_t queueFamilyIndex, unsigned threadCount, uint32_t slotCount, jobSystem * jobs)
+{
+    if (threadCount == 0)
+    {
+        threadCount = jobs != nullptr ? jobs->threadCount() : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    _threadCount = threadCount;
+    _jobs = jobs;
+    _commandPools.assign(slotCount, std::vector<VkCommandPool>(threadCount, VK_NULL_HANDLE));
+    _secondaries.assign(slotCount, std::vector<VkCommandBuffer>(threadCount, VK_NULL_HANDLE));
+
+    for (uint32_t slot = 0; slot < slotCount; ++slot)
+    {
+        for (unsigned t = 0; t < threadCount; ++t)
+        {
+            // no per buffer reset, the whole pool is reset when the slot is recorded
+            VkCommandPoolCreateInfo poolInfo = {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.queueFamilyIndex = queueFamilyIndex;
+            poolInfo.flags = 0;
+
+            if (vkCreateCommandPool(device, &poolInfo, nullptr, &_commandPools[slot][t]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create recording thread command pool!");
+            }
+
+            VkCommandBufferAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = _commandPools[slot][t];
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount = 1;
+
+            if (vkAllocateCommandBuffers(device, &allocInfo, &_secondaries[slot][t]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate secondary command buffers!");
+            }
+        }
+    }
+}
+
+void parallelRecorder::destroy(VkDevice & device)
+{
+    // the secondaries go with their pools
+    for (std::vector<VkCommandPool> & slotPools : _commandPools)
+    {
+        for (VkCommandPool commandPool : slotPools)
+        {
+            vkDestroyCommandPool(device, commandPool, nullptr);
+        }
+    }
+    _commandPools.clear();
+    _secondaries.clear();
+}
+
+void parallelRecorder::record(VkDevice & device,
+                              VkCommandBuffer primary,
+                              uint32_t slot,
+                              VkRenderPass renderPass,
+                              uint32_t subpass,
+                              VkFramebuffer framebuffer,
+                              drawQueue & queue,
+                              VkCommandBufferUsageFlags usage)
+{
+    _statistics = drawQueue::statistics();
+
+    size_t count = queue.size();
+    if (count == 0)
+    {
+        return;
+    }
+    queue.sort();
+
+    // every secondary of the slot goes back to its pool at once
+    for (VkCommandPool commandPool : _commandPools[slot])
+    {
+        vkResetCommandPool(device, commandPool, 0);
+    }
+
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(_threadCount, count / minimumDrawsPerChunk));
+    size_t perChunk = (count + chunkCount - 1) / chunkCount;
+
+    VkCommandBufferInheritanceInfo inheritance = {};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.renderPass = renderPass;
+    inheritance.subpass = subpass;
+    inheritance.framebuffer = framebuffer;
+
+    // chunk t is recorded with thread t's pool; a pool only ever serves one
+    // chunk at a time whichever thread runs it
+    std::vector<VkCommandBuffer> & secondaries = _secondaries[slot];
+    std::vector<drawQueue::statistics> counts(chunkCount);
+    if (_jobs != nullptr)
+    {
+        jobSystem::counter done;
+        for (size_t t = 0; t < chunkCount; ++t)
+        {
+            size_t first = std::min(count, t * perChunk);
+            size_t last = std::min(count, first + perChunk);
+            _jobs->run([&, t, first, last]() {
+                recordChunk(secondaries[t], inheritance, usage, queue, first, last, counts[t]);
+            }, &done);
+        }
+        _jobs->wait(done);
+    }
+    else
+    {
+        // the calling thread takes the first
+        std::vector<std::exception_ptr> errors(chunkCount);
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < chunkCount; ++t)
+        {
+            size_t first = std::min(count, t * perChunk);
+            size_t last = std::min(count, first + perChunk);
+            threads.emplace_back([&, t, first, last]() {
+                try
+                {
+                    recordChunk(secondaries[t], inheritance, usage, queue, first, last, counts[t]);
+                }
+                catch (...)
+                {
+                    errors[t] = std::current_exception();
+                }
+            });
+        }
+        try
+        {
+            recordChunk(secondaries[0], inheritance, usage, queue, 0, std::min(count, perChunk), counts[0]);
+        }
+        catch (...)
+        {
+            errors[0] = std::current_exception();
+        }
+
+        for (std::thread & thread : threads)
+        {
+            thread.join();
+        }
+        for (std::exception_ptr & error : errors)
+        {
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    for (const drawQueue::statistics & chunkCounts : counts)
+    {
+        _statistics.add(chunkCounts);
+    }
+    vkCmdExecuteCommands(primary, static_cast<uint32_t>(chunkCount), secondaries.data());
+}
+
+const drawQueue::statistics & parallelRecorder::getStatistics() const
+{
+    return _statistics;
+}
+
+unsigned parallelRecorder::threadCount() const
+{
+    return _threadCount;
+}
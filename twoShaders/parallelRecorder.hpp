@@ -0,0 +1,61 @@
+//
+//  parallelRecorder.hpp
+//  vulkanTesting
+//
+
+#ifndef parallelRecorder_hpp
+#define parallelRecorder_hpp
+
+#include <vector>
+
+#include "window.hpp"
+#include "drawQueue.hpp"
+#include "jobSystem.hpp"
+
+// Records a drawQueue on several threads.  The sorted draws are split into one
+// contiguous chunk per thread, each recorded into a secondary command buffer
+// that continues the primary's render pass, and the primary executes them in
+// order.  Every thread has its own command pool per slot, since a pool may only
+// be used by one thread at a time, and a slot's pools are reset whole with
+// vkResetCommandPool when it is recorded again.
+class parallelRecorder
+{
+public:
+    parallelRecorder();
+
+    // threadCount 0 means one per hardware thread, or per thread of jobs.  A slot,
+    // e.g. a swap chain image, can stay in use on the GPU while another slot is
+    // recorded.  With jobs the chunks run as its tasks instead of on new threads.
+    void create(VkDevice & device, uint32_t queueFamilyIndex, unsigned threadCount, uint32_t slotCount, jobSystem * jobs = nullptr);
+
+    void destroy(VkDevice & device);
+
+    // Inside a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+    // The slot's previous recording must no longer be in use by the GPU.  usage is
+    // added to the secondaries' begin flags.
+    void record(VkDevice & device,
+                VkCommandBuffer primary,
+                uint32_t slot,
+                VkRenderPass renderPass,
+                uint32_t subpass,
+                VkFramebuffer framebuffer,
+                drawQueue & queue,
+                VkCommandBufferUsageFlags usage = 0);
+
+    // binds of the last record, summed over the chunks
+    const drawQueue::statistics & getStatistics() const;
+
+    unsigned threadCount() const;
+
+private:
+    unsigned _threadCount;
+    jobSystem * _jobs;
+
+    // [slot][thread]
+    std::vector<std::vector<VkCommandPool>> _commandPools;
+    std::vector<std::vector<VkCommandBuffer>> _secondaries;
+
+    drawQueue::statistics _statistics;
+};
+
+#endif /* parallelRecorder_hpp */
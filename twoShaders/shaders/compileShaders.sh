@@ -0,0 +1,2 @@
+../../vulkan_bin/glslangValidator -V instanced.vert -o instanced.spv
+../../vulkan_bin/glslangValidator -V objectCull.comp -o objectCull.spv
@@ -0,0 +1,27 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+} ubo;
+
+layout(binding = 1) uniform projMatrix {
+    mat4 matrix;
+} projMat;
+
+// binding 0, per vertex
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+// binding 1, per instance: the model matrix replaces ubo.model
+layout(location = 2) in mat4 instanceModel;
+layout(location = 6) in vec4 instanceColor;
+layout(location = 7) in uint instanceMaterialId;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    gl_Position = projMat.matrix * ubo.view * instanceModel * vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor * instanceColor.rgb;
+}
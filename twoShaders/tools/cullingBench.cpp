@@ -0,0 +1,124 @@
+//
+//  cullingBench.cpp
+//  vulkanTesting
+//
+//  Frustum culls a field of random bounding spheres and prints the time per
+//  pass for the scalar reference, the SIMD kernel on one thread, and the SIMD
+//  kernel split across threads, with the number of objects that survived.
+//  Both SIMD results are checked against the scalar one.  Exit code 2 means
+//  they disagreed.
+//
+//  usage: cullingBench [--objects N] [--threads T] [--passes P]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../frustumCulling.hpp"
+
+namespace
+{
+    // Best of passes, in milliseconds
+    double timeBest(uint32_t passes, const std::function<void()> & pass)
+    {
+        double best = 1.0e30;
+        for (uint32_t i = 0; i < passes; ++i)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            pass();
+            best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+        }
+        return best;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    size_t objectCount = 1000000;
+    unsigned threadCount = 0;
+    uint32_t passes = 20;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--objects" && i + 1 < argc)
+        {
+            objectCount = static_cast<size_t>(std::atoll(argv[++i]));
+        }
+        else if (argument == "--threads" && i + 1 < argc)
+        {
+            threadCount = static_cast<unsigned>(std::atoi(argv[++i]));
+        }
+        else if (argument == "--passes" && i + 1 < argc)
+        {
+            passes = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        }
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [--objects N] [--threads T] [--passes P]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Objects scattered through a 200 unit cube, camera at one face looking in
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.1f, 2.0f);
+
+    frustumCulling::spheres bounds;
+    bounds.resize(objectCount);
+    for (size_t i = 0; i < objectCount; ++i)
+    {
+        bounds.set(i, glm::vec3(position(random), position(random), position(random)), size(random));
+    }
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, -120.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 250.0f);
+    proj[1][1] *= -1;
+    frustumCulling::frustum frustum = frustumCulling::extractPlanes(proj * view);
+
+    std::vector<uint32_t> reference;
+    std::vector<uint32_t> simd;
+    std::vector<uint32_t> parallel;
+    reference.reserve(objectCount);
+    simd.reserve(objectCount);
+    parallel.reserve(objectCount);
+
+    double scalarMs = timeBest(passes, [&]() {
+        reference.clear();
+        frustumCulling::cullScalar(bounds, frustum, 0, objectCount, reference);
+    });
+    double simdMs = timeBest(passes, [&]() {
+        simd.clear();
+        frustumCulling::cull(bounds, frustum, 0, objectCount, simd);
+    });
+    double parallelMs = timeBest(passes, [&]() {
+        frustumCulling::cullParallel(bounds, frustum, parallel, threadCount);
+    });
+
+    std::cout << objectCount << " objects, " << reference.size() << " visible ("
+              << std::fixed << std::setprecision(1) << 100.0 * reference.size() / std::max<size_t>(objectCount, 1) << "%)" << std::endl;
+    std::cout << std::setprecision(3);
+    std::cout << "  scalar:         " << std::setw(8) << scalarMs << " ms" << std::endl;
+    std::cout << "  " << std::left << std::setw(15) << (std::string(frustumCulling::kernelName()) + ":") << std::right
+              << std::setw(8) << simdMs << " ms" << std::endl;
+    std::cout << "  threads:        " << std::setw(8) << parallelMs << " ms" << std::endl;
+
+    if (simd != reference || parallel != reference)
+    {
+        std::cout << "SIMD culling does not match the scalar reference" << std::endl;
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,524 @@
+//
+//  drawQueueCheck.cpp
+//  vulkanTesting
+//
+//  Records drawQueues and compares the order the draws ran in and the binds
+//  with what they should be: sorted by pass, pipeline, descriptor set, mesh
+//  and depth, near to far within the same state, every draw run with its own
+//  state bound, and the exact binds and skipped binds, also when the sorted
+//  draws are recorded as separate ranges the way parallelRecorder does.  The
+//  vkCmdBind* entry points drawQueue calls are defined here and track what is
+//  bound, so it links without the Vulkan loader and nothing touches a device.
+//  Exit code 2 means a check failed.
+//
+//  usage: drawQueueCheck [--draws N] [--verbose]
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "../drawQueue.hpp"
+
+namespace
+{
+    // What the fake command buffer has bound, and the draws in the order they ran
+    struct commandLog {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        VkBuffer vertexBuffer = VK_NULL_HANDLE;
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+
+        uint32_t pipelineBinds = 0;
+        uint32_t descriptorSetBinds = 0;
+        uint32_t vertexBufferBinds = 0;
+        uint32_t indexBufferBinds = 0;
+
+        std::vector<uint32_t> draws;
+        uint32_t wrongState = 0;
+    };
+
+    commandLog commands;
+}
+
+// The entry points drawQueue records with
+VKAPI_ATTR void VKAPI_CALL vkCmdBindPipeline(VkCommandBuffer, VkPipelineBindPoint, VkPipeline pipeline)
+{
+    commands.pipeline = pipeline;
+    commands.pipelineBinds++;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindDescriptorSets(VkCommandBuffer, VkPipelineBindPoint, VkPipelineLayout layout, uint32_t,
+                                                   uint32_t, const VkDescriptorSet * descriptorSets, uint32_t, const uint32_t *)
+{
+    commands.layout = layout;
+    commands.descriptorSet = descriptorSets[0];
+    commands.descriptorSetBinds++;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindVertexBuffers(VkCommandBuffer, uint32_t, uint32_t, const VkBuffer * buffers, const VkDeviceSize *)
+{
+    commands.vertexBuffer = buffers[0];
+    commands.vertexBufferBinds++;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindIndexBuffer(VkCommandBuffer, VkBuffer buffer, VkDeviceSize, VkIndexType)
+{
+    commands.indexBuffer = buffer;
+    commands.indexBufferBinds++;
+}
+
+namespace
+{
+    bool verbose = false;
+
+    // xorshift, deterministic
+    uint32_t randomState = 0x2545F491u;
+    uint32_t random()
+    {
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        return randomState;
+    }
+
+    bool check(const std::string & name, bool passed)
+    {
+        std::cout << (passed ? "  ok      " : "  FAILED  ") << name << std::endl;
+        return passed;
+    }
+
+    // Handles are pointers or 64 bit integers depending on the platform
+    template<typename T>
+    T makeHandle(uint64_t value)
+    {
+        T handle;
+        std::memcpy(&handle, &value, sizeof(handle));
+        return handle;
+    }
+
+    // A draw by the indices of its state, none is a draw without a descriptor set
+    const int none = -1;
+
+    struct drawDescription {
+        uint32_t pass;
+        int pipeline;
+        int descriptorSet;
+        int mesh;
+        float depth;
+    };
+
+    drawQueue::draw makeDraw(uint32_t id, const drawDescription & description)
+    {
+        drawQueue::draw aDraw;
+        aDraw.pipeline = makeHandle<VkPipeline>(0x1000 + description.pipeline);
+        aDraw.pipelineLayout = makeHandle<VkPipelineLayout>(0x2000 + description.pipeline);
+        if (description.descriptorSet != none)
+        {
+            aDraw.descriptorSet = makeHandle<VkDescriptorSet>(0x3000 + description.descriptorSet);
+        }
+        aDraw.vertexBufferCount = 1;
+        aDraw.vertexBuffers[0] = makeHandle<VkBuffer>(0x4000 + description.mesh);
+        aDraw.indexBuffer = makeHandle<VkBuffer>(0x5000 + description.mesh);
+
+        VkPipeline pipeline = aDraw.pipeline;
+        VkPipelineLayout layout = aDraw.pipelineLayout;
+        VkDescriptorSet descriptorSet = aDraw.descriptorSet;
+        VkBuffer vertexBuffer = aDraw.vertexBuffers[0];
+        VkBuffer indexBuffer = aDraw.indexBuffer;
+        aDraw.record = [=](VkCommandBuffer) {
+            bool ownState = commands.pipeline == pipeline && commands.vertexBuffer == vertexBuffer && commands.indexBuffer == indexBuffer;
+            if (descriptorSet != VK_NULL_HANDLE)
+            {
+                ownState &= commands.descriptorSet == descriptorSet && commands.layout == layout;
+            }
+            if (!ownState)
+            {
+                commands.wrongState++;
+            }
+            commands.draws.push_back(id);
+        };
+        return aDraw;
+    }
+
+    void submitAll(drawQueue & queue, const std::vector<drawDescription> & descriptions)
+    {
+        for (uint32_t i = 0; i < descriptions.size(); ++i)
+        {
+            queue.submit(descriptions[i].pass, descriptions[i].depth, makeDraw(i, descriptions[i]));
+        }
+    }
+
+    // What a secondary command buffer starts with
+    void beginCommands()
+    {
+        commands = commandLog();
+    }
+
+    // The order the key gives: the queue numbers pipelines, sets and meshes in the
+    // order it first sees them, and draws with equal keys keep their submit order
+    std::vector<uint32_t> expectedOrder(const std::vector<drawDescription> & descriptions)
+    {
+        std::map<int, int> pipelineIds, descriptorSetIds, meshIds;
+        auto id = [](std::map<int, int> & ids, int index) {
+            return ids.emplace(index, static_cast<int>(ids.size())).first->second;
+        };
+
+        std::vector<std::tuple<uint32_t, int, int, int, float>> keys;
+        for (const drawDescription & description : descriptions)
+        {
+            keys.emplace_back(description.pass, id(pipelineIds, description.pipeline), id(descriptorSetIds, description.descriptorSet),
+                              id(meshIds, description.mesh), std::max(description.depth, 0.0f));
+        }
+
+        std::vector<uint32_t> order(descriptions.size());
+        for (uint32_t i = 0; i < order.size(); ++i)
+        {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+        return order;
+    }
+
+    // Walks draws [first, last) of order starting with nothing bound, binding only
+    // what differs from the draw before
+    drawQueue::statistics expectedBinds(const std::vector<drawDescription> & descriptions, const std::vector<uint32_t> & order,
+                                        size_t first, size_t last)
+    {
+        drawQueue::statistics counts;
+        int pipeline = none - 1;
+        int descriptorSet = none - 1;
+        int descriptorSetPipeline = none - 1;
+        int mesh = none - 1;
+        for (size_t i = first; i < last; ++i)
+        {
+            const drawDescription & description = descriptions[order[i]];
+            counts.draws++;
+
+            if (description.pipeline != pipeline)
+            {
+                pipeline = description.pipeline;
+                counts.pipelineBinds++;
+            }
+            else
+            {
+                counts.pipelineBindsSkipped++;
+            }
+
+            // every pipeline has its own layout
+            if (description.descriptorSet != none)
+            {
+                if (description.descriptorSet != descriptorSet || description.pipeline != descriptorSetPipeline)
+                {
+                    descriptorSet = description.descriptorSet;
+                    descriptorSetPipeline = description.pipeline;
+                    counts.descriptorSetBinds++;
+                }
+                else
+                {
+                    counts.descriptorSetBindsSkipped++;
+                }
+            }
+
+            if (description.mesh != mesh)
+            {
+                mesh = description.mesh;
+                counts.vertexBufferBinds++;
+                counts.indexBufferBinds++;
+            }
+            else
+            {
+                counts.vertexBufferBindsSkipped++;
+                counts.indexBufferBindsSkipped++;
+            }
+        }
+        return counts;
+    }
+
+    bool sameStatistics(const drawQueue::statistics & a, const drawQueue::statistics & b)
+    {
+        return a.draws == b.draws &&
+               a.pipelineBinds == b.pipelineBinds && a.pipelineBindsSkipped == b.pipelineBindsSkipped &&
+               a.descriptorSetBinds == b.descriptorSetBinds && a.descriptorSetBindsSkipped == b.descriptorSetBindsSkipped &&
+               a.vertexBufferBinds == b.vertexBufferBinds && a.vertexBufferBindsSkipped == b.vertexBufferBindsSkipped &&
+               a.indexBufferBinds == b.indexBufferBinds && a.indexBufferBindsSkipped == b.indexBufferBindsSkipped;
+    }
+
+    // the binds the fake command buffer saw agree with what the queue counted
+    bool commandsMatch(const drawQueue::statistics & counts)
+    {
+        return commands.pipelineBinds == counts.pipelineBinds && commands.descriptorSetBinds == counts.descriptorSetBinds &&
+               commands.vertexBufferBinds == counts.vertexBufferBinds && commands.indexBufferBinds == counts.indexBufferBinds;
+    }
+
+    void printStatistics(const std::string & name, const drawQueue::statistics & counts)
+    {
+        std::cout << "    " << name << ": " << counts.draws << " draws, pipeline " << counts.pipelineBinds << "/" << counts.pipelineBindsSkipped
+                  << ", descriptor set " << counts.descriptorSetBinds << "/" << counts.descriptorSetBindsSkipped
+                  << ", vertex buffer " << counts.vertexBufferBinds << "/" << counts.vertexBufferBindsSkipped
+                  << ", index buffer " << counts.indexBufferBinds << "/" << counts.indexBufferBindsSkipped << " (bound/skipped)" << std::endl;
+    }
+
+    // Random state, submitted in random order.  Depths are whole numbers, which the
+    // key keeps exactly, so the expected order is exact.
+    std::vector<drawDescription> randomScene(size_t drawCount)
+    {
+        std::vector<drawDescription> descriptions(drawCount);
+        for (drawDescription & description : descriptions)
+        {
+            description.pass = random() % 3;
+            description.pipeline = static_cast<int>(random() % 4);
+            description.descriptorSet = random() % 6 == 0 ? none : static_cast<int>(random() % 5);
+            description.mesh = static_cast<int>(random() % 5);
+            description.depth = static_cast<float>(random() % 1000);
+        }
+        return descriptions;
+    }
+
+    bool sortOrder(size_t drawCount)
+    {
+        std::vector<drawDescription> descriptions = randomScene(drawCount);
+        std::vector<uint32_t> order = expectedOrder(descriptions);
+
+        drawQueue queue;
+        submitAll(queue, descriptions);
+        beginCommands();
+        queue.record(VK_NULL_HANDLE);
+
+        drawQueue::statistics expected = expectedBinds(descriptions, order, 0, order.size());
+        if (verbose)
+        {
+            printStatistics("expected", expected);
+            printStatistics("recorded", queue.getStatistics());
+        }
+
+        bool passed = check("sorted by pass, pipeline, descriptor set, mesh, depth", commands.draws == order);
+        passed &= check("every draw ran with its own state bound", commands.wrongState == 0);
+        passed &= check("binds and skipped binds are exact", sameStatistics(queue.getStatistics(), expected));
+        passed &= check("bind calls match the statistics", commandsMatch(queue.getStatistics()));
+
+        // handles keep their ids after clear, so the next frame sorts the same way
+        queue.clear();
+        submitAll(queue, descriptions);
+        beginCommands();
+        queue.record(VK_NULL_HANDLE);
+        passed &= check("the next frame sorts the same", commands.draws == order);
+
+        // ranges start with nothing bound, as a secondary command buffer does
+        queue.sort();
+        drawQueue::statistics rangeCounts;
+        drawQueue::statistics expectedRanges;
+        std::vector<uint32_t> rangeDraws;
+        bool rangeState = true;
+        size_t rangeCount = 7;
+        for (size_t r = 0; r < rangeCount; ++r)
+        {
+            size_t first = order.size() * r / rangeCount;
+            size_t last = order.size() * (r + 1) / rangeCount;
+            drawQueue::statistics counts;
+            beginCommands();
+            queue.record(VK_NULL_HANDLE, first, last, counts);
+
+            rangeDraws.insert(rangeDraws.end(), commands.draws.begin(), commands.draws.end());
+            rangeState &= commands.wrongState == 0 && commandsMatch(counts);
+            rangeCounts.add(counts);
+            expectedRanges.add(expectedBinds(descriptions, order, first, last));
+        }
+        passed &= check("ranges run the sorted order", rangeDraws == order);
+        passed &= check("ranges bind their own state", rangeState);
+        passed &= check("range binds and skipped binds are exact", sameStatistics(rangeCounts, expectedRanges));
+        return passed;
+    }
+
+    bool nearToFar()
+    {
+        // one state, depths in a shuffled order
+        std::vector<drawDescription> descriptions;
+        for (uint32_t i = 0; i < 500; ++i)
+        {
+            descriptions.push_back({0, 0, 0, 0, 0.25f + 0.37f * i});
+        }
+        for (size_t i = descriptions.size() - 1; i > 0; --i)
+        {
+            std::swap(descriptions[i], descriptions[random() % (i + 1)]);
+        }
+        // behind the camera counts as the nearest
+        descriptions.push_back({0, 0, 0, 0, -3.0f});
+
+        drawQueue queue;
+        submitAll(queue, descriptions);
+        beginCommands();
+        queue.record(VK_NULL_HANDLE);
+
+        bool ordered = commands.draws.size() == descriptions.size() && commands.draws[0] == descriptions.size() - 1;
+        for (size_t i = 2; ordered && i < commands.draws.size(); ++i)
+        {
+            ordered = descriptions[commands.draws[i - 1]].depth < descriptions[commands.draws[i]].depth;
+        }
+        bool passed = check("near to far within the same state", ordered);
+
+        // depth only orders draws of the same state: a far draw of the first
+        // pipeline runs before a near one of the second, and pass 0 before pass 1
+        std::vector<drawDescription> layered = {
+            {1, 0, 0, 0, 1.0f},
+            {0, 1, 0, 0, 1.0f},
+            {0, 0, 0, 0, 900.0f},
+            {0, 1, 0, 0, 2.0f}
+        };
+        drawQueue layeredQueue;
+        submitAll(layeredQueue, layered);
+        beginCommands();
+        layeredQueue.record(VK_NULL_HANDLE);
+        passed &= check("pass, then pipeline, before depth", commands.draws == std::vector<uint32_t>({2, 1, 3, 0}));
+        return passed;
+    }
+
+    bool directedBinds()
+    {
+        // 2 pipelines x 3 descriptor sets x 2 meshes, 5 draws each, submitted
+        // interleaved so that no two neighbours share anything
+        std::vector<drawDescription> descriptions;
+        for (int copy = 0; copy < 5; ++copy)
+        {
+            for (int mesh = 0; mesh < 2; ++mesh)
+            {
+                for (int descriptorSet = 0; descriptorSet < 3; ++descriptorSet)
+                {
+                    for (int pipeline = 0; pipeline < 2; ++pipeline)
+                    {
+                        descriptions.push_back({0, pipeline, descriptorSet, mesh, static_cast<float>(copy)});
+                    }
+                }
+            }
+        }
+
+        drawQueue queue;
+        submitAll(queue, descriptions);
+        beginCommands();
+        queue.record(VK_NULL_HANDLE);
+        const drawQueue::statistics & counts = queue.getStatistics();
+        if (verbose)
+        {
+            printStatistics("recorded", counts);
+        }
+
+        bool passed = check("60 draws", counts.draws == 60 && commands.draws.size() == 60);
+        passed &= check("2 pipeline binds, 58 skipped", counts.pipelineBinds == 2 && counts.pipelineBindsSkipped == 58);
+        passed &= check("6 descriptor set binds, 54 skipped", counts.descriptorSetBinds == 6 && counts.descriptorSetBindsSkipped == 54);
+        passed &= check("12 vertex buffer binds, 48 skipped", counts.vertexBufferBinds == 12 && counts.vertexBufferBindsSkipped == 48);
+        passed &= check("12 index buffer binds, 48 skipped", counts.indexBufferBinds == 12 && counts.indexBufferBindsSkipped == 48);
+        passed &= check("bind calls match the directed statistics", commandsMatch(counts) && commands.wrongState == 0);
+
+        // the same set through another pipeline's layout binds again
+        std::vector<drawDescription> shared = {
+            {0, 0, 0, 0, 1.0f},
+            {0, 0, 0, 0, 2.0f},
+            {0, 1, 0, 0, 1.0f},
+            {0, 1, none, 0, 2.0f}
+        };
+        drawQueue sharedQueue;
+        submitAll(sharedQueue, shared);
+        beginCommands();
+        sharedQueue.record(VK_NULL_HANDLE);
+        const drawQueue::statistics & sharedCounts = sharedQueue.getStatistics();
+        passed &= check("a set rebinds with a new layout, draws without one skip nothing",
+                        sharedCounts.descriptorSetBinds == 2 && sharedCounts.descriptorSetBindsSkipped == 1 && commands.wrongState == 0);
+        return passed;
+    }
+
+    // Ids have 12 bits: one more pipeline than that must fail rather than wrap
+    // into another pipeline's id, and clear() hands the ids out again
+    bool idLimit()
+    {
+        drawQueue queue;
+        auto fill = [&queue](int pipelines) {
+            for (int pipeline = 0; pipeline < pipelines; ++pipeline)
+            {
+                queue.submit(0, 0.0f, makeDraw(static_cast<uint32_t>(pipeline), {0, pipeline, none, 0, 0.0f}));
+            }
+        };
+
+        bool accepted = true;
+        try
+        {
+            fill(4096);
+        }
+        catch (const std::runtime_error &)
+        {
+            accepted = false;
+        }
+        bool passed = check("4096 pipelines in one queue", accepted);
+
+        bool rejected = false;
+        try
+        {
+            queue.submit(0, 0.0f, makeDraw(4096, {0, 4096, none, 0, 0.0f}));
+        }
+        catch (const std::runtime_error &)
+        {
+            rejected = true;
+        }
+        passed &= check("the 4097th pipeline is rejected", rejected);
+
+        // a frame later the first 4096 are gone and 4096 new ones fit
+        queue.clear();
+        std::vector<drawDescription> descriptions;
+        for (int pipeline = 4096; pipeline < 8192; ++pipeline)
+        {
+            descriptions.push_back({0, pipeline, none, 0, 0.0f});
+        }
+        accepted = true;
+        try
+        {
+            submitAll(queue, descriptions);
+        }
+        catch (const std::runtime_error &)
+        {
+            accepted = false;
+        }
+        beginCommands();
+        queue.record(VK_NULL_HANDLE);
+        passed &= check("clear() reuses the ids", accepted && commands.draws == expectedOrder(descriptions) && commands.wrongState == 0);
+        return passed;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    size_t drawCount = 10000;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--draws" && i + 1 < argc)
+        {
+            drawCount = std::max<size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+        }
+        else if (argument == "--verbose")
+        {
+            verbose = true;
+        }
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [--draws N] [--verbose]" << std::endl;
+            return 1;
+        }
+    }
+
+    bool passed = true;
+    passed &= sortOrder(drawCount);
+    passed &= nearToFar();
+    passed &= directedBinds();
+    passed &= idLimit();
+
+    std::cout << (passed ? "every queue recorded as expected" : "draw queue check failed") << std::endl;
+    return passed ? 0 : 2;
+}
@@ -0,0 +1,671 @@
+//
+//  headlessDevice.cpp
+//  vulkanTesting
+//
+
+#include "headlessDevice.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../shaderReader.hpp"
+
+namespace
+{
+    const VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+    struct Vertex {
+        glm::vec2 pos;
+        glm::vec3 color;
+    };
+
+    // matches the uniform blocks of instanced.vert
+    struct UniformBufferObject {
+        glm::mat4 model;
+        glm::mat4 view;
+    };
+
+    struct projectionMatrix {
+        glm::mat4 matrix;
+    };
+
+    const std::vector<Vertex> quadVertices = {
+        {{-0.5f, -0.5f}, {1.0f, 1.0f, 1.0f}},
+        {{0.5f, -0.5f}, {1.0f, 1.0f, 1.0f}},
+        {{0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}},
+        {{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}}
+    };
+
+    const std::vector<uint16_t> quadIndices = {0, 1, 2, 2, 3, 0};
+}
+
+headlessDevice::headlessDevice(const std::string & applicationName, const std::string & shaderDirectory,
+                               uint32_t size, uint32_t instanceCount, bool timestamps)
+    : _size(size), _timestamps(timestamps)
+{
+    createDevice(applicationName);
+    createTarget();
+    createRenderPass();
+    createDescriptors();
+    createPipeline(shaderDirectory);
+
+    _vertexBuffer = createHostBuffer(sizeof(quadVertices[0]) * quadVertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, quadVertices.data());
+    _indexBuffer = createHostBuffer(sizeof(quadIndices[0]) * quadIndices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, quadIndices.data());
+    _readbackBuffer = createHostBuffer(static_cast<VkDeviceSize>(size) * size * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT, nullptr);
+
+    // one frame in flight at a time, so a single segment
+    _instances.create(_device, _physicalDevice, instanceCount, 1);
+    fillInstances();
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = _queueFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    if (vkCreateCommandPool(_device, &poolInfo, nullptr, &_commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create command pool!");
+    }
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = _commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(_device, &allocInfo, &_commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate command buffers!");
+    }
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(_device, &fenceInfo, nullptr, &_fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create fence!");
+    }
+
+    if (_timestamps)
+    {
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2;
+        if (vkCreateQueryPool(_device, &queryInfo, nullptr, &_queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create query pool!");
+        }
+    }
+}
+
+headlessDevice::~headlessDevice()
+{
+    vkDeviceWaitIdle(_device);
+
+    vkDestroyQueryPool(_device, _queryPool, nullptr);
+    vkDestroyFence(_device, _fence, nullptr);
+    vkDestroyCommandPool(_device, _commandPool, nullptr);
+
+    _instances.destroy(_device);
+    destroyBuffer(_readbackBuffer);
+    destroyBuffer(_indexBuffer);
+    destroyBuffer(_vertexBuffer);
+
+    _pipeline.destroy(_device);
+    _fragmentShader.destroy(_device);
+    _vertexShader.destroy(_device);
+
+    destroyBuffer(_projectionBuffer);
+    destroyBuffer(_uniformBuffer);
+    vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(_device, _descriptorSetLayout, nullptr);
+
+    vkDestroyFramebuffer(_device, _framebuffer, nullptr);
+    vkDestroyRenderPass(_device, _renderPass, nullptr);
+    vkDestroyImageView(_device, _imageView, nullptr);
+    vkDestroyImage(_device, _image, nullptr);
+    vkFreeMemory(_device, _imageMemory, nullptr);
+
+    vkDestroyDevice(_device, nullptr);
+    vkDestroyInstance(_instance, nullptr);
+}
+
+uint32_t headlessDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(_physicalDevice, &memProperties);
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+    {
+        if (typeFilter & (1 << i) &&
+            (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+headlessDevice::buffer headlessDevice::createHostBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const void * contents)
+{
+    buffer aBuffer;
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(_device, &bufferInfo, nullptr, &aBuffer.handle) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(_device, aBuffer.handle, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
+                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    if (vkAllocateMemory(_device, &allocInfo, nullptr, &aBuffer.memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate buffer memory!");
+    }
+
+    vkBindBufferMemory(_device, aBuffer.handle, aBuffer.memory, 0);
+
+    if (contents != nullptr)
+    {
+        void * data;
+        vkMapMemory(_device, aBuffer.memory, 0, size, 0, &data);
+        memcpy(data, contents, static_cast<size_t>(size));
+        vkUnmapMemory(_device, aBuffer.memory);
+    }
+
+    return aBuffer;
+}
+
+void headlessDevice::destroyBuffer(buffer & aBuffer)
+{
+    vkDestroyBuffer(_device, aBuffer.handle, nullptr);
+    vkFreeMemory(_device, aBuffer.memory, nullptr);
+    aBuffer = buffer();
+}
+
+void headlessDevice::createDevice(const std::string & applicationName)
+{
+    // No surface and no extensions: nothing is presented
+    VkApplicationInfo appInfo = {};
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = applicationName.c_str();
+    appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.pEngineName = "No Engine";
+    appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.apiVersion = VK_API_VERSION_1_0;
+
+    VkInstanceCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    createInfo.pApplicationInfo = &appInfo;
+
+    if (vkCreateInstance(&createInfo, nullptr, &_instance) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create Vulkan instance!");
+    }
+
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(_instance, &deviceCount, nullptr);
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    vkEnumeratePhysicalDevices(_instance, &deviceCount, devices.data());
+
+    // first device with a graphics queue, one that can write timestamps when they are wanted
+    for (const auto & device : devices)
+    {
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+        for (uint32_t i = 0; i < queueFamilyCount; ++i)
+        {
+            if (queueFamilies[i].queueCount > 0 && (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+                (!_timestamps || queueFamilies[i].timestampValidBits > 0))
+            {
+                _physicalDevice = device;
+                _queueFamily = i;
+                break;
+            }
+        }
+        if (_physicalDevice != VK_NULL_HANDLE)
+        {
+            break;
+        }
+    }
+    if (_physicalDevice == VK_NULL_HANDLE)
+    {
+        throw std::runtime_error("failed to find a suitable GPU!");
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(_physicalDevice, &properties);
+    _timestampPeriod = properties.limits.timestampPeriod;
+    std::cout << properties.deviceName << std::endl;
+
+    float queuePriority = 1.f;
+    VkDeviceQueueCreateInfo queueCreateInfo = {};
+    queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueCreateInfo.queueFamilyIndex = _queueFamily;
+    queueCreateInfo.queueCount = 1;
+    queueCreateInfo.pQueuePriorities = &queuePriority;
+
+    VkPhysicalDeviceFeatures deviceFeatures = {};
+    VkDeviceCreateInfo deviceInfo = {};
+    deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceInfo.pQueueCreateInfos = &queueCreateInfo;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pEnabledFeatures = &deviceFeatures;
+
+    if (vkCreateDevice(_physicalDevice, &deviceInfo, nullptr, &_device) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create logical device!");
+    }
+
+    vkGetDeviceQueue(_device, _queueFamily, 0, &_queue);
+}
+
+void headlessDevice::createTarget()
+{
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = colorFormat;
+    imageInfo.extent = {_size, _size, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(_device, &imageInfo, nullptr, &_image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(_device, _image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if (vkAllocateMemory(_device, &allocInfo, nullptr, &_imageMemory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate image memory!");
+    }
+    vkBindImageMemory(_device, _image, _imageMemory, 0);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = _image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = colorFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(_device, &viewInfo, nullptr, &_imageView) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image views!");
+    }
+}
+
+void headlessDevice::createRenderPass()
+{
+    // Ends in TRANSFER_SRC so the frame can be copied out for the coverage check
+    VkAttachmentDescription colorAttachment = {};
+    colorAttachment.format = colorFormat;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    VkAttachmentReference colorAttachmentRef = {};
+    colorAttachmentRef.attachment = 0;
+    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorAttachmentRef;
+
+    VkSubpassDependency dependency = {};
+    dependency.srcSubpass = 0;
+    dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 1;
+    renderPassInfo.pDependencies = &dependency;
+
+    if (vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render pass!");
+    }
+
+    VkFramebufferCreateInfo framebufferInfo = {};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = _renderPass;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments = &_imageView;
+    framebufferInfo.width = _size;
+    framebufferInfo.height = _size;
+    framebufferInfo.layers = 1;
+
+    if (vkCreateFramebuffer(_device, &framebufferInfo, nullptr, &_framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create framebuffer!");
+    }
+}
+
+void headlessDevice::createDescriptors()
+{
+    VkDescriptorSetLayoutBinding uboLayoutBinding[2] = {};
+    for (uint32_t i = 0; i < 2; ++i) {
+        uboLayoutBinding[i].binding = i;
+        uboLayoutBinding[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uboLayoutBinding[i].descriptorCount = 1;
+        uboLayoutBinding[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = uboLayoutBinding;
+
+    if (vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSize.descriptorCount = 2;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &_descriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(_device, &allocInfo, &_descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    // the instances carry the whole transform, the shared matrices are identity
+    UniformBufferObject ubo = {glm::mat4(1.0f), glm::mat4(1.0f)};
+    projectionMatrix proj = {glm::mat4(1.0f)};
+    _uniformBuffer = createHostBuffer(sizeof(ubo), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &ubo);
+    _projectionBuffer = createHostBuffer(sizeof(proj), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &proj);
+
+    VkDescriptorBufferInfo bufferInfo[2] = {};
+    bufferInfo[0].buffer = _uniformBuffer.handle;
+    bufferInfo[0].range = sizeof(UniformBufferObject);
+    bufferInfo[1].buffer = _projectionBuffer.handle;
+    bufferInfo[1].range = sizeof(projectionMatrix);
+
+    VkWriteDescriptorSet descriptorWrite[2] = {};
+    for (uint32_t i = 0; i < 2; ++i) {
+        descriptorWrite[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite[i].dstSet = _descriptorSet;
+        descriptorWrite[i].dstBinding = i;
+        descriptorWrite[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrite[i].descriptorCount = 1;
+        descriptorWrite[i].pBufferInfo = &bufferInfo[i];
+    }
+    vkUpdateDescriptorSets(_device, 2, descriptorWrite, 0, nullptr);
+}
+
+void headlessDevice::createPipeline(const std::string & shaderDirectory)
+{
+    _vertexShader = shaderModule(shaderReader::readFile(shaderDirectory + "instanced.spv"));
+    _vertexShader.createShader(_device);
+    _fragmentShader = shaderModule(shaderReader::readFile(shaderDirectory + "frag.spv"));
+    _fragmentShader.createShader(_device);
+
+    _pipeline.vertexShaderModule = _vertexShader.getShaderModule();
+    _pipeline.fragmentShaderModule = _fragmentShader.getShaderModule();
+
+    // binding 0 per vertex, binding 1 per instance
+    VkVertexInputBindingDescription bindingDescriptions[2] = {};
+    bindingDescriptions[0].binding = 0;
+    bindingDescriptions[0].stride = sizeof(Vertex);
+    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    bindingDescriptions[1] = instanceData::getBindingDescription(1);
+
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions(2);
+    attributeDescriptions[0] = {0, 0, VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, pos))};
+    attributeDescriptions[1] = {1, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, color))};
+    auto instanceAttributes = instanceData::getAttributeDescriptions(1, 2);
+    attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
+
+    _pipeline.vertexInputInfo = {};
+    _pipeline.vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    _pipeline.vertexInputInfo.vertexBindingDescriptionCount = 2;
+    _pipeline.vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions;
+    _pipeline.vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+    _pipeline.vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+    _pipeline.inputAssembly = {};
+    _pipeline.inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    _pipeline.inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    _pipeline.inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    VkViewport viewport = {0.0f, 0.0f, static_cast<float>(_size), static_cast<float>(_size), 0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, {_size, _size}};
+
+    _pipeline.viewportState = {};
+    _pipeline.viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    _pipeline.viewportState.viewportCount = 1;
+    _pipeline.viewportState.pViewports = &viewport;
+    _pipeline.viewportState.scissorCount = 1;
+    _pipeline.viewportState.pScissors = &scissor;
+
+    _pipeline.rasterizer = {};
+    _pipeline.rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    _pipeline.rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    _pipeline.rasterizer.lineWidth = 1.0f;
+    _pipeline.rasterizer.cullMode = VK_CULL_MODE_NONE;
+    _pipeline.rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    _pipeline.pipelineLayoutInfo = {};
+    _pipeline.pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    _pipeline.pipelineLayoutInfo.setLayoutCount = 1;
+    _pipeline.pipelineLayoutInfo.pSetLayouts = &_descriptorSetLayout;
+
+    _pipeline.createPipeLine(_device, _renderPass);
+}
+
+void headlessDevice::fillInstances()
+{
+    // a square grid covering clip space, each quad a little smaller than its cell
+    uint32_t count = _instances.capacity();
+    uint32_t grid = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+    float cell = 2.0f / grid;
+
+    instanceData * instances = _instances.getInstances(0);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t column = i % grid;
+        uint32_t row = i / grid;
+        glm::vec3 position(-1.0f + (column + 0.5f) * cell, -1.0f + (row + 0.5f) * cell, 0.0f);
+
+        instances[i].model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.8f * cell, 0.8f * cell, 1.0f));
+        instances[i].color = glm::vec4(static_cast<float>(column) / grid, static_cast<float>(row) / grid, 1.0f, 1.0f);
+        instances[i].materialId = i % 8;
+    }
+}
+
+VkCommandBuffer headlessDevice::beginFrame(VkSubpassContents contents)
+{
+    vkResetCommandBuffer(_commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(_commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+
+    if (_timestamps)
+    {
+        vkCmdResetQueryPool(_commandBuffer, _queryPool, 0, 2);
+        vkCmdWriteTimestamp(_commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _queryPool, 0);
+    }
+
+    VkRenderPassBeginInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = _renderPass;
+    renderPassInfo.framebuffer = _framebuffer;
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = {_size, _size};
+    VkClearValue clearColor = {0.f, 0.f, 0.f, 1.f};
+    renderPassInfo.clearValueCount = 1;
+    renderPassInfo.pClearValues = &clearColor;
+
+    vkCmdBeginRenderPass(_commandBuffer, &renderPassInfo, contents);
+    return _commandBuffer;
+}
+
+void headlessDevice::endFrame()
+{
+    vkCmdEndRenderPass(_commandBuffer);
+    if (_timestamps)
+    {
+        vkCmdWriteTimestamp(_commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _queryPool, 1);
+    }
+
+    VkBufferImageCopy region = {};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {_size, _size, 1};
+    vkCmdCopyImageToBuffer(_commandBuffer, _image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, _readbackBuffer.handle, 1, &region);
+
+    if (vkEndCommandBuffer(_commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+}
+
+void headlessDevice::submitFrame()
+{
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &_commandBuffer;
+    if (vkQueueSubmit(_queue, 1, &submitInfo, _fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit draw command buffer!");
+    }
+    vkWaitForFences(_device, 1, &_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    vkResetFences(_device, 1, &_fence);
+}
+
+double headlessDevice::gpuMilliseconds()
+{
+    if (!_timestamps)
+    {
+        throw std::runtime_error("frames are not timestamped!");
+    }
+
+    uint64_t timestamps[2] = {};
+    vkGetQueryPoolResults(_device, _queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    return static_cast<double>(timestamps[1] - timestamps[0]) * _timestampPeriod / 1.0e6;
+}
+
+size_t headlessDevice::coveredPixels()
+{
+    size_t pixelCount = static_cast<size_t>(_size) * _size;
+    void * data;
+    vkMapMemory(_device, _readbackBuffer.memory, 0, pixelCount * 4, 0, &data);
+    const uint8_t * pixels = static_cast<const uint8_t *>(data);
+
+    size_t covered = 0;
+    for (size_t i = 0; i < pixelCount; ++i)
+    {
+        if (pixels[4 * i] != 0 || pixels[4 * i + 1] != 0 || pixels[4 * i + 2] != 0)
+        {
+            ++covered;
+        }
+    }
+    vkUnmapMemory(_device, _readbackBuffer.memory);
+    return covered;
+}
+
+VkDevice & headlessDevice::getDevice()
+{
+    return _device;
+}
+
+uint32_t headlessDevice::getQueueFamily() const
+{
+    return _queueFamily;
+}
+
+VkRenderPass & headlessDevice::getRenderPass()
+{
+    return _renderPass;
+}
+
+VkFramebuffer & headlessDevice::getFramebuffer()
+{
+    return _framebuffer;
+}
+
+pipeline & headlessDevice::getPipeline()
+{
+    return _pipeline;
+}
+
+VkDescriptorSet & headlessDevice::getDescriptorSet()
+{
+    return _descriptorSet;
+}
+
+headlessDevice::buffer & headlessDevice::getVertexBuffer()
+{
+    return _vertexBuffer;
+}
+
+headlessDevice::buffer & headlessDevice::getIndexBuffer()
+{
+    return _indexBuffer;
+}
+
+uint32_t headlessDevice::getIndexCount() const
+{
+    return static_cast<uint32_t>(quadIndices.size());
+}
+
+instanceBuffer & headlessDevice::getInstances()
+{
+    return _instances;
+}
@@ -0,0 +1,136 @@
+//
+//  headlessDevice.hpp
+//  vulkanTesting
+//
+//  The offscreen fixture the benches render with: a device with no surface, a
+//  square color target, the instanced pipeline with identity matrices, a quad
+//  and an instanceBuffer filled with a grid of quads covering the target.
+//  A frame is begun, recorded by the bench, ended and submitted, after which
+//  the image is in a host buffer for coveredPixels.
+//
+//  Built with the bench that uses it, e.g.
+//  g++ -std=c++17 -O2 instancingBench.cpp headlessDevice.cpp ../instanceBuffer.cpp
+//      ../pipeline.cpp ../shaderModule.cpp ../shaderReader.cpp -lvulkan
+//
+
+#ifndef headlessDevice_hpp
+#define headlessDevice_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "../instanceBuffer.hpp"
+#include "../pipeline.hpp"
+#include "../shaderModule.hpp"
+
+class headlessDevice
+{
+public:
+    struct buffer {
+        VkBuffer handle = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+    };
+
+    // shaderDirectory holds instanced.spv and frag.spv.  With timestamps the
+    // queue must be able to write them and every frame is bracketed by a pair.
+    headlessDevice(const std::string & applicationName, const std::string & shaderDirectory,
+                   uint32_t size, uint32_t instanceCount, bool timestamps);
+
+    ~headlessDevice();
+
+    // resets and begins the command buffer and begins the render pass, cleared to black
+    VkCommandBuffer beginFrame(VkSubpassContents contents);
+
+    // ends the render pass and the command buffer, after copying the image out
+    void endFrame();
+
+    // submits the frame and waits for it to finish
+    void submitFrame();
+
+    // GPU time of the last frame in milliseconds, needs timestamps
+    double gpuMilliseconds();
+
+    // pixels of the last frame that are not the clear color
+    size_t coveredPixels();
+
+    VkDevice & getDevice();
+
+    uint32_t getQueueFamily() const;
+
+    VkRenderPass & getRenderPass();
+
+    VkFramebuffer & getFramebuffer();
+
+    pipeline & getPipeline();
+
+    VkDescriptorSet & getDescriptorSet();
+
+    // four vertices of a unit quad, binding 0
+    buffer & getVertexBuffer();
+
+    // getIndexCount() uint16 indices into the quad
+    buffer & getIndexBuffer();
+
+    uint32_t getIndexCount() const;
+
+    // a single segment, binding 1
+    instanceBuffer & getInstances();
+
+private:
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+    buffer createHostBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const void * contents);
+
+    void destroyBuffer(buffer & aBuffer);
+
+    void createDevice(const std::string & applicationName);
+
+    void createTarget();
+
+    void createRenderPass();
+
+    void createDescriptors();
+
+    void createPipeline(const std::string & shaderDirectory);
+
+    void fillInstances();
+
+private:
+    uint32_t _size;
+    bool _timestamps;
+    VkInstance _instance = VK_NULL_HANDLE;
+    VkPhysicalDevice _physicalDevice = VK_NULL_HANDLE;
+    VkDevice _device = VK_NULL_HANDLE;
+    VkQueue _queue = VK_NULL_HANDLE;
+    uint32_t _queueFamily = 0;
+    float _timestampPeriod = 1.0f;
+
+    VkImage _image = VK_NULL_HANDLE;
+    VkDeviceMemory _imageMemory = VK_NULL_HANDLE;
+    VkImageView _imageView = VK_NULL_HANDLE;
+    VkRenderPass _renderPass = VK_NULL_HANDLE;
+    VkFramebuffer _framebuffer = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout _descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet _descriptorSet = VK_NULL_HANDLE;
+    buffer _uniformBuffer;
+    buffer _projectionBuffer;
+
+    shaderModule _vertexShader;
+    shaderModule _fragmentShader;
+    pipeline _pipeline;
+
+    buffer _vertexBuffer;
+    buffer _indexBuffer;
+    buffer _readbackBuffer;
+    instanceBuffer _instances;
+
+    VkCommandPool _commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer _commandBuffer = VK_NULL_HANDLE;
+    VkFence _fence = VK_NULL_HANDLE;
+    VkQueryPool _queryPool = VK_NULL_HANDLE;
+};
+
+#endif /* headlessDevice_hpp */
@@ -0,0 +1,145 @@
+//
+//  instancingBench.cpp
+//  vulkanTesting
+//
+//  Renders a grid of quads into an offscreen image, without a window, two ways:
+//  one vkCmdDrawIndexed per quad, and a single instanced draw that reads the
+//  per quad transform and color from an instanceBuffer.  For each it prints the
+//  CPU time to record the frame and the GPU time between timestamps, averaged
+//  over the frames.  The image is read back after each run and must not be
+//  empty.  Exit code 2 means nothing was drawn.
+//
+//  usage: instancingBench [shaderDirectory] [--count N] [--frames F] [--size S]
+//
+//  shaderDirectory holds instanced.spv and frag.spv (default shaders/).  The device,
+//  target and pipeline come from headlessDevice.cpp, built alongside.
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "headlessDevice.hpp"
+
+namespace
+{
+    // records and submits one frame, returns the GPU time in milliseconds
+    double renderFrame(headlessDevice & device, bool instanced, double & recordMs)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        VkCommandBuffer commandBuffer = device.beginFrame(VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, device.getPipeline().getPipeline());
+
+        instanceBuffer & instances = device.getInstances();
+        VkBuffer vertexBuffers[] = {device.getVertexBuffer().handle, instances.getBuffer()};
+        VkDeviceSize offsets[] = {0, instances.getOffset(0)};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, device.getIndexBuffer().handle, 0, VK_INDEX_TYPE_UINT16);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, device.getPipeline().getPipeineLayout(), 0, 1, &device.getDescriptorSet(), 0, nullptr);
+
+        uint32_t indexCount = device.getIndexCount();
+        if (instanced)
+        {
+            vkCmdDrawIndexed(commandBuffer, indexCount, instances.capacity(), 0, 0, 0);
+        }
+        else
+        {
+            // same instance data, one draw per quad picked out by firstInstance
+            for (uint32_t i = 0; i < instances.capacity(); ++i)
+            {
+                vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, i);
+            }
+        }
+
+        device.endFrame();
+        recordMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        device.submitFrame();
+        return device.gpuMilliseconds();
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    std::string shaderDirectory = "shaders/";
+    uint32_t count = 100000;
+    uint32_t frames = 60;
+    uint32_t size = 1024;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--count" && i + 1 < argc)
+        {
+            count = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if (argument == "--frames" && i + 1 < argc)
+        {
+            frames = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if (argument == "--size" && i + 1 < argc)
+        {
+            size = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if (argument[0] != '-')
+        {
+            shaderDirectory = argument;
+            if (shaderDirectory.back() != '/')
+            {
+                shaderDirectory += '/';
+            }
+        }
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [shaderDirectory] [--count N] [--frames F] [--size S]" << std::endl;
+            return 1;
+        }
+    }
+    if (count == 0 || frames == 0 || size == 0)
+    {
+        std::cout << "count, frames and size must be positive" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        headlessDevice device("instancingBench", shaderDirectory, size, count, true);
+        std::cout << count << " quads, " << frames << " frames at " << size << "x" << size << std::endl;
+
+        const bool modes[] = {false, true};
+        for (bool instanced : modes)
+        {
+            // one warm up frame so pipeline and memory first use is not timed
+            double recordMs = 0.0;
+            renderFrame(device, instanced, recordMs);
+
+            double totalRecordMs = 0.0;
+            double totalGpuMs = 0.0;
+            for (uint32_t frame = 0; frame < frames; ++frame)
+            {
+                totalGpuMs += renderFrame(device, instanced, recordMs);
+                totalRecordMs += recordMs;
+            }
+
+            size_t covered = device.coveredPixels();
+            std::cout << std::setw(10) << (instanced ? "instanced" : "per draw") << ": "
+                      << (instanced ? 1 : count) << " draws, record " << std::fixed << std::setprecision(3) << totalRecordMs / frames
+                      << " ms, gpu " << totalGpuMs / frames << " ms, "
+                      << std::setprecision(1) << 100.0 * covered / (static_cast<double>(size) * size) << "% covered" << std::endl;
+            if (covered == 0)
+            {
+                std::cout << "nothing was drawn" << std::endl;
+                return 2;
+            }
+        }
+    }
+    catch (const std::exception & e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
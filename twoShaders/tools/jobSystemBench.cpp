@@ -0,0 +1,323 @@
+//
+//  jobSystemBench.cpp
+//  vulkanTesting
+//
+//  Stress tests and a scaling benchmark for jobSystem.  The stress pass runs,
+//  on 1 to T threads and for several rounds each: a flood of small tasks, a
+//  tree of tasks that spawn and wait on their children, chains of stages held
+//  back on the previous stage's counter, tasks that must run on the main
+//  thread, exceptions carried back to wait(), and parallelFor coverage.  Exit
+//  code 2 means one of them went wrong.  The benchmark then times the same
+//  parallelFor workload and a spawn heavy task tree on 1, 2, 4 ... T threads.
+//
+//  usage: jobSystemBench [--threads T] [--rounds R] [--items N] [--passes P] [--no-stress]
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../jobSystem.hpp"
+
+namespace
+{
+    // Best of passes, in milliseconds
+    double timeBest(uint32_t passes, const std::function<void()> & pass)
+    {
+        double best = 1.0e30;
+        for (uint32_t i = 0; i < passes; ++i)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            pass();
+            best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    bool check(bool passed, const std::string & what, unsigned threadCount)
+    {
+        if (!passed)
+        {
+            std::cout << "  FAILED on " << threadCount << " threads: " << what << std::endl;
+        }
+        return passed;
+    }
+
+    // Every task below depth spawns two children and waits on them
+    void spawnTree(jobSystem & jobs, uint32_t depth, std::atomic<uint64_t> & leaves)
+    {
+        if (depth == 0)
+        {
+            leaves.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        jobSystem::counter children;
+        jobs.run([&jobs, depth, &leaves]() { spawnTree(jobs, depth - 1, leaves); }, &children);
+        jobs.run([&jobs, depth, &leaves]() { spawnTree(jobs, depth - 1, leaves); }, &children);
+        jobs.wait(children);
+    }
+
+    // A few microseconds of arithmetic per item
+    float work(size_t item)
+    {
+        float value = static_cast<float>(item);
+        for (int i = 0; i < 64; ++i)
+        {
+            value = std::sqrt(value * 1.0001f + 1.0f);
+        }
+        return value;
+    }
+
+    bool stress(unsigned threadCount, uint32_t rounds)
+    {
+        bool passed = true;
+        for (uint32_t round = 0; round < rounds; ++round)
+        {
+            jobSystem jobs;
+            jobs.create(threadCount);
+
+            // a flood of independent tasks, more than one deque holds
+            {
+                const uint32_t taskCount = 20000;
+                std::atomic<uint32_t> ran(0);
+                jobSystem::counter done;
+                for (uint32_t i = 0; i < taskCount; ++i)
+                {
+                    jobs.run([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); }, &done);
+                }
+                jobs.wait(done);
+                passed &= check(ran.load() == taskCount && done.pending() == 0, "flood ran " + std::to_string(ran.load()) + " tasks", threadCount);
+            }
+
+            // nested spawn and wait, waits inside tasks help instead of blocking
+            {
+                const uint32_t depth = 12;
+                std::atomic<uint64_t> leaves(0);
+                jobSystem::counter done;
+                jobs.run([&]() { spawnTree(jobs, depth, leaves); }, &done);
+                jobs.wait(done);
+                passed &= check(leaves.load() == (1ull << depth), "tree reached " + std::to_string(leaves.load()) + " leaves", threadCount);
+            }
+
+            // stages held back on the previous stage, each must see it complete
+            {
+                const uint32_t stageCount = 16;
+                const uint32_t tasksPerStage = 64;
+                std::vector<std::atomic<uint32_t>> finished(stageCount);
+                std::vector<jobSystem::counter> stages(stageCount);
+                std::atomic<uint32_t> early(0);
+                for (uint32_t stage = 0; stage < stageCount; ++stage)
+                {
+                    finished[stage].store(0);
+                }
+                for (uint32_t stage = 0; stage < stageCount; ++stage)
+                {
+                    jobSystem::counter * after = stage > 0 ? &stages[stage - 1] : nullptr;
+                    for (uint32_t i = 0; i < tasksPerStage; ++i)
+                    {
+                        jobs.run([&, stage]() {
+                            if (stage > 0 && finished[stage - 1].load() != tasksPerStage)
+                            {
+                                early.fetch_add(1);
+                            }
+                            finished[stage].fetch_add(1);
+                        }, &stages[stage], after);
+                    }
+                }
+                jobs.wait(stages[stageCount - 1]);
+                passed &= check(early.load() == 0 && finished[stageCount - 1].load() == tasksPerStage,
+                                std::to_string(early.load()) + " tasks ran before their stage's dependency", threadCount);
+            }
+
+            // main thread tasks handed out by workers, run while the main thread waits
+            {
+                const uint32_t taskCount = 256;
+                std::thread::id mainThread = std::this_thread::get_id();
+                std::atomic<uint32_t> ranOnMain(0);
+                std::atomic<uint32_t> ranElsewhere(0);
+                jobSystem::counter done;
+                for (uint32_t i = 0; i < taskCount; ++i)
+                {
+                    jobs.run([&]() {
+                        jobs.runOnMainThread([&]() {
+                            if (std::this_thread::get_id() == mainThread)
+                            {
+                                ranOnMain.fetch_add(1);
+                            }
+                            else
+                            {
+                                ranElsewhere.fetch_add(1);
+                            }
+                        }, &done);
+                    }, &done);
+                }
+                jobs.wait(done);
+                passed &= check(ranOnMain.load() == taskCount && ranElsewhere.load() == 0,
+                                std::to_string(ranElsewhere.load()) + " main thread tasks ran elsewhere", threadCount);
+            }
+
+            // the first exception comes back from wait, the other tasks still run
+            {
+                std::atomic<uint32_t> ran(0);
+                jobSystem::counter done;
+                for (uint32_t i = 0; i < 100; ++i)
+                {
+                    jobs.run([&ran, i]() {
+                        ran.fetch_add(1);
+                        if (i % 10 == 3)
+                        {
+                            throw std::runtime_error("task failed");
+                        }
+                    }, &done);
+                }
+                bool caught = false;
+                try
+                {
+                    jobs.wait(done);
+                }
+                catch (const std::runtime_error &)
+                {
+                    caught = true;
+                }
+                passed &= check(caught && ran.load() == 100, "exception was not carried back to wait", threadCount);
+            }
+
+            // parallelFor covers every index once for awkward sizes
+            for (size_t count : {size_t(1), size_t(7), size_t(1000), size_t(65537)})
+            {
+                std::vector<std::atomic<uint32_t>> hits(count);
+                for (std::atomic<uint32_t> & hit : hits)
+                {
+                    hit.store(0);
+                }
+                jobs.parallelFor(count, 100, [&](size_t first, size_t last) {
+                    for (size_t i = first; i < last; ++i)
+                    {
+                        hits[i].fetch_add(1);
+                    }
+                });
+                bool once = std::all_of(hits.begin(), hits.end(), [](const std::atomic<uint32_t> & hit) { return hit.load() == 1; });
+                passed &= check(once, "parallelFor over " + std::to_string(count) + " items missed or repeated one", threadCount);
+            }
+
+            jobs.destroy();
+            if (!passed)
+            {
+                break;
+            }
+        }
+        return passed;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t rounds = 20;
+    size_t itemCount = 1000000;
+    uint32_t passes = 10;
+    bool runStress = true;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--threads" && i + 1 < argc)
+        {
+            maxThreads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        }
+        else if (argument == "--rounds" && i + 1 < argc)
+        {
+            rounds = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        }
+        else if (argument == "--items" && i + 1 < argc)
+        {
+            itemCount = static_cast<size_t>(std::max(1ll, std::atoll(argv[++i])));
+        }
+        else if (argument == "--passes" && i + 1 < argc)
+        {
+            passes = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        }
+        else if (argument == "--no-stress")
+        {
+            runStress = false;
+        }
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [--threads T] [--rounds R] [--items N] [--passes P] [--no-stress]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<unsigned> threadCounts;
+    for (unsigned threadCount = 1; threadCount < maxThreads; threadCount *= 2)
+    {
+        threadCounts.push_back(threadCount);
+    }
+    threadCounts.push_back(maxThreads);
+
+    if (runStress)
+    {
+        std::cout << "stress, " << rounds << " rounds per thread count" << std::endl;
+        for (unsigned threadCount : threadCounts)
+        {
+            if (!stress(threadCount, rounds))
+            {
+                return 2;
+            }
+            std::cout << "  " << std::setw(3) << threadCount << " threads: passed" << std::endl;
+        }
+    }
+
+    std::cout << itemCount << " parallelFor items, tree of " << (1u << 16) << " spawned leaves, best of " << passes << std::endl;
+    std::cout << "  threads   parallelFor   speedup     tree   speedup" << std::endl;
+    std::vector<float> results(itemCount);
+    double baseFor = 0.0;
+    double baseTree = 0.0;
+    for (unsigned threadCount : threadCounts)
+    {
+        jobSystem jobs;
+        jobs.create(threadCount);
+
+        double forMs = timeBest(passes, [&]() {
+            jobs.parallelFor(itemCount, 4096, [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; ++i)
+                {
+                    results[i] = work(i);
+                }
+            });
+        });
+        double treeMs = timeBest(passes, [&]() {
+            std::atomic<uint64_t> leaves(0);
+            spawnTree(jobs, 16, leaves);
+        });
+        jobs.destroy();
+
+        if (threadCount == 1)
+        {
+            baseFor = forMs;
+            baseTree = treeMs;
+        }
+        std::cout << std::fixed << std::setprecision(3)
+                  << "  " << std::setw(7) << threadCount
+                  << std::setw(11) << forMs << " ms" << std::setw(9) << std::setprecision(2) << baseFor / forMs << "x"
+                  << std::setprecision(3) << std::setw(9) << treeMs << " ms" << std::setw(7) << std::setprecision(2) << baseTree / treeMs << "x" << std::endl;
+    }
+
+    // keep the workload from being optimised away
+    float checksum = 0.0f;
+    for (size_t i = 0; i < itemCount; i += 4096)
+    {
+        checksum += results[i];
+    }
+    std::cout << "checksum " << checksum << std::endl;
+    return 0;
+}
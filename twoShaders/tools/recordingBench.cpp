@@ -0,0 +1,184 @@
+//
+//  recordingBench.cpp
+//  vulkanTesting
+//
+//  Records a frame of one vkCmdDrawIndexed per quad into an offscreen image,
+//  without a window, through a drawQueue and a parallelRecorder, once for each
+//  thread count from 1 up to the hardware threads (doubling).  Each draw picks
+//  its quad out of an instanceBuffer by firstInstance.  It prints the CPU time to
+//  record the frame, the speedup over one thread, and the pixels covered, which
+//  must not be empty and must be the same for every thread count.  Exit code 2
+//  means they were not.
+//
+//  usage: recordingBench [shaderDirectory] [--draws N] [--frames F] [--size S] [--threads T]
+//
+//  shaderDirectory holds instanced.spv and frag.spv (default shaders/).  The device,
+//  target and pipeline come from headlessDevice.cpp, built alongside.
+//
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../drawQueue.hpp"
+#include "../parallelRecorder.hpp"
+#include "headlessDevice.hpp"
+
+namespace
+{
+    // one draw per instance, submitted once and recorded every frame
+    void fillQueue(headlessDevice & device, drawQueue & queue)
+    {
+        queue.clear();
+
+        instanceBuffer & instances = device.getInstances();
+        drawQueue::draw quad;
+        quad.pipeline = device.getPipeline().getPipeline();
+        quad.pipelineLayout = device.getPipeline().getPipeineLayout();
+        quad.descriptorSet = device.getDescriptorSet();
+        quad.vertexBufferCount = 2;
+        quad.vertexBuffers[0] = device.getVertexBuffer().handle;
+        quad.vertexBuffers[1] = instances.getBuffer();
+        quad.vertexOffsets[1] = instances.getOffset(0);
+        quad.indexBuffer = device.getIndexBuffer().handle;
+        quad.indexType = VK_INDEX_TYPE_UINT16;
+
+        uint32_t indexCount = device.getIndexCount();
+        for (uint32_t i = 0; i < instances.capacity(); ++i)
+        {
+            quad.record = [indexCount, i](VkCommandBuffer commandBuffer) {
+                vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, i);
+            };
+            queue.submit(0, static_cast<float>(i), quad);
+        }
+    }
+
+    // records a frame with recorder and submits it, returns the CPU record time in milliseconds
+    double renderFrame(headlessDevice & device, parallelRecorder & recorder, drawQueue & queue)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        VkCommandBuffer commandBuffer = device.beginFrame(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        recorder.record(device.getDevice(), commandBuffer, 0, device.getRenderPass(), 0, device.getFramebuffer(), queue, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        device.endFrame();
+
+        double recordMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        device.submitFrame();
+        return recordMs;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    std::string shaderDirectory = "shaders/";
+    uint32_t count = 50000;
+    uint32_t frames = 60;
+    uint32_t size = 1024;
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--draws" && i + 1 < argc)
+        {
+            count = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if (argument == "--frames" && i + 1 < argc)
+        {
+            frames = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if (argument == "--size" && i + 1 < argc)
+        {
+            size = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if (argument == "--threads" && i + 1 < argc)
+        {
+            maxThreads = static_cast<unsigned>(std::atoi(argv[++i]));
+        }
+        else if (argument[0] != '-')
+        {
+            shaderDirectory = argument;
+            if (shaderDirectory.back() != '/')
+            {
+                shaderDirectory += '/';
+            }
+        }
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [shaderDirectory] [--draws N] [--frames F] [--size S] [--threads T]" << std::endl;
+            return 1;
+        }
+    }
+    if (count == 0 || frames == 0 || size == 0 || maxThreads == 0)
+    {
+        std::cout << "draws, frames, size and threads must be positive" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        headlessDevice device("recordingBench", shaderDirectory, size, count, false);
+        std::cout << count << " draws, " << frames << " frames at " << size << "x" << size << std::endl;
+
+        drawQueue queue;
+        fillQueue(device, queue);
+
+        std::vector<unsigned> threadCounts;
+        for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+        {
+            threadCounts.push_back(threads);
+        }
+        threadCounts.push_back(maxThreads);
+
+        double singleThreadMs = 0.0;
+        size_t expectedCovered = 0;
+        for (unsigned threads : threadCounts)
+        {
+            parallelRecorder recorder;
+            recorder.create(device.getDevice(), device.getQueueFamily(), threads, 1);
+
+            // one warm up frame so pipeline and memory first use is not timed
+            renderFrame(device, recorder, queue);
+
+            double totalRecordMs = 0.0;
+            for (uint32_t frame = 0; frame < frames; ++frame)
+            {
+                totalRecordMs += renderFrame(device, recorder, queue);
+            }
+            recorder.destroy(device.getDevice());
+
+            double recordMs = totalRecordMs / frames;
+            if (threads == 1)
+            {
+                singleThreadMs = recordMs;
+            }
+
+            size_t covered = device.coveredPixels();
+            std::cout << std::setw(3) << threads << " threads: record " << std::fixed << std::setprecision(3) << recordMs
+                      << " ms, " << std::setprecision(2) << singleThreadMs / recordMs << "x, "
+                      << std::setprecision(1) << 100.0 * covered / (static_cast<double>(size) * size) << "% covered" << std::endl;
+            if (covered == 0)
+            {
+                std::cout << "nothing was drawn" << std::endl;
+                return 2;
+            }
+            if (expectedCovered != 0 && covered != expectedCovered)
+            {
+                std::cout << "coverage differs from one thread" << std::endl;
+                return 2;
+            }
+            expectedCovered = covered;
+        }
+    }
+    catch (const std::exception & e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
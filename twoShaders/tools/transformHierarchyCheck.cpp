@@ -0,0 +1,354 @@
+//
+//  transformHierarchyCheck.cpp
+//  vulkanTesting
+//
+//  Builds random transform trees and compares every world matrix after each
+//  update with a naive recursive evaluation of the local transforms: right
+//  after building, over frames of random edits, after nodes are added to a
+//  tree that has already been updated (which re-sorts it), and with levels
+//  wide enough to be split over the job system.  write() must keep a copy of
+//  the instances in sync from the frame it returns.  Nothing touches a device.
+//  Exit code 2 means a world matrix or an instance was wrong.
+//
+//  usage: transformHierarchyCheck [--nodes N] [--frames F] [--threads T] [--verbose]
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "../jobSystem.hpp"
+#include "../transformHierarchy.hpp"
+
+namespace
+{
+    bool verbose = false;
+
+    // xorshift, deterministic
+    uint32_t randomState = 0x2545F491u;
+    uint32_t random()
+    {
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        return randomState;
+    }
+
+    // in [low, high)
+    float randomFloat(float low, float high)
+    {
+        return low + (high - low) * static_cast<float>(random() % 65536) / 65536.0f;
+    }
+
+    bool check(const std::string & name, bool passed)
+    {
+        std::cout << (passed ? "  ok      " : "  FAILED  ") << name << std::endl;
+        return passed;
+    }
+
+    // The same tree kept by handle, evaluated from scratch
+    struct referenceNode {
+        uint32_t parent;
+        int32_t instance;
+        glm::vec3 translation;
+        glm::quat rotation;
+        glm::vec3 scale;
+    };
+
+    class referenceTree
+    {
+    public:
+        referenceTree(transformHierarchy & hierarchy) : _hierarchy(hierarchy)
+        {
+        }
+
+        uint32_t add(uint32_t parent, int32_t instance = transformHierarchy::noInstance)
+        {
+            uint32_t handle = _hierarchy.add(parent, instance);
+            _nodes.push_back({parent, instance, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f)});
+            edit(handle);
+            return handle;
+        }
+
+        // a new translation, rotation or scale, or all three
+        void edit(uint32_t handle)
+        {
+            referenceNode & node = _nodes[handle];
+            uint32_t what = random() % 4;
+            if (what == 0 || what == 3)
+            {
+                node.translation = glm::vec3(randomFloat(-2.0f, 2.0f), randomFloat(-2.0f, 2.0f), randomFloat(-2.0f, 2.0f));
+                _hierarchy.setTranslation(handle, node.translation);
+            }
+            if (what == 1 || what == 3)
+            {
+                glm::vec3 axis = glm::normalize(glm::vec3(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(0.1f, 1.0f)));
+                node.rotation = glm::angleAxis(randomFloat(-3.0f, 3.0f), axis);
+                _hierarchy.setRotation(handle, node.rotation);
+            }
+            if (what == 2 || what == 3)
+            {
+                // near one, so matrices stay in range down deep trees
+                node.scale = glm::vec3(randomFloat(0.8f, 1.25f), randomFloat(0.8f, 1.25f), randomFloat(0.8f, 1.25f));
+                _hierarchy.setScale(handle, node.scale);
+            }
+        }
+
+        glm::mat4 world(uint32_t handle) const
+        {
+            const referenceNode & node = _nodes[handle];
+            glm::mat4 local = glm::translate(glm::mat4(1.0f), node.translation) * glm::mat4_cast(node.rotation) *
+                              glm::scale(glm::mat4(1.0f), node.scale);
+            return node.parent == transformHierarchy::noParent ? local : world(node.parent) * local;
+        }
+
+        // largest difference of any world matrix element, relative to its size
+        float worstError() const
+        {
+            float worst = 0.0f;
+            for (uint32_t handle = 0; handle < _nodes.size(); ++handle)
+            {
+                worst = std::max(worst, difference(world(handle), _hierarchy.getWorld(handle)));
+            }
+            return worst;
+        }
+
+        // write() into instances, which has to match every instance node after
+        bool instancesMatch(std::vector<instanceData> & instances, uint64_t & writtenFrame) const
+        {
+            writtenFrame = _hierarchy.write(instances.data(), writtenFrame);
+            for (uint32_t handle = 0; handle < _nodes.size(); ++handle)
+            {
+                int32_t instance = _nodes[handle].instance;
+                if (instance != transformHierarchy::noInstance && difference(instances[instance].model, _hierarchy.getWorld(handle)) != 0.0f)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        size_t size() const
+        {
+            return _nodes.size();
+        }
+
+    private:
+        static float difference(const glm::mat4 & a, const glm::mat4 & b)
+        {
+            float worst = 0.0f;
+            for (int column = 0; column < 4; ++column)
+            {
+                for (int row = 0; row < 4; ++row)
+                {
+                    float size = std::max(1.0f, std::abs(a[column][row]));
+                    worst = std::max(worst, std::abs(a[column][row] - b[column][row]) / size);
+                }
+            }
+            return worst;
+        }
+
+        transformHierarchy & _hierarchy;
+        std::vector<referenceNode> _nodes;
+    };
+
+    // float rounding of a few matrix products per level
+    const float tolerance = 1e-4f;
+
+    // Random trees, parents drawn from the nodes already added, then frames of
+    // random edits with nodes added part way through
+    bool randomTrees(size_t nodeCount, size_t frameCount, jobSystem & jobs)
+    {
+        transformHierarchy hierarchy;
+        referenceTree reference(hierarchy);
+        std::vector<instanceData> instances(2 * nodeCount + frameCount);
+        int32_t nextInstance = 0;
+
+        auto addRandom = [&]() {
+            // a few roots, otherwise under any earlier node
+            uint32_t parent = (reference.size() == 0 || random() % 64 == 0) ? transformHierarchy::noParent
+                                                                             : random() % reference.size();
+            int32_t instance = random() % 2 == 0 ? nextInstance++ : transformHierarchy::noInstance;
+            reference.add(parent, instance);
+        };
+
+        for (size_t i = 0; i < nodeCount; ++i)
+        {
+            addRandom();
+        }
+        hierarchy.update(&jobs);
+
+        uint64_t writtenFrame = 0;
+        float built = reference.worstError();
+        bool instancesSynced = reference.instancesMatch(instances, writtenFrame);
+
+        float edited = 0.0f;
+        float added = 0.0f;
+        for (size_t frame = 0; frame < frameCount; ++frame)
+        {
+            size_t edits = random() % 32;
+            for (size_t e = 0; e < edits; ++e)
+            {
+                reference.edit(random() % reference.size());
+            }
+
+            // every fourth frame grows the tree after it has been sorted
+            bool grows = frame % 4 == 3;
+            if (grows)
+            {
+                size_t adds = 1 + random() % 16;
+                for (size_t a = 0; a < adds; ++a)
+                {
+                    addRandom();
+                }
+            }
+
+            hierarchy.update(&jobs);
+            float error = reference.worstError();
+            if (grows)
+            {
+                added = std::max(added, error);
+            }
+            else
+            {
+                edited = std::max(edited, error);
+            }
+            instancesSynced &= reference.instancesMatch(instances, writtenFrame);
+        }
+
+        if (verbose)
+        {
+            std::cout << "    " << reference.size() << " nodes, worst relative error " << std::max(built, std::max(edited, added)) << std::endl;
+        }
+
+        bool passed = check("world matrices after building", built <= tolerance);
+        passed &= check("world matrices after random edits", edited <= tolerance);
+        passed &= check("world matrices after later adds", added <= tolerance);
+        passed &= check("write keeps the instances in sync", instancesSynced);
+        return passed;
+    }
+
+    // Levels wide enough that update() splits them over the job system
+    bool wideLevels(size_t width, size_t frameCount, jobSystem & jobs)
+    {
+        transformHierarchy hierarchy;
+        referenceTree reference(hierarchy);
+        std::vector<instanceData> instances(2 * width + 2 * frameCount);
+
+        uint32_t root = reference.add(transformHierarchy::noParent);
+        std::vector<uint32_t> middle;
+        for (size_t i = 0; i < width; ++i)
+        {
+            middle.push_back(reference.add(root));
+        }
+        int32_t nextInstance = 0;
+        for (size_t i = 0; i < width; ++i)
+        {
+            reference.add(middle[random() % middle.size()], nextInstance++);
+        }
+        hierarchy.update(&jobs);
+
+        uint64_t writtenFrame = 0;
+        float worst = reference.worstError();
+        bool instancesSynced = reference.instancesMatch(instances, writtenFrame);
+
+        for (size_t frame = 0; frame < frameCount; ++frame)
+        {
+            // the root moves everything, or a few middle nodes their children
+            if (frame % 2 == 0)
+            {
+                reference.edit(root);
+            }
+            for (size_t e = 0; e < 8; ++e)
+            {
+                reference.edit(middle[random() % middle.size()]);
+            }
+            reference.add(middle[random() % middle.size()], nextInstance++);
+
+            hierarchy.update(&jobs);
+            worst = std::max(worst, reference.worstError());
+            instancesSynced &= reference.instancesMatch(instances, writtenFrame);
+        }
+
+        if (verbose)
+        {
+            std::cout << "    " << reference.size() << " nodes on " << jobs.threadCount() << " threads, worst relative error " << worst << std::endl;
+        }
+
+        bool passed = check("world matrices of levels split over jobs", worst <= tolerance);
+        passed &= check("write keeps split levels' instances in sync", instancesSynced);
+        return passed;
+    }
+
+    bool singleThreaded()
+    {
+        transformHierarchy hierarchy;
+        referenceTree reference(hierarchy);
+        uint32_t parent = reference.add(transformHierarchy::noParent);
+        for (int i = 0; i < 40; ++i)
+        {
+            parent = reference.add(parent);
+        }
+        hierarchy.update();
+        float worst = reference.worstError();
+
+        reference.edit(0);
+        hierarchy.update();
+        worst = std::max(worst, reference.worstError());
+        return check("a chain without a job system", worst <= tolerance);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    size_t nodeCount = 20000;
+    size_t frameCount = 64;
+    unsigned threadCount = 4;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--nodes" && i + 1 < argc)
+        {
+            nodeCount = std::max<size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+        }
+        else if (argument == "--frames" && i + 1 < argc)
+        {
+            frameCount = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (argument == "--threads" && i + 1 < argc)
+        {
+            threadCount = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (argument == "--verbose")
+        {
+            verbose = true;
+        }
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [--nodes N] [--frames F] [--threads T] [--verbose]" << std::endl;
+            return 1;
+        }
+    }
+
+    jobSystem jobs;
+    jobs.create(threadCount);
+
+    bool passed = true;
+    passed &= randomTrees(nodeCount, frameCount, jobs);
+    passed &= wideLevels(3 * nodeCount / 2, frameCount / 4, jobs);
+    passed &= singleThreaded();
+
+    jobs.destroy();
+
+    std::cout << (passed ? "every world matrix matched the recursive evaluation" : "transform hierarchy check failed") << std::endl;
+    return passed ? 0 : 2;
+}
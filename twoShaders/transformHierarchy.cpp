@@ -0,0 +1,206 @@
+//
+//  transformHierarchy.cpp
+//  vulkanTesting
+//
+
+#include "transformHierarchy.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace
+{
+    // Below this many nodes per job, handing out the job costs more than it saves
+    const size_t minimumNodesPerJob = 4096;
+
+    template<typename T>
+    void permute(std::vector<T> & values, const std::vector<uint32_t> & order)
+    {
+        std::vector<T> sorted(order.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            sorted[i] = values[order[i]];
+        }
+        values.swap(sorted);
+    }
+}
+
+const uint32_t transformHierarchy::noParent;
+const int32_t transformHierarchy::noInstance;
+
+transformHierarchy::transformHierarchy() : _sorted(true),
+                                           _frame(0)
+{
+}
+
+uint32_t transformHierarchy::add(uint32_t parent, int32_t instance)
+{
+    if (parent != noParent && parent >= _slots.size())
+    {
+        throw std::runtime_error("failed to add transform, parent does not exist!");
+    }
+
+    uint32_t handle = static_cast<uint32_t>(_slots.size());
+    uint32_t slot = static_cast<uint32_t>(_handles.size());
+    uint32_t parentSlot = (parent == noParent) ? noParent : _slots[parent];
+
+    _translation.push_back(glm::vec3(0.0f));
+    _rotation.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    _scale.push_back(glm::vec3(1.0f));
+    _world.push_back(glm::mat4(1.0f));
+    _parent.push_back(parentSlot);
+    _depth.push_back((parentSlot == noParent) ? 0 : _depth[parentSlot] + 1);
+    _instance.push_back(instance);
+    _dirty.push_back(1);
+    _changedFrame.push_back(0);
+    _handles.push_back(handle);
+    _slots.push_back(slot);
+
+    // the levels are rebuilt by the next update
+    _sorted = false;
+    return handle;
+}
+
+void transformHierarchy::setTranslation(uint32_t node, const glm::vec3 & translation)
+{
+    uint32_t slot = _slots[node];
+    _translation[slot] = translation;
+    _dirty[slot] = 1;
+}
+
+void transformHierarchy::setRotation(uint32_t node, const glm::quat & rotation)
+{
+    uint32_t slot = _slots[node];
+    _rotation[slot] = rotation;
+    _dirty[slot] = 1;
+}
+
+void transformHierarchy::setScale(uint32_t node, const glm::vec3 & scale)
+{
+    uint32_t slot = _slots[node];
+    _scale[slot] = scale;
+    _dirty[slot] = 1;
+}
+
+const glm::mat4 & transformHierarchy::getWorld(uint32_t node) const
+{
+    return _world[_slots[node]];
+}
+
+size_t transformHierarchy::size() const
+{
+    return _handles.size();
+}
+
+void transformHierarchy::sortByDepth()
+{
+    std::vector<uint32_t> order(_handles.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        return _depth[a] < _depth[b];
+    });
+
+    std::vector<uint32_t> newSlot(order.size());
+    for (uint32_t i = 0; i < order.size(); ++i)
+    {
+        newSlot[order[i]] = i;
+    }
+
+    permute(_translation, order);
+    permute(_rotation, order);
+    permute(_scale, order);
+    permute(_world, order);
+    permute(_parent, order);
+    permute(_depth, order);
+    permute(_instance, order);
+    permute(_dirty, order);
+    permute(_changedFrame, order);
+    permute(_handles, order);
+
+    for (uint32_t & parent : _parent)
+    {
+        parent = (parent == noParent) ? noParent : newSlot[parent];
+    }
+    for (uint32_t i = 0; i < _handles.size(); ++i)
+    {
+        _slots[_handles[i]] = i;
+    }
+
+    _levelStart.clear();
+    for (size_t i = 0; i < _depth.size(); ++i)
+    {
+        if (i == 0 || _depth[i] != _depth[i - 1])
+        {
+            _levelStart.push_back(i);
+        }
+    }
+    _levelStart.push_back(_depth.size());
+    _sorted = true;
+}
+
+void transformHierarchy::updateRange(size_t first, size_t last)
+{
+    for (size_t i = first; i < last; ++i)
+    {
+        uint32_t parent = _parent[i];
+        if (!_dirty[i] && (parent == noParent || !_dirty[parent]))
+        {
+            continue;
+        }
+
+        // scale, then rotate, then translate
+        glm::mat4 local = glm::mat4_cast(_rotation[i]);
+        local[0] *= _scale[i].x;
+        local[1] *= _scale[i].y;
+        local[2] *= _scale[i].z;
+        local[3] = glm::vec4(_translation[i], 1.0f);
+
+        _world[i] = (parent == noParent) ? local : _world[parent] * local;
+
+        // the level below sees this node as dirty and follows it
+        _dirty[i] = 1;
+        _changedFrame[i] = _frame;
+    }
+}
+
+void transformHierarchy::update(jobSystem * jobs)
+{
+    if (!_sorted)
+    {
+        sortByDepth();
+    }
+    ++_frame;
+
+    for (size_t level = 0; level + 1 < _levelStart.size(); ++level)
+    {
+        size_t first = _levelStart[level];
+        size_t count = _levelStart[level + 1] - first;
+
+        // each job takes a contiguous run of the level
+        if (jobs != nullptr && jobs->threadCount() > 1 && count >= 2 * minimumNodesPerJob)
+        {
+            jobs->parallelFor(count, minimumNodesPerJob, [this, first](size_t begin, size_t end) {
+                updateRange(first + begin, first + end);
+            });
+        }
+        else
+        {
+            updateRange(first, first + count);
+        }
+    }
+
+    std::fill(_dirty.begin(), _dirty.end(), 0);
+}
+
+uint64_t transformHierarchy::write(instanceData * instances, uint64_t writtenFrame) const
+{
+    for (size_t i = 0; i < _instance.size(); ++i)
+    {
+        if (_instance[i] != noInstance && _changedFrame[i] > writtenFrame)
+        {
+            instances[_instance[i]].model = _world[i];
+        }
+    }
+    return _frame;
+}
@@ -0,0 +1,86 @@
+//
+//  transformHierarchy.hpp
+//  vulkanTesting
+//
+
+#ifndef transformHierarchy_hpp
+#define transformHierarchy_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "instanceBuffer.hpp"
+#include "jobSystem.hpp"
+
+// Parent / child transforms kept as structure of arrays sorted by depth, so every
+// parent sits in an earlier level than its children.  A level only reads the
+// level above it, which lets update() split each level across threads.  Nodes
+// are dirtied by their setters and a dirty node recomputes itself and everything
+// below it; untouched subtrees keep last frame's world matrix.  The threads are
+// the job system's, update() waits for each level before starting the next.
+//
+// Nodes are addressed by the handle add() returns, which stays valid when the
+// arrays are re-sorted.
+class transformHierarchy
+{
+public:
+    static const uint32_t noParent = UINT32_MAX;
+    static const int32_t noInstance = -1;
+
+    transformHierarchy();
+
+    // parent has to be added first.  instance is the index in the instance
+    // buffer that receives this node's world matrix, if any.
+    uint32_t add(uint32_t parent, int32_t instance = noInstance);
+
+    void setTranslation(uint32_t node, const glm::vec3 & translation);
+
+    void setRotation(uint32_t node, const glm::quat & rotation);
+
+    void setScale(uint32_t node, const glm::vec3 & scale);
+
+    const glm::mat4 & getWorld(uint32_t node) const;
+
+    size_t size() const;
+
+    // Recompute the dirty subtrees level by level, each level split over jobs if
+    // given.  Small levels stay on the calling thread.
+    void update(jobSystem * jobs = nullptr);
+
+    // Write the model matrix of every instance node changed since writtenFrame
+    // into instances, and return the frame to pass next time.  Keep one frame per
+    // destination, e.g. per segment of the instance ring.
+    uint64_t write(instanceData * instances, uint64_t writtenFrame) const;
+
+private:
+    void sortByDepth();
+
+    void updateRange(size_t first, size_t last);
+
+private:
+    // per node, in depth order
+    std::vector<glm::vec3> _translation;
+    std::vector<glm::quat> _rotation;
+    std::vector<glm::vec3> _scale;
+    std::vector<glm::mat4> _world;
+    std::vector<uint32_t> _parent; // position in these arrays, or noParent
+    std::vector<uint32_t> _depth;
+    std::vector<int32_t> _instance;
+    std::vector<uint8_t> _dirty;
+    std::vector<uint64_t> _changedFrame;
+    std::vector<uint32_t> _handles;
+
+    // handle to position in the arrays
+    std::vector<uint32_t> _slots;
+
+    // first node of each level, plus one past the last node
+    std::vector<size_t> _levelStart;
+    bool _sorted;
+    uint64_t _frame;
+};
+
+#endif /* transformHierarchy_hpp */
@@ -5,24 +5,36 @@
 //  Created by Paul Premakumar on 9/7/18.
 //  Copyright © 2018 Paul Premakumar. All rights reserved.
 //
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <set>
+#include <thread>
 #include <vector>
 
 #define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "HelloTriangleApplication.h"
-#include "shaderReader.hpp"
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include "blockCompression.hpp"
+#include "ktx2.hpp"
+#include "meshLoader.hpp"
+#include "meshOptimizer.hpp"
+#include "meshSimplifier.hpp"
+#include "meshlet.hpp"
+#include "textureCache.hpp"
+#include "vertexFormat.hpp"
+#include "vertexLayout.hpp"
 
 namespace
 {
@@ -39,62 +51,113 @@ namespace
     const bool enableValidationLayers = true;
 #endif
 
-    struct Vertex {
-        glm::vec2 pos;
-        glm::vec3 color;
-        glm::vec2 texCoord;
-
-        static VkVertexInputBindingDescription getBindingDescription() {
-            VkVertexInputBindingDescription bindingDescription = {};
-
-            bindingDescription.binding = 0;
-            bindingDescription.stride = sizeof(Vertex);
-            bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-            return bindingDescription;
-        }
-
-        static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
-        {
-            std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
-
-            attributeDescriptions[0].binding = 0;
-            attributeDescriptions[0].location = 0;
-            attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-            attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-            attributeDescriptions[1].binding = 0;
-            attributeDescriptions[1].location = 1;
-            attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-            attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-            attributeDescriptions[2].binding = 0;
-            attributeDescriptions[2].location = 2;
-            attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-            attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-            return attributeDescriptions;
-        }
-    };
-
-    // Interleaved position and color
+    // Interleaved position and color, drawn when there is no model to load
     const std::vector<Vertex> vertices = {
-        {{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
-        {{0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
-        {{0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}},
-        {{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f}}
+        {{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
+        {{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
+        {{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}},
+        {{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f}}
     };
 
     // The order to draw the above vertices
-    const std::vector<uint16_t> indices = {
+    const std::vector<uint32_t> indices = {
         0, 1, 2, 2, 3, 0
     };
 
+    // First one found (pack or loose file) is loaded
+    const std::vector<std::string> modelAssets = {
+        "models/model.glb", "models/model.gltf", "models/model.obj"
+    };
+
     struct MVPUniformBufferObject {
         glm::mat4 model;
         glm::mat4 view;
         glm::mat4 proj;
     };
+
+    static_assert(vertexLayout::std140Block<MVPUniformBufferObject,
+                                            UNIFORM_LAYOUT_FIELD(MVPUniformBufferObject, model),
+                                            UNIFORM_LAYOUT_FIELD(MVPUniformBufferObject, view),
+                                            UNIFORM_LAYOUT_FIELD(MVPUniformBufferObject, proj)>::valid,
+                  "MVPUniformBufferObject must match the std140 block in shader.vert");
+
+    // Planes and camera in model space, rewritten every frame
+    struct CullingUniformBufferObject {
+        glm::vec4 planes[6];
+        glm::vec4 cameraPosition;
+        uint32_t clusterCount;
+        uint32_t clusterOffset; // first cluster of the current LOD level
+        uint32_t padding[2];
+        // occlusion culling only
+        glm::mat4 modelView;
+        glm::vec4 projection;   // proj[0][0], proj[1][1], proj[2][2], proj[3][2]
+        glm::vec4 occlusion;    // Hi-Z level 0 width and height, level count, model to view scale
+    };
+
+    static_assert(vertexLayout::std140Block<CullingUniformBufferObject,
+                                            UNIFORM_LAYOUT_FIELD(CullingUniformBufferObject, planes),
+                                            UNIFORM_LAYOUT_FIELD(CullingUniformBufferObject, cameraPosition),
+                                            UNIFORM_LAYOUT_FIELD(CullingUniformBufferObject, clusterCount),
+                                            UNIFORM_LAYOUT_FIELD(CullingUniformBufferObject, clusterOffset),
+                                            UNIFORM_LAYOUT_FIELD(CullingUniformBufferObject, modelView),
+                                            UNIFORM_LAYOUT_FIELD(CullingUniformBufferObject, projection),
+                                            UNIFORM_LAYOUT_FIELD(CullingUniformBufferObject, occlusion)>::valid,
+                  "CullingUniformBufferObject must match the std140 block in cull.comp");
+
+    // Below this a plain indexed draw costs less than the culling dispatch saves
+    const size_t clusterCullingMinTriangles = 4096;
+
+    // Draw the mesh into the depth buffer first, positions only, so the main pass's
+    // EQUAL test runs the fragment shader once per pixel.  Costs a second geometry pass.
+    const bool depthPrePass = true;
+
+    // Scales the command buffers are recorded for, evenly from 50% to 100% of each
+    // axis.  Switching between them per frame costs nothing, unlike resizing images.
+    const uint32_t resolutionSteps = 9;
+
+    // Present mode, swap chain length and CPU pacing, see framePacer.hpp
+    const framePacer::mode latencyMode = framePacer::lowLatency;
+
+    // Workgroup size of shaders/hiz.comp in each dimension
+    const uint32_t hiZGroupSize = 8;
+
+    struct HiZPushConstants {
+        int32_t sourceSize[2];
+        int32_t destinationSize[2];
+    };
+
+    // Largest LOD error allowed on screen.  Under a pixel, switching levels is not visible.
+    const float lodPixelThreshold = 1.0f;
+
+    // Loose assets and assets.pak live in vulkanTesting/, relative to the Xcode build directory
+    std::string assetDirectory()
+    {
+        return std::string(std::getenv("PWD")) + "/../../../../../vulkanTesting/";
+    }
+
+    // The frame pacer's clock
+    double secondsNow()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Viewport and scissor, dynamic in every pipeline
+    void setViewport(VkCommandBuffer commandBuffer, VkExtent2D extent)
+    {
+        VkViewport viewport = {};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(extent.width);
+        viewport.height = static_cast<float>(extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor = {};
+        scissor.offset = {0, 0};
+        scissor.extent = extent;
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    }
 }
 
 void HelloTriangleApplication::run() {
@@ -107,11 +170,51 @@ void HelloTriangleApplication::run() {
 void HelloTriangleApplication::initWindow() {
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
     _window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan window", nullptr, nullptr);
+    glfwSetWindowUserPointer(_window, this);
+    glfwSetFramebufferSizeCallback(_window, framebufferResizeCallback);
+    glfwSetWindowRefreshCallback(_window, windowRefreshCallback);
+}
+
+void HelloTriangleApplication::framebufferResizeCallback(GLFWwindow * window, int, int)
+{
+    HelloTriangleApplication * application = static_cast<HelloTriangleApplication *>(glfwGetWindowUserPointer(window));
+    application->_framebufferResized = true;
+}
+
+void HelloTriangleApplication::windowRefreshCallback(GLFWwindow * window)
+{
+    // Also called before initVulkan has made anything to draw with
+    HelloTriangleApplication * application = static_cast<HelloTriangleApplication *>(glfwGetWindowUserPointer(window));
+    if (application->_commandBuffers.empty())
+    {
+        return;
+    }
+
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(window, &width, &height);
+    if (width > 0 && height > 0)
+    {
+        application->drawFrame();
+    }
 }
 
 void HelloTriangleApplication::initVulkan() {
+    framePacer::settings pacing;
+    pacing.latencyMode = latencyMode;
+    _framePacer = framePacer(pacing);
+    std::cout << "Latency mode " << framePacer::modeName(latencyMode) << std::endl;
+
+    // Built by tools/assetPacker.  Without it every asset is read from its own file.
+    if (_assets.open(assetDirectory() + "assets.pak"))
+    {
+        std::cout << "Opened asset pack with " << _assets.entryCount() << " entries" << std::endl;
+    }
+
+    // Anything not in the pack is read in the background while the device is created
+    prefetchAssets({"shaders/vert.spv", "shaders/frag.spv", "shaders/cull.spv", "shaders/cullOcclusion.spv", "shaders/hiz.spv", "shaders/depth.spv", "shaders/upscaleVert.spv", "shaders/upscaleFrag.spv", "textures/logo.ktx2", "textures/logo.jpg"});
+    prefetchAssets(modelAssets);
+
     createInstance();
     setupDebugCallback();
     createSurface();
@@ -121,24 +224,49 @@ void HelloTriangleApplication::initVulkan() {
     createImageViews();
     createRenderPass();
     createDescriptorSetLayout();
+    // The pipeline's vertex input depends on the layout the mesh is encoded with
+    loadMesh();
     createGraphicsPipeline();
-    createFrameBuffers();
     createCommandPool();
     createTextureImage();
     createTextureImageView();
     createTextureSampler();
     createVertexBuffer();
+    if (depthPrePass)
+    {
+        createPositionBuffer();
+    }
     createIndexBuffer();
-    createUniformBuffers();
-    createDescriptorPool();
-    createDescriptorSets();
-    createCommandBuffers();
+    if (_clusterCulling)
+    {
+        createClusterBuffers();
+        createCullingPipeline();
+    }
+    if (_occlusionCulling)
+    {
+        createHiZPipeline();
+    }
+    createTimestampQueries();
+    createImageResources();
+    createSwapChainResources();
     createSynchronizationObjects();
+
+    // Release reads nobody used, e.g. logo.jpg when the baked texture was loaded
+    _prefetchedAssets.clear();
 }
 
 void HelloTriangleApplication::mainLoop()
 {
     while (!glfwWindowShouldClose(_window)) {
+        // A minimized window has no extent to make a swap chain for
+        int width = 0, height = 0;
+        glfwGetFramebufferSize(_window, &width, &height);
+        if (width == 0 || height == 0)
+        {
+            glfwWaitEvents();
+            continue;
+        }
+
         glfwPollEvents();
         drawFrame();
     }
@@ -149,14 +277,55 @@ void HelloTriangleApplication::mainLoop()
 void HelloTriangleApplication::drawFrame()
 {
 
+    // Blocking means the GPU finishes the frame just as the wait returns, which the pacer times
+    bool waited = vkGetFenceStatus(_device, _inFlightFences[_currentFrame]) == VK_NOT_READY;
     vkWaitForFences(_device, 1, &_inFlightFences[_currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
-    vkResetFences(_device, 1, &_inFlightFences[_currentFrame]);
+
+    // The fence was last used by frame _frameNumber + 1 - MAX_FRAMES_IN_FLIGHT, so it
+    // and every frame before it have finished
+    uint64_t completedFrame = _frameNumber + 1 >= MAX_FRAMES_IN_FLIGHT ? _frameNumber + 1 - MAX_FRAMES_IN_FLIGHT : 0;
+    _deletionQueue.collect(completedFrame);
+
+    // The GPU time of the frame that used this fence picks the resolution of this one
+    // and when to start it
+    if (_frameImages[_currentFrame] >= 0)
+    {
+        // Frames from before the image count changed wrote the retired query pool
+        if (_dynamicResolution && completedFrame > _imageResourcesRetiredFrame)
+        {
+            readFrameTime(static_cast<uint32_t>(_frameImages[_currentFrame]));
+        }
+        _framePacer.frameCompleted(secondsNow(), waited);
+        _frameImages[_currentFrame] = -1;
+    }
+
+    // Input is sampled as late as still keeps the GPU busy, see framePacer
+    double now = secondsNow();
+    double inputTime = _framePacer.inputTime(now);
+    if (inputTime > now)
+    {
+        std::this_thread::sleep_for(std::chrono::duration<double>(inputTime - now));
+    }
 
     // Acquire an image from the swap chain
     uint32_t imageIndex;
-    vkAcquireNextImageKHR(_device, _swapChain, std::numeric_limits<uint64_t>::max(), _imageAvailableSemaphores[_currentFrame], VK_NULL_HANDLE, &imageIndex);
+    VkResult acquireResult = vkAcquireNextImageKHR(_device, _swapChain, std::numeric_limits<uint64_t>::max(), _imageAvailableSemaphores[_currentFrame], VK_NULL_HANDLE, &imageIndex);
+    if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+        // Nothing was signaled, the fence stays set for the next attempt
+        recreateSwapChain();
+        return;
+    }
+    else if (acquireResult != VK_SUCCESS && acquireResult != VK_SUBOPTIMAL_KHR)
+    {
+        throw std::runtime_error("failed to acquire swap chain image!");
+    }
+
+    // Only once something will be submitted, or the next wait would never return
+    vkResetFences(_device, 1, &_inFlightFences[_currentFrame]);
     // Execute the command buffer with that image as attachment in the frame buffer
 
+    _framePacer.inputSampled(secondsNow());
     updateUniformBuffer(imageIndex);
 
     // submit the command buffer
@@ -170,7 +339,7 @@ void HelloTriangleApplication::drawFrame()
 
     // bind the command buffer associated with the image
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &_commandBuffers[imageIndex];
+    submitInfo.pCommandBuffers = &_commandBuffers[_resolutionStep * _swapChainImages.size() + imageIndex];
 
     VkSemaphore signalSemaphores[] = {_renderFinishedSemaphores[_currentFrame]};
     submitInfo.signalSemaphoreCount = 1;
@@ -179,6 +348,9 @@ void HelloTriangleApplication::drawFrame()
     if (vkQueueSubmit(_graphicsQueue, 1, &submitInfo, _inFlightFences[_currentFrame]) != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
+    _framePacer.frameSubmitted(secondsNow());
+    _frameImages[_currentFrame] = imageIndex;
+    _frameNumber++;
 
     // Return the image to the swap chain for presentation
     VkPresentInfoKHR presentInfo = {};
@@ -195,10 +367,19 @@ void HelloTriangleApplication::drawFrame()
 
     presentInfo.pResults = nullptr; // options
 
-    vkQueuePresentKHR(_presentQueue, &presentInfo);
+    VkResult presentResult = vkQueuePresentKHR(_presentQueue, &presentInfo);
 
     // increment the next frame
     _currentFrame = (_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+
+    if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR || _framebufferResized)
+    {
+        recreateSwapChain();
+    }
+    else if (presentResult != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to present swap chain image!");
+    }
 }
 
 void HelloTriangleApplication::createSurface()
@@ -290,21 +471,7 @@ namespace
     }
 
     // only VK_PRESENT_MODE_FIFO_KHR is guaranteed to be avialable
-    VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> availablePresentModes) {
-        VkPresentModeKHR bestMode = VK_PRESENT_MODE_FIFO_KHR;
-
-        for (const auto& availablePresentMode : availablePresentModes) {
-            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-                return availablePresentMode;
-            } else if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-                bestMode = availablePresentMode;
-            }
-        }
-
-        return bestMode;
-    }
-
-    VkExtent2D chooseSwapExtent (const VkSurfaceCapabilitiesKHR& capabilities)
+    VkExtent2D chooseSwapExtent (const VkSurfaceCapabilitiesKHR& capabilities, GLFWwindow * window)
     {
         // Match the current extent
         if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
@@ -314,7 +481,9 @@ namespace
         else
         {
             // Some window managers do allow us to differ here and this is indicated by setting the width and height in currentExtent to a special value: the maximum value of uint32_t. In that case we'll pick the resolution that best matches the window within the minImageExtent and maxImageExtent bounds.
-            VkExtent2D actualExtent = {WIDTH, HEIGHT};
+            int width = 0, height = 0;
+            glfwGetFramebufferSize(window, &width, &height);
+            VkExtent2D actualExtent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
 
             actualExtent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, actualExtent.width));
             actualExtent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, actualExtent.height));
@@ -542,46 +711,223 @@ namespace
     }
 }
 
-void HelloTriangleApplication::cleanupSwapChain()
+void HelloTriangleApplication::recreateSwapChain()
+{
+    _framebufferResized = false;
+    size_t imageCount = _swapChainImages.size();
+
+    // The retired handles stay valid until the frames in flight finish, createSwapChain
+    // still passes the old swap chain along
+    retireSwapChain();
+    createSwapChain();
+
+    // The driver may hand out a different number of images for the new size
+    if (_swapChainImages.size() != imageCount)
+    {
+        retireImageResources();
+        createImageResources();
+    }
+
+    createSwapChainResources();
+}
+
+void HelloTriangleApplication::createSwapChainResources()
+{
+    createImageViews();
+    // The frame buffers hold the graph's depth image, the culling descriptors its Hi-Z pyramid
+    createFrameGraph();
+    createFrameBuffers();
+    if (_clusterCulling)
+    {
+        createCullingDescriptorSets();
+    }
+    if (_occlusionCulling)
+    {
+        createHiZDescriptorSets();
+    }
+    createUpscaleDescriptorSet();
+    createCommandBuffers();
+}
+
+void HelloTriangleApplication::retireSwapChain()
 {
-    // delete frame buffers before the image views and renderpass
-    for (size_t i = 0; i < _swapChainBuffers.size(); i++) {
-        vkDestroyFramebuffer(_device, _swapChainBuffers[i], nullptr);
+    // Copies of the handles, the members are about to be replaced
+    std::vector<VkFramebuffer> frameBuffers = _swapChainBuffers;
+    frameBuffers.push_back(_sceneFrameBuffer);
+    if (depthPrePass)
+    {
+        frameBuffers.push_back(_depthFrameBuffer);
+    }
+    std::vector<VkCommandBuffer> commandBuffers = _commandBuffers;
+    retire([this, frameBuffers, commandBuffers]() {
+        // delete frame buffers before the image views
+        for (VkFramebuffer frameBuffer : frameBuffers) {
+            vkDestroyFramebuffer(_device, frameBuffer, nullptr);
+        }
+        vkFreeCommandBuffers(_device, _commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+    });
+    _commandBuffers.clear();
+
+    VkDescriptorPool upscalePool = _upscaleDescriptorPool;
+    VkSampler upscaleSampler = _upscaleSampler;
+    retire([this, upscalePool, upscaleSampler]() {
+        vkDestroyDescriptorPool(_device, upscalePool, nullptr);
+        vkDestroySampler(_device, upscaleSampler, nullptr);
+    });
+
+    if (_clusterCulling)
+    {
+        VkDescriptorPool cullingPool = _cullingDescriptorPool;
+        retire([this, cullingPool]() {
+            vkDestroyDescriptorPool(_device, cullingPool, nullptr);
+        });
+    }
+
+    if (_occlusionCulling)
+    {
+        // views of the graph's images, so before it frees them
+        std::vector<VkImageView> views = _hiZLevelViews;
+        views.push_back(_depthSampleView);
+        VkDescriptorPool hiZPool = _hiZDescriptorPool;
+        retire([this, views, hiZPool]() {
+            vkDestroyDescriptorPool(_device, hiZPool, nullptr);
+            for (VkImageView view : views) {
+                vkDestroyImageView(_device, view, nullptr);
+            }
+        });
     }
 
-    vkFreeCommandBuffers(_device, _commandPool, static_cast<uint32_t>(_commandBuffers.size()), _commandBuffers.data());
+    // The graph owns the transient images, the new one is built from scratch
+    std::shared_ptr<renderGraph> graph = std::make_shared<renderGraph>(std::move(_frameGraph));
+    _frameGraph = renderGraph();
+    retire([this, graph]() {
+        graph->destroy(_device);
+    });
 
-    // pipeline layout
-    vkDestroyPipeline(_device, _graphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
-    vkDestroyRenderPass(_device, _renderPass, nullptr);
+    std::vector<VkImageView> imageViews = _swapChainImageViews;
+    VkSwapchainKHR swapChain = _swapChain;
+    retire([this, imageViews, swapChain]() {
+        for (VkImageView imageView : imageViews) {
+            vkDestroyImageView(_device, imageView, nullptr);
+        }
+        vkDestroySwapchainKHR(_device, swapChain, nullptr);
+    });
+}
 
-    // destroy image views
-    for (size_t i = 0; i < _swapChainImageViews.size(); i++) {
-        vkDestroyImageView(_device, _swapChainImageViews[i], nullptr);
+void HelloTriangleApplication::createImageResources()
+{
+    createUniformBuffers();
+    createDescriptorPool();
+    createDescriptorSets();
+    if (_clusterCulling)
+    {
+        createCullingBuffers();
+    }
+    createDrawIndirectBuffers();
+    if (_dynamicResolution)
+    {
+        createTimestampQueryPool();
     }
+}
 
-    vkDestroySwapchainKHR(_device, _swapChain, nullptr);
+void HelloTriangleApplication::retireImageResources()
+{
+    std::vector<VkBuffer> buffers = _uniformBuffers;
+    std::vector<VkDeviceMemory> memories = _uniformBuffersMemory;
+    buffers.insert(buffers.end(), _drawIndirectBuffers.begin(), _drawIndirectBuffers.end());
+    memories.insert(memories.end(), _drawIndirectBuffersMemory.begin(), _drawIndirectBuffersMemory.end());
+    if (_clusterCulling)
+    {
+        buffers.insert(buffers.end(), _culledIndexBuffers.begin(), _culledIndexBuffers.end());
+        memories.insert(memories.end(), _culledIndexBuffersMemory.begin(), _culledIndexBuffersMemory.end());
+        buffers.insert(buffers.end(), _cullingUniformBuffers.begin(), _cullingUniformBuffers.end());
+        memories.insert(memories.end(), _cullingUniformBuffersMemory.begin(), _cullingUniformBuffersMemory.end());
+    }
+
+    // the descriptor sets go with their pool
+    VkDescriptorPool descriptorPool = _descriptorPool;
+    VkQueryPool queryPool = _dynamicResolution ? _timestampQueryPool : VK_NULL_HANDLE;
+    retire([this, buffers, memories, descriptorPool, queryPool]() {
+        vkDestroyDescriptorPool(_device, descriptorPool, nullptr);
+        vkDestroyQueryPool(_device, queryPool, nullptr);
+        for (size_t i = 0; i < buffers.size(); i++) {
+            vkDestroyBuffer(_device, buffers[i], nullptr);
+            vkFreeMemory(_device, memories[i], nullptr);
+        }
+    });
+
+    _uniformBuffers.clear();
+    _uniformBuffersMemory.clear();
+    _drawIndirectBuffers.clear();
+    _drawIndirectBuffersMemory.clear();
+    _culledIndexBuffers.clear();
+    _culledIndexBuffersMemory.clear();
+    _cullingUniformBuffers.clear();
+    _cullingUniformBuffersMemory.clear();
+    _descriptorSets.clear();
+    _imageResourcesRetiredFrame = _frameNumber;
+}
+
+void HelloTriangleApplication::retire(std::function<void()> destroy)
+{
+    // the last frame that can use the objects is the last one submitted
+    _deletionQueue.push(_frameNumber, destroy);
 }
 
 void HelloTriangleApplication::cleanup()
 {
-    cleanupSwapChain();
+    // mainLoop waited for the device to idle
+    retireSwapChain();
+    retireImageResources();
+    _deletionQueue.flush();
+
+    // pipeline layout
+    vkDestroyPipeline(_device, _graphicsPipeline, nullptr);
+    vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+    vkDestroyRenderPass(_device, _renderPass, nullptr);
+    vkDestroyPipeline(_device, _upscalePipeline, nullptr);
+    vkDestroyPipelineLayout(_device, _upscalePipelineLayout, nullptr);
+    vkDestroyRenderPass(_device, _upscaleRenderPass, nullptr);
+    if (depthPrePass)
+    {
+        vkDestroyPipeline(_device, _depthPipeline, nullptr);
+        vkDestroyRenderPass(_device, _depthRenderPass, nullptr);
+        vkDestroyRenderPass(_device, _depthLoadRenderPass, nullptr);
+    }
 
     vkDestroySampler(_device, _textureSampler, nullptr);
     vkDestroyImageView(_device, _textureImageView, nullptr);
     vkDestroyImage(_device, _textureImage, nullptr);
     vkFreeMemory(_device, _textureImageMemory, nullptr);
 
-    vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
-
     vkDestroyDescriptorSetLayout(_device, _descriptorSetLayout, nullptr);
 
-    for (size_t i = 0; i < _swapChainImages.size(); i++) {
-        vkDestroyBuffer(_device, _uniformBuffers[i], nullptr);
-        vkFreeMemory(_device, _uniformBuffersMemory[i], nullptr);
+    vkDestroyDescriptorSetLayout(_device, _upscaleDescriptorSetLayout, nullptr);
+
+    if (_clusterCulling)
+    {
+        vkDestroyPipeline(_device, _cullingPipeline, nullptr);
+        vkDestroyPipelineLayout(_device, _cullingPipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(_device, _cullingDescriptorSetLayout, nullptr);
+
+        vkDestroyBuffer(_device, _clusterIndexBuffer, nullptr);
+        vkFreeMemory(_device, _clusterIndexBufferMemory, nullptr);
+        vkDestroyBuffer(_device, _clusterBuffer, nullptr);
+        vkFreeMemory(_device, _clusterBufferMemory, nullptr);
+    }
+
+    if (_occlusionCulling)
+    {
+        vkDestroyPipeline(_device, _hiZPipeline, nullptr);
+        vkDestroyPipelineLayout(_device, _hiZPipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(_device, _hiZDescriptorSetLayout, nullptr);
+        vkDestroySampler(_device, _hiZSampler, nullptr);
+
+        vkDestroyBuffer(_device, _clusterVisibilityBuffer, nullptr);
+        vkFreeMemory(_device, _clusterVisibilityBufferMemory, nullptr);
     }
 
+
     // Index buffer and memory
     vkDestroyBuffer(_device, _indexBuffer, nullptr);
     vkFreeMemory(_device, _indexBufferMemory, nullptr);
@@ -590,6 +936,12 @@ void HelloTriangleApplication::cleanup()
     vkDestroyBuffer(_device, _vertexBuffer, nullptr);
     vkFreeMemory(_device, _vertexBufferMemory, nullptr);
 
+    if (depthPrePass)
+    {
+        vkDestroyBuffer(_device, _positionBuffer, nullptr);
+        vkFreeMemory(_device, _positionBufferMemory, nullptr);
+    }
+
     // semaphores
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
@@ -716,8 +1068,15 @@ void HelloTriangleApplication::createLogicalDevice()
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(_physicalDevice, &supportedFeatures);
+
     VkPhysicalDeviceFeatures deviceFeatures = {};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+
+    // Needed to sample the BCn textures written by textureBaker
+    _textureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -739,17 +1098,65 @@ void HelloTriangleApplication::createLogicalDevice()
     vkGetDeviceQueue(_device, indices.presentFamily, 0, &_presentQueue);
 }
 
-VkShaderModule HelloTriangleApplication::createShaderModule(const std::string &shaderFilePath) {
-    auto shader = shaderReader::readFile(shaderFilePath);
-    if (shader.size() == 0) {
+void HelloTriangleApplication::prefetchAssets(const std::vector<std::string> & assetNames)
+{
+    std::vector<std::string> names;
+    std::vector<std::string> paths;
+    for (const std::string & name : assetNames) {
+        if (!_assets.contains(name) && _prefetchedAssets.count(name) == 0) {
+            names.push_back(name);
+            paths.push_back(assetDirectory() + name);
+        }
+    }
+
+    // One batch so the loader can put every read in flight together
+    std::vector<std::future<asyncFileLoader::result>> reads = _fileLoader.read(paths);
+    for (size_t i = 0; i < names.size(); ++i) {
+        _prefetchedAssets[names[i]] = std::move(reads[i]);
+    }
+}
+
+bool HelloTriangleApplication::loadAsset(const std::string & assetName,
+                                         const uint8_t *& data,
+                                         size_t & size,
+                                         std::vector<uint8_t> & storage)
+{
+    // Straight out of the mapped pack when we have one
+    if (_assets.get(assetName, data, size, storage)) {
+        return true;
+    }
+
+    asyncFileLoader::result loaded;
+    auto prefetched = _prefetchedAssets.find(assetName);
+    if (prefetched != _prefetchedAssets.end()) {
+        loaded = prefetched->second.get();
+        _prefetchedAssets.erase(prefetched);
+    } else {
+        loaded = _fileLoader.read(assetDirectory() + assetName).get();
+    }
+
+    if (!loaded.ok()) {
+        return false;
+    }
+    storage = std::move(loaded.bytes);
+    data = storage.data();
+    size = storage.size();
+    return true;
+}
+
+VkShaderModule HelloTriangleApplication::createShaderModule(const std::string &assetName) {
+    const uint8_t* code = nullptr;
+    size_t codeSize = 0;
+    std::vector<uint8_t> storage;
+    if (!loadAsset(assetName, code, codeSize, storage) || codeSize == 0) {
         std::string errMsg("Did not find file : ");
-        errMsg += shaderFilePath;
+        errMsg += assetName;
         throw std::runtime_error(errMsg);
     }
     VkShaderModuleCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = shader.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(shader.data());
+    createInfo.codeSize = codeSize;
+    createInfo.pCode = reinterpret_cast<const uint32_t*>(code);
 
     VkShaderModule shaderModule;
     if (vkCreateShaderModule(_device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
@@ -826,6 +1233,7 @@ void HelloTriangleApplication::endSingleTimeCommands(VkCommandBuffer commandBuff
 
 void HelloTriangleApplication::createImage(uint32_t width,
                                            uint32_t height,
+                                           uint32_t mipLevels,
                                            VkFormat format,
                                            VkImageTiling tiling,
                                            VkImageUsageFlags usage,
@@ -839,7 +1247,7 @@ void HelloTriangleApplication::createImage(uint32_t width,
     imageInfo.extent.width = width;
     imageInfo.extent.height = height;
     imageInfo.extent.depth = 1; // still 1 even though this is 2D
-    imageInfo.mipLevels = 1; // Can use an array of textures for mipmapping
+    imageInfo.mipLevels = mipLevels;
     imageInfo.arrayLayers = 1;
 
     imageInfo.format = format;
@@ -882,7 +1290,8 @@ void HelloTriangleApplication::createImage(uint32_t width,
 void HelloTriangleApplication::transitionImageLayout(VkImage image,
                                                      VkFormat format,
                                                      VkImageLayout oldLayout,
-                                                     VkImageLayout newLayout)
+                                                     VkImageLayout newLayout,
+                                                     uint32_t mipLevels)
 {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
@@ -895,11 +1304,11 @@ void HelloTriangleApplication::transitionImageLayout(VkImage image,
     barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 
-    // Our image does not have mipmaps or layers, so this can be simple
+    // Transition every mip level at once, our images do not have layers
     barrier.image = image;
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.levelCount = mipLevels;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
 
@@ -935,42 +1344,119 @@ void HelloTriangleApplication::transitionImageLayout(VkImage image,
     endSingleTimeCommands(commandBuffer);
 }
 
-void HelloTriangleApplication::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+void HelloTriangleApplication::copyBufferToImage(VkBuffer buffer, VkImage image, const std::vector<VkBufferImageCopy> & regions)
 {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
-    VkBufferImageCopy region = {};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = {
-        width,
-        height,
-        1
-    };
-
-    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    // One region per mip level, all copied with a single command
+    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
 
     endSingleTimeCommands(commandBuffer);
 }
 
+bool HelloTriangleApplication::isFormatSampleable(VkFormat format)
+{
+    // Block compressed formats also need the device feature enabled in createLogicalDevice
+    blockCompression::blockFormat blockFormat;
+    if (ktx2::blockFormatOf(format, blockFormat) && !_textureCompressionBC)
+    {
+        return false;
+    }
+
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(_physicalDevice, format, &formatProperties);
+
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (formatProperties.optimalTilingFeatures & required) == required;
+}
+
 void HelloTriangleApplication::createTextureImage()
 {
-    int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load((std::string(std::getenv("PWD")) + "/../../../../../vulkanTesting/textures/logo.jpg").c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    // RGBA = 4 bytes
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Pack entries are used in place, the storage vectors hold anything read from loose files
+    const uint8_t* bakedData = nullptr;
+    size_t bakedSize = 0;
+    std::vector<uint8_t> bakedStorage;
+
+    // Prefer the block compressed texture written by tools/textureBaker
+    ktx2::texture baked;
+    if (loadAsset("textures/logo.ktx2", bakedData, bakedSize, bakedStorage) && baked.open(bakedData, bakedSize))
+    {
+        std::vector<textureCache::mipLevel> levels;
+        for (const ktx2::level & level : baked.levels())
+        {
+            levels.push_back({level.width, level.height, level.offset, level.size});
+        }
+
+        blockCompression::blockFormat blockFormat;
+        if (isFormatSampleable(baked.format()))
+        {
+            createTextureImage(baked.format(), baked.width(), baked.height(), baked.data(), levels);
+            std::cout << "Loaded baked texture in "
+                      << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+            return;
+        }
+        else if (ktx2::blockFormatOf(baked.format(), blockFormat))
+        {
+            // The device cannot sample this block format, so decode every level on the CPU instead
+            std::vector<uint8_t> texels;
+            std::vector<uint8_t> decoded;
+            for (textureCache::mipLevel & level : levels)
+            {
+                blockCompression::decode(baked.data() + level.offset, level.width, level.height, blockFormat, decoded);
+                level.offset = texels.size();
+                level.size = decoded.size();
+                texels.insert(texels.end(), decoded.begin(), decoded.end());
+                texels.resize((texels.size() + 15) & ~static_cast<size_t>(15)); // keep every level 16 byte aligned
+            }
+
+            VkFormat fallbackFormat = ktx2::isSrgb(baked.format()) ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+            createTextureImage(fallbackFormat, baked.width(), baked.height(), texels.data(), levels);
+            std::cout << "Block compressed textures not supported, decoded baked texture in "
+                      << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+            return;
+        }
+
+        std::cout << "Baked texture format " << baked.format() << " not supported, loading the source image" << std::endl;
+    }
+
+    // Decoded and mipmapped texels are cached on disk so only the first launch pays for the JPEG decode
+    const uint8_t* sourceData = nullptr;
+    size_t sourceSize = 0;
+    std::vector<uint8_t> sourceStorage;
+    if (!loadAsset("textures/logo.jpg", sourceData, sourceSize, sourceStorage))
+    {
+        throw std::runtime_error("failed to open texture textures/logo.jpg!");
+    }
+    textureCache::texture texture = textureCache::load(sourceData, sourceSize, "textures/logo.jpg",
+                                                       assetDirectory() + "textureCache");
+
+    // 8 bits for each channel (make sure to use the same as you've read in)
+    createTextureImage(VK_FORMAT_R8G8B8A8_UNORM, texture.width(), texture.height(), texture.texels(), texture.mips());
+
+    std::cout << "Loaded texture " << (texture.fromCache() ? "from cache" : "from source") << " in "
+              << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+}
 
-    if (!pixels) {
-        throw std::runtime_error("failed to load texture image!");
+void HelloTriangleApplication::createTextureImage(VkFormat format,
+                                                  uint32_t width,
+                                                  uint32_t height,
+                                                  const uint8_t * texels,
+                                                  const std::vector<textureCache::mipLevel> & mips)
+{
+    // Only stage the bytes the levels actually cover
+    VkDeviceSize firstByte = mips[0].offset;
+    VkDeviceSize lastByte = 0;
+    for (const textureCache::mipLevel & mip : mips)
+    {
+        firstByte = std::min<VkDeviceSize>(firstByte, mip.offset);
+        lastByte = std::max<VkDeviceSize>(lastByte, mip.offset + mip.size);
     }
+    VkDeviceSize imageSize = lastByte - firstByte;
+
+    _textureFormat = format;
+    _textureMipLevels = static_cast<uint32_t>(mips.size());
 
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
@@ -979,14 +1465,32 @@ void HelloTriangleApplication::createTextureImage()
     createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
     void* data;
     vkMapMemory(_device, stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
+    memcpy(data, texels + firstByte, static_cast<size_t>(imageSize));
     vkUnmapMemory(_device, stagingBufferMemory);
 
-    // clear out from stbi
-    stbi_image_free(pixels);
+    // One copy region per mip level.  Offsets are already aligned to the texel block size by the cache and the baker.
+    std::vector<VkBufferImageCopy> regions(mips.size());
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        const textureCache::mipLevel & mip = mips[i];
 
-    // 8 bits for each channel (make sure to use the same as you've read in)
-    VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+        regions[i] = {};
+        regions[i].bufferOffset = mip.offset - firstByte;
+        regions[i].bufferRowLength = 0;
+        regions[i].bufferImageHeight = 0;
+
+        regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        regions[i].imageSubresource.mipLevel = static_cast<uint32_t>(i);
+        regions[i].imageSubresource.baseArrayLayer = 0;
+        regions[i].imageSubresource.layerCount = 1;
+
+        regions[i].imageOffset = {0, 0, 0};
+        regions[i].imageExtent = {
+            mip.width,
+            mip.height,
+            1
+        };
+    }
 
     // Let vulkan take care of how the image is stored.  If you want direct access to the texels in memory, must use VK_IMAGE_TILING_LINEAR or it will be nonsense.
     VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -997,16 +1501,16 @@ void HelloTriangleApplication::createTextureImage()
     // For use on the device
     VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
-    createImage(texWidth, texHeight, format, tiling, usage, properties, _textureImage, _textureImageMemory);
+    createImage(width, height, _textureMipLevels, format, tiling, usage, properties, _textureImage, _textureImageMemory);
 
     // Transfer the image from its current layout into a layout that is optimal for transfer
-    transitionImageLayout(_textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    transitionImageLayout(_textureImage, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, _textureMipLevels);
 
     // Copy the bytes over
-    copyBufferToImage(stagingBuffer, _textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+    copyBufferToImage(stagingBuffer, _textureImage, regions);
 
     // Transition the image into a format that is useful for sampling in the shader
-    transitionImageLayout(_textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    transitionImageLayout(_textureImage, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, _textureMipLevels);
 
     vkDestroyBuffer(_device, stagingBuffer, nullptr);
     vkFreeMemory(_device, stagingBufferMemory, nullptr);
@@ -1014,7 +1518,7 @@ void HelloTriangleApplication::createTextureImage()
 
 void HelloTriangleApplication::createTextureImageView()
 {
-    _textureImageView = createImageView(_textureImage, VK_FORMAT_R8G8B8A8_UNORM);
+    _textureImageView = createImageView(_textureImage, _textureFormat, _textureMipLevels);
 }
 
 void HelloTriangleApplication::createTextureSampler()
@@ -1049,7 +1553,7 @@ void HelloTriangleApplication::createTextureSampler()
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
+    samplerInfo.maxLod = static_cast<float>(_textureMipLevels);
 
     if (vkCreateSampler(_device, &samplerInfo, nullptr, &_textureSampler) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture sampler!");
@@ -1103,78 +1607,742 @@ void HelloTriangleApplication::copyBuffer(VkBuffer srcBuffer,
     endSingleTimeCommands(commandBuffer);
 }
 
-void HelloTriangleApplication::createVertexBuffer()
+void HelloTriangleApplication::createDeviceLocalBuffer(const void * data,
+                                                       VkDeviceSize size,
+                                                       VkBufferUsageFlags usage,
+                                                       VkBuffer& buffer,
+                                                       VkDeviceMemory& bufferMemory)
 {
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-
     // Setup a staging buffer visible to local CPU
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
 
     // Copy data into staging buffer
-    void* data;
-    vkMapMemory(_device, stagingBufferMemory, 0, bufferSize, 0, &data);
+    void* mapped;
+    vkMapMemory(_device, stagingBufferMemory, 0, size, 0, &mapped);
     // We can copy without doing synchronization because we specified the VK_MEMORY_PROPERTY_HOST_COHERENT_BIT flag above
-    memcpy(data, vertices.data(), (size_t) bufferSize);
+    memcpy(mapped, data, (size_t) size);
     vkUnmapMemory(_device, stagingBufferMemory);
 
     // Make a destination buffer that is local to the device and can serve as
     // the destination for transfers
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _vertexBuffer, _vertexBufferMemory);
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
 
-    copyBuffer(stagingBuffer, _vertexBuffer, bufferSize);
+    copyBuffer(stagingBuffer, buffer, size);
 
     vkDestroyBuffer(_device, stagingBuffer, nullptr);
     vkFreeMemory(_device, stagingBufferMemory, nullptr);
 }
 
-// Identical to above function except for noted differences (good candidate for abstraction)
-void HelloTriangleApplication::createIndexBuffer()
+void HelloTriangleApplication::loadMesh()
 {
-    // difference: size is calcualted off of indices
-    VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+    auto start = std::chrono::high_resolution_clock::now();
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-    void* data;
-    vkMapMemory(_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    // difference: transfer index data
-    memcpy(data, indices.data(), (size_t) bufferSize);
-    vkUnmapMemory(_device, stagingBufferMemory);
-
-    // difference: usage is index buffer
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _indexBuffer, _indexBufferMemory);
+    for (const std::string & name : modelAssets)
+    {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        std::vector<uint8_t> storage;
+        if (!loadAsset(name, data, size, storage))
+        {
+            continue;
+        }
 
-    copyBuffer(stagingBuffer, _indexBuffer, bufferSize);
+        // External glTF buffers sit next to the model
+        std::string directory = name.substr(0, name.find_last_of('/') + 1);
+        meshLoader::bufferLoader loadBuffer = [this, &directory](const std::string & uri, std::vector<uint8_t> & bytes) {
+            const uint8_t* bufferData = nullptr;
+            size_t bufferSize = 0;
+            std::vector<uint8_t> bufferStorage;
+            if (!loadAsset(directory + uri, bufferData, bufferSize, bufferStorage))
+            {
+                return false;
+            }
+            bytes.assign(bufferData, bufferData + bufferSize);
+            return true;
+        };
 
-    vkDestroyBuffer(_device, stagingBuffer, nullptr);
-    vkFreeMemory(_device, stagingBufferMemory, nullptr);
-}
+        _mesh = meshLoader::load(data, size, name, loadBuffer);
 
-void HelloTriangleApplication::createUniformBuffers()
-{
-    VkDeviceSize bufferSize = sizeof(MVPUniformBufferObject);
+        // Exporters rarely write triangles in a cache friendly order
+        meshOptimizer::report report = meshOptimizer::optimize(_mesh);
+        std::cout << "Optimized " << name << ": ACMR " << report.cacheBefore.acmr << " -> " << report.cacheAfter.acmr
+                  << ", ATVR " << report.cacheBefore.atvr << " -> " << report.cacheAfter.atvr << std::endl;
 
-    _uniformBuffers.resize(_swapChainImages.size());
-    _uniformBuffersMemory.resize(_swapChainImages.size());
+        std::cout << "Loaded " << name << " (" << _mesh.vertices.size() << " vertices, " << _mesh.indices.size() / 3 << " triangles) in "
+                  << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+        break;
+    }
 
-    for (size_t i = 0; i < _swapChainImages.size(); i++) {
-        createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, _uniformBuffers[i], _uniformBuffersMemory[i]);
+    if (_mesh.vertices.empty())
+    {
+        _mesh.vertices = vertices;
+        _mesh.indices = indices;
     }
-}
 
-void HelloTriangleApplication::updateUniformBuffer(uint32_t currentImage)
-{
-    static auto startTime = std::chrono::high_resolution_clock::now();
+    _indexType = meshLoader::indexType(_mesh.vertices.size());
 
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+    // Coarser levels share the vertex buffer and follow the full mesh in the index buffer
+    _lodChain = meshSimplifier::buildLodChain(_mesh);
+    std::cout << "Built " << _lodChain.levels.size() << " LOD levels, coarsest has "
+              << _lodChain.levels.back().indexCount / 3 << " triangles" << std::endl;
 
-    MVPUniformBufferObject ubo = {};
-    ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    // Bounding sphere for the distance used in LOD selection
+    glm::vec3 low = _mesh.vertices[0].pos;
+    glm::vec3 high = low;
+    for (const Vertex & vertex : _mesh.vertices)
+    {
+        low = glm::min(low, glm::vec3(vertex.pos));
+        high = glm::max(high, glm::vec3(vertex.pos));
+    }
+    _meshCenter = (low + high) * 0.5f;
+    _meshRadius = glm::length(high - low) * 0.5f;
+
+    // Dense meshes are split into meshlets, per LOD level, and culled per cluster on the GPU
+    if (_mesh.indices.size() / 3 >= clusterCullingMinTriangles)
+    {
+        for (const meshSimplifier::lod & level : _lodChain.levels)
+        {
+            std::vector<uint32_t> levelIndices(_lodChain.indices.begin() + level.firstIndex,
+                                               _lodChain.indices.begin() + level.firstIndex + level.indexCount);
+            meshlet::clusterSet levelClusters = meshlet::build(levelIndices, _mesh.vertices);
+
+            uint32_t indexOffset = static_cast<uint32_t>(_clusters.indices.size());
+            _lodClusterRanges.push_back(std::make_pair(static_cast<uint32_t>(_clusters.clusters.size()),
+                                                       static_cast<uint32_t>(levelClusters.clusters.size())));
+            for (meshlet::cluster & cluster : levelClusters.clusters)
+            {
+                cluster.indexOffset += indexOffset;
+                _clusters.clusters.push_back(cluster);
+            }
+            _clusters.indices.insert(_clusters.indices.end(), levelClusters.indices.begin(), levelClusters.indices.end());
+        }
+        _clusterCulling = true;
+        // The pre-pass depth is what clusters are tested against
+        _occlusionCulling = depthPrePass;
+        std::cout << "Built " << _lodClusterRanges[0].second << " meshlets for cluster culling" << std::endl;
+    }
+
+    // Quantize the vertex buffer when the device can fetch every compact format
+    _vertexLayout = vertexFormat::compact(_mesh.vertices);
+    for (const vertexFormat::attribute & attribute : _vertexLayout.attributes())
+    {
+        if (!isVertexFormatSupported(vertexFormat::vulkanFormat(attribute.format)))
+        {
+            _vertexLayout = vertexFormat::full();
+            break;
+        }
+    }
+    _positionLayout = vertexFormat::positionOnly(_vertexLayout);
+    std::cout << "Vertex stride " << _vertexLayout.stride() << " bytes (" << sizeof(Vertex) << " unquantized)" << std::endl;
+}
+
+bool HelloTriangleApplication::isVertexFormatSupported(VkFormat format)
+{
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(_physicalDevice, format, &formatProperties);
+    return (formatProperties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) != 0;
+}
+
+void HelloTriangleApplication::createVertexBuffer()
+{
+    std::vector<uint8_t> encodedVertices = vertexFormat::encode(_mesh.vertices, _vertexLayout);
+    createDeviceLocalBuffer(encodedVertices.data(), encodedVertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, _vertexBuffer, _vertexBufferMemory);
+}
+
+void HelloTriangleApplication::createPositionBuffer()
+{
+    std::vector<uint8_t> encodedPositions = vertexFormat::encode(_mesh.vertices, _positionLayout);
+    createDeviceLocalBuffer(encodedPositions.data(), encodedPositions.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, _positionBuffer, _positionBufferMemory);
+}
+
+void HelloTriangleApplication::createIndexBuffer()
+{
+    // Narrowed to 16 bits when the mesh allows
+    std::vector<uint8_t> packedIndices = meshLoader::packIndices(_lodChain.indices, _indexType);
+    createDeviceLocalBuffer(packedIndices.data(), packedIndices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, _indexBuffer, _indexBufferMemory);
+}
+
+void HelloTriangleApplication::createClusterBuffers()
+{
+    std::vector<meshlet::gpuCluster> packedClusters = meshlet::pack(_clusters);
+    createDeviceLocalBuffer(packedClusters.data(), packedClusters.size() * sizeof(meshlet::gpuCluster), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, _clusterBuffer, _clusterBufferMemory);
+
+    createDeviceLocalBuffer(_clusters.indices.data(), _clusters.indices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, _clusterIndexBuffer, _clusterIndexBufferMemory);
+
+    // Shared by every frame, each reads what the one before it wrote.  Starts with
+    // nothing visible, so the first frame's phase 2 draws everything in the frustum.
+    if (_occlusionCulling)
+    {
+        std::vector<uint32_t> visibility(_clusters.clusters.size(), 0);
+        createDeviceLocalBuffer(visibility.data(), visibility.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, _clusterVisibilityBuffer, _clusterVisibilityBufferMemory);
+    }
+}
+
+void HelloTriangleApplication::createCullingBuffers()
+{
+    // One set per image so a frame never overwrites what an earlier frame still draws from
+    size_t imageCount = _swapChainImages.size();
+    _culledIndexBuffers.resize(imageCount);
+    _culledIndexBuffersMemory.resize(imageCount);
+    _cullingUniformBuffers.resize(imageCount);
+    _cullingUniformBuffersMemory.resize(imageCount);
+
+    for (size_t i = 0; i < imageCount; i++) {
+        // Worst case every cluster of the full detail level is visible
+        VkDeviceSize indexBytes = _lodChain.levels[0].indexCount * sizeof(uint32_t);
+        createBuffer(indexBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _culledIndexBuffers[i], _culledIndexBuffersMemory[i]);
+        createBuffer(sizeof(CullingUniformBufferObject), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, _cullingUniformBuffers[i], _cullingUniformBuffersMemory[i]);
+    }
+}
+
+void HelloTriangleApplication::createDrawIndirectBuffers()
+{
+    _drawIndirectBuffers.resize(_swapChainImages.size());
+    _drawIndirectBuffersMemory.resize(_swapChainImages.size());
+
+    for (size_t i = 0; i < _swapChainImages.size(); i++) {
+        if (_clusterCulling)
+        {
+            // The second command draws what occlusion culling found after the first, see cull.comp
+            createBuffer(2 * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _drawIndirectBuffers[i], _drawIndirectBuffersMemory[i]);
+        }
+        else
+        {
+            createBuffer(sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, _drawIndirectBuffers[i], _drawIndirectBuffersMemory[i]);
+        }
+    }
+}
+
+void HelloTriangleApplication::createCullingPipeline()
+{
+    // 0 culling uniform, 1 clusters, 2 cluster indices, 3 culled indices, 4 draw commands,
+    // then for occlusion culling 5 cluster visibility and 6 the Hi-Z pyramid
+    std::vector<VkDescriptorSetLayoutBinding> bindings(_occlusionCulling ? 7 : 5);
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = (i == 0) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        if (i == 6)
+        {
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        }
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_cullingDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create culling descriptor set layout!");
+    }
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &_cullingDescriptorSetLayout;
+
+    // the culling phase
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(uint32_t);
+    if (_occlusionCulling)
+    {
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    }
+
+    if (vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &_cullingPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create culling pipeline layout!");
+    }
+
+    VkShaderModule cullingShaderModule = createShaderModule(_occlusionCulling ? "shaders/cullOcclusion.spv" : "shaders/cull.spv");
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = cullingShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = _cullingPipelineLayout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    if (vkCreateComputePipelines(_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_cullingPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create culling pipeline!");
+    }
+
+    vkDestroyShaderModule(_device, cullingShaderModule, nullptr);
+}
+
+void HelloTriangleApplication::createCullingDescriptorSets()
+{
+    uint32_t imageCount = static_cast<uint32_t>(_swapChainImages.size());
+
+    std::array<VkDescriptorPoolSize, 3> poolSizes;
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount = imageCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = 5 * imageCount;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[2].descriptorCount = imageCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = imageCount;
+
+    if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_cullingDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create culling descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(imageCount, _cullingDescriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _cullingDescriptorPool;
+    allocInfo.descriptorSetCount = imageCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    _cullingDescriptorSets.resize(imageCount);
+    if (vkAllocateDescriptorSets(_device, &allocInfo, _cullingDescriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate culling descriptor sets!");
+    }
+
+    for (size_t i = 0; i < imageCount; i++)
+    {
+        std::array<VkDescriptorBufferInfo, 6> bufferInfos = {};
+        bufferInfos[0] = {_cullingUniformBuffers[i], 0, sizeof(CullingUniformBufferObject)};
+        bufferInfos[1] = {_clusterBuffer, 0, VK_WHOLE_SIZE};
+        bufferInfos[2] = {_clusterIndexBuffer, 0, VK_WHOLE_SIZE};
+        bufferInfos[3] = {_culledIndexBuffers[i], 0, VK_WHOLE_SIZE};
+        bufferInfos[4] = {_drawIndirectBuffers[i], 0, VK_WHOLE_SIZE};
+
+        // Every level, sampled with texelFetch
+        VkDescriptorImageInfo pyramidInfo = {};
+
+        std::vector<VkWriteDescriptorSet> descriptorWrites(_occlusionCulling ? 7 : 5);
+        for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+            descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet = _cullingDescriptorSets[i];
+            descriptorWrites[binding].dstBinding = binding;
+            descriptorWrites[binding].dstArrayElement = 0;
+            descriptorWrites[binding].descriptorType = (binding == 0) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[binding].descriptorCount = 1;
+            descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+        }
+
+        if (_occlusionCulling)
+        {
+            bufferInfos[5] = {_clusterVisibilityBuffer, 0, VK_WHOLE_SIZE};
+
+            pyramidInfo.sampler = _hiZSampler;
+            pyramidInfo.imageView = _frameGraph.getImageView(_frameHiZ);
+            pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            descriptorWrites[6].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            descriptorWrites[6].pBufferInfo = nullptr;
+            descriptorWrites[6].pImageInfo = &pyramidInfo;
+        }
+
+        vkUpdateDescriptorSets(_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+void HelloTriangleApplication::recordClusterCulling(VkCommandBuffer commandBuffer, size_t imageIndex, uint32_t phase)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cullingPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cullingPipelineLayout, 0 /* first set */, 1 /* descriptor set count */, &_cullingDescriptorSets[imageIndex], 0 /* dynamic offset count */, nullptr /* dynamic offsets */);
+    if (_occlusionCulling)
+    {
+        vkCmdPushConstants(commandBuffer, _cullingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(phase), &phase);
+    }
+
+    // One workgroup per cluster of the largest level, folded into rows to stay under
+    // the 65535 group limit.  Groups past the current level's clusters exit at once.
+    uint32_t clusterCount = _lodClusterRanges[0].second;
+    uint32_t groupsX = std::min<uint32_t>(clusterCount, 65535);
+    uint32_t groupsY = (clusterCount + groupsX - 1) / groupsX;
+    vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+}
+
+void HelloTriangleApplication::createHiZPipeline()
+{
+    // texelFetch only, the sampler just has to allow every level
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.minLod = 0.0f;
+    // the level count changes with the window size
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    if (vkCreateSampler(_device, &samplerInfo, nullptr, &_hiZSampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z sampler!");
+    }
+
+    // 0 the depth buffer or the level above, 1 the level written
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = (i == 0) ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_hiZDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z descriptor set layout!");
+    }
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(HiZPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &_hiZDescriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &_hiZPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z pipeline layout!");
+    }
+
+    VkShaderModule hiZShaderModule = createShaderModule("shaders/hiz.spv");
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = hiZShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = _hiZPipelineLayout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    if (vkCreateComputePipelines(_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_hiZPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z pipeline!");
+    }
+
+    vkDestroyShaderModule(_device, hiZShaderModule, nullptr);
+}
+
+void HelloTriangleApplication::createHiZDescriptorSets()
+{
+    // The graph's depth view may include stencil, which cannot be sampled with depth
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = _frameGraph.getImage(_frameDepth);
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = _depthFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(_device, &viewInfo, nullptr, &_depthSampleView) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth sample view!");
+    }
+
+    // Each level is written through its own view and read through it by the next
+    _hiZLevelViews.resize(_hiZLevels);
+    viewInfo.image = _frameGraph.getImage(_frameHiZ);
+    viewInfo.format = VK_FORMAT_R32_SFLOAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    for (uint32_t level = 0; level < _hiZLevels; level++) {
+        viewInfo.subresourceRange.baseMipLevel = level;
+        if (vkCreateImageView(_device, &viewInfo, nullptr, &_hiZLevelViews[level]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create Hi-Z level view!");
+        }
+    }
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes;
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = _hiZLevels;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = _hiZLevels;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = _hiZLevels;
+
+    if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_hiZDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(_hiZLevels, _hiZDescriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _hiZDescriptorPool;
+    allocInfo.descriptorSetCount = _hiZLevels;
+    allocInfo.pSetLayouts = layouts.data();
+
+    _hiZDescriptorSets.resize(_hiZLevels);
+    if (vkAllocateDescriptorSets(_device, &allocInfo, _hiZDescriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate Hi-Z descriptor sets!");
+    }
+
+    // The whole pyramid stays in GENERAL while it is built, the depth buffer is read only
+    for (uint32_t level = 0; level < _hiZLevels; level++)
+    {
+        std::array<VkDescriptorImageInfo, 2> imageInfos = {};
+        imageInfos[0].sampler = _hiZSampler;
+        imageInfos[0].imageView = (level == 0) ? _depthSampleView : _hiZLevelViews[level - 1];
+        imageInfos[0].imageLayout = (level == 0) ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+        imageInfos[1].imageView = _hiZLevelViews[level];
+        imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
+        for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+            descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet = _hiZDescriptorSets[level];
+            descriptorWrites[binding].dstBinding = binding;
+            descriptorWrites[binding].dstArrayElement = 0;
+            descriptorWrites[binding].descriptorType = (binding == 0) ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            descriptorWrites[binding].descriptorCount = 1;
+            descriptorWrites[binding].pImageInfo = &imageInfos[binding];
+        }
+
+        vkUpdateDescriptorSets(_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+void HelloTriangleApplication::recordHiZ(VkCommandBuffer commandBuffer)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _hiZPipeline);
+
+    HiZPushConstants sizes = {};
+    // the depth rendered at the recorded scale, stretched over the whole pyramid
+    sizes.sourceSize[0] = static_cast<int32_t>(_renderExtent.width);
+    sizes.sourceSize[1] = static_cast<int32_t>(_renderExtent.height);
+    for (uint32_t level = 0; level < _hiZLevels; level++)
+    {
+        sizes.destinationSize[0] = static_cast<int32_t>(std::max(_hiZExtent.width >> level, 1u));
+        sizes.destinationSize[1] = static_cast<int32_t>(std::max(_hiZExtent.height >> level, 1u));
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _hiZPipelineLayout, 0 /* first set */, 1 /* descriptor set count */, &_hiZDescriptorSets[level], 0 /* dynamic offset count */, nullptr /* dynamic offsets */);
+        vkCmdPushConstants(commandBuffer, _hiZPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sizes), &sizes);
+        vkCmdDispatch(commandBuffer,
+                      (sizes.destinationSize[0] + hiZGroupSize - 1) / hiZGroupSize,
+                      (sizes.destinationSize[1] + hiZGroupSize - 1) / hiZGroupSize,
+                      1);
+
+        // Within the pass, so the graph cannot order it: the next level reads this one
+        if (level + 1 < _hiZLevels)
+        {
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = _frameGraph.getImage(_frameHiZ);
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = level;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = 1;
+
+            vkCmdPipelineBarrier(commandBuffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+
+        sizes.sourceSize[0] = sizes.destinationSize[0];
+        sizes.sourceSize[1] = sizes.destinationSize[1];
+    }
+}
+
+void HelloTriangleApplication::createFrameGraph()
+{
+    _frameGraph.clear();
+
+    // The swap chain image is acquired at the color output stage, see drawFrame
+    renderGraph::imageDescription targetDescription;
+    targetDescription.format = _swapChainImageFormat;
+    targetDescription.extent = _swapChainExtent;
+    _frameTarget = _frameGraph.importImage("swap chain image", targetDescription,
+                                           VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                           VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    _frameDrawCommand = _frameGraph.importBuffer("draw command");
+
+    renderGraph::imageDescription depthDescription;
+    depthDescription.format = _depthFormat;
+    depthDescription.extent = _swapChainExtent;
+    depthDescription.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (_depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || _depthFormat == VK_FORMAT_D24_UNORM_S8_UINT)
+    {
+        depthDescription.aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    _frameDepth = _frameGraph.createImage("depth", depthDescription);
+
+    // Full size, the scene covers as much of it as the resolution scale allows
+    renderGraph::imageDescription sceneDescription = targetDescription;
+    _frameSceneColor = _frameGraph.createImage("scene color", sceneDescription);
+
+    if (_clusterCulling)
+    {
+        _frameCulledIndices = _frameGraph.importBuffer("culled indices");
+
+        // Start from empty draws, the shader adds the visible clusters' indices
+        renderGraph::pass reset = _frameGraph.addPass("reset draw", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            std::array<VkDrawIndexedIndirectCommand, 2> emptyDraws = {};
+            emptyDraws[0].instanceCount = 1;
+            emptyDraws[1].instanceCount = 1;
+            vkCmdUpdateBuffer(commandBuffer, _drawIndirectBuffers[imageIndex], 0, sizeof(emptyDraws), emptyDraws.data());
+        });
+        _frameGraph.write(reset, _frameDrawCommand, renderGraph::transfer);
+
+        // With occlusion culling this is phase 1, the clusters visible last frame
+        renderGraph::pass cull = _frameGraph.addPass("cluster culling", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            recordClusterCulling(commandBuffer, imageIndex, _occlusionCulling ? 1 : 0);
+        });
+        _frameGraph.write(cull, _frameDrawCommand, renderGraph::storage);
+        _frameGraph.write(cull, _frameCulledIndices, renderGraph::storage);
+        if (_occlusionCulling)
+        {
+            // the previous frame's phase 2 wrote it
+            _frameVisibility = _frameGraph.importBuffer("cluster visibility", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+            _frameGraph.read(cull, _frameVisibility, renderGraph::storage);
+        }
+    }
+
+    // The pre-pass draws the same triangles as the main pass
+    if (depthPrePass)
+    {
+        renderGraph::pass prePass = _frameGraph.addPass("depth pre-pass", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            recordDepthPrePass(commandBuffer, imageIndex, 0);
+        });
+        _frameGraph.write(prePass, _frameDepth, renderGraph::depthAttachment);
+        _frameGraph.read(prePass, _frameDrawCommand, renderGraph::indirectBuffer);
+        if (_clusterCulling)
+        {
+            _frameGraph.read(prePass, _frameCulledIndices, renderGraph::indexBuffer);
+        }
+    }
+
+    // Phase 2 tests every cluster against the depth of phase 1 and the pre-pass adds
+    // the ones that were missing, see cull.comp
+    if (_occlusionCulling)
+    {
+        _hiZExtent = {1, 1};
+        while (_hiZExtent.width * 2 <= _swapChainExtent.width) {
+            _hiZExtent.width *= 2;
+        }
+        while (_hiZExtent.height * 2 <= _swapChainExtent.height) {
+            _hiZExtent.height *= 2;
+        }
+        _hiZLevels = 1;
+        while ((std::max(_hiZExtent.width, _hiZExtent.height) >> _hiZLevels) > 0) {
+            _hiZLevels++;
+        }
+
+        renderGraph::imageDescription hiZDescription;
+        hiZDescription.format = VK_FORMAT_R32_SFLOAT;
+        hiZDescription.extent = _hiZExtent;
+        hiZDescription.mipLevels = _hiZLevels;
+        _frameHiZ = _frameGraph.createImage("hi-z pyramid", hiZDescription);
+
+        renderGraph::pass hiZ = _frameGraph.addPass("hi-z pyramid", [this](VkCommandBuffer commandBuffer, uint32_t) {
+            recordHiZ(commandBuffer);
+        });
+        _frameGraph.read(hiZ, _frameDepth, renderGraph::computeSampled);
+        _frameGraph.write(hiZ, _frameHiZ, renderGraph::storage);
+
+        renderGraph::pass occlusion = _frameGraph.addPass("occlusion culling", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            recordClusterCulling(commandBuffer, imageIndex, 2);
+        });
+        _frameGraph.read(occlusion, _frameHiZ, renderGraph::computeSampled);
+        _frameGraph.write(occlusion, _frameVisibility, renderGraph::storage);
+        _frameGraph.write(occlusion, _frameDrawCommand, renderGraph::storage);
+        _frameGraph.write(occlusion, _frameCulledIndices, renderGraph::storage);
+
+        renderGraph::pass disoccluded = _frameGraph.addPass("depth pre-pass, disoccluded", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            recordDepthPrePass(commandBuffer, imageIndex, 1);
+        });
+        _frameGraph.write(disoccluded, _frameDepth, renderGraph::depthAttachment);
+        _frameGraph.read(disoccluded, _frameDrawCommand, renderGraph::indirectBuffer);
+        _frameGraph.read(disoccluded, _frameCulledIndices, renderGraph::indexBuffer);
+    }
+
+    renderGraph::pass main = _frameGraph.addPass("main", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        recordMainPass(commandBuffer, imageIndex);
+    });
+    _frameGraph.write(main, _frameSceneColor, renderGraph::colorAttachment);
+    if (depthPrePass)
+    {
+        _frameGraph.read(main, _frameDepth, renderGraph::depthAttachment);
+    }
+    else
+    {
+        _frameGraph.write(main, _frameDepth, renderGraph::depthAttachment);
+    }
+    _frameGraph.read(main, _frameDrawCommand, renderGraph::indirectBuffer);
+    if (_clusterCulling)
+    {
+        _frameGraph.read(main, _frameCulledIndices, renderGraph::indexBuffer);
+    }
+
+    renderGraph::pass upscale = _frameGraph.addPass("upscale", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        recordUpscale(commandBuffer, imageIndex);
+    });
+    _frameGraph.read(upscale, _frameSceneColor, renderGraph::fragmentSampled);
+    _frameGraph.write(upscale, _frameTarget, renderGraph::colorAttachment);
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(_physicalDevice, &memoryProperties);
+    _frameGraph.allocate(_device, memoryProperties);
+    std::cout << _frameGraph.describe();
+}
+
+void HelloTriangleApplication::createUniformBuffers()
+{
+    VkDeviceSize bufferSize = sizeof(MVPUniformBufferObject);
+
+    _uniformBuffers.resize(_swapChainImages.size());
+    _uniformBuffersMemory.resize(_swapChainImages.size());
+
+    for (size_t i = 0; i < _swapChainImages.size(); i++) {
+        createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, _uniformBuffers[i], _uniformBuffersMemory[i]);
+    }
+}
+
+void HelloTriangleApplication::updateUniformBuffer(uint32_t currentImage)
+{
+    static auto startTime = std::chrono::high_resolution_clock::now();
+
+    auto currentTime = std::chrono::high_resolution_clock::now();
+    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+
+    MVPUniformBufferObject ubo = {};
+    ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
     ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
@@ -1187,6 +2355,52 @@ void HelloTriangleApplication::updateUniformBuffer(uint32_t currentImage)
     vkMapMemory(_device, _uniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
     memcpy(data, &ubo, sizeof(ubo));
     vkUnmapMemory(_device, _uniformBuffersMemory[currentImage]);
+
+    // Distance to the nearest point of the bounding sphere and the projected size of a
+    // model unit there; proj[1][1] is the cotangent of half the vertical field of view
+    glm::vec4 meshCenter = ubo.model * glm::vec4(glm::vec3(_meshCenter), 1.0f);
+    glm::vec4 cameraPosition = glm::inverse(ubo.view) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    float distance = std::max(glm::length(glm::vec3(meshCenter) - glm::vec3(cameraPosition)) - _meshRadius, 0.1f);
+    float pixelsPerUnit = 0.5f * renderExtent(_resolutionStep).height * std::abs(ubo.proj[1][1]) / distance;
+    _currentLod = meshSimplifier::selectLod(_lodChain, pixelsPerUnit, lodPixelThreshold, _currentLod);
+
+    if (_clusterCulling)
+    {
+        // Clusters are culled in model space, which saves transforming every bound
+        CullingUniformBufferObject culling = {};
+        float planes[6][4];
+        meshlet::frustumPlanes(ubo.proj * ubo.view * ubo.model, planes);
+        for (int i = 0; i < 6; i++) {
+            culling.planes[i] = glm::vec4(planes[i][0], planes[i][1], planes[i][2], planes[i][3]);
+        }
+        culling.cameraPosition = glm::inverse(ubo.view * ubo.model) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        culling.clusterOffset = _lodClusterRanges[_currentLod].first;
+        culling.clusterCount = _lodClusterRanges[_currentLod].second;
+        if (_occlusionCulling)
+        {
+            // Cluster spheres are projected in view space; radii scale by the largest axis
+            culling.modelView = ubo.view * ubo.model;
+            culling.projection = glm::vec4(ubo.proj[0][0], ubo.proj[1][1], ubo.proj[2][2], ubo.proj[3][2]);
+            float scale = std::max(glm::length(glm::vec3(culling.modelView[0])),
+                                   std::max(glm::length(glm::vec3(culling.modelView[1])), glm::length(glm::vec3(culling.modelView[2]))));
+            culling.occlusion = glm::vec4(_hiZExtent.width, _hiZExtent.height, _hiZLevels, scale);
+        }
+
+        vkMapMemory(_device, _cullingUniformBuffersMemory[currentImage], 0, sizeof(culling), 0, &data);
+        memcpy(data, &culling, sizeof(culling));
+        vkUnmapMemory(_device, _cullingUniformBuffersMemory[currentImage]);
+    }
+    else
+    {
+        VkDrawIndexedIndirectCommand draw = {};
+        draw.indexCount = _lodChain.levels[_currentLod].indexCount;
+        draw.instanceCount = 1;
+        draw.firstIndex = _lodChain.levels[_currentLod].firstIndex;
+
+        vkMapMemory(_device, _drawIndirectBuffersMemory[currentImage], 0, sizeof(draw), 0, &data);
+        memcpy(data, &draw, sizeof(draw));
+        vkUnmapMemory(_device, _drawIndirectBuffersMemory[currentImage]);
+    }
 }
 
 uint32_t HelloTriangleApplication::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
@@ -1237,8 +2451,11 @@ void HelloTriangleApplication::createCommandBuffers()
 {
     // Because one of the drawing commands involves binding the right VkFramebuffer,
     // we'll actually have to record a command buffer for every image in the swap chain
-    // once again.
-    _commandBuffers.resize(_swapChainBuffers.size());
+    // once again.  With dynamic resolution every step gets its own set, so changing
+    // the scale is just submitting a different buffer.
+    size_t stepCount = _dynamicResolution ? resolutionSteps : 1;
+    size_t imageCount = _swapChainBuffers.size();
+    _commandBuffers.resize(stepCount * imageCount);
 
     VkCommandBufferAllocateInfo allocInfo = {};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -1257,6 +2474,10 @@ void HelloTriangleApplication::createCommandBuffers()
     // begin command buffer recording
     for (size_t i = 0; i < _commandBuffers.size(); ++i)
     {
+        uint32_t step = static_cast<uint32_t>(i / imageCount);
+        size_t image = i % imageCount;
+        _renderExtent = renderExtent(step);
+
         VkCommandBufferBeginInfo beginInfo = {};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
@@ -1266,38 +2487,32 @@ void HelloTriangleApplication::createCommandBuffers()
             throw std::runtime_error("failed to begin recording command buffer!");
         }
 
-        // Start the render pass
-        VkRenderPassBeginInfo renderPassInfo = {};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = _renderPass;
-        renderPassInfo.framebuffer = _swapChainBuffers[i];
-
-        renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = _swapChainExtent;
-
-        VkClearValue clearColor = {0.f, 0.f, 0.f, 1.f};
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
-
-        vkCmdBeginRenderPass(_commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        // basic drawing commands
-        vkCmdBindPipeline(_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _graphicsPipeline);
-
-        VkBuffer vertexBuffers[] = {_vertexBuffer};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(_commandBuffers[i], 0 /* offset */, 1 /* number of bindings */, vertexBuffers, offsets);
-
-        vkCmdBindIndexBuffer(_commandBuffers[i], _indexBuffer, 0 /* offset */, VK_INDEX_TYPE_UINT16 /* or VK_INDEX_TYPE_UINT32 */);
-
-        vkCmdBindDescriptorSets(_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0 /* first set */, 1 /* descriptor set count */, &_descriptorSets[i], 0 /* dynamic offset count */, nullptr /* dynamic offsets */);
+        // Both timestamps of an image are reset here, so readFrameTime never sees
+        // a stale pair from the last time the image was drawn
+        if (_dynamicResolution)
+        {
+            uint32_t firstQuery = 2 * static_cast<uint32_t>(image);
+            vkCmdResetQueryPool(_commandBuffers[i], _timestampQueryPool, firstQuery, 2);
+            vkCmdWriteTimestamp(_commandBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _timestampQueryPool, firstQuery);
+        }
 
-        // old draw command
-        // vkCmdDraw(_commandBuffers[i], static_cast<uint32_t>(vertices.size()), 1 /* instance count*/, 0 /* first vertex */, 0 /* first instance*/);
-        // indexed draw command
-        vkCmdDrawIndexed(_commandBuffers[i], static_cast<uint32_t>(indices.size()), 1 /* instance count */, 0 /* first index */, 0 /* vertex offset */, 0 /* first instance */);
+        // Culling, the render pass and the barriers between them
+        _frameGraph.bindImage(_frameTarget, _swapChainImages[image]);
+        _frameGraph.bindBuffer(_frameDrawCommand, _drawIndirectBuffers[image]);
+        if (_clusterCulling)
+        {
+            _frameGraph.bindBuffer(_frameCulledIndices, _culledIndexBuffers[image]);
+        }
+        if (_occlusionCulling)
+        {
+            _frameGraph.bindBuffer(_frameVisibility, _clusterVisibilityBuffer);
+        }
+        _frameGraph.execute(_commandBuffers[i], static_cast<uint32_t>(image));
 
-        vkCmdEndRenderPass(_commandBuffers[i]);
+        if (_dynamicResolution)
+        {
+            vkCmdWriteTimestamp(_commandBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _timestampQueryPool, 2 * static_cast<uint32_t>(image) + 1);
+        }
 
         if (vkEndCommandBuffer(_commandBuffers[i]) != VK_SUCCESS)
         {
@@ -1310,20 +2525,263 @@ void HelloTriangleApplication::createCommandBuffers()
     }
 }
 
+void HelloTriangleApplication::recordDepthPrePass(VkCommandBuffer commandBuffer, size_t imageIndex, uint32_t drawCommand)
+{
+    VkRenderPassBeginInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = (drawCommand == 0) ? _depthRenderPass : _depthLoadRenderPass;
+    renderPassInfo.framebuffer = _depthFrameBuffer;
+
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = _renderExtent;
+
+    VkClearValue clearDepth = {};
+    clearDepth.depthStencil = {1.0f, 0};
+    renderPassInfo.clearValueCount = 1;
+    renderPassInfo.pClearValues = &clearDepth;
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _depthPipeline);
+    setViewport(commandBuffer, _renderExtent);
+
+    VkBuffer vertexBuffers[] = {_positionBuffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0 /* offset */, 1 /* number of bindings */, vertexBuffers, offsets);
+
+    // same layout, only the uniform buffer is read
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0 /* first set */, 1 /* descriptor set count */, &_descriptorSets[imageIndex], 0 /* dynamic offset count */, nullptr /* dynamic offsets */);
+
+    if (_clusterCulling)
+    {
+        vkCmdBindIndexBuffer(commandBuffer, _culledIndexBuffers[imageIndex], 0 /* offset */, VK_INDEX_TYPE_UINT32);
+    }
+    else
+    {
+        vkCmdBindIndexBuffer(commandBuffer, _indexBuffer, 0 /* offset */, _indexType);
+    }
+    vkCmdDrawIndexedIndirect(commandBuffer, _drawIndirectBuffers[imageIndex], drawCommand * sizeof(VkDrawIndexedIndirectCommand), 1 /* draw count */, sizeof(VkDrawIndexedIndirectCommand));
+
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+void HelloTriangleApplication::recordMainPass(VkCommandBuffer commandBuffer, size_t imageIndex)
+{
+    // Start the render pass
+    VkRenderPassBeginInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = _renderPass;
+    renderPassInfo.framebuffer = _sceneFrameBuffer;
+
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = _renderExtent;
+
+    // the depth clear is ignored when the pre-pass filled it
+    std::array<VkClearValue, 2> clearValues = {};
+    clearValues[0].color = {0.f, 0.f, 0.f, 1.f};
+    clearValues[1].depthStencil = {1.0f, 0};
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    // basic drawing commands
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _graphicsPipeline);
+    setViewport(commandBuffer, _renderExtent);
+
+    VkBuffer vertexBuffers[] = {_vertexBuffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0 /* offset */, 1 /* number of bindings */, vertexBuffers, offsets);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0 /* first set */, 1 /* descriptor set count */, &_descriptorSets[imageIndex], 0 /* dynamic offset count */, nullptr /* dynamic offsets */);
+
+    // old draw command
+    // vkCmdDraw(commandBuffer, static_cast<uint32_t>(vertices.size()), 1 /* instance count*/, 0 /* first vertex */, 0 /* first instance*/);
+    if (_clusterCulling)
+    {
+        // Only the triangles of visible clusters, counted by the culling pass.  The
+        // second draw is empty without occlusion culling; two draws of one each since
+        // a draw count above 1 needs the multiDrawIndirect feature.
+        vkCmdBindIndexBuffer(commandBuffer, _culledIndexBuffers[imageIndex], 0 /* offset */, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexedIndirect(commandBuffer, _drawIndirectBuffers[imageIndex], 0 /* offset */, 1 /* draw count */, sizeof(VkDrawIndexedIndirectCommand));
+        vkCmdDrawIndexedIndirect(commandBuffer, _drawIndirectBuffers[imageIndex], sizeof(VkDrawIndexedIndirectCommand), 1 /* draw count */, sizeof(VkDrawIndexedIndirectCommand));
+    }
+    else
+    {
+        // indexed draw command, the range of the current LOD level is written every frame
+        vkCmdBindIndexBuffer(commandBuffer, _indexBuffer, 0 /* offset */, _indexType);
+        vkCmdDrawIndexedIndirect(commandBuffer, _drawIndirectBuffers[imageIndex], 0 /* offset */, 1 /* draw count */, sizeof(VkDrawIndexedIndirectCommand));
+    }
+
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+void HelloTriangleApplication::createUpscaleDescriptorSet()
+{
+    // Bilinear, clamped: the shader keeps its coordinates inside the rendered part
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = 0.0f;
+
+    if (vkCreateSampler(_device, &samplerInfo, nullptr, &_upscaleSampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upscale sampler!");
+    }
+
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_upscaleDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upscale descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _upscaleDescriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &_upscaleDescriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(_device, &allocInfo, &_upscaleDescriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate upscale descriptor set!");
+    }
+
+    // one scene image serves every swap chain image
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.sampler = _upscaleSampler;
+    imageInfo.imageView = _frameGraph.getImageView(_frameSceneColor);
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet descriptorWrite = {};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = _upscaleDescriptorSet;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(_device, 1, &descriptorWrite, 0, nullptr);
+}
+
+void HelloTriangleApplication::recordUpscale(VkCommandBuffer commandBuffer, size_t imageIndex)
+{
+    VkRenderPassBeginInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = _upscaleRenderPass;
+    renderPassInfo.framebuffer = _swapChainBuffers[imageIndex];
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = _swapChainExtent;
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _upscalePipeline);
+    setViewport(commandBuffer, _swapChainExtent);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _upscalePipelineLayout, 0 /* first set */, 1 /* descriptor set count */, &_upscaleDescriptorSet, 0 /* dynamic offset count */, nullptr /* dynamic offsets */);
+
+    float scale[2] = {
+        static_cast<float>(_renderExtent.width) / _swapChainExtent.width,
+        static_cast<float>(_renderExtent.height) / _swapChainExtent.height
+    };
+    vkCmdPushConstants(commandBuffer, _upscalePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(scale), scale);
+    vkCmdDraw(commandBuffer, 3 /* vertex count */, 1 /* instance count */, 0 /* first vertex */, 0 /* first instance */);
+
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+void HelloTriangleApplication::createTimestampQueries()
+{
+    _frameImages.assign(MAX_FRAMES_IN_FLIGHT, -1);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(_physicalDevice, &properties);
+    _dynamicResolution = properties.limits.timestampComputeAndGraphics == VK_TRUE;
+    if (!_dynamicResolution)
+    {
+        std::cout << "No timestamp queries, dynamic resolution is off" << std::endl;
+        return;
+    }
+    _timestampPeriod = properties.limits.timestampPeriod;
+
+    _resolutionController.reset();
+    _resolutionStep = resolutionSteps - 1;
+}
+
+void HelloTriangleApplication::createTimestampQueryPool()
+{
+    // start and end of each swap chain image's command buffer
+    VkQueryPoolCreateInfo queryPoolInfo = {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = 2 * static_cast<uint32_t>(_swapChainImages.size());
+
+    if (vkCreateQueryPool(_device, &queryPoolInfo, nullptr, &_timestampQueryPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timestamp query pool!");
+    }
+}
+
+void HelloTriangleApplication::readFrameTime(uint32_t imageIndex)
+{
+    // The frame's fence has signaled, so the results are there unless the image has
+    // been submitted again since; that frame is simply skipped
+    uint64_t timestamps[2];
+    VkResult result = vkGetQueryPoolResults(_device, _timestampQueryPool, 2 * imageIndex, 2, sizeof(timestamps), timestamps,
+                                            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS || timestamps[1] < timestamps[0])
+    {
+        return;
+    }
+
+    float milliseconds = static_cast<float>(timestamps[1] - timestamps[0]) * _timestampPeriod * 1e-6f;
+    _resolutionController.update(milliseconds);
+    _framePacer.gpuTime(milliseconds);
+    _resolutionStep = _resolutionController.step(resolutionSteps);
+}
+
+VkExtent2D HelloTriangleApplication::renderExtent(uint32_t resolutionStep) const
+{
+    if (!_dynamicResolution)
+    {
+        return _swapChainExtent;
+    }
+
+    float scale = _resolutionController.stepScale(resolutionStep, resolutionSteps);
+    VkExtent2D extent;
+    extent.width = std::max(1u, static_cast<uint32_t>(std::lround(_swapChainExtent.width * scale)));
+    extent.height = std::max(1u, static_cast<uint32_t>(std::lround(_swapChainExtent.height * scale)));
+    return extent;
+}
+
 void HelloTriangleApplication::createFrameBuffers()
 {
     _swapChainBuffers.resize(_swapChainImageViews.size());
 
-    // create a frame buffer for each image view
+    // create a frame buffer for each image view, the upscale pass writes them
     for (size_t i = 0; i < _swapChainImageViews.size(); ++i)
     {
-        VkImageView attachments[] = { _swapChainImageViews[i] };
-
         VkFramebufferCreateInfo framebufferInfo = {};
         framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = _renderPass;
+        framebufferInfo.renderPass = _upscaleRenderPass;
         framebufferInfo.attachmentCount = 1;
-        framebufferInfo.pAttachments = attachments;
+        framebufferInfo.pAttachments = &_swapChainImageViews[i];
         framebufferInfo.width = _swapChainExtent.width;
         framebufferInfo.height = _swapChainExtent.height;
         framebufferInfo.layers = 1;
@@ -1335,6 +2793,42 @@ void HelloTriangleApplication::createFrameBuffers()
         }
     }
 
+    // every image shares the scene and depth images, the graph orders the frames' uses of them
+    std::array<VkImageView, 2> sceneAttachments = { _frameGraph.getImageView(_frameSceneColor), _frameGraph.getImageView(_frameDepth) };
+
+    VkFramebufferCreateInfo sceneFramebufferInfo = {};
+    sceneFramebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    sceneFramebufferInfo.renderPass = _renderPass;
+    sceneFramebufferInfo.attachmentCount = static_cast<uint32_t>(sceneAttachments.size());
+    sceneFramebufferInfo.pAttachments = sceneAttachments.data();
+    sceneFramebufferInfo.width = _swapChainExtent.width;
+    sceneFramebufferInfo.height = _swapChainExtent.height;
+    sceneFramebufferInfo.layers = 1;
+
+    if (vkCreateFramebuffer(_device, &sceneFramebufferInfo, nullptr, &_sceneFrameBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create scene framebuffer!");
+    }
+
+    if (depthPrePass)
+    {
+        VkImageView depthView = _frameGraph.getImageView(_frameDepth);
+
+        VkFramebufferCreateInfo framebufferInfo = {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = _depthRenderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &depthView;
+        framebufferInfo.width = _swapChainExtent.width;
+        framebufferInfo.height = _swapChainExtent.height;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(_device, &framebufferInfo, nullptr, &_depthFrameBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create depth pre-pass framebuffer!");
+        }
+    }
+
     std::cout << " Number of framebuffers created : " << _swapChainBuffers.size() << std::endl;
 }
 
@@ -1370,6 +2864,19 @@ void HelloTriangleApplication::createDescriptorSetLayout()
     if (vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_descriptorSetLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor set layout!");
     }
+
+    // ------------- Upscale pass, the scene image -------------
+    VkDescriptorSetLayoutBinding sceneLayoutBinding = samplerLayoutBinding;
+    sceneLayoutBinding.binding = 0;
+
+    VkDescriptorSetLayoutCreateInfo upscaleLayoutInfo = {};
+    upscaleLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    upscaleLayoutInfo.bindingCount = 1;
+    upscaleLayoutInfo.pBindings = &sceneLayoutBinding;
+
+    if (vkCreateDescriptorSetLayout(_device, &upscaleLayoutInfo, nullptr, &_upscaleDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upscale descriptor set layout!");
+    }
 }
 
 void HelloTriangleApplication::createDescriptorPool()
@@ -1453,7 +2960,7 @@ void HelloTriangleApplication::createDescriptorSets()
 void HelloTriangleApplication::createGraphicsPipeline()
 {
     // vertex shader
-    _vertexShaderModule = createShaderModule(std::string(std::getenv("PWD")) + "/../../../../../vulkanTesting/shaders/vert.spv");
+    _vertexShaderModule = createShaderModule("shaders/vert.spv");
     VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -1461,7 +2968,7 @@ void HelloTriangleApplication::createGraphicsPipeline()
     vertShaderStageInfo.pName = "main"; // you can have other entry points as well
 
     // fragment shader
-    _fragmentShaderModule = createShaderModule(std::string(std::getenv("PWD")) + "/../../../../../vulkanTesting/shaders/frag.spv");
+    _fragmentShaderModule = createShaderModule("shaders/frag.spv");
     VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
     fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -1477,8 +2984,8 @@ void HelloTriangleApplication::createGraphicsPipeline()
     // Fixed stages
     // Vertex Input
     VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    auto bindingDescription = _vertexLayout.getBindingDescription();
+    auto attributeDescriptions = _vertexLayout.getAttributeDescriptions();
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     vertexInputInfo.vertexBindingDescriptionCount = 1;
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());;
@@ -1536,7 +3043,15 @@ void HelloTriangleApplication::createGraphicsPipeline()
     multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
     multisampling.alphaToOneEnable = VK_FALSE; // Optional
 
-    // Depth and stencil testing - not needed here
+    // Depth testing.  After the pre-pass the depth buffer already holds the nearest
+    // surface, so only fragments of that surface pass and nothing is written.
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = depthPrePass ? VK_FALSE : VK_TRUE;
+    depthStencil.depthCompareOp = depthPrePass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
 
     // Color blending
     VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
@@ -1551,10 +3066,10 @@ void HelloTriangleApplication::createGraphicsPipeline()
 
     VkDynamicState dynamicStates[] = {
         VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_LINE_WIDTH
+        VK_DYNAMIC_STATE_SCISSOR
     };
 
-    // states you can change on the fly
+    // states you can change on the fly, the scene's size follows the resolution scale
     VkPipelineDynamicStateCreateInfo dynamicState = {};
     dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
     dynamicState.dynamicStateCount = 2;
@@ -1593,9 +3108,9 @@ void HelloTriangleApplication::createGraphicsPipeline()
     pipelineInfo.pViewportState = &viewportState;
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = nullptr; // Optional
+    pipelineInfo.pDepthStencilState = &depthStencil;
     pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.pDynamicState = nullptr; // Optional
+    pipelineInfo.pDynamicState = &dynamicState;
 
     pipelineInfo.layout = _pipelineLayout;
     pipelineInfo.renderPass = _renderPass;
@@ -1609,13 +3124,101 @@ void HelloTriangleApplication::createGraphicsPipeline()
         throw std::runtime_error("failed to create graphics pipeline!");
     }
 
+    if (depthPrePass)
+    {
+        // Same state as above except for the shaders, the vertex input and the depth
+        // test.  No fragment shader, the depth comes from the rasterizer.
+        VkShaderModule depthShaderModule = createShaderModule("shaders/depth.spv");
+        VkPipelineShaderStageCreateInfo depthShaderStageInfo = vertShaderStageInfo;
+        depthShaderStageInfo.module = depthShaderModule;
+
+        auto positionBindingDescription = _positionLayout.getBindingDescription();
+        auto positionAttributeDescriptions = _positionLayout.getAttributeDescriptions();
+        VkPipelineVertexInputStateCreateInfo positionInputInfo = vertexInputInfo;
+        positionInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(positionAttributeDescriptions.size());
+        positionInputInfo.pVertexBindingDescriptions = &positionBindingDescription;
+        positionInputInfo.pVertexAttributeDescriptions = positionAttributeDescriptions.data();
+
+        VkPipelineDepthStencilStateCreateInfo prePassDepthStencil = depthStencil;
+        prePassDepthStencil.depthWriteEnable = VK_TRUE;
+        prePassDepthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+        VkPipelineColorBlendStateCreateInfo noColor = colorBlending;
+        noColor.attachmentCount = 0;
+        noColor.pAttachments = nullptr;
+
+        VkGraphicsPipelineCreateInfo depthPipelineInfo = pipelineInfo;
+        depthPipelineInfo.stageCount = 1;
+        depthPipelineInfo.pStages = &depthShaderStageInfo;
+        depthPipelineInfo.pVertexInputState = &positionInputInfo;
+        depthPipelineInfo.pDepthStencilState = &prePassDepthStencil;
+        depthPipelineInfo.pColorBlendState = &noColor;
+        depthPipelineInfo.renderPass = _depthRenderPass;
+
+        VkResult result = vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &depthPipelineInfo, nullptr, &_depthPipeline);
+        vkDestroyShaderModule(_device, depthShaderModule, nullptr);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pre-pass pipeline!");
+        }
+    }
+
+    // Upscale: a screen covering triangle from the vertex index, no depth, no culling
+    VkShaderModule upscaleVertexModule = createShaderModule("shaders/upscaleVert.spv");
+    VkShaderModule upscaleFragmentModule = createShaderModule("shaders/upscaleFrag.spv");
+    VkPipelineShaderStageCreateInfo upscaleStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+    upscaleStages[0].module = upscaleVertexModule;
+    upscaleStages[1].module = upscaleFragmentModule;
+
+    VkPipelineVertexInputStateCreateInfo noVertexInput = {};
+    noVertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineRasterizationStateCreateInfo upscaleRasterizer = rasterizer;
+    upscaleRasterizer.cullMode = VK_CULL_MODE_NONE;
+
+    VkPipelineDepthStencilStateCreateInfo noDepth = depthStencil;
+    noDepth.depthTestEnable = VK_FALSE;
+    noDepth.depthWriteEnable = VK_FALSE;
+
+    // the part of the scene image that was rendered to
+    VkPushConstantRange upscaleRange = {};
+    upscaleRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    upscaleRange.offset = 0;
+    upscaleRange.size = 2 * sizeof(float);
+
+    VkPipelineLayoutCreateInfo upscaleLayoutInfo = {};
+    upscaleLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    upscaleLayoutInfo.setLayoutCount = 1;
+    upscaleLayoutInfo.pSetLayouts = &_upscaleDescriptorSetLayout;
+    upscaleLayoutInfo.pushConstantRangeCount = 1;
+    upscaleLayoutInfo.pPushConstantRanges = &upscaleRange;
+
+    if (vkCreatePipelineLayout(_device, &upscaleLayoutInfo, nullptr, &_upscalePipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upscale pipeline layout!");
+    }
+
+    VkGraphicsPipelineCreateInfo upscalePipelineInfo = pipelineInfo;
+    upscalePipelineInfo.pStages = upscaleStages;
+    upscalePipelineInfo.pVertexInputState = &noVertexInput;
+    upscalePipelineInfo.pRasterizationState = &upscaleRasterizer;
+    upscalePipelineInfo.pDepthStencilState = &noDepth;
+    upscalePipelineInfo.layout = _upscalePipelineLayout;
+    upscalePipelineInfo.renderPass = _upscaleRenderPass;
+
+    VkResult upscaleResult = vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &upscalePipelineInfo, nullptr, &_upscalePipeline);
+    vkDestroyShaderModule(_device, upscaleVertexModule, nullptr);
+    vkDestroyShaderModule(_device, upscaleFragmentModule, nullptr);
+    if (upscaleResult != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upscale pipeline!");
+    }
+
     // destroy shader modules
     vkDestroyShaderModule(_device, _vertexShaderModule, nullptr);
     vkDestroyShaderModule(_device, _fragmentShaderModule, nullptr);
 }
 
 VkImageView HelloTriangleApplication::createImageView(VkImage image,
-                                               VkFormat format)
+                                               VkFormat format,
+                                               uint32_t mipLevels)
 {
     VkImageViewCreateInfo viewInfo = {};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -1624,7 +3227,7 @@ VkImageView HelloTriangleApplication::createImageView(VkImage image,
     viewInfo.format = format;
     viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
@@ -1656,33 +3259,54 @@ void HelloTriangleApplication::createImageViews()
  */
 void HelloTriangleApplication::createRenderPass()
 {
-    // single color buffer attachment
+    _depthFormat = findDepthFormat();
+
+    // single color buffer attachment, the offscreen scene image the upscale pass reads
     VkAttachmentDescription colorAttachment = {};
     colorAttachment.format = _swapChainImageFormat;
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 
     colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;      // before rendering : clear
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;    // after rendering : preserve contents
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // we don't care about the layout of the image
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // final layout is optimized for presentation
+    // the frame graph moves the image into and out of the attachment layout
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    // depth attachment, only tested against after the pre-pass wrote it
+    VkImageLayout depthLayout = depthPrePass ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    VkAttachmentDescription depthAttachment = {};
+    depthAttachment.format = _depthFormat;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = depthPrePass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; // not needed after the frame
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = depthLayout;
+    depthAttachment.finalLayout = depthLayout;
 
     // attachment reference
     VkAttachmentReference colorAttachmentRef = {};
-    colorAttachmentRef.attachment = 0; // we only have 1 VkAttachmentDescription so it's index is 0
+    colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    VkAttachmentReference depthAttachmentRef = {};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = depthLayout;
+
     // subpass
     VkSubpassDescription subpass = {};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS; // this is a graphics subpass
 
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
     // render pass
+    std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
     VkRenderPassCreateInfo renderPassInfo = {};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
 
@@ -1690,20 +3314,96 @@ void HelloTriangleApplication::createRenderPass()
         throw std::runtime_error("failed to create render pass!");
     }
 
-    // take care of the transition(?) at the start of the render pass
-    VkSubpassDependency dependency = {};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
+    // upscale: covers the whole swap chain image, so nothing needs loading
+    VkAttachmentDescription upscaleAttachment = colorAttachment;
+    upscaleAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+    VkSubpassDescription upscaleSubpass = {};
+    upscaleSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    upscaleSubpass.colorAttachmentCount = 1;
+    upscaleSubpass.pColorAttachments = &colorAttachmentRef;
+
+    VkRenderPassCreateInfo upscaleInfo = {};
+    upscaleInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    upscaleInfo.attachmentCount = 1;
+    upscaleInfo.pAttachments = &upscaleAttachment;
+    upscaleInfo.subpassCount = 1;
+    upscaleInfo.pSubpasses = &upscaleSubpass;
+
+    if (vkCreateRenderPass(_device, &upscaleInfo, nullptr, &_upscaleRenderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upscale render pass!");
+    }
+
+    if (!depthPrePass)
+    {
+        return;
+    }
+
+    // depth pre-pass: clears and writes the depth buffer, no color
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;  // the main pass tests against it
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference prePassDepthRef = {};
+    prePassDepthRef.attachment = 0;
+    prePassDepthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription prePassSubpass = {};
+    prePassSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    prePassSubpass.colorAttachmentCount = 0;
+    prePassSubpass.pDepthStencilAttachment = &prePassDepthRef;
+
+    VkRenderPassCreateInfo prePassInfo = {};
+    prePassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    prePassInfo.attachmentCount = 1;
+    prePassInfo.pAttachments = &depthAttachment;
+    prePassInfo.subpassCount = 1;
+    prePassInfo.pSubpasses = &prePassSubpass;
+
+    if (vkCreateRenderPass(_device, &prePassInfo, nullptr, &_depthRenderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pre-pass render pass!");
+    }
+
+    // adds to the depth of the first pre-pass, compatible with its frame buffer and pipeline
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
 
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
+    if (vkCreateRenderPass(_device, &prePassInfo, nullptr, &_depthLoadRenderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pre-pass render pass!");
+    }
+}
 
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+VkFormat HelloTriangleApplication::findSupportedFormat(const std::vector<VkFormat> & candidates,
+                                                       VkImageTiling tiling,
+                                                       VkFormatFeatureFlags features)
+{
+    for (VkFormat format : candidates)
+    {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(_physicalDevice, format, &properties);
 
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
+        VkFormatFeatureFlags supported = tiling == VK_IMAGE_TILING_LINEAR ? properties.linearTilingFeatures : properties.optimalTilingFeatures;
+        if ((supported & features) == features)
+        {
+            return format;
+        }
+    }
 
+    throw std::runtime_error("failed to find supported format!");
+}
+
+VkFormat HelloTriangleApplication::findDepthFormat()
+{
+    // 32 bit float first, the stencil formats only as a fallback since nothing uses stencil.
+    // Occlusion culling builds its Hi-Z pyramid from the pre-pass depth, so samples it.
+    VkFormatFeatureFlags features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if (depthPrePass)
+    {
+        features |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    }
+    return findSupportedFormat({VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+                               VK_IMAGE_TILING_OPTIMAL,
+                               features);
 }
 
 void HelloTriangleApplication::createSwapChain()
@@ -1711,15 +3411,11 @@ void HelloTriangleApplication::createSwapChain()
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(_physicalDevice, _surface);
 
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.surfaceFormats);
-    VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
-    VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
+    VkPresentModeKHR presentMode = _framePacer.choosePresentMode(swapChainSupport.presentModes);
+    VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities, _window);
 
-    // number of images in our swap chain
-    uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-    // A value of 0 for maxImageCount means that there is no limit besides memory requirements, which is why we need to check for that.
-    if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
-        imageCount = swapChainSupport.capabilities.maxImageCount;
-    }
+    // number of images in our swap chain, more queue frames for the display and add latency
+    uint32_t imageCount = _framePacer.chooseImageCount(swapChainSupport.capabilities);
     std::cout << "SwapChain image Count " << imageCount << std::endl;
 
     // Create the swap chain
@@ -1761,7 +3457,8 @@ void HelloTriangleApplication::createSwapChain()
     // Unless you really need to be able to read these pixels back and get predictable results,
     // you'll get the best performance by enabling clipping.
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    // lets the driver hand over resources, the old one is retired by the caller
+    createInfo.oldSwapchain = _swapChain;
 
     if (vkCreateSwapchainKHR(_device, &createInfo, nullptr, &_swapChain) != VK_SUCCESS)
     {
@@ -12,9 +12,23 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <functional>
+#include <map>
 #include <vector>
 #include <string>
 
+#include "assetPack.hpp"
+#include "asyncFileLoader.hpp"
+#include "deletionQueue.hpp"
+#include "dynamicResolution.hpp"
+#include "framePacer.hpp"
+#include "meshLoader.hpp"
+#include "meshSimplifier.hpp"
+#include "meshlet.hpp"
+#include "renderGraph.hpp"
+#include "textureCache.hpp"
+#include "vertexFormat.hpp"
+
 class HelloTriangleApplication {
 
 public:
@@ -31,7 +45,35 @@ private:
 
     void drawFrame();
 
-    void cleanupSwapChain();
+    // Sets _framebufferResized, drawFrame recreates the swap chain after presenting
+    static void framebufferResizeCallback(GLFWwindow * window, int width, int height);
+
+    // Draws while the window is being resized, when the main loop does not get to run
+    static void windowRefreshCallback(GLFWwindow * window);
+
+    // New swap chain for the window's current size, created from the old one.  The
+    // old one and everything sized for it are retired instead of waiting for the
+    // device to idle, so frames keep coming during a live resize.
+    void recreateSwapChain();
+
+    // Everything that depends on the swap chain's images or extent: views, frame
+    // buffers, the graph's transient images, the descriptors of those images and
+    // the command buffers.  Render passes and pipelines outlive it, their viewport
+    // and scissor are dynamic.
+    void createSwapChainResources();
+
+    void retireSwapChain();
+
+    // One of each per swap chain image: uniform buffers and their descriptor sets,
+    // culling and draw command buffers, timestamp queries.  Kept across
+    // recreations, remade only when the image count changes.
+    void createImageResources();
+
+    void retireImageResources();
+
+    // destroy runs once no frame submitted before this call can still be using the
+    // objects it frees, see deletionQueue
+    void retire(std::function<void()> destroy);
 
     void cleanup();
 
@@ -47,7 +89,8 @@ private:
     void createSwapChain();
 
     VkImageView createImageView(VkImage image,
-                                VkFormat format);
+                                VkFormat format,
+                                uint32_t mipLevels = 1);
 
     void createImageViews();
 
@@ -57,8 +100,17 @@ private:
 
     void createDescriptorSets();
 
+    // The main pipeline and, with the depth pre-pass, the depth only one
     void createGraphicsPipeline();
 
+    // First of candidates the device can use with optimal tiling for features
+    VkFormat findSupportedFormat(const std::vector<VkFormat> & candidates,
+                                 VkImageTiling tiling,
+                                 VkFormatFeatureFlags features);
+
+    VkFormat findDepthFormat();
+
+    // The main render pass and, with the depth pre-pass, the depth only one
     void createRenderPass();
 
     void createFrameBuffers();
@@ -71,6 +123,7 @@ private:
 
     void createImage(uint32_t width,
                      uint32_t height,
+                     uint32_t mipLevels,
                      VkFormat format,
                      VkImageTiling tiling,
                      VkImageUsageFlags usage,
@@ -81,15 +134,24 @@ private:
     void transitionImageLayout(VkImage image,
                                VkFormat format,
                                VkImageLayout oldLayout,
-                               VkImageLayout newLayout);
+                               VkImageLayout newLayout,
+                               uint32_t mipLevels);
 
     void copyBufferToImage(VkBuffer buffer,
                            VkImage image,
-                           uint32_t width,
-                           uint32_t height);
+                           const std::vector<VkBufferImageCopy> & regions);
+
+    bool isFormatSampleable(VkFormat format);
 
     void createTextureImage();
 
+    // Upload a mip chain.  Level offsets are relative to texels.
+    void createTextureImage(VkFormat format,
+                            uint32_t width,
+                            uint32_t height,
+                            const uint8_t * texels,
+                            const std::vector<textureCache::mipLevel> & mips);
+
     void createTextureImageView();
 
     void createTextureSampler();
@@ -104,10 +166,80 @@ private:
                     VkBuffer dstBuffer,
                     VkDeviceSize size);
 
+    // Device local buffer filled with data through a staging buffer
+    void createDeviceLocalBuffer(const void * data,
+                                 VkDeviceSize size,
+                                 VkBufferUsageFlags usage,
+                                 VkBuffer& buffer,
+                                 VkDeviceMemory& bufferMemory);
+
+    // Model from the assets if there is one, otherwise the built in quad.
+    // Also picks the vertex layout, so it runs before createGraphicsPipeline.
+    void loadMesh();
+
+    bool isVertexFormatSupported(VkFormat format);
+
     void createVertexBuffer();
 
+    // Positions alone, read by the depth pre-pass
+    void createPositionBuffer();
+
     void createIndexBuffer();
 
+    // Per image draw commands, written by the culling pass or by updateUniformBuffer
+    void createDrawIndirectBuffers();
+
+    // Cluster culling for dense meshes, see meshlet.hpp and shaders/cull.comp.  A compute
+    // pass writes the visible triangles into a per image index buffer and draw command.
+    void createClusterBuffers();
+
+    // Per image culled indices and culling uniforms
+    void createCullingBuffers();
+
+    void createCullingPipeline();
+
+    void createCullingDescriptorSets();
+
+    // phase is pushed to the occlusion culling shader, 0 without occlusion culling
+    void recordClusterCulling(VkCommandBuffer commandBuffer, size_t imageIndex, uint32_t phase);
+
+    // Occlusion culling against a Hi-Z pyramid of the pre-pass depth, see
+    // shaders/hiz.comp.  The descriptor sets need the graph's images, so they are
+    // made after createFrameGraph.
+    void createHiZPipeline();
+
+    void createHiZDescriptorSets();
+
+    void recordHiZ(VkCommandBuffer commandBuffer);
+
+    // The frame's passes and what they read and write, see renderGraph.hpp.  The
+    // graph places the barriers and layout transitions between them.
+    void createFrameGraph();
+
+    // drawCommand 0 clears the depth buffer, 1 adds the clusters occlusion culling
+    // found that were not drawn last frame
+    void recordDepthPrePass(VkCommandBuffer commandBuffer, size_t imageIndex, uint32_t drawCommand);
+
+    void recordMainPass(VkCommandBuffer commandBuffer, size_t imageIndex);
+
+    // Dynamic resolution: the scene is drawn into the top left of an offscreen image
+    // at a scale dynamicResolution picks from the GPU frame time, then stretched over
+    // the swap chain image.  Every scale step has its own recorded command buffers.
+    void createUpscaleDescriptorSet();
+
+    void recordUpscale(VkCommandBuffer commandBuffer, size_t imageIndex);
+
+    // Queries for the GPU time of each swap chain image's command buffer.  Without
+    // timestamp support the scene is always drawn at full size.
+    void createTimestampQueries();
+
+    void createTimestampQueryPool();
+
+    // Feeds the GPU time of the frame that last used imageIndex to the controller
+    void readFrameTime(uint32_t imageIndex);
+
+    VkExtent2D renderExtent(uint32_t resolutionStep) const;
+
     void createUniformBuffers();
 
     void updateUniformBuffer(uint32_t currentImage);
@@ -119,7 +251,18 @@ private:
 
     void createSynchronizationObjects();
 
-    VkShaderModule createShaderModule(const std::string & shaderFilePath);
+    // assetName is relative to vulkanTesting/, e.g. "shaders/vert.spv"
+    VkShaderModule createShaderModule(const std::string & assetName);
+
+    // Start reading the loose files for assets that are not in the pack
+    void prefetchAssets(const std::vector<std::string> & assetNames);
+
+    // From the pack, a prefetch or a blocking read, in that order.  data points into
+    // the pack or into storage.  Returns false if the asset does not exist.
+    bool loadAsset(const std::string & assetName,
+                   const uint8_t *& data,
+                   size_t & size,
+                   std::vector<uint8_t> & storage);
 
     /**
      * Initialize the vulkan library by creating an instance.
@@ -130,6 +273,14 @@ private:
 private:
 
     GLFWwindow* _window = nullptr;
+
+    // Mapped for the lifetime of the application, see tools/assetPacker
+    assetPack _assets;
+
+    // Loose file reads started by prefetchAssets, keyed by asset name
+    asyncFileLoader _fileLoader;
+    std::map<std::string, std::future<asyncFileLoader::result>> _prefetchedAssets;
+
     VkInstance _instance;
     VkQueue _graphicsQueue;
     VkPhysicalDevice _physicalDevice = VK_NULL_HANDLE;
@@ -137,14 +288,70 @@ private:
     VkSurfaceKHR _surface;
     VkQueue _presentQueue;
 
+    // CPU copy of the geometry in the vertex and index buffers
+    meshLoader::mesh _mesh;
+    VkIndexType _indexType = VK_INDEX_TYPE_UINT16;
+    // Every LOD level is in the index buffer, one is picked each frame by projected error
+    meshSimplifier::lodChain _lodChain;
+    uint32_t _currentLod = 0;
+    glm::packed_vec3 _meshCenter;
+    float _meshRadius = 0.0f;
+    vertexFormat::layout _vertexLayout;
+
     // Vertex Buffer
     VkBuffer _vertexBuffer;
     VkDeviceMemory _vertexBufferMemory;
 
+    // Position only stream for the depth pre-pass
+    vertexFormat::layout _positionLayout;
+    VkBuffer _positionBuffer;
+    VkDeviceMemory _positionBufferMemory;
+
     // Index Buffer
     VkBuffer _indexBuffer;
     VkDeviceMemory _indexBufferMemory;
 
+    // Cluster culling, only for meshes with enough triangles to pay for the dispatch
+    bool _clusterCulling = false;
+    meshlet::clusterSet _clusters;
+    // First cluster and cluster count of each LOD level
+    std::vector<std::pair<uint32_t, uint32_t>> _lodClusterRanges;
+    VkBuffer _clusterBuffer;
+    VkDeviceMemory _clusterBufferMemory;
+    VkBuffer _clusterIndexBuffer;
+    VkDeviceMemory _clusterIndexBufferMemory;
+    // Per swap chain image, written by the culling pass and read by the draw
+    std::vector<VkBuffer> _culledIndexBuffers;
+    std::vector<VkDeviceMemory> _culledIndexBuffersMemory;
+    std::vector<VkBuffer> _cullingUniformBuffers;
+    std::vector<VkDeviceMemory> _cullingUniformBuffersMemory;
+    VkDescriptorSetLayout _cullingDescriptorSetLayout;
+    VkDescriptorPool _cullingDescriptorPool;
+    std::vector<VkDescriptorSet> _cullingDescriptorSets;
+    VkPipelineLayout _cullingPipelineLayout;
+    VkPipeline _cullingPipeline;
+
+    // Occlusion culling, with cluster culling and the depth pre-pass
+    bool _occlusionCulling = false;
+    // One flag per cluster of every level, visible after the last frame's culling
+    VkBuffer _clusterVisibilityBuffer;
+    VkDeviceMemory _clusterVisibilityBufferMemory;
+    // Level 0 is the depth extent rounded down to powers of two
+    VkExtent2D _hiZExtent;
+    uint32_t _hiZLevels;
+    VkImageView _depthSampleView;
+    std::vector<VkImageView> _hiZLevelViews;
+    VkSampler _hiZSampler;
+    VkDescriptorSetLayout _hiZDescriptorSetLayout;
+    VkDescriptorPool _hiZDescriptorPool;
+    std::vector<VkDescriptorSet> _hiZDescriptorSets; // one per level
+    VkPipelineLayout _hiZPipelineLayout;
+    VkPipeline _hiZPipeline;
+
+    // Draw command per swap chain image, device local when the culling pass writes it
+    std::vector<VkBuffer> _drawIndirectBuffers;
+    std::vector<VkDeviceMemory> _drawIndirectBuffersMemory;
+
     // Uniform Buffer
     std::vector<VkBuffer> _uniformBuffers;
     std::vector<VkDeviceMemory> _uniformBuffersMemory;
@@ -153,13 +360,16 @@ private:
     VkImage _textureImage;
     VkDeviceMemory _textureImageMemory;
     VkImageView _textureImageView;
+    VkFormat _textureFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    uint32_t _textureMipLevels = 1;
+    bool _textureCompressionBC = false;
     VkSampler _textureSampler;
 
     // debug callback
     VkDebugUtilsMessengerEXT _callback;
 
-    // swap chain
-    VkSwapchainKHR _swapChain;
+    // swap chain, the old one is passed along when it is recreated
+    VkSwapchainKHR _swapChain = VK_NULL_HANDLE;
     VkFormat _swapChainImageFormat;
     VkExtent2D _swapChainExtent;
     std::vector<VkImage> _swapChainImages;
@@ -174,6 +384,38 @@ private:
     VkRenderPass _renderPass;
     VkPipelineLayout _pipelineLayout;
 
+    // depth buffer, a transient image of the frame graph
+    VkFormat _depthFormat;
+
+    // depth pre-pass, fills the depth buffer so the main pass shades each pixel once
+    VkRenderPass _depthRenderPass;
+    // keeps the depth, for the clusters occlusion culling adds
+    VkRenderPass _depthLoadRenderPass;
+    VkPipeline _depthPipeline;
+    VkFramebuffer _depthFrameBuffer;
+
+    // scene color and depth, full size, the passes draw into their top left
+    VkFramebuffer _sceneFrameBuffer;
+
+    // dynamic resolution, _swapChainBuffers are the upscale pass's frame buffers
+    bool _dynamicResolution = false;
+    dynamicResolution _resolutionController;
+    uint32_t _resolutionStep = 0;
+    // extent of the scale step whose command buffers are being recorded
+    VkExtent2D _renderExtent;
+    VkQueryPool _timestampQueryPool;
+    float _timestampPeriod = 1.0f; // nanoseconds per tick
+    // swap chain image each frame in flight was submitted with, -1 once the frame's
+    // fence has signaled and its timestamps have been read
+    std::vector<int64_t> _frameImages;
+    VkRenderPass _upscaleRenderPass;
+    VkDescriptorSetLayout _upscaleDescriptorSetLayout;
+    VkDescriptorPool _upscaleDescriptorPool;
+    VkDescriptorSet _upscaleDescriptorSet;
+    VkSampler _upscaleSampler;
+    VkPipelineLayout _upscalePipelineLayout;
+    VkPipeline _upscalePipeline;
+
     // descriptors
     VkDescriptorSetLayout _descriptorSetLayout;
     VkDescriptorPool _descriptorPool;
@@ -182,7 +424,17 @@ private:
     // graphics pipeline
     VkPipeline _graphicsPipeline;
 
-    // commands
+    // frame graph, its imported resources are bound per swap chain image
+    renderGraph _frameGraph;
+    renderGraph::resource _frameTarget;
+    renderGraph::resource _frameDrawCommand;
+    renderGraph::resource _frameCulledIndices;
+    renderGraph::resource _frameDepth;
+    renderGraph::resource _frameSceneColor;
+    renderGraph::resource _frameVisibility;
+    renderGraph::resource _frameHiZ;
+
+    // commands, one per swap chain image for each resolution step
     VkCommandPool _commandPool;
     std::vector<VkCommandBuffer> _commandBuffers;
 
@@ -192,6 +444,14 @@ private:
     std::vector<VkFence> _inFlightFences;
     // current frame
     size_t _currentFrame = 0;
+    framePacer _framePacer;
+    // frames submitted so far, retired objects are stamped with it
+    uint64_t _frameNumber = 0;
+    // frames up to this one used per image resources that have since been retired
+    uint64_t _imageResourcesRetiredFrame = 0;
+    bool _framebufferResized = false;
+    // destroys waiting on the frames in flight, collected after each fence wait
+    deletionQueue _deletionQueue;
 };
 
 #endif /* HelloTriangleApplication_h */
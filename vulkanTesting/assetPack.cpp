@@ -0,0 +1,550 @@
+//
+//  assetPack.cpp
+//  vulkanTesting
+//
+
+#include "assetPack.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+struct assetPack::header {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t bucketBits;
+    uint32_t namesSize;
+    uint32_t reserved;
+    uint64_t tocOffset;
+    uint64_t bucketOffset;
+    uint64_t namesOffset;
+};
+
+struct assetPack::entry {
+    uint64_t nameHash;
+    uint64_t offset;     // from the start of the pack
+    uint64_t storedSize;
+    uint64_t size;       // uncompressed
+    uint32_t nameOffset; // into the name strings
+    uint32_t nameLength;
+    uint32_t compression;
+    uint32_t reserved;
+};
+
+namespace
+{
+    const char PACK_MAGIC[4] = { 'V', 'P', 'A', 'K' };
+    const uint32_t PACK_VERSION = 1;
+    const uint64_t BLOB_ALIGNMENT = 16;
+
+    const uint32_t COMPRESSION_NONE = 0;
+    const uint32_t COMPRESSION_LZ4 = 1;
+
+    // 64 bit FNV-1a
+    uint64_t hashName(const char * name, size_t length)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < length; ++i)
+        {
+            hash ^= static_cast<uint8_t>(name[i]);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    // [offset, offset + length) lies within size, compared without adding the two
+    // so that huge values from a damaged pack cannot wrap past the end
+    bool fitsIn(uint64_t offset, uint64_t length, uint64_t size)
+    {
+        return offset <= size && length <= size - offset;
+    }
+
+    uint32_t bucketOf(uint64_t hash, uint32_t bucketBits)
+    {
+        return bucketBits == 0 ? 0 : static_cast<uint32_t>(hash >> (64 - bucketBits));
+    }
+
+    uint64_t alignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    uint32_t read32(const uint8_t * p)
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    void writeLength(std::vector<uint8_t> & out, size_t length)
+    {
+        while (length >= 255)
+        {
+            out.push_back(255);
+            length -= 255;
+        }
+        out.push_back(static_cast<uint8_t>(length));
+    }
+
+    // One LZ4 sequence: literals followed by an optional match
+    void writeSequence(std::vector<uint8_t> & out, const uint8_t * literals, size_t literalLength, size_t offset, size_t matchLength)
+    {
+        size_t matchCode = matchLength >= 4 ? matchLength - 4 : 0;
+        uint8_t token = static_cast<uint8_t>((std::min<size_t>(literalLength, 15) << 4) |
+                                             (matchLength ? std::min<size_t>(matchCode, 15) : 0));
+        out.push_back(token);
+        if (literalLength >= 15)
+        {
+            writeLength(out, literalLength - 15);
+        }
+        out.insert(out.end(), literals, literals + literalLength);
+
+        if (matchLength)
+        {
+            out.push_back(static_cast<uint8_t>(offset & 0xff));
+            out.push_back(static_cast<uint8_t>(offset >> 8));
+            if (matchCode >= 15)
+            {
+                writeLength(out, matchCode - 15);
+            }
+        }
+    }
+
+    bool readLength(const uint8_t *& in, const uint8_t * end, size_t & length)
+    {
+        uint8_t byte;
+        do
+        {
+            if (in >= end)
+            {
+                return false;
+            }
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+}
+
+assetPack::assetPack() :
+_file(),
+_data(nullptr),
+_size(0),
+_header(nullptr),
+_entries(nullptr),
+_buckets(nullptr),
+_names(nullptr)
+{
+
+}
+
+bool assetPack::open(const std::string & filePath)
+{
+    close();
+    if (!_file.open(filePath))
+    {
+        return false;
+    }
+    _data = _file.data();
+    _size = _file.size();
+    if (!validate())
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool assetPack::open(const void * data, size_t size)
+{
+    close();
+    _data = static_cast<const uint8_t *>(data);
+    _size = size;
+    if (!validate())
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void assetPack::close()
+{
+    _file.close();
+    _data = nullptr;
+    _size = 0;
+    _header = nullptr;
+    _entries = nullptr;
+    _buckets = nullptr;
+    _names = nullptr;
+}
+
+bool assetPack::isOpen() const
+{
+    return _header != nullptr;
+}
+
+bool assetPack::validate()
+{
+    if (_data == nullptr || _size < sizeof(header))
+    {
+        return false;
+    }
+
+    const header * packHeader = reinterpret_cast<const header *>(_data);
+    if (memcmp(packHeader->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 ||
+        packHeader->version != PACK_VERSION ||
+        packHeader->bucketBits > 31)
+    {
+        return false;
+    }
+
+    uint64_t bucketCount = 1ULL << packHeader->bucketBits;
+    // The lengths are 32 bit counts times small sizes, only the offsets can be huge
+    if (!fitsIn(packHeader->tocOffset, static_cast<uint64_t>(packHeader->entryCount) * sizeof(entry), _size) ||
+        !fitsIn(packHeader->bucketOffset, (bucketCount + 1) * sizeof(uint32_t), _size) ||
+        !fitsIn(packHeader->namesOffset, packHeader->namesSize, _size) ||
+        packHeader->tocOffset % alignof(entry) != 0 ||
+        packHeader->bucketOffset % alignof(uint32_t) != 0)
+    {
+        return false;
+    }
+
+    const entry * entries = reinterpret_cast<const entry *>(_data + packHeader->tocOffset);
+    const uint32_t * buckets = reinterpret_cast<const uint32_t *>(_data + packHeader->bucketOffset);
+
+    for (uint64_t i = 0; i < bucketCount; ++i)
+    {
+        if (buckets[i] > buckets[i + 1] || buckets[i + 1] > packHeader->entryCount)
+        {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < packHeader->entryCount; ++i)
+    {
+        const entry & record = entries[i];
+        if (!fitsIn(record.offset, record.storedSize, _size) ||
+            !fitsIn(record.nameOffset, record.nameLength, packHeader->namesSize) ||
+            (record.compression != COMPRESSION_NONE && record.compression != COMPRESSION_LZ4) ||
+            (record.compression == COMPRESSION_NONE && record.storedSize != record.size))
+        {
+            return false;
+        }
+    }
+
+    _header = packHeader;
+    _entries = entries;
+    _buckets = buckets;
+    _names = reinterpret_cast<const char *>(_data + packHeader->namesOffset);
+    return true;
+}
+
+const assetPack::entry * assetPack::find(const std::string & name) const
+{
+    if (!isOpen())
+    {
+        return nullptr;
+    }
+
+    uint64_t hash = hashName(name.data(), name.size());
+    uint32_t bucket = bucketOf(hash, _header->bucketBits);
+
+    // Buckets hold a handful of entries at most, the name compare guards against hash collisions
+    for (uint32_t i = _buckets[bucket]; i < _buckets[bucket + 1]; ++i)
+    {
+        const entry & record = _entries[i];
+        if (record.nameHash == hash &&
+            record.nameLength == name.size() &&
+            memcmp(_names + record.nameOffset, name.data(), name.size()) == 0)
+        {
+            return &record;
+        }
+    }
+    return nullptr;
+}
+
+bool assetPack::contains(const std::string & name) const
+{
+    return find(name) != nullptr;
+}
+
+bool assetPack::get(const std::string & name, const uint8_t *& data, size_t & size, std::vector<uint8_t> & scratch) const
+{
+    const entry * record = find(name);
+    if (record == nullptr)
+    {
+        return false;
+    }
+
+    if (record->compression == COMPRESSION_NONE)
+    {
+        data = _data + record->offset;
+        size = static_cast<size_t>(record->size);
+        return true;
+    }
+
+    scratch.resize(static_cast<size_t>(record->size));
+    if (!decompress(_data + record->offset, static_cast<size_t>(record->storedSize), scratch.data(), scratch.size()))
+    {
+        return false;
+    }
+    data = scratch.data();
+    size = scratch.size();
+    return true;
+}
+
+bool assetPack::read(const std::string & name, std::vector<char> & out) const
+{
+    const uint8_t * data = nullptr;
+    size_t size = 0;
+    std::vector<uint8_t> scratch;
+    if (!get(name, data, size, scratch))
+    {
+        return false;
+    }
+    out.assign(reinterpret_cast<const char *>(data), reinterpret_cast<const char *>(data) + size);
+    return true;
+}
+
+size_t assetPack::entryCount() const
+{
+    return isOpen() ? _header->entryCount : 0;
+}
+
+std::string assetPack::entryName(size_t index) const
+{
+    if (index >= entryCount())
+    {
+        return std::string();
+    }
+    return std::string(_names + _entries[index].nameOffset, _entries[index].nameLength);
+}
+
+bool assetPack::write(const std::string & filePath, const std::vector<source> & sources, bool compress)
+{
+    // Sort by hash so every bucket is a contiguous run of entries
+    std::vector<std::pair<uint64_t, size_t> > order;
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        order.push_back(std::make_pair(hashName(sources[i].name.data(), sources[i].name.size()), i));
+    }
+    std::sort(order.begin(), order.end());
+
+    for (size_t i = 1; i < order.size(); ++i)
+    {
+        if (sources[order[i].second].name == sources[order[i - 1].second].name)
+        {
+            return false;
+        }
+    }
+
+    // About one entry per bucket
+    uint32_t bucketBits = 0;
+    while ((static_cast<size_t>(1) << bucketBits) < sources.size())
+    {
+        ++bucketBits;
+    }
+    uint32_t bucketCount = 1u << bucketBits;
+
+    std::vector<entry> entries(sources.size());
+    std::vector<uint32_t> buckets(bucketCount + 1, 0);
+    std::vector<std::vector<uint8_t> > blobs(sources.size());
+    std::string names;
+
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        const source & file = sources[order[i].second];
+        entry & record = entries[i];
+        memset(&record, 0, sizeof(record));
+        record.nameHash = order[i].first;
+        record.nameOffset = static_cast<uint32_t>(names.size());
+        record.nameLength = static_cast<uint32_t>(file.name.size());
+        record.size = file.bytes.size();
+        record.compression = COMPRESSION_NONE;
+        names += file.name;
+
+        if (compress && !file.bytes.empty())
+        {
+            std::vector<uint8_t> packed = assetPack::compress(file.bytes.data(), file.bytes.size());
+            if (packed.size() * 10 <= file.bytes.size() * 9)
+            {
+                record.compression = COMPRESSION_LZ4;
+                blobs[i].swap(packed);
+            }
+        }
+        if (record.compression == COMPRESSION_NONE)
+        {
+            blobs[i] = file.bytes;
+        }
+        record.storedSize = blobs[i].size();
+
+        // buckets[b + 1] counts the entries in bucket b until the prefix sum below
+        buckets[bucketOf(record.nameHash, bucketBits) + 1]++;
+    }
+    for (uint32_t b = 0; b < bucketCount; ++b)
+    {
+        buckets[b + 1] += buckets[b];
+    }
+
+    header packHeader;
+    memset(&packHeader, 0, sizeof(packHeader));
+    memcpy(packHeader.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    packHeader.version = PACK_VERSION;
+    packHeader.entryCount = static_cast<uint32_t>(entries.size());
+    packHeader.bucketBits = bucketBits;
+    packHeader.namesSize = static_cast<uint32_t>(names.size());
+    packHeader.tocOffset = sizeof(header);
+    packHeader.bucketOffset = packHeader.tocOffset + entries.size() * sizeof(entry);
+    packHeader.namesOffset = packHeader.bucketOffset + buckets.size() * sizeof(uint32_t);
+
+    uint64_t offset = packHeader.namesOffset + names.size();
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        offset = alignUp(offset, BLOB_ALIGNMENT);
+        entries[i].offset = offset;
+        offset += entries[i].storedSize;
+    }
+
+    // Write to a temporary name and rename so readers never see a half written pack
+    std::string tempPath = filePath + ".tmp";
+    FILE * file = fopen(tempPath.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    bool written = fwrite(&packHeader, sizeof(packHeader), 1, file) == 1 &&
+                   fwrite(entries.data(), sizeof(entry), entries.size(), file) == entries.size() &&
+                   fwrite(buckets.data(), sizeof(uint32_t), buckets.size(), file) == buckets.size() &&
+                   fwrite(names.data(), 1, names.size(), file) == names.size();
+
+    uint64_t position = packHeader.namesOffset + names.size();
+    const uint8_t zeros[BLOB_ALIGNMENT] = {};
+    for (size_t i = 0; written && i < entries.size(); ++i)
+    {
+        size_t padding = static_cast<size_t>(entries[i].offset - position);
+        written = fwrite(zeros, 1, padding, file) == padding &&
+                  fwrite(blobs[i].data(), 1, blobs[i].size(), file) == blobs[i].size();
+        position = entries[i].offset + entries[i].storedSize;
+    }
+
+    written = (fclose(file) == 0) && written;
+    if (!written || rename(tempPath.c_str(), filePath.c_str()) != 0)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::vector<uint8_t> assetPack::compress(const uint8_t * data, size_t size)
+{
+    // Greedy LZ4 with a single hash table of the last position each 4 byte sequence was seen.
+    // The format needs the last 5 bytes as literals and no match starting in the last 12.
+    const size_t LAST_LITERALS = 5;
+    const size_t MATCH_FIND_LIMIT = 12;
+    const uint32_t HASH_BITS = 12;
+
+    std::vector<uint8_t> out;
+    out.reserve(size + size / 255 + 16);
+
+    size_t anchor = 0;
+    if (size > MATCH_FIND_LIMIT)
+    {
+        std::vector<int64_t> table(static_cast<size_t>(1) << HASH_BITS, -1);
+        size_t matchFindEnd = size - MATCH_FIND_LIMIT;
+        size_t matchEnd = size - LAST_LITERALS;
+
+        size_t position = 0;
+        while (position < matchFindEnd)
+        {
+            uint32_t sequence = read32(data + position);
+            uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+            int64_t candidate = table[hash];
+            table[hash] = static_cast<int64_t>(position);
+
+            if (candidate < 0 ||
+                position - static_cast<size_t>(candidate) > 65535 ||
+                read32(data + candidate) != sequence)
+            {
+                ++position;
+                continue;
+            }
+
+            size_t matchLength = 4;
+            while (position + matchLength < matchEnd && data[candidate + matchLength] == data[position + matchLength])
+            {
+                ++matchLength;
+            }
+
+            writeSequence(out, data + anchor, position - anchor, position - static_cast<size_t>(candidate), matchLength);
+            position += matchLength;
+            anchor = position;
+        }
+    }
+
+    writeSequence(out, data + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+bool assetPack::decompress(const uint8_t * data, size_t size, uint8_t * out, size_t outSize)
+{
+    const uint8_t * in = data;
+    const uint8_t * end = data + size;
+    size_t written = 0;
+
+    while (in < end)
+    {
+        uint8_t token = *in++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(in, end, literalLength))
+        {
+            return false;
+        }
+        if (literalLength > static_cast<size_t>(end - in) || literalLength > outSize - written)
+        {
+            return false;
+        }
+        memcpy(out + written, in, literalLength);
+        in += literalLength;
+        written += literalLength;
+
+        // The last sequence has no match
+        if (in == end)
+        {
+            break;
+        }
+
+        if (end - in < 2)
+        {
+            return false;
+        }
+        size_t offset = static_cast<size_t>(in[0]) | (static_cast<size_t>(in[1]) << 8);
+        in += 2;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(in, end, matchLength))
+        {
+            return false;
+        }
+        matchLength += 4;
+
+        if (offset == 0 || offset > written || matchLength > outSize - written)
+        {
+            return false;
+        }
+
+        // Byte by byte because the match may overlap what it is writing
+        const uint8_t * match = out + written - offset;
+        for (size_t i = 0; i < matchLength; ++i)
+        {
+            out[written + i] = match[i];
+        }
+        written += matchLength;
+    }
+
+    return written == outSize;
+}
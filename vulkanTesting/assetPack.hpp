@@ -0,0 +1,87 @@
+//
+//  assetPack.hpp
+//  vulkanTesting
+//
+
+#ifndef assetPack_hpp
+#define assetPack_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mappedFile.hpp"
+
+// Single file asset archive.  The file is mapped once and every lookup is a hash
+// into a bucket table followed by pointer arithmetic, no per-asset syscalls.
+//
+// Layout (little endian):
+//   header
+//   table of contents, sorted by 64 bit FNV-1a name hash
+//   bucket table: bucketCount + 1 first-entry indices, bucketed by the top bits of the hash
+//   name strings
+//   blobs, each 16 byte aligned
+//
+// Blobs are stored as is, or LZ4 block compressed when that saves space.
+// Shared with the Android sample, so this must stay C++11.
+class assetPack
+{
+public:
+
+    struct source {
+        std::string name;
+        std::vector<uint8_t> bytes;
+    };
+
+    assetPack();
+
+    // Map the pack from disk
+    bool open(const std::string & filePath);
+
+    // Use a pack that is already in memory (e.g. AAsset_getBuffer).  The caller keeps it alive.
+    bool open(const void * data, size_t size);
+
+    void close();
+
+    bool isOpen() const;
+
+    bool contains(const std::string & name) const;
+
+    // Stored entries point straight into the pack, compressed entries are expanded into scratch.
+    // Returns false if the entry is missing or corrupt.
+    bool get(const std::string & name, const uint8_t *& data, size_t & size, std::vector<uint8_t> & scratch) const;
+
+    // Copy of an entry, for callers that want to own the bytes
+    bool read(const std::string & name, std::vector<char> & out) const;
+
+    size_t entryCount() const;
+
+    std::string entryName(size_t index) const;
+
+    // Build a pack.  With compress set, each entry is LZ4 compressed if that makes it at least 10% smaller.
+    static bool write(const std::string & filePath, const std::vector<source> & sources, bool compress);
+
+    // LZ4 block format, exposed for the packer tool
+    static std::vector<uint8_t> compress(const uint8_t * data, size_t size);
+
+    static bool decompress(const uint8_t * data, size_t size, uint8_t * out, size_t outSize);
+
+private:
+    struct header;
+    struct entry;
+
+    const entry * find(const std::string & name) const;
+
+    bool validate();
+
+    mappedFile _file;
+    const uint8_t * _data;
+    size_t _size;
+    const header * _header;
+    const entry * _entries;
+    const uint32_t * _buckets;
+    const char * _names;
+};
+
+#endif /* assetPack_hpp */
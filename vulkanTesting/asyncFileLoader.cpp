@@ -0,0 +1,632 @@
+//
+//  asyncFileLoader.cpp
+//  vulkanTesting
+//
+
+#include "asyncFileLoader.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+struct asyncFileLoader::request {
+    result output;
+    callback done;
+    int fd = -1;
+    size_t size = 0;
+    size_t offset = 0;
+    iovec chunk;
+};
+
+namespace
+{
+    // Opens the file and sizes the destination buffer.  Metadata calls are cheap
+    // next to the reads, so they stay synchronous on the loader thread.
+    bool openRequest(asyncFileLoader::result & output, int & fd, size_t & size)
+    {
+        fd = ::open(output.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            output.error = errno;
+            return false;
+        }
+
+        struct stat fileInfo;
+        if (fstat(fd, &fileInfo) != 0)
+        {
+            output.error = errno;
+            return false;
+        }
+
+        size = static_cast<size_t>(fileInfo.st_size);
+        output.bytes.resize(size);
+        return true;
+    }
+}
+
+#ifdef __linux__
+
+// Raw io_uring: the kernel headers are enough, no liburing dependency
+struct asyncFileLoader::ring {
+    int fd = -1;
+    int wakeFd = -1;
+    unsigned entries = 0;
+    unsigned queued = 0;
+    int error = 0; // errno that took the ring out of service
+
+    void * sqRing = MAP_FAILED;
+    size_t sqRingSize = 0;
+    void * cqRing = MAP_FAILED;
+    size_t cqRingSize = 0;
+    void * sqeMemory = MAP_FAILED;
+    size_t sqeMemorySize = 0;
+
+    unsigned * sqHead = nullptr;
+    unsigned * sqTail = nullptr;
+    unsigned * sqMask = nullptr;
+    unsigned * sqArray = nullptr;
+    io_uring_sqe * sqes = nullptr;
+
+    unsigned * cqHead = nullptr;
+    unsigned * cqTail = nullptr;
+    unsigned * cqMask = nullptr;
+    io_uring_cqe * cqes = nullptr;
+
+    ~ring()
+    {
+        if (sqeMemory != MAP_FAILED)
+        {
+            munmap(sqeMemory, sqeMemorySize);
+        }
+        if (cqRing != MAP_FAILED && cqRing != sqRing)
+        {
+            munmap(cqRing, cqRingSize);
+        }
+        if (sqRing != MAP_FAILED)
+        {
+            munmap(sqRing, sqRingSize);
+        }
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        if (wakeFd >= 0)
+        {
+            ::close(wakeFd);
+        }
+    }
+
+    bool create(unsigned depth)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+        if (fd < 0)
+        {
+            return false;
+        }
+        entries = params.sq_entries;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMapping)
+        {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED)
+        {
+            return false;
+        }
+        cqRing = singleMapping ? sqRing :
+                 mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED)
+        {
+            return false;
+        }
+        sqeMemorySize = params.sq_entries * sizeof(io_uring_sqe);
+        sqeMemory = mmap(nullptr, sqeMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqeMemory == MAP_FAILED)
+        {
+            return false;
+        }
+
+        uint8_t * sq = static_cast<uint8_t *>(sqRing);
+        sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        sqes = static_cast<io_uring_sqe *>(sqeMemory);
+
+        uint8_t * cq = static_cast<uint8_t *>(cqRing);
+        cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+        // Other threads write this to pull the loader out of io_uring_enter
+        wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        return wakeFd >= 0;
+    }
+
+    io_uring_sqe * nextSqe()
+    {
+        unsigned tail = *sqTail;
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= entries)
+        {
+            // Requeued reads can fill it; the kernel frees the slots of what it takes
+            if (!submit(0))
+            {
+                return nullptr;
+            }
+            if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= entries)
+            {
+                error = EBUSY;
+                return nullptr;
+            }
+        }
+        unsigned index = tail & *sqMask;
+        io_uring_sqe * sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++queued;
+        return sqe;
+    }
+
+    bool queueRead(request * item)
+    {
+        io_uring_sqe * sqe = nextSqe();
+        if (sqe == nullptr)
+        {
+            return false;
+        }
+        item->chunk.iov_base = item->output.bytes.data() + item->offset;
+        item->chunk.iov_len = item->size - item->offset;
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = item->fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&item->chunk);
+        sqe->len = 1;
+        sqe->off = item->offset;
+        sqe->user_data = reinterpret_cast<uint64_t>(item);
+        return true;
+    }
+
+    // user_data 0 marks the wake-up poll, every other completion is a request
+    bool queueWakePoll()
+    {
+        io_uring_sqe * sqe = nextSqe();
+        if (sqe == nullptr)
+        {
+            return false;
+        }
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = wakeFd;
+        sqe->poll_events = POLLIN;
+        sqe->user_data = 0;
+        return true;
+    }
+
+    bool submitAndWait()
+    {
+        return submit(1);
+    }
+
+    // Hands the queued entries to the kernel and waits for minComplete completions.
+    // False once io_uring_enter fails for a reason retrying will not fix.
+    bool submit(unsigned minComplete)
+    {
+        unsigned flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+        while (true)
+        {
+            int submitted = static_cast<int>(syscall(__NR_io_uring_enter, fd, queued, minComplete, flags, nullptr, 0));
+            if (submitted >= 0)
+            {
+                queued -= std::min(queued, static_cast<unsigned>(submitted));
+                return true;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            {
+                error = errno;
+                return false;
+            }
+        }
+    }
+
+    // Moves the requests the kernel never took out of the submission queue,
+    // returning how many there were
+    size_t takeUnsubmitted(std::vector<std::unique_ptr<request>> & items)
+    {
+        size_t count = 0;
+        unsigned tail = *sqTail;
+        for (unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE); head != tail; ++head)
+        {
+            const io_uring_sqe & sqe = sqes[sqArray[head & *sqMask]];
+            if (sqe.user_data != 0)
+            {
+                items.emplace_back(reinterpret_cast<request *>(sqe.user_data));
+                ++count;
+            }
+        }
+        queued = 0;
+        return count;
+    }
+
+    void wake()
+    {
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd, &one, sizeof(one));
+        (void)written; // a full counter still leaves the eventfd readable
+    }
+};
+
+#else
+
+struct asyncFileLoader::ring {
+    bool create(unsigned)
+    {
+        return false;
+    }
+
+    void wake()
+    {
+    }
+};
+
+#endif
+
+asyncFileLoader::asyncFileLoader(unsigned queueDepth, unsigned threadCount) :
+_outstanding(0),
+_stopping(false),
+_ringFailed(false)
+{
+    std::unique_ptr<ring> candidate(new ring);
+    if (candidate->create(std::max(queueDepth, 2u)))
+    {
+        _ring = std::move(candidate);
+        _threads.emplace_back(&asyncFileLoader::ringLoop, this);
+        return;
+    }
+
+    if (threadCount == 0)
+    {
+        threadCount = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+    }
+    for (unsigned i = 0; i < threadCount; ++i)
+    {
+        _threads.emplace_back(&asyncFileLoader::workerLoop, this);
+    }
+}
+
+asyncFileLoader::~asyncFileLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    if (_ring)
+    {
+        _ring->wake();
+    }
+    _wake.notify_all();
+
+    for (std::thread & thread : _threads)
+    {
+        thread.join();
+    }
+}
+
+void asyncFileLoader::read(const std::string & filePath, callback done)
+{
+    std::vector<std::unique_ptr<request>> requests;
+    requests.emplace_back(new request);
+    requests.back()->output.path = filePath;
+    requests.back()->done = std::move(done);
+    enqueue(requests);
+}
+
+std::future<asyncFileLoader::result> asyncFileLoader::read(const std::string & filePath)
+{
+    std::vector<std::future<result>> futures = read(std::vector<std::string>(1, filePath));
+    return std::move(futures[0]);
+}
+
+std::vector<std::future<asyncFileLoader::result>> asyncFileLoader::read(const std::vector<std::string> & filePaths)
+{
+    std::vector<std::future<result>> futures;
+    std::vector<std::unique_ptr<request>> requests;
+    for (const std::string & filePath : filePaths)
+    {
+        // std::function has to be copyable, so the promise is shared
+        std::shared_ptr<std::promise<result>> promise = std::make_shared<std::promise<result>>();
+        futures.push_back(promise->get_future());
+
+        requests.emplace_back(new request);
+        requests.back()->output.path = filePath;
+        requests.back()->done = [promise](result && output) {
+            promise->set_value(std::move(output));
+        };
+    }
+    enqueue(requests);
+    return futures;
+}
+
+void asyncFileLoader::wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle.wait(lock, [this] { return _outstanding == 0; });
+}
+
+bool asyncFileLoader::usingIoUring() const
+{
+    return _ring != nullptr && !_ringFailed;
+}
+
+void asyncFileLoader::enqueue(std::vector<std::unique_ptr<request>> & requests)
+{
+    bool ringActive = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (std::unique_ptr<request> & item : requests)
+        {
+            _pending.push_back(std::move(item));
+        }
+        _outstanding += requests.size();
+        ringActive = _ring && !_ringFailed;
+    }
+
+    if (ringActive)
+    {
+        _ring->wake();
+    }
+    else if (requests.size() == 1)
+    {
+        _wake.notify_one();
+    }
+    else
+    {
+        _wake.notify_all();
+    }
+}
+
+void asyncFileLoader::finish(std::unique_ptr<request> item)
+{
+    if (item->fd >= 0)
+    {
+        ::close(item->fd);
+        item->fd = -1;
+    }
+    // The file may have shrunk since we sized the buffer
+    item->output.bytes.resize(item->offset);
+
+    if (item->done)
+    {
+        item->done(std::move(item->output));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        --_outstanding;
+    }
+    _idle.notify_all();
+}
+
+void asyncFileLoader::ringLoop()
+{
+#ifdef __linux__
+    ring & uring = *_ring;
+
+    // One slot stays reserved for the wake-up poll
+    size_t capacity = uring.entries - 1;
+    size_t inFlight = 0;
+
+    // Applies a read's completion, handing back the request if it has bytes left to read
+    auto complete = [this](const io_uring_cqe & cqe) {
+        std::unique_ptr<request> item(reinterpret_cast<request *>(cqe.user_data));
+        if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+        {
+            return item;
+        }
+        if (cqe.res < 0)
+        {
+            item->output.error = -cqe.res;
+        }
+        else
+        {
+            item->offset += static_cast<size_t>(cqe.res);
+            if (cqe.res > 0 && item->offset < item->size)
+            {
+                // Short read, carry on from where it stopped
+                return item;
+            }
+        }
+        finish(std::move(item));
+        return std::unique_ptr<request>();
+    };
+
+    // Requests left for blocking reads if the ring fails
+    std::vector<std::unique_ptr<request>> retry;
+    bool failed = !uring.queueWakePoll();
+
+    while (!failed)
+    {
+        std::vector<std::unique_ptr<request>> batch;
+        bool finished = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            while (!_pending.empty() && inFlight + batch.size() < capacity)
+            {
+                batch.push_back(std::move(_pending.front()));
+                _pending.pop_front();
+            }
+            finished = _stopping && _pending.empty() && batch.empty() && inFlight == 0;
+        }
+        if (finished)
+        {
+            return;
+        }
+
+        for (std::unique_ptr<request> & item : batch)
+        {
+            if (failed)
+            {
+                retry.push_back(std::move(item));
+                continue;
+            }
+            if (!openRequest(item->output, item->fd, item->size) || item->size == 0)
+            {
+                finish(std::move(item));
+                continue;
+            }
+            if (!uring.queueRead(item.get()))
+            {
+                failed = true;
+                retry.push_back(std::move(item));
+                continue;
+            }
+            item.release();
+            ++inFlight;
+        }
+
+        if (!failed && !uring.submitAndWait())
+        {
+            failed = true;
+        }
+
+        unsigned head = *uring.cqHead;
+        unsigned tail = __atomic_load_n(uring.cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head)
+        {
+            const io_uring_cqe & cqe = uring.cqes[head & *uring.cqMask];
+
+            if (cqe.user_data == 0)
+            {
+                uint64_t count;
+                ssize_t drained = ::read(uring.wakeFd, &count, sizeof(count));
+                (void)drained; // nonblocking, another wake-up may already have drained it
+                if (!failed && !uring.queueWakePoll())
+                {
+                    failed = true;
+                }
+                continue;
+            }
+
+            std::unique_ptr<request> item = complete(cqe);
+            if (!item)
+            {
+                --inFlight;
+                continue;
+            }
+            if (failed || !uring.queueRead(item.get()))
+            {
+                failed = true;
+                --inFlight;
+                retry.push_back(std::move(item));
+                continue;
+            }
+            item.release();
+        }
+        __atomic_store_n(uring.cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    // The ring is out of service.  Reads the kernel never took are retried with
+    // blocking reads, reads it did take are waited for, since it still writes into
+    // their buffers, then this thread carries on as a thread pool of one.
+    std::cout << "io_uring failed, falling back to blocking reads: " << strerror(uring.error) << std::endl;
+    inFlight -= uring.takeUnsubmitted(retry);
+    while (inFlight > 0)
+    {
+        unsigned head = *uring.cqHead;
+        unsigned tail = __atomic_load_n(uring.cqTail, __ATOMIC_ACQUIRE);
+        if (head == tail)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        for (; head != tail; ++head)
+        {
+            const io_uring_cqe & cqe = uring.cqes[head & *uring.cqMask];
+            if (cqe.user_data == 0)
+            {
+                continue;
+            }
+            std::unique_ptr<request> item = complete(cqe);
+            if (item)
+            {
+                retry.push_back(std::move(item));
+            }
+            --inFlight;
+        }
+        __atomic_store_n(uring.cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto item = retry.rbegin(); item != retry.rend(); ++item)
+        {
+            _pending.push_front(std::move(*item));
+        }
+        _ringFailed = true;
+    }
+    workerLoop();
+#endif
+}
+
+void asyncFileLoader::workerLoop()
+{
+    while (true)
+    {
+        std::unique_ptr<request> item;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this] { return _stopping || !_pending.empty(); });
+            if (_pending.empty())
+            {
+                return;
+            }
+            item = std::move(_pending.front());
+            _pending.pop_front();
+        }
+
+        // Requests handed over by a failed ring may be open and partly read already
+        if (item->fd >= 0 || openRequest(item->output, item->fd, item->size))
+        {
+            while (item->offset < item->size)
+            {
+                ssize_t bytesRead = pread(item->fd, item->output.bytes.data() + item->offset,
+                                          item->size - item->offset, static_cast<off_t>(item->offset));
+                if (bytesRead < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (bytesRead < 0)
+                {
+                    item->output.error = errno;
+                }
+                if (bytesRead <= 0)
+                {
+                    break;
+                }
+                item->offset += static_cast<size_t>(bytesRead);
+            }
+        }
+        finish(std::move(item));
+    }
+}
@@ -0,0 +1,90 @@
+//
+//  asyncFileLoader.hpp
+//  vulkanTesting
+//
+
+#ifndef asyncFileLoader_hpp
+#define asyncFileLoader_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reads whole files off the calling thread.  On Linux the reads go through an
+// io_uring so every outstanding request is in flight at once and submitted with
+// a single syscall.  Where io_uring is unavailable (other platforms, old kernels,
+// seccomp) a small pool of threads does blocking reads instead, and if the ring
+// fails later on its thread finishes the queue with blocking reads.
+//
+// Callbacks run on the loader's own thread(s) and should hand the bytes off
+// rather than do heavy work.  The destructor finishes every queued request.
+class asyncFileLoader
+{
+public:
+
+    struct result {
+        std::string path;
+        std::vector<uint8_t> bytes;
+        int error = 0; // errno of the failed open/read, 0 on success
+
+        bool ok() const { return error == 0; }
+    };
+
+    typedef std::function<void(result &&)> callback;
+
+    // queueDepth bounds the reads in flight on the ring, threadCount sizes the
+    // fallback pool (0 picks from the core count)
+    explicit asyncFileLoader(unsigned queueDepth = 64, unsigned threadCount = 0);
+
+    asyncFileLoader(const asyncFileLoader &) = delete;
+
+    asyncFileLoader & operator=(const asyncFileLoader &) = delete;
+
+    ~asyncFileLoader();
+
+    void read(const std::string & filePath, callback done);
+
+    std::future<result> read(const std::string & filePath);
+
+    // Queues the whole batch before waking the loader, so it goes out in one submission
+    std::vector<std::future<result>> read(const std::vector<std::string> & filePaths);
+
+    // Blocks until every request made so far has completed
+    void wait();
+
+    bool usingIoUring() const;
+
+private:
+    struct request;
+    struct ring;
+
+    void enqueue(std::vector<std::unique_ptr<request>> & requests);
+
+    void finish(std::unique_ptr<request> item);
+
+    void ringLoop();
+
+    void workerLoop();
+
+    std::unique_ptr<ring> _ring;
+    std::vector<std::thread> _threads;
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _idle;
+    std::deque<std::unique_ptr<request>> _pending;
+    size_t _outstanding;
+    bool _stopping;
+    std::atomic<bool> _ringFailed; // the ring thread has fallen back to blocking reads
+};
+
+#endif /* asyncFileLoader_hpp */
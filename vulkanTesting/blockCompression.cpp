@@ -0,0 +1,1192 @@
+//
+//  blockCompression.cpp
+//  vulkanTesting
+//
+
+#include "blockCompression.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+namespace
+{
+    // BC7 4 bit index interpolation weights, out of 64
+    const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // BC7 2 and 3 bit index interpolation weights, out of 64
+    const int BC7_WEIGHTS2[4] = { 0, 21, 43, 64 };
+    const int BC7_WEIGHTS3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+
+    // BC7 mode layouts: subsets, partition bits, rotation bits, index selection bits,
+    // color and alpha bits per endpoint, p-bits per endpoint or shared per subset,
+    // and the bits of the first and second index sets
+    struct bc7Mode {
+        int subsets;
+        int partitionBits;
+        int rotationBits;
+        int indexSelectionBits;
+        int colorBits;
+        int alphaBits;
+        int endpointPBits;
+        int sharedPBits;
+        int indexBits;
+        int secondIndexBits;
+    };
+
+    const bc7Mode BC7_MODES[8] = {
+        { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+        { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+        { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+        { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+        { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+        { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+        { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+        { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+    };
+
+    // Two subset partitions, bit i set when texel i is in the second subset
+    const uint16_t BC7_PARTITIONS2[64] = {
+        0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+        0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+        0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+        0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+        0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+        0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+        0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+        0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+    };
+
+    // Three subset partitions, the subset of every texel
+    const uint8_t BC7_PARTITIONS3[64][16] = {
+        { 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2 },
+        { 0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1 },
+        { 0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+        { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2 },
+        { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2 },
+        { 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1 },
+        { 0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+        { 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2 },
+        { 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2 },
+        { 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2 },
+        { 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2 },
+        { 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0 },
+        { 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2 },
+        { 0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0 },
+        { 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2 },
+        { 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1 },
+        { 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2 },
+        { 0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1 },
+        { 0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2 },
+        { 0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0 },
+        { 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0 },
+        { 0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2 },
+        { 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0 },
+        { 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1 },
+        { 0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2 },
+        { 0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2 },
+        { 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1 },
+        { 0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2 },
+        { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1 },
+        { 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2 },
+        { 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0 },
+        { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+        { 0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0 },
+        { 0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1 },
+        { 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1 },
+        { 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1 },
+        { 0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2 },
+        { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1 },
+        { 0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1 },
+        { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1 },
+        { 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 },
+        { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 },
+        { 0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1 },
+        { 0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2 },
+        { 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2 },
+        { 0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2 },
+        { 0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2 },
+        { 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2 },
+        { 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2 },
+        { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2 },
+        { 0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2 },
+        { 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1 },
+        { 0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2 },
+        { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 },
+        { 0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0 }
+    };
+
+    // Anchor texel of the second subset of a two subset partition, its index drops the top bit
+    const uint8_t BC7_ANCHORS2[64] = {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+        15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+        6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15
+    };
+
+    // Anchor texels of the second and third subsets of a three subset partition
+    const uint8_t BC7_ANCHORS3_SECOND[64] = {
+        3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+        3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+        8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+        3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3
+    };
+
+    const uint8_t BC7_ANCHORS3_THIRD[64] = {
+        15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+        15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+        15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+        15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8
+    };
+
+    // Squared RGB error of a BC1 block above which the cluster fit is tried, 16 texels off by 4 per channel
+    const uint32_t BC1_CLUSTER_FIT_ERROR = 16 * 3 * 4 * 4;
+
+    // Gather a 4x4 block, repeating the last row/column past the image edge
+    void loadBlock(const uint8_t * rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t block[16][4])
+    {
+        for (uint32_t y = 0; y < 4; ++y)
+        {
+            uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+            for (uint32_t x = 0; x < 4; ++x)
+            {
+                uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+                memcpy(block[y * 4 + x], rgba + (static_cast<size_t>(sourceY) * width + sourceX) * 4, 4);
+            }
+        }
+    }
+
+    void storeBlock(const uint8_t block[16][4], uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t * rgba)
+    {
+        for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; ++y)
+        {
+            for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; ++x)
+            {
+                memcpy(rgba + (static_cast<size_t>(blockY * 4 + y) * width + blockX * 4 + x) * 4, block[y * 4 + x], 4);
+            }
+        }
+    }
+
+    // Principal axis of the first `channels` channels of a block, by power iteration on the covariance
+    void principalAxis(const uint8_t block[16][4], int channels, float mean[4], float axis[4])
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            mean[c] = 0.0f;
+            axis[c] = 0.0f;
+        }
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int c = 0; c < channels; ++c)
+            {
+                mean[c] += block[i][c];
+            }
+        }
+        for (int c = 0; c < channels; ++c)
+        {
+            mean[c] /= 16.0f;
+        }
+
+        float covariance[4][4] = {};
+        for (int i = 0; i < 16; ++i)
+        {
+            float d[4];
+            for (int c = 0; c < channels; ++c)
+            {
+                d[c] = block[i][c] - mean[c];
+            }
+            for (int a = 0; a < channels; ++a)
+            {
+                for (int b = 0; b < channels; ++b)
+                {
+                    covariance[a][b] += d[a] * d[b];
+                }
+            }
+        }
+
+        // Start from the channel with the largest spread, which converges quickly for typical blocks
+        int largest = 0;
+        for (int c = 1; c < channels; ++c)
+        {
+            if (covariance[c][c] > covariance[largest][largest])
+            {
+                largest = c;
+            }
+        }
+        for (int c = 0; c < channels; ++c)
+        {
+            axis[c] = covariance[largest][c];
+        }
+
+        for (int iteration = 0; iteration < 8; ++iteration)
+        {
+            float next[4] = {};
+            for (int a = 0; a < channels; ++a)
+            {
+                for (int b = 0; b < channels; ++b)
+                {
+                    next[a] += covariance[a][b] * axis[b];
+                }
+            }
+            float length = 0.0f;
+            for (int c = 0; c < channels; ++c)
+            {
+                length += next[c] * next[c];
+            }
+            length = std::sqrt(length);
+            if (length < 1e-6f)
+            {
+                break;
+            }
+            for (int c = 0; c < channels; ++c)
+            {
+                axis[c] = next[c] / length;
+            }
+        }
+    }
+
+    // ---- BC1 ----
+
+    uint16_t packRgb565(const float color[3])
+    {
+        int r = static_cast<int>(std::lround(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f));
+        int g = static_cast<int>(std::lround(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f));
+        int b = static_cast<int>(std::lround(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f));
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    void unpackRgb565(uint16_t packed, int color[3])
+    {
+        int r = (packed >> 11) & 31;
+        int g = (packed >> 5) & 63;
+        int b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // Four color palette, or three colors plus transparent black when allowed and color0 <= color1
+    void bc1Palette(uint16_t color0, uint16_t color1, bool allowThreeColor, int palette[4][4])
+    {
+        unpackRgb565(color0, palette[0]);
+        unpackRgb565(color1, palette[1]);
+        palette[0][3] = 255;
+        palette[1][3] = 255;
+        palette[2][3] = 255;
+        palette[3][3] = 255;
+
+        if (color0 > color1 || !allowThreeColor)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+        }
+        else
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+            palette[3][3] = 0;
+        }
+    }
+
+    // Pick the nearest palette entry for every texel, returns the total squared error
+    uint32_t bc1Indices(const uint8_t block[16][4], uint16_t color0, uint16_t color1, uint32_t & indices)
+    {
+        int palette[4][4];
+        bc1Palette(color0, color1, false, palette);
+
+        uint32_t totalError = 0;
+        indices = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            uint32_t bestError = std::numeric_limits<uint32_t>::max();
+            uint32_t best = 0;
+            for (uint32_t p = 0; p < 4; ++p)
+            {
+                uint32_t error = 0;
+                for (int c = 0; c < 3; ++c)
+                {
+                    int d = block[i][c] - palette[p][c];
+                    error += static_cast<uint32_t>(d * d);
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= best << (2 * i);
+            totalError += bestError;
+        }
+        return totalError;
+    }
+
+    // Least squares endpoints for a fixed set of indices
+    bool bc1Refit(const uint8_t block[16][4], uint32_t indices, float endpoint0[3], float endpoint1[3])
+    {
+        const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+        float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+        float ax[3] = {}, bx[3] = {};
+        for (int i = 0; i < 16; ++i)
+        {
+            float a = weights[(indices >> (2 * i)) & 3];
+            float b = 1.0f - a;
+            aa += a * a;
+            bb += b * b;
+            ab += a * b;
+            for (int c = 0; c < 3; ++c)
+            {
+                ax[c] += a * block[i][c];
+                bx[c] += b * block[i][c];
+            }
+        }
+
+        float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) < 1e-6f)
+        {
+            return false;
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            endpoint0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+            endpoint1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+        }
+        return true;
+    }
+
+    // Cluster fit: the texels sorted along the principal axis are split into four
+    // runs that take palette entries 0, 2, 3 and 1 in order.  Every split gets its
+    // least squares endpoints and the one with the lowest unquantized error is kept.
+    bool bc1ClusterFit(const uint8_t block[16][4], const float axis[4], float endpoint0[3], float endpoint1[3])
+    {
+        int order[16];
+        float projections[16];
+        for (int i = 0; i < 16; ++i)
+        {
+            order[i] = i;
+            projections[i] = block[i][0] * axis[0] + block[i][1] * axis[1] + block[i][2] * axis[2];
+        }
+        std::sort(order, order + 16, [&](int a, int b) { return projections[a] > projections[b]; });
+
+        // prefix[k] sums the first k sorted texels
+        float prefix[17][3] = {};
+        float squaredLength = 0.0f;
+        for (int k = 0; k < 16; ++k)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                float value = block[order[k]][c];
+                prefix[k + 1][c] = prefix[k][c] + value;
+                squaredLength += value * value;
+            }
+        }
+
+        float bestError = std::numeric_limits<float>::max();
+        for (int s0 = 0; s0 <= 16; ++s0)
+        {
+            for (int s1 = s0; s1 <= 16; ++s1)
+            {
+                for (int s2 = s1; s2 <= 16; ++s2)
+                {
+                    // weights of endpoint0 are 1, 2/3, 1/3 and 0 along the runs
+                    float n0 = static_cast<float>(s0);
+                    float n1 = static_cast<float>(s1 - s0);
+                    float n2 = static_cast<float>(s2 - s1);
+                    float n3 = static_cast<float>(16 - s2);
+                    float aa = n0 + n1 * (4.0f / 9.0f) + n2 * (1.0f / 9.0f);
+                    float bb = n3 + n1 * (1.0f / 9.0f) + n2 * (4.0f / 9.0f);
+                    float ab = (n1 + n2) * (2.0f / 9.0f);
+                    float determinant = aa * bb - ab * ab;
+                    if (determinant < 1e-6f)
+                    {
+                        continue;
+                    }
+
+                    float error = squaredLength;
+                    float e0[3], e1[3];
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        float run0 = prefix[s0][c];
+                        float run1 = prefix[s1][c] - prefix[s0][c];
+                        float run2 = prefix[s2][c] - prefix[s1][c];
+                        float run3 = prefix[16][c] - prefix[s2][c];
+                        float ax = run0 + run1 * (2.0f / 3.0f) + run2 * (1.0f / 3.0f);
+                        float bx = run3 + run1 * (1.0f / 3.0f) + run2 * (2.0f / 3.0f);
+                        e0[c] = (ax * bb - bx * ab) / determinant;
+                        e1[c] = (bx * aa - ax * ab) / determinant;
+                        error += aa * e0[c] * e0[c] + 2.0f * ab * e0[c] * e1[c] + bb * e1[c] * e1[c]
+                               - 2.0f * (e0[c] * ax + e1[c] * bx);
+                    }
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        memcpy(endpoint0, e0, sizeof(e0));
+                        memcpy(endpoint1, e1, sizeof(e1));
+                    }
+                }
+            }
+        }
+        return bestError != std::numeric_limits<float>::max();
+    }
+
+    // Refit the endpoints to the indices they chose until the quantized error stops improving
+    uint32_t bc1Refine(const uint8_t block[16][4], uint16_t & color0, uint16_t & color1, uint32_t & indices)
+    {
+        uint32_t error = bc1Indices(block, color0, color1, indices);
+        for (int iteration = 0; iteration < 8 && error > 0; ++iteration)
+        {
+            float refit0[3], refit1[3];
+            if (!bc1Refit(block, indices, refit0, refit1))
+            {
+                break;
+            }
+            uint16_t refitColor0 = packRgb565(refit0);
+            uint16_t refitColor1 = packRgb565(refit1);
+            uint32_t refitIndices = 0;
+            uint32_t refitError = bc1Indices(block, refitColor0, refitColor1, refitIndices);
+            if (refitError >= error)
+            {
+                break;
+            }
+            color0 = refitColor0;
+            color1 = refitColor1;
+            indices = refitIndices;
+            error = refitError;
+        }
+        return error;
+    }
+
+    // Moves each endpoint channel one 5:6:5 step either way while that lowers the error,
+    // rounding each channel on its own is rarely the best pair
+    uint32_t bc1NudgeEndpoints(const uint8_t block[16][4], uint16_t & color0, uint16_t & color1, uint32_t & indices, uint32_t error)
+    {
+        const int shifts[3] = { 11, 5, 0 };
+        const int maxima[3] = { 31, 63, 31 };
+
+        bool improved = true;
+        for (int pass = 0; pass < 4 && improved && error > 0; ++pass)
+        {
+            improved = false;
+            for (int endpoint = 0; endpoint < 2; ++endpoint)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    for (int step = -1; step <= 1; step += 2)
+                    {
+                        uint16_t candidate0 = color0;
+                        uint16_t candidate1 = color1;
+                        uint16_t & color = endpoint == 0 ? candidate0 : candidate1;
+                        int value = ((color >> shifts[c]) & maxima[c]) + step;
+                        if (value < 0 || value > maxima[c])
+                        {
+                            continue;
+                        }
+                        color = static_cast<uint16_t>((color & ~(maxima[c] << shifts[c])) | (value << shifts[c]));
+
+                        uint32_t candidateIndices = 0;
+                        uint32_t candidateError = bc1Indices(block, candidate0, candidate1, candidateIndices);
+                        if (candidateError < error)
+                        {
+                            color0 = candidate0;
+                            color1 = candidate1;
+                            indices = candidateIndices;
+                            error = candidateError;
+                            improved = true;
+                        }
+                    }
+                }
+            }
+        }
+        return error;
+    }
+
+    void encodeBc1Block(const uint8_t block[16][4], uint8_t * out)
+    {
+        float mean[4], axis[4];
+        principalAxis(block, 3, mean, axis);
+
+        float minProjection = std::numeric_limits<float>::max();
+        float maxProjection = -std::numeric_limits<float>::max();
+        for (int i = 0; i < 16; ++i)
+        {
+            float projection = 0.0f;
+            for (int c = 0; c < 3; ++c)
+            {
+                projection += (block[i][c] - mean[c]) * axis[c];
+            }
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+
+        // Inset the endpoints slightly, the extremes are usually outliers
+        float inset = (maxProjection - minProjection) / 16.0f;
+        float endpoint0[3], endpoint1[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            endpoint0[c] = mean[c] + axis[c] * (maxProjection - inset);
+            endpoint1[c] = mean[c] + axis[c] * (minProjection + inset);
+        }
+
+        uint16_t color0 = packRgb565(endpoint0);
+        uint16_t color1 = packRgb565(endpoint1);
+        uint32_t indices = 0;
+        uint32_t error = bc1Refine(block, color0, color1, indices);
+
+        // The cluster fit wins on blocks with more than one gradient, and costs too much
+        // to try on blocks the refit already got to within about 4 levels per channel
+        float cluster0[3], cluster1[3];
+        if (error > BC1_CLUSTER_FIT_ERROR && bc1ClusterFit(block, axis, cluster0, cluster1))
+        {
+            uint16_t clusterColor0 = packRgb565(cluster0);
+            uint16_t clusterColor1 = packRgb565(cluster1);
+            uint32_t clusterIndices = 0;
+            uint32_t clusterError = bc1Refine(block, clusterColor0, clusterColor1, clusterIndices);
+            if (clusterError < error)
+            {
+                color0 = clusterColor0;
+                color1 = clusterColor1;
+                indices = clusterIndices;
+                error = clusterError;
+            }
+        }
+
+        bc1NudgeEndpoints(block, color0, color1, indices, error);
+
+        // color0 > color1 selects the four color mode, swap the endpoints and remap 0<->1, 2<->3
+        if (color0 < color1)
+        {
+            std::swap(color0, color1);
+            indices ^= 0x55555555;
+        }
+        else if (color0 == color1)
+        {
+            indices = 0;
+        }
+
+        out[0] = static_cast<uint8_t>(color0 & 0xff);
+        out[1] = static_cast<uint8_t>(color0 >> 8);
+        out[2] = static_cast<uint8_t>(color1 & 0xff);
+        out[3] = static_cast<uint8_t>(color1 >> 8);
+        out[4] = static_cast<uint8_t>(indices);
+        out[5] = static_cast<uint8_t>(indices >> 8);
+        out[6] = static_cast<uint8_t>(indices >> 16);
+        out[7] = static_cast<uint8_t>(indices >> 24);
+    }
+
+    void decodeBc1Block(const uint8_t * in, bool allowThreeColor, uint8_t block[16][4])
+    {
+        uint16_t color0 = static_cast<uint16_t>(in[0] | (in[1] << 8));
+        uint16_t color1 = static_cast<uint16_t>(in[2] | (in[3] << 8));
+        uint32_t indices = static_cast<uint32_t>(in[4]) | (static_cast<uint32_t>(in[5]) << 8) |
+                           (static_cast<uint32_t>(in[6]) << 16) | (static_cast<uint32_t>(in[7]) << 24);
+
+        int palette[4][4];
+        bc1Palette(color0, color1, allowThreeColor, palette);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const int * color = palette[(indices >> (2 * i)) & 3];
+            for (int c = 0; c < 4; ++c)
+            {
+                block[i][c] = static_cast<uint8_t>(color[c]);
+            }
+        }
+    }
+
+    // ---- BC3 alpha (BC4 layout) ----
+
+    void bc4Palette(int alpha0, int alpha1, int palette[8])
+    {
+        palette[0] = alpha0;
+        palette[1] = alpha1;
+        if (alpha0 > alpha1)
+        {
+            for (int i = 1; i < 7; ++i)
+            {
+                palette[i + 1] = ((7 - i) * alpha0 + i * alpha1) / 7;
+            }
+        }
+        else
+        {
+            for (int i = 1; i < 5; ++i)
+            {
+                palette[i + 1] = ((5 - i) * alpha0 + i * alpha1) / 5;
+            }
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    void encodeBc4AlphaBlock(const uint8_t block[16][4], uint8_t * out)
+    {
+        int minAlpha = 255;
+        int maxAlpha = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            minAlpha = std::min(minAlpha, static_cast<int>(block[i][3]));
+            maxAlpha = std::max(maxAlpha, static_cast<int>(block[i][3]));
+        }
+
+        out[0] = static_cast<uint8_t>(maxAlpha);
+        out[1] = static_cast<uint8_t>(minAlpha);
+
+        uint64_t indices = 0;
+        if (maxAlpha != minAlpha)
+        {
+            int palette[8];
+            bc4Palette(maxAlpha, minAlpha, palette);
+            for (int i = 0; i < 16; ++i)
+            {
+                int best = 0;
+                int bestError = std::numeric_limits<int>::max();
+                for (int p = 0; p < 8; ++p)
+                {
+                    int error = std::abs(block[i][3] - palette[p]);
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                indices |= static_cast<uint64_t>(best) << (3 * i);
+            }
+        }
+
+        for (int i = 0; i < 6; ++i)
+        {
+            out[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+        }
+    }
+
+    void decodeBc4AlphaBlock(const uint8_t * in, uint8_t block[16][4])
+    {
+        int palette[8];
+        bc4Palette(in[0], in[1], palette);
+
+        uint64_t indices = 0;
+        for (int i = 0; i < 6; ++i)
+        {
+            indices |= static_cast<uint64_t>(in[2 + i]) << (8 * i);
+        }
+        for (int i = 0; i < 16; ++i)
+        {
+            block[i][3] = static_cast<uint8_t>(palette[(indices >> (3 * i)) & 7]);
+        }
+    }
+
+    // ---- BC7 mode 6 ----
+
+    struct bitWriter {
+        uint8_t * out;
+        uint32_t position;
+
+        void write(uint32_t value, uint32_t bits)
+        {
+            for (uint32_t i = 0; i < bits; ++i, ++position)
+            {
+                if ((value >> i) & 1)
+                {
+                    out[position >> 3] |= static_cast<uint8_t>(1 << (position & 7));
+                }
+            }
+        }
+    };
+
+    struct bitReader {
+        const uint8_t * in;
+        uint32_t position;
+
+        uint32_t read(uint32_t bits)
+        {
+            uint32_t value = 0;
+            for (uint32_t i = 0; i < bits; ++i, ++position)
+            {
+                value |= static_cast<uint32_t>((in[position >> 3] >> (position & 7)) & 1) << i;
+            }
+            return value;
+        }
+    };
+
+    // Quantize an RGBA endpoint to 7 bits per channel plus a shared p-bit, picking the p-bit with the lower error
+    void quantizeMode6Endpoint(const float endpoint[4], int quantized[4], int & pBit)
+    {
+        float bestError = std::numeric_limits<float>::max();
+        for (int p = 0; p < 2; ++p)
+        {
+            int candidate[4];
+            float error = 0.0f;
+            for (int c = 0; c < 4; ++c)
+            {
+                float value = std::min(std::max(endpoint[c], 0.0f), 255.0f);
+                candidate[c] = std::min(std::max(static_cast<int>(std::lround((value - p) / 2.0f)), 0), 127);
+                float d = static_cast<float>(candidate[c] * 2 + p) - value;
+                error += d * d;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                pBit = p;
+                memcpy(quantized, candidate, sizeof(candidate));
+            }
+        }
+    }
+
+    void mode6Palette(const int quantized0[4], int p0, const int quantized1[4], int p1, int palette[16][4])
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            int e0 = (quantized0[c] << 1) | p0;
+            int e1 = (quantized1[c] << 1) | p1;
+            for (int i = 0; i < 16; ++i)
+            {
+                palette[i][c] = ((64 - BC7_WEIGHTS4[i]) * e0 + BC7_WEIGHTS4[i] * e1 + 32) >> 6;
+            }
+        }
+    }
+
+    uint32_t mode6Indices(const uint8_t block[16][4], const int palette[16][4], uint8_t indices[16])
+    {
+        uint32_t totalError = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            uint32_t bestError = std::numeric_limits<uint32_t>::max();
+            for (int p = 0; p < 16; ++p)
+            {
+                uint32_t error = 0;
+                for (int c = 0; c < 4; ++c)
+                {
+                    int d = block[i][c] - palette[p][c];
+                    error += static_cast<uint32_t>(d * d);
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    indices[i] = static_cast<uint8_t>(p);
+                }
+            }
+            totalError += bestError;
+        }
+        return totalError;
+    }
+
+    struct mode6Candidate {
+        int quantized0[4];
+        int quantized1[4];
+        int p0;
+        int p1;
+        uint8_t indices[16];
+        uint32_t error;
+    };
+
+    void evaluateMode6(const uint8_t block[16][4], const float endpoint0[4], const float endpoint1[4], mode6Candidate & candidate)
+    {
+        quantizeMode6Endpoint(endpoint0, candidate.quantized0, candidate.p0);
+        quantizeMode6Endpoint(endpoint1, candidate.quantized1, candidate.p1);
+
+        int palette[16][4];
+        mode6Palette(candidate.quantized0, candidate.p0, candidate.quantized1, candidate.p1, palette);
+        candidate.error = mode6Indices(block, palette, candidate.indices);
+    }
+
+    void encodeBc7Block(const uint8_t block[16][4], uint8_t * out)
+    {
+        float mean[4], axis[4];
+        principalAxis(block, 4, mean, axis);
+
+        float minProjection = std::numeric_limits<float>::max();
+        float maxProjection = -std::numeric_limits<float>::max();
+        for (int i = 0; i < 16; ++i)
+        {
+            float projection = 0.0f;
+            for (int c = 0; c < 4; ++c)
+            {
+                projection += (block[i][c] - mean[c]) * axis[c];
+            }
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+
+        float endpoint0[4], endpoint1[4];
+        for (int c = 0; c < 4; ++c)
+        {
+            endpoint0[c] = mean[c] + axis[c] * minProjection;
+            endpoint1[c] = mean[c] + axis[c] * maxProjection;
+        }
+
+        mode6Candidate best;
+        evaluateMode6(block, endpoint0, endpoint1, best);
+
+        // Least squares refit of the endpoints against the chosen weights, repeated while it improves
+        for (int iteration = 0; iteration < 2 && best.error > 0; ++iteration)
+        {
+            float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+            float ax[4] = {}, bx[4] = {};
+            for (int i = 0; i < 16; ++i)
+            {
+                float b = BC7_WEIGHTS4[best.indices[i]] / 64.0f;
+                float a = 1.0f - b;
+                aa += a * a;
+                bb += b * b;
+                ab += a * b;
+                for (int c = 0; c < 4; ++c)
+                {
+                    ax[c] += a * block[i][c];
+                    bx[c] += b * block[i][c];
+                }
+            }
+            float determinant = aa * bb - ab * ab;
+            if (std::fabs(determinant) < 1e-6f)
+            {
+                break;
+            }
+            for (int c = 0; c < 4; ++c)
+            {
+                endpoint0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+                endpoint1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+            }
+
+            mode6Candidate refit;
+            evaluateMode6(block, endpoint0, endpoint1, refit);
+            if (refit.error >= best.error)
+            {
+                break;
+            }
+            best = refit;
+        }
+
+        // The anchor (first) index is stored without its top bit, so it must be < 8
+        if (best.indices[0] >= 8)
+        {
+            std::swap(best.quantized0, best.quantized1);
+            std::swap(best.p0, best.p1);
+            for (int i = 0; i < 16; ++i)
+            {
+                best.indices[i] = static_cast<uint8_t>(15 - best.indices[i]);
+            }
+        }
+
+        memset(out, 0, 16);
+        bitWriter writer = { out, 0 };
+        writer.write(1 << 6, 7); // mode 6
+        for (int c = 0; c < 4; ++c)
+        {
+            writer.write(static_cast<uint32_t>(best.quantized0[c]), 7);
+            writer.write(static_cast<uint32_t>(best.quantized1[c]), 7);
+        }
+        writer.write(static_cast<uint32_t>(best.p0), 1);
+        writer.write(static_cast<uint32_t>(best.p1), 1);
+        writer.write(best.indices[0], 3);
+        for (int i = 1; i < 16; ++i)
+        {
+            writer.write(best.indices[i], 4);
+        }
+    }
+
+    int bc7Subset(const bc7Mode & mode, uint32_t partition, int texel)
+    {
+        if (mode.subsets == 2)
+        {
+            return (BC7_PARTITIONS2[partition] >> texel) & 1;
+        }
+        if (mode.subsets == 3)
+        {
+            return BC7_PARTITIONS3[partition][texel];
+        }
+        return 0;
+    }
+
+    bool bc7IsAnchor(const bc7Mode & mode, uint32_t partition, int texel)
+    {
+        if (texel == 0)
+        {
+            return true;
+        }
+        if (mode.subsets == 2)
+        {
+            return texel == BC7_ANCHORS2[partition];
+        }
+        if (mode.subsets == 3)
+        {
+            return texel == BC7_ANCHORS3_SECOND[partition] || texel == BC7_ANCHORS3_THIRD[partition];
+        }
+        return false;
+    }
+
+    int bc7Interpolate(int e0, int e1, uint32_t index, int indexBits)
+    {
+        const int * weights = indexBits == 2 ? BC7_WEIGHTS2 : (indexBits == 3 ? BC7_WEIGHTS3 : BC7_WEIGHTS4);
+        return ((64 - weights[index]) * e0 + weights[index] * e1 + 32) >> 6;
+    }
+
+    // Any of the eight modes.  The reserved encoding (no mode bit in the first byte)
+    // decodes to transparent black, as the format requires.
+    void decodeBc7Block(const uint8_t * in, uint8_t block[16][4])
+    {
+        int modeIndex = 0;
+        while (modeIndex < 8 && !((in[0] >> modeIndex) & 1))
+        {
+            ++modeIndex;
+        }
+        if (modeIndex == 8)
+        {
+            memset(block, 0, 16 * 4);
+            return;
+        }
+        const bc7Mode & mode = BC7_MODES[modeIndex];
+
+        bitReader reader = { in, static_cast<uint32_t>(modeIndex + 1) };
+        uint32_t partition = reader.read(static_cast<uint32_t>(mode.partitionBits));
+        uint32_t rotation = reader.read(static_cast<uint32_t>(mode.rotationBits));
+        uint32_t indexSelection = reader.read(static_cast<uint32_t>(mode.indexSelectionBits));
+
+        // endpoints[subset * 2 + endpoint][channel], channels stored in turn, subsets and endpoints within each
+        int endpoints[6][4];
+        int endpointCount = mode.subsets * 2;
+        for (int c = 0; c < 4; ++c)
+        {
+            int bits = c < 3 ? mode.colorBits : mode.alphaBits;
+            for (int e = 0; e < endpointCount; ++e)
+            {
+                endpoints[e][c] = static_cast<int>(reader.read(static_cast<uint32_t>(bits)));
+            }
+        }
+
+        // p-bits append a low bit to every channel, alpha included when it is stored
+        int pBits[6] = {};
+        if (mode.endpointPBits)
+        {
+            for (int e = 0; e < endpointCount; ++e)
+            {
+                pBits[e] = static_cast<int>(reader.read(1));
+            }
+        }
+        else if (mode.sharedPBits)
+        {
+            for (int subset = 0; subset < mode.subsets; ++subset)
+            {
+                pBits[subset * 2] = pBits[subset * 2 + 1] = static_cast<int>(reader.read(1));
+            }
+        }
+
+        bool hasPBits = mode.endpointPBits || mode.sharedPBits;
+        for (int e = 0; e < endpointCount; ++e)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                int bits = c < 3 ? mode.colorBits : mode.alphaBits;
+                if (bits == 0)
+                {
+                    endpoints[e][c] = 255;
+                    continue;
+                }
+                int value = endpoints[e][c];
+                if (hasPBits)
+                {
+                    value = (value << 1) | pBits[e];
+                    bits += 1;
+                }
+                // replicate the top bits into the bits below
+                value <<= 8 - bits;
+                endpoints[e][c] = value | (value >> bits);
+            }
+        }
+
+        // The anchor texels store their index without its top bit, which is zero
+        uint32_t indices[16];
+        for (int i = 0; i < 16; ++i)
+        {
+            int bits = mode.indexBits - (bc7IsAnchor(mode, partition, i) ? 1 : 0);
+            indices[i] = reader.read(static_cast<uint32_t>(bits));
+        }
+        uint32_t secondIndices[16] = {};
+        if (mode.secondIndexBits)
+        {
+            for (int i = 0; i < 16; ++i)
+            {
+                secondIndices[i] = reader.read(static_cast<uint32_t>(mode.secondIndexBits - (i == 0 ? 1 : 0)));
+            }
+        }
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const int * e0 = endpoints[bc7Subset(mode, partition, i) * 2];
+            const int * e1 = endpoints[bc7Subset(mode, partition, i) * 2 + 1];
+
+            int texel[4];
+            if (mode.secondIndexBits)
+            {
+                // Modes 4 and 5 index color and alpha separately, mode 4 can swap the two sets
+                uint32_t colorIndex = indexSelection ? secondIndices[i] : indices[i];
+                uint32_t alphaIndex = indexSelection ? indices[i] : secondIndices[i];
+                int colorBits = indexSelection ? mode.secondIndexBits : mode.indexBits;
+                int alphaBits = indexSelection ? mode.indexBits : mode.secondIndexBits;
+                for (int c = 0; c < 3; ++c)
+                {
+                    texel[c] = bc7Interpolate(e0[c], e1[c], colorIndex, colorBits);
+                }
+                texel[3] = bc7Interpolate(e0[3], e1[3], alphaIndex, alphaBits);
+            }
+            else
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    texel[c] = bc7Interpolate(e0[c], e1[c], indices[i], mode.indexBits);
+                }
+            }
+
+            // Rotation swaps alpha with red, green or blue
+            if (rotation > 0)
+            {
+                std::swap(texel[3], texel[rotation - 1]);
+            }
+            for (int c = 0; c < 4; ++c)
+            {
+                block[i][c] = static_cast<uint8_t>(texel[c]);
+            }
+        }
+    }
+
+    void encodeBlockRows(const uint8_t * rgba, uint32_t width, uint32_t height, blockCompression::blockFormat format,
+                         uint32_t firstRow, uint32_t lastRow, uint8_t * out)
+    {
+        uint32_t blocksX = (width + 3) / 4;
+        size_t bytes = blockCompression::blockBytes(format);
+
+        for (uint32_t blockY = firstRow; blockY < lastRow; ++blockY)
+        {
+            for (uint32_t blockX = 0; blockX < blocksX; ++blockX)
+            {
+                uint8_t block[16][4];
+                loadBlock(rgba, width, height, blockX, blockY, block);
+
+                uint8_t * blockOut = out + (static_cast<size_t>(blockY) * blocksX + blockX) * bytes;
+                switch (format)
+                {
+                    case blockCompression::blockFormat::bc1:
+                        encodeBc1Block(block, blockOut);
+                        break;
+                    case blockCompression::blockFormat::bc3:
+                        encodeBc4AlphaBlock(block, blockOut);
+                        encodeBc1Block(block, blockOut + 8);
+                        break;
+                    case blockCompression::blockFormat::bc7:
+                        encodeBc7Block(block, blockOut);
+                        break;
+                }
+            }
+        }
+    }
+}
+
+size_t blockCompression::blockBytes(blockFormat format)
+{
+    return format == blockFormat::bc1 ? 8 : 16;
+}
+
+size_t blockCompression::encodedSize(uint32_t width, uint32_t height, blockFormat format)
+{
+    return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+std::vector<uint8_t> blockCompression::encode(const uint8_t * rgba,
+                                              uint32_t width,
+                                              uint32_t height,
+                                              blockFormat format,
+                                              unsigned threadCount)
+{
+    std::vector<uint8_t> blocks(encodedSize(width, height, format), 0);
+
+    uint32_t blocksY = (height + 3) / 4;
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = std::min(threadCount, blocksY);
+
+    // Every thread owns a contiguous band of block rows, so no synchronization is needed
+    std::vector<std::thread> threads;
+    uint32_t rowsPerThread = (blocksY + threadCount - 1) / threadCount;
+    for (uint32_t firstRow = rowsPerThread; firstRow < blocksY; firstRow += rowsPerThread)
+    {
+        uint32_t lastRow = std::min(firstRow + rowsPerThread, blocksY);
+        threads.emplace_back(encodeBlockRows, rgba, width, height, format, firstRow, lastRow, blocks.data());
+    }
+    encodeBlockRows(rgba, width, height, format, 0, std::min(rowsPerThread, blocksY), blocks.data());
+
+    for (std::thread & thread : threads)
+    {
+        thread.join();
+    }
+
+    return blocks;
+}
+
+void blockCompression::decode(const uint8_t * blocks,
+                              uint32_t width,
+                              uint32_t height,
+                              blockFormat format,
+                              std::vector<uint8_t> & rgba)
+{
+    rgba.assign(static_cast<size_t>(width) * height * 4, 0);
+
+    uint32_t blocksX = (width + 3) / 4;
+    uint32_t blocksY = (height + 3) / 4;
+    size_t bytes = blockBytes(format);
+
+    for (uint32_t blockY = 0; blockY < blocksY; ++blockY)
+    {
+        for (uint32_t blockX = 0; blockX < blocksX; ++blockX)
+        {
+            const uint8_t * blockIn = blocks + (static_cast<size_t>(blockY) * blocksX + blockX) * bytes;
+            uint8_t block[16][4];
+            switch (format)
+            {
+                case blockFormat::bc1:
+                    decodeBc1Block(blockIn, true, block);
+                    break;
+                case blockFormat::bc3:
+                    // The color half of BC3 is always in four color mode
+                    decodeBc1Block(blockIn + 8, false, block);
+                    decodeBc4AlphaBlock(blockIn, block);
+                    break;
+                case blockFormat::bc7:
+                    decodeBc7Block(blockIn, block);
+                    break;
+            }
+            storeBlock(block, width, height, blockX, blockY, rgba.data());
+        }
+    }
+}
+
+double blockCompression::psnr(const uint8_t * reference, const uint8_t * test, size_t texelCount)
+{
+    double squaredError = 0.0;
+    for (size_t i = 0; i < texelCount * 4; ++i)
+    {
+        double d = static_cast<double>(reference[i]) - static_cast<double>(test[i]);
+        squaredError += d * d;
+    }
+    if (squaredError == 0.0)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    double meanSquaredError = squaredError / static_cast<double>(texelCount * 4);
+    return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
@@ -0,0 +1,48 @@
+//
+//  blockCompression.hpp
+//  vulkanTesting
+//
+
+#ifndef blockCompression_hpp
+#define blockCompression_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CPU encoders and decoders for the BCn block formats we bake textures into.
+// All images are tightly packed RGBA8.  Partial 4x4 blocks at the right and
+// bottom edges are padded by repeating the last row/column.
+namespace blockCompression {
+
+    enum class blockFormat : uint32_t {
+        bc1 = 0, // RGB 5:6:5 endpoints, 4 bits per texel, opaque
+        bc3 = 1, // BC1 color plus a separate 8 bit alpha block, 8 bits per texel
+        bc7 = 2  // 8 bits per texel, encoded as mode 6 (single subset RGBA 7.7.7.7 + p-bit), any mode decodes
+    };
+
+    size_t blockBytes(blockFormat format);
+
+    size_t encodedSize(uint32_t width, uint32_t height, blockFormat format);
+
+    // Encode on threadCount threads, 0 means one per hardware thread
+    std::vector<uint8_t> encode(const uint8_t * rgba,
+                                uint32_t width,
+                                uint32_t height,
+                                blockFormat format,
+                                unsigned threadCount = 0);
+
+    // Decode back to RGBA8.  Used as the fallback when the device cannot sample the
+    // compressed format and to measure encoder quality.  Every BC7 mode is understood,
+    // so files from other encoders decode too.
+    void decode(const uint8_t * blocks,
+                uint32_t width,
+                uint32_t height,
+                blockFormat format,
+                std::vector<uint8_t> & rgba);
+
+    // Peak signal to noise ratio in dB over all four channels of two RGBA8 images
+    double psnr(const uint8_t * reference, const uint8_t * test, size_t texelCount);
+}
+
+#endif /* blockCompression_hpp */
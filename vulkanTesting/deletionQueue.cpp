@@ -0,0 +1,53 @@
+//
+//  deletionQueue.cpp
+//  vulkanTesting
+//
+
+#include "deletionQueue.hpp"
+
+#include <algorithm>
+#include <utility>
+
+deletionQueue::deletionQueue()
+{
+}
+
+void deletionQueue::push(uint64_t frame, std::function<void()> destroy)
+{
+    if (!_entries.empty())
+    {
+        frame = std::max(frame, _entries.back().frame);
+    }
+    _entries.push_back({frame, std::move(destroy)});
+}
+
+void deletionQueue::collect(uint64_t completedFrame)
+{
+    while (!_entries.empty() && _entries.front().frame <= completedFrame)
+    {
+        // popped first, a destroy may push more
+        std::function<void()> destroy = std::move(_entries.front().destroy);
+        _entries.pop_front();
+        destroy();
+    }
+}
+
+void deletionQueue::flush()
+{
+    while (!_entries.empty())
+    {
+        std::function<void()> destroy = std::move(_entries.front().destroy);
+        _entries.pop_front();
+        destroy();
+    }
+}
+
+size_t deletionQueue::size() const
+{
+    return _entries.size();
+}
+
+bool deletionQueue::empty() const
+{
+    return _entries.empty();
+}
@@ -0,0 +1,85 @@
+//
+//  dynamicResolution.cpp
+//  vulkanTesting
+//
+
+#include "dynamicResolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+dynamicResolution::dynamicResolution()
+{
+    reset();
+}
+
+dynamicResolution::dynamicResolution(const settings & someSettings) : _settings(someSettings)
+{
+    reset();
+}
+
+void dynamicResolution::reset()
+{
+    _scale = _settings.maxScale;
+    _measured = false;
+    _smoothedMilliseconds = 0.0f;
+    _error = 0.0f;
+    _previousError = 0.0f;
+}
+
+float dynamicResolution::update(float gpuMilliseconds)
+{
+    float error = 0.0f;
+    if (!_measured)
+    {
+        // nothing to take a difference with yet, so only the integral term acts
+        _measured = true;
+        _smoothedMilliseconds = gpuMilliseconds;
+        error = (_settings.targetMilliseconds - _smoothedMilliseconds) / _settings.targetMilliseconds;
+        _error = error;
+        _previousError = error;
+    }
+    else
+    {
+        _smoothedMilliseconds += _settings.smoothing * (gpuMilliseconds - _smoothedMilliseconds);
+        error = (_settings.targetMilliseconds - _smoothedMilliseconds) / _settings.targetMilliseconds;
+    }
+
+    float change = _settings.proportional * (error - _error) +
+                   _settings.integral * error +
+                   _settings.derivative * (error - 2.0f * _error + _previousError);
+    _previousError = _error;
+    _error = error;
+
+    _scale = std::min(std::max(_scale + change, _settings.minScale), _settings.maxScale);
+    return _scale;
+}
+
+float dynamicResolution::scale() const
+{
+    return _scale;
+}
+
+uint32_t dynamicResolution::step(uint32_t stepCount) const
+{
+    if (stepCount < 2 || _settings.maxScale <= _settings.minScale)
+    {
+        return 0;
+    }
+    float position = (_scale - _settings.minScale) / (_settings.maxScale - _settings.minScale);
+    return static_cast<uint32_t>(std::lround(position * (stepCount - 1)));
+}
+
+float dynamicResolution::stepScale(uint32_t step, uint32_t stepCount) const
+{
+    if (stepCount < 2)
+    {
+        return _settings.maxScale;
+    }
+    return _settings.minScale + (_settings.maxScale - _settings.minScale) * step / (stepCount - 1);
+}
+
+const dynamicResolution::settings & dynamicResolution::getSettings() const
+{
+    return _settings;
+}
@@ -0,0 +1,60 @@
+//
+//  dynamicResolution.hpp
+//  vulkanTesting
+//
+
+#ifndef dynamicResolution_hpp
+#define dynamicResolution_hpp
+
+#include <cstdint>
+
+// Render scale from measured GPU frame time.  A PID controller in velocity form:
+// every frame the scale moves by the change the three terms ask for, so clamping
+// the scale to its range cannot wind the integral up.  The error is the distance
+// from the target as a fraction of it, positive when there is time to spare.
+//
+// The scale applies to each axis.  Callers that can only render a few sizes use
+// step() and stepScale() to snap to evenly spaced ones.
+class dynamicResolution
+{
+public:
+    struct settings {
+        float targetMilliseconds = 14.0f; // leaves headroom under a 60 Hz frame
+        float minScale = 0.5f;
+        float maxScale = 1.0f;
+        float proportional = 0.1f;
+        float integral = 0.05f;
+        float derivative = 0.02f;
+        // weight of the newest measurement in the smoothed frame time
+        float smoothing = 0.25f;
+    };
+
+    dynamicResolution();
+
+    explicit dynamicResolution(const settings & someSettings);
+
+    // Back to maxScale, forgetting every measurement
+    void reset();
+
+    // One measured frame, returns the new scale
+    float update(float gpuMilliseconds);
+
+    float scale() const;
+
+    // Nearest of stepCount scales spread evenly from minScale to maxScale
+    uint32_t step(uint32_t stepCount) const;
+
+    float stepScale(uint32_t step, uint32_t stepCount) const;
+
+    const settings & getSettings() const;
+
+private:
+    settings _settings;
+    float _scale;
+    bool _measured;
+    float _smoothedMilliseconds;
+    float _error;
+    float _previousError;
+};
+
+#endif /* dynamicResolution_hpp */
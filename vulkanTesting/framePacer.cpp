@@ -0,0 +1,186 @@
+//
+//  framePacer.cpp
+//  vulkanTesting
+//
+
+#include "framePacer.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    void smooth(float & average, bool & measured, float sample, float weight)
+    {
+        average = measured ? average + weight * (sample - average) : sample;
+        measured = true;
+    }
+}
+
+framePacer::framePacer()
+{
+    reset();
+}
+
+framePacer::framePacer(const settings & someSettings) : _settings(someSettings)
+{
+    reset();
+}
+
+void framePacer::reset()
+{
+    _submitted.clear();
+    _lastFinish = 0.0;
+    _lastInput = 0.0;
+    _sampledInput = false;
+    _cpuMilliseconds = 0.0f;
+    _gpuMilliseconds = 0.0f;
+    _measuredCpu = false;
+    _measuredGpu = false;
+    _timestamps = false;
+}
+
+VkPresentModeKHR framePacer::choosePresentMode(const std::vector<VkPresentModeKHR> & availableModes) const
+{
+    std::vector<VkPresentModeKHR> preferred;
+    switch (_settings.latencyMode)
+    {
+        case lowLatency:
+            // scan out starts as soon as the frame is done, at the cost of tearing
+            preferred = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+            break;
+        case throughput:
+            // the GPU never waits for the display and nothing tears
+            preferred = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR};
+            break;
+        case powerSave:
+            break;
+    }
+
+    for (VkPresentModeKHR mode : preferred)
+    {
+        if (std::find(availableModes.begin(), availableModes.end(), mode) != availableModes.end())
+        {
+            return mode;
+        }
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+uint32_t framePacer::chooseImageCount(const VkSurfaceCapabilitiesKHR & capabilities) const
+{
+    uint32_t imageCount = capabilities.minImageCount;
+    if (_settings.latencyMode == lowLatency)
+    {
+        imageCount += 1;
+    }
+    else if (_settings.latencyMode == throughput)
+    {
+        imageCount += 2;
+    }
+
+    // A maxImageCount of 0 means no limit besides memory
+    if (capabilities.maxImageCount > 0)
+    {
+        imageCount = std::min(imageCount, capabilities.maxImageCount);
+    }
+    return imageCount;
+}
+
+void framePacer::frameCompleted(double now, bool waited)
+{
+    if (_submitted.empty())
+    {
+        return;
+    }
+
+    // The GPU started the frame when it was submitted or when the one before finished
+    double start = std::max(_submitted.front(), _lastFinish);
+    _submitted.pop_front();
+
+    if (waited)
+    {
+        if (!_timestamps)
+        {
+            smooth(_gpuMilliseconds, _measuredGpu, static_cast<float>((now - start) * 1000.0), _settings.smoothing);
+        }
+        _lastFinish = now;
+    }
+    else
+    {
+        // finished some time before now, assume it took as long as usual
+        _lastFinish = std::min(now, start + _gpuMilliseconds / 1000.0);
+    }
+}
+
+void framePacer::gpuTime(float milliseconds)
+{
+    _timestamps = true;
+    smooth(_gpuMilliseconds, _measuredGpu, milliseconds, _settings.smoothing);
+}
+
+double framePacer::inputTime(double now) const
+{
+    if (_settings.latencyMode == throughput)
+    {
+        return now;
+    }
+
+    // When the GPU finishes the frames in flight if it runs them back to back.
+    // Submitting then, not earlier, keeps the frame from waiting in a queue.
+    double idle = _lastFinish;
+    for (double submitted : _submitted)
+    {
+        idle = std::max(submitted, idle) + _gpuMilliseconds / 1000.0;
+    }
+
+    double time = std::max(now, idle - (_cpuMilliseconds + _settings.marginMilliseconds) / 1000.0);
+    if (_settings.latencyMode == powerSave && _sampledInput)
+    {
+        time = std::max(time, _lastInput + _settings.powerSaveFrameMilliseconds / 1000.0);
+    }
+    return time;
+}
+
+void framePacer::inputSampled(double now)
+{
+    _lastInput = now;
+    _sampledInput = true;
+}
+
+void framePacer::frameSubmitted(double now)
+{
+    if (_sampledInput)
+    {
+        smooth(_cpuMilliseconds, _measuredCpu, static_cast<float>((now - _lastInput) * 1000.0), _settings.smoothing);
+    }
+    _submitted.push_back(now);
+}
+
+float framePacer::cpuMilliseconds() const
+{
+    return _cpuMilliseconds;
+}
+
+float framePacer::gpuMilliseconds() const
+{
+    return _gpuMilliseconds;
+}
+
+const framePacer::settings & framePacer::getSettings() const
+{
+    return _settings;
+}
+
+const char * framePacer::modeName(mode aMode)
+{
+    switch (aMode)
+    {
+        case lowLatency:
+            return "low latency";
+        case throughput:
+            return "throughput";
+        case powerSave:
+            return "power save";
+    }
+    return "unknown";
+}
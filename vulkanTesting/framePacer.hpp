@@ -0,0 +1,95 @@
+//
+//  framePacer.hpp
+//  vulkanTesting
+//
+
+#ifndef framePacer_hpp
+#define framePacer_hpp
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+// Latency policy: the present mode and swap chain length of a mode, and how long
+// the CPU waits before sampling input for the next frame.
+//
+//   - lowLatency prefers IMMEDIATE with one spare image and starts each frame as
+//     late as it can while still submitting before the GPU runs out of work, so
+//     input is never older than the frame in flight
+//   - throughput prefers MAILBOX with two spare images and never waits, the GPU
+//     always has the next frame queued
+//   - powerSave uses FIFO with the fewest images and paces like lowLatency,
+//     capped at a frame rate below the display's
+//
+// Times are seconds on any one clock.  The GPU time of a frame comes from
+// timestamps when the caller has them, otherwise from when waits on its fence
+// returned.
+class framePacer
+{
+public:
+    enum mode {
+        lowLatency,
+        throughput,
+        powerSave
+    };
+
+    struct settings {
+        mode latencyMode = lowLatency;
+        // slack before the GPU is predicted to run dry, covers sleep overshoot and jitter
+        float marginMilliseconds = 1.0f;
+        // weight of the newest measurement in the smoothed CPU and GPU times
+        float smoothing = 0.1f;
+        float powerSaveFrameMilliseconds = 1000.0f / 30.0f;
+    };
+
+    framePacer();
+
+    explicit framePacer(const settings & someSettings);
+
+    // Forgets every frame and measurement
+    void reset();
+
+    // First of the mode's present modes the surface has, FIFO is always there
+    VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR> & availableModes) const;
+
+    uint32_t chooseImageCount(const VkSurfaceCapabilitiesKHR & capabilities) const;
+
+    // The oldest frame in flight has finished.  waited is true when the caller
+    // blocked on its fence until now, so now is when the GPU finished it.
+    void frameCompleted(double now, bool waited);
+
+    // Measured GPU time of the frame about to be passed to frameCompleted
+    void gpuTime(float milliseconds);
+
+    // When to sample input for the next frame, now or later.  The caller sleeps
+    // until then, then calls inputSampled.
+    double inputTime(double now) const;
+
+    void inputSampled(double now);
+
+    void frameSubmitted(double now);
+
+    float cpuMilliseconds() const;
+
+    float gpuMilliseconds() const;
+
+    const settings & getSettings() const;
+
+    static const char * modeName(mode aMode);
+
+private:
+    settings _settings;
+    std::deque<double> _submitted; // frames in flight, oldest first
+    double _lastFinish;
+    double _lastInput;
+    bool _sampledInput;
+    float _cpuMilliseconds;
+    float _gpuMilliseconds;
+    bool _measuredCpu;
+    bool _measuredGpu;
+    bool _timestamps; // fence waits no longer update the GPU time
+};
+
+#endif /* framePacer_hpp */
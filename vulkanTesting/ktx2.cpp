@@ -0,0 +1,320 @@
+//
+//  ktx2.cpp
+//  vulkanTesting
+//
+
+#include "ktx2.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+    struct fileHeader {
+        uint8_t identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+
+    struct levelIndex {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    // Khronos data format descriptor constants
+    const uint8_t KHR_DF_MODEL_RGBSDA = 1;
+    const uint8_t KHR_DF_MODEL_BC1A = 128;
+    const uint8_t KHR_DF_MODEL_BC3 = 130;
+    const uint8_t KHR_DF_MODEL_BC7 = 134;
+    const uint8_t KHR_DF_PRIMARIES_BT709 = 1;
+    const uint8_t KHR_DF_TRANSFER_LINEAR = 1;
+    const uint8_t KHR_DF_TRANSFER_SRGB = 2;
+
+    struct dfdSample {
+        uint16_t bitOffset;
+        uint8_t bitLength; // minus one
+        uint8_t channelType;
+        uint32_t upper;
+    };
+
+    // Basic descriptor block, one sample per channel (or per BC sub-block)
+    std::vector<uint32_t> buildDataFormatDescriptor(VkFormat format)
+    {
+        uint8_t model = KHR_DF_MODEL_RGBSDA;
+        uint8_t blockDimension = 0;
+        uint8_t bytesPlane0 = 4;
+        std::vector<dfdSample> samples;
+
+        blockCompression::blockFormat blockFormat;
+        if (ktx2::blockFormatOf(format, blockFormat))
+        {
+            blockDimension = 3; // 4x4, stored minus one
+            bytesPlane0 = static_cast<uint8_t>(blockCompression::blockBytes(blockFormat));
+            switch (blockFormat)
+            {
+                case blockCompression::blockFormat::bc1:
+                    model = KHR_DF_MODEL_BC1A;
+                    samples.push_back({ 0, 63, 0, 0xffffffffu });
+                    break;
+                case blockCompression::blockFormat::bc3:
+                    model = KHR_DF_MODEL_BC3;
+                    samples.push_back({ 0, 63, 15, 0xffffffffu });
+                    samples.push_back({ 64, 63, 0, 0xffffffffu });
+                    break;
+                case blockCompression::blockFormat::bc7:
+                    model = KHR_DF_MODEL_BC7;
+                    samples.push_back({ 0, 127, 0, 0xffffffffu });
+                    break;
+            }
+        }
+        else
+        {
+            // R, G, B, A bytes.  Alpha is never sRGB encoded, so it carries the linear qualifier.
+            const uint8_t alphaChannel = ktx2::isSrgb(format) ? static_cast<uint8_t>(15 | 0x80) : 15;
+            samples.push_back({ 0, 7, 0, 255 });
+            samples.push_back({ 8, 7, 1, 255 });
+            samples.push_back({ 16, 7, 2, 255 });
+            samples.push_back({ 24, 7, alphaChannel, 255 });
+        }
+
+        uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+        std::vector<uint32_t> words;
+        words.push_back(4 + blockSize);                                  // dfdTotalSize
+        words.push_back(0);                                              // vendorId, descriptorType
+        words.push_back(2 | (blockSize << 16));                          // versionNumber, descriptorBlockSize
+        words.push_back(model |
+                        (KHR_DF_PRIMARIES_BT709 << 8) |
+                        ((ktx2::isSrgb(format) ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16)); // flags = 0
+        words.push_back(blockDimension | (blockDimension << 8));         // texelBlockDimension0..3
+        words.push_back(bytesPlane0);                                    // bytesPlane0..3
+        words.push_back(0);                                              // bytesPlane4..7
+        for (const dfdSample & sample : samples)
+        {
+            words.push_back(sample.bitOffset | (sample.bitLength << 16) | (static_cast<uint32_t>(sample.channelType) << 24));
+            words.push_back(0); // samplePosition
+            words.push_back(0); // sampleLower
+            words.push_back(sample.upper);
+        }
+        return words;
+    }
+
+    uint64_t alignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+bool ktx2::texture::open(const std::string & filePath)
+{
+    if (!_file.open(filePath))
+    {
+        return false;
+    }
+    _data = _file.data();
+    _size = _file.size();
+    return parse();
+}
+
+bool ktx2::texture::open(const void * data, size_t size)
+{
+    _file.close();
+    _data = static_cast<const uint8_t *>(data);
+    _size = size;
+    return parse();
+}
+
+bool ktx2::texture::parse()
+{
+    _levels.clear();
+    if (_size < sizeof(fileHeader))
+    {
+        _file.close();
+        return false;
+    }
+
+    const fileHeader * header = reinterpret_cast<const fileHeader *>(_data);
+    if (memcmp(header->identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0 ||
+        header->pixelWidth == 0 || header->pixelHeight == 0 || header->pixelDepth > 1 ||
+        header->layerCount > 1 || header->faceCount != 1 ||
+        header->supercompressionScheme != 0)
+    {
+        _file.close();
+        return false;
+    }
+
+    // A level count of zero asks the loader to generate mips, we only load what is stored
+    uint32_t levelCount = std::max(1u, header->levelCount);
+    if (sizeof(fileHeader) + levelCount * sizeof(levelIndex) > _size)
+    {
+        _file.close();
+        return false;
+    }
+
+    const levelIndex * index = reinterpret_cast<const levelIndex *>(_data + sizeof(fileHeader));
+    for (uint32_t i = 0; i < levelCount; ++i)
+    {
+        if (index[i].byteOffset + index[i].byteLength > _size)
+        {
+            _file.close();
+            _levels.clear();
+            return false;
+        }
+
+        level mip;
+        mip.width = std::max(1u, header->pixelWidth >> i);
+        mip.height = std::max(1u, header->pixelHeight >> i);
+        mip.offset = index[i].byteOffset;
+        mip.size = index[i].byteLength;
+        _levels.push_back(mip);
+    }
+
+    _format = static_cast<VkFormat>(header->vkFormat);
+    _width = header->pixelWidth;
+    _height = header->pixelHeight;
+    return true;
+}
+
+VkFormat ktx2::texture::format() const
+{
+    return _format;
+}
+
+uint32_t ktx2::texture::width() const
+{
+    return _width;
+}
+
+uint32_t ktx2::texture::height() const
+{
+    return _height;
+}
+
+const std::vector<ktx2::level> & ktx2::texture::levels() const
+{
+    return _levels;
+}
+
+const uint8_t * ktx2::texture::data() const
+{
+    return _data;
+}
+
+bool ktx2::write(const std::string & filePath,
+                 VkFormat format,
+                 uint32_t width,
+                 uint32_t height,
+                 const std::vector<std::vector<uint8_t>> & levels)
+{
+    blockCompression::blockFormat blockFormat;
+    bool blockCompressed = blockFormatOf(format, blockFormat);
+
+    // Level data must be aligned to lcm(texel block size, 4)
+    uint64_t alignment = blockCompressed ? blockCompression::blockBytes(blockFormat) : 4;
+
+    std::vector<uint32_t> dfd = buildDataFormatDescriptor(format);
+
+    fileHeader header = {};
+    memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    header.vkFormat = static_cast<uint32_t>(format);
+    header.typeSize = 1;
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.faceCount = 1;
+    header.levelCount = static_cast<uint32_t>(levels.size());
+    header.dfdByteOffset = static_cast<uint32_t>(sizeof(fileHeader) + levels.size() * sizeof(levelIndex));
+    header.dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+
+    // The spec stores the smallest level first
+    std::vector<levelIndex> index(levels.size());
+    uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+    for (size_t i = levels.size(); i-- > 0;)
+    {
+        offset = alignUp(offset, alignment);
+        index[i].byteOffset = offset;
+        index[i].byteLength = levels[i].size();
+        index[i].uncompressedByteLength = levels[i].size();
+        offset += levels[i].size();
+    }
+
+    FILE * file = fopen(filePath.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(index.data(), sizeof(levelIndex), index.size(), file) == index.size() &&
+                   fwrite(dfd.data(), sizeof(uint32_t), dfd.size(), file) == dfd.size();
+
+    uint64_t position = header.dfdByteOffset + header.dfdByteLength;
+    const uint8_t zeros[16] = {};
+    for (size_t i = levels.size(); written && i-- > 0;)
+    {
+        size_t padding = static_cast<size_t>(index[i].byteOffset - position);
+        written = fwrite(zeros, 1, padding, file) == padding &&
+                  fwrite(levels[i].data(), 1, levels[i].size(), file) == levels[i].size();
+        position = index[i].byteOffset + index[i].byteLength;
+    }
+
+    return (fclose(file) == 0) && written;
+}
+
+VkFormat ktx2::vulkanFormat(blockCompression::blockFormat format, bool srgb)
+{
+    switch (format)
+    {
+        case blockCompression::blockFormat::bc1:
+            return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        case blockCompression::blockFormat::bc3:
+            return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+        case blockCompression::blockFormat::bc7:
+            return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+bool ktx2::blockFormatOf(VkFormat format, blockCompression::blockFormat & blockFormat)
+{
+    switch (format)
+    {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            blockFormat = blockCompression::blockFormat::bc1;
+            return true;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            blockFormat = blockCompression::blockFormat::bc3;
+            return true;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            blockFormat = blockCompression::blockFormat::bc7;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool ktx2::isSrgb(VkFormat format)
+{
+    return format == VK_FORMAT_R8G8B8A8_SRGB ||
+           format == VK_FORMAT_BC1_RGB_SRGB_BLOCK ||
+           format == VK_FORMAT_BC3_SRGB_BLOCK ||
+           format == VK_FORMAT_BC7_SRGB_BLOCK;
+}
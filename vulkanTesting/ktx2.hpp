@@ -0,0 +1,78 @@
+//
+//  ktx2.hpp
+//  vulkanTesting
+//
+
+#ifndef ktx2_hpp
+#define ktx2_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "blockCompression.hpp"
+#include "mappedFile.hpp"
+
+// Minimal KTX2 support: single layer, single face 2D textures with a full or
+// partial mip chain and no supercompression.  Enough for what textureBaker writes.
+namespace ktx2 {
+
+    struct level {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset; // from the start of the file
+        uint64_t size;
+    };
+
+    class texture
+    {
+    public:
+
+        // Map a .ktx2 file.  Returns false if it is missing or not a file we can read.
+        bool open(const std::string & filePath);
+
+        // Use a file that is already in memory.  The caller keeps it alive.
+        bool open(const void * data, size_t size);
+
+        VkFormat format() const;
+
+        uint32_t width() const;
+
+        uint32_t height() const;
+
+        // levels()[0] is the base level
+        const std::vector<level> & levels() const;
+
+        const uint8_t * data() const;
+
+    private:
+        bool parse();
+
+        mappedFile _file;
+        const uint8_t * _data = nullptr;
+        size_t _size = 0;
+        VkFormat _format = VK_FORMAT_UNDEFINED;
+        uint32_t _width = 0;
+        uint32_t _height = 0;
+        std::vector<level> _levels;
+    };
+
+    // Write levels (base level first) as a KTX2 file.  Only the formats returned by
+    // vulkanFormat() and R8G8B8A8 are supported.
+    bool write(const std::string & filePath,
+               VkFormat format,
+               uint32_t width,
+               uint32_t height,
+               const std::vector<std::vector<uint8_t>> & levels);
+
+    VkFormat vulkanFormat(blockCompression::blockFormat format, bool srgb);
+
+    // Returns false for formats that are not block compressed
+    bool blockFormatOf(VkFormat format, blockCompression::blockFormat & blockFormat);
+
+    bool isSrgb(VkFormat format);
+}
+
+#endif /* ktx2_hpp */
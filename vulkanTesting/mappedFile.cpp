@@ -0,0 +1,105 @@
+//
+//  mappedFile.cpp
+//  vulkanTesting
+//
+
+#include "mappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+mappedFile::mappedFile() :
+_data(nullptr),
+_size(0)
+{
+
+}
+
+mappedFile::mappedFile(mappedFile && other) :
+_data(other._data),
+_size(other._size)
+{
+    other._data = nullptr;
+    other._size = 0;
+}
+
+mappedFile & mappedFile::operator=(mappedFile && other)
+{
+    if (this != &other)
+    {
+        close();
+        _data = other._data;
+        _size = other._size;
+        other._data = nullptr;
+        other._size = 0;
+    }
+    return *this;
+}
+
+mappedFile::~mappedFile()
+{
+    close();
+}
+
+bool mappedFile::open(const std::string & filePath)
+{
+    close();
+
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) != 0 || fileInfo.st_size <= 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    size_t fileSize = static_cast<size_t>(fileInfo.st_size);
+    void * mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // We read every mapped file front to back straight into a staging buffer
+    madvise(mapping, fileSize, MADV_SEQUENTIAL);
+
+    _data = mapping;
+    _size = fileSize;
+    return true;
+}
+
+void mappedFile::close()
+{
+    if (_data != nullptr)
+    {
+        munmap(_data, _size);
+        _data = nullptr;
+        _size = 0;
+    }
+}
+
+bool mappedFile::isOpen() const
+{
+    return _data != nullptr;
+}
+
+const uint8_t * mappedFile::data() const
+{
+    return static_cast<const uint8_t *>(_data);
+}
+
+size_t mappedFile::size() const
+{
+    return _size;
+}
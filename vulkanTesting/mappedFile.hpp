@@ -0,0 +1,47 @@
+//
+//  mappedFile.hpp
+//  vulkanTesting
+//
+
+#ifndef mappedFile_hpp
+#define mappedFile_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file.  The mapping is released when
+// the object is destroyed, so pointers from data() must not outlive it.
+class mappedFile
+{
+public:
+
+    mappedFile();
+
+    mappedFile(mappedFile && other);
+
+    mappedFile & operator=(mappedFile && other);
+
+    mappedFile(const mappedFile &) = delete;
+
+    mappedFile & operator=(const mappedFile &) = delete;
+
+    ~mappedFile();
+
+    // Returns false if the file does not exist or could not be mapped
+    bool open(const std::string & filePath);
+
+    void close();
+
+    bool isOpen() const;
+
+    const uint8_t * data() const;
+
+    size_t size() const;
+
+private:
+    void * _data;
+    size_t _size;
+};
+
+#endif /* mappedFile_hpp */
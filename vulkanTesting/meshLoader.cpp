@@ -0,0 +1,992 @@
+//
+//  meshLoader.cpp
+//  vulkanTesting
+//
+
+#include "meshLoader.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    const uint32_t emptySlot = 0xFFFFFFFFu;
+
+    uint64_t hashVertex(const Vertex & vertex)
+    {
+        // Mix the raw float bits, 64 bits at a time
+        uint64_t words[4];
+        memcpy(words, &vertex, sizeof(words));
+        uint64_t hash = 0x9E3779B97F4A7C15ull;
+        for (uint64_t word : words)
+        {
+            hash ^= word;
+            hash *= 0xBF58476D1CE4E5B9ull;
+            hash ^= hash >> 31;
+        }
+        return hash;
+    }
+
+    bool endsWith(const std::string & name, const char * suffix)
+    {
+        size_t length = strlen(suffix);
+        if (name.size() < length)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < length; ++i)
+        {
+            if (tolower(static_cast<unsigned char>(name[name.size() - length + i])) != suffix[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // ---- OBJ ----
+
+    const char * skipSpaces(const char * p)
+    {
+        while (*p == ' ' || *p == '\t' || *p == '\r')
+        {
+            ++p;
+        }
+        return p;
+    }
+
+    const char * nextLine(const char * p)
+    {
+        while (*p != '\0' && *p != '\n')
+        {
+            ++p;
+        }
+        return *p == '\n' ? p + 1 : p;
+    }
+
+    // OBJ indices are 1 based, negative ones count back from the end.  Returns -1 if out of range.
+    long resolveObjIndex(long index, size_t count)
+    {
+        long resolved = index > 0 ? index - 1 : static_cast<long>(count) + index;
+        return (index == 0 || resolved < 0 || resolved >= static_cast<long>(count)) ? -1 : resolved;
+    }
+
+    // ---- glTF ----
+
+    // Just enough JSON for glTF.  Objects keep their keys in order next to the values.
+    struct json {
+        enum kind { null, boolean, number, string, array, object };
+
+        kind type = null;
+        bool flag = false;
+        double value = 0.0;
+        std::string text;
+        std::vector<std::string> keys;
+        std::vector<json> items;
+
+        const json * find(const char * key) const
+        {
+            for (size_t i = 0; i < keys.size(); ++i)
+            {
+                if (keys[i] == key)
+                {
+                    return &items[i];
+                }
+            }
+            return nullptr;
+        }
+
+        double numberOr(const char * key, double fallback) const
+        {
+            const json * member = find(key);
+            return member && member->type == number ? member->value : fallback;
+        }
+
+        size_t size() const
+        {
+            return type == array ? items.size() : 0;
+        }
+    };
+
+    class jsonParser
+    {
+    public:
+        jsonParser(const char * begin, const char * end) :
+        _p(begin),
+        _end(end)
+        {
+
+        }
+
+        json parse()
+        {
+            json root = parseValue(0);
+            skipWhitespace();
+            if (_p != _end)
+            {
+                fail();
+            }
+            return root;
+        }
+
+    private:
+        [[noreturn]] void fail()
+        {
+            throw std::runtime_error("failed to parse glTF json!");
+        }
+
+        void skipWhitespace()
+        {
+            while (_p < _end && (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r'))
+            {
+                ++_p;
+            }
+        }
+
+        bool consume(const char * literal)
+        {
+            size_t length = strlen(literal);
+            if (static_cast<size_t>(_end - _p) >= length && memcmp(_p, literal, length) == 0)
+            {
+                _p += length;
+                return true;
+            }
+            return false;
+        }
+
+        void appendUtf8(std::string & out, unsigned codePoint)
+        {
+            if (codePoint < 0x80)
+            {
+                out += static_cast<char>(codePoint);
+            }
+            else if (codePoint < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (codePoint >> 6));
+                out += static_cast<char>(0x80 | (codePoint & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xE0 | (codePoint >> 12));
+                out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (codePoint & 0x3F));
+            }
+        }
+
+        std::string parseString()
+        {
+            std::string out;
+            ++_p; // opening quote
+            while (_p < _end && *_p != '"')
+            {
+                char c = *_p++;
+                if (c != '\\')
+                {
+                    out += c;
+                    continue;
+                }
+                if (_p >= _end)
+                {
+                    fail();
+                }
+                char escape = *_p++;
+                switch (escape)
+                {
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'n': out += '\n'; break;
+                    case 'r': out += '\r'; break;
+                    case 't': out += '\t'; break;
+                    case 'u':
+                    {
+                        if (_end - _p < 4)
+                        {
+                            fail();
+                        }
+                        appendUtf8(out, static_cast<unsigned>(strtoul(std::string(_p, 4).c_str(), nullptr, 16)));
+                        _p += 4;
+                        break;
+                    }
+                    default: out += escape; break;
+                }
+            }
+            if (_p >= _end)
+            {
+                fail();
+            }
+            ++_p; // closing quote
+            return out;
+        }
+
+        json parseValue(int depth)
+        {
+            if (depth > 64)
+            {
+                fail();
+            }
+            skipWhitespace();
+            if (_p >= _end)
+            {
+                fail();
+            }
+
+            json result;
+            if (*_p == '{')
+            {
+                result.type = json::object;
+                ++_p;
+                skipWhitespace();
+                if (_p < _end && *_p == '}')
+                {
+                    ++_p;
+                    return result;
+                }
+                while (true)
+                {
+                    skipWhitespace();
+                    if (_p >= _end || *_p != '"')
+                    {
+                        fail();
+                    }
+                    result.keys.push_back(parseString());
+                    skipWhitespace();
+                    if (_p >= _end || *_p++ != ':')
+                    {
+                        fail();
+                    }
+                    result.items.push_back(parseValue(depth + 1));
+                    skipWhitespace();
+                    if (_p < _end && *_p == ',')
+                    {
+                        ++_p;
+                        continue;
+                    }
+                    if (_p < _end && *_p == '}')
+                    {
+                        ++_p;
+                        return result;
+                    }
+                    fail();
+                }
+            }
+            if (*_p == '[')
+            {
+                result.type = json::array;
+                ++_p;
+                skipWhitespace();
+                if (_p < _end && *_p == ']')
+                {
+                    ++_p;
+                    return result;
+                }
+                while (true)
+                {
+                    result.items.push_back(parseValue(depth + 1));
+                    skipWhitespace();
+                    if (_p < _end && *_p == ',')
+                    {
+                        ++_p;
+                        continue;
+                    }
+                    if (_p < _end && *_p == ']')
+                    {
+                        ++_p;
+                        return result;
+                    }
+                    fail();
+                }
+            }
+            if (*_p == '"')
+            {
+                result.type = json::string;
+                result.text = parseString();
+                return result;
+            }
+            if (consume("true"))
+            {
+                result.type = json::boolean;
+                result.flag = true;
+                return result;
+            }
+            if (consume("false"))
+            {
+                result.type = json::boolean;
+                return result;
+            }
+            if (consume("null"))
+            {
+                return result;
+            }
+
+            // Numbers: copy out so strtod cannot run past the buffer
+            const char * start = _p;
+            while (_p < _end && (isdigit(static_cast<unsigned char>(*_p)) || *_p == '-' || *_p == '+' || *_p == '.' || *_p == 'e' || *_p == 'E'))
+            {
+                ++_p;
+            }
+            if (_p == start)
+            {
+                fail();
+            }
+            result.type = json::number;
+            result.value = strtod(std::string(start, _p).c_str(), nullptr);
+            return result;
+        }
+
+        const char * _p;
+        const char * _end;
+    };
+
+    bool decodeBase64(const std::string & text, size_t start, std::vector<uint8_t> & bytes)
+    {
+        uint32_t accumulator = 0;
+        int bits = 0;
+        for (size_t i = start; i < text.size() && text[i] != '='; ++i)
+        {
+            char c = text[i];
+            int value;
+            if (c >= 'A' && c <= 'Z') value = c - 'A';
+            else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') value = c - '0' + 52;
+            else if (c == '+') value = 62;
+            else if (c == '/') value = 63;
+            else return false;
+
+            accumulator = (accumulator << 6) | static_cast<uint32_t>(value);
+            bits += 6;
+            if (bits >= 8)
+            {
+                bits -= 8;
+                bytes.push_back(static_cast<uint8_t>(accumulator >> bits));
+            }
+        }
+        return true;
+    }
+
+    struct accessorView {
+        const uint8_t * data = nullptr;
+        size_t count = 0;
+        size_t stride = 0;
+        int componentType = 0;
+        int components = 0;
+        bool normalized = false;
+    };
+
+    size_t componentSize(int componentType)
+    {
+        switch (componentType)
+        {
+            case 5120: case 5121: return 1; // BYTE, UNSIGNED_BYTE
+            case 5122: case 5123: return 2; // SHORT, UNSIGNED_SHORT
+            case 5125: case 5126: return 4; // UNSIGNED_INT, FLOAT
+            default: return 0;
+        }
+    }
+
+    int componentCount(const std::string & type)
+    {
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2") return 2;
+        if (type == "VEC3") return 3;
+        if (type == "VEC4") return 4;
+        return 0;
+    }
+
+    accessorView accessor(const json & document, const std::vector<std::vector<uint8_t>> & buffers, size_t index)
+    {
+        const json * accessors = document.find("accessors");
+        const json * bufferViews = document.find("bufferViews");
+        if (!accessors || index >= accessors->size() || !bufferViews)
+        {
+            throw std::runtime_error("glTF accessor out of range!");
+        }
+        const json & source = accessors->items[index];
+        const json * viewIndex = source.find("bufferView");
+        if (!viewIndex || source.find("sparse"))
+        {
+            throw std::runtime_error("glTF sparse accessors are not supported!");
+        }
+        size_t viewSlot = static_cast<size_t>(viewIndex->value);
+        if (viewSlot >= bufferViews->size())
+        {
+            throw std::runtime_error("glTF buffer view out of range!");
+        }
+        const json & view = bufferViews->items[viewSlot];
+        size_t bufferSlot = static_cast<size_t>(view.numberOr("buffer", 0));
+        if (bufferSlot >= buffers.size())
+        {
+            throw std::runtime_error("glTF buffer out of range!");
+        }
+        const std::vector<uint8_t> & buffer = buffers[bufferSlot];
+
+        const json * type = source.find("type");
+        const json * normalized = source.find("normalized");
+
+        accessorView result;
+        result.componentType = static_cast<int>(source.numberOr("componentType", 0));
+        result.components = type ? componentCount(type->text) : 0;
+        result.count = static_cast<size_t>(source.numberOr("count", 0));
+        result.normalized = normalized && normalized->flag;
+
+        size_t elementSize = componentSize(result.componentType) * static_cast<size_t>(result.components);
+        if (elementSize == 0)
+        {
+            throw std::runtime_error("glTF accessor has an unknown type!");
+        }
+        result.stride = static_cast<size_t>(view.numberOr("byteStride", 0));
+        if (result.stride == 0)
+        {
+            result.stride = elementSize;
+        }
+
+        size_t offset = static_cast<size_t>(view.numberOr("byteOffset", 0) + source.numberOr("byteOffset", 0));
+        size_t viewEnd = static_cast<size_t>(view.numberOr("byteOffset", 0) + view.numberOr("byteLength", 0));
+        if (result.count > 0 &&
+            (viewEnd > buffer.size() || offset + result.stride * (result.count - 1) + elementSize > viewEnd))
+        {
+            throw std::runtime_error("glTF accessor runs past its buffer!");
+        }
+        result.data = buffer.data() + offset;
+        return result;
+    }
+
+    bool isFloat(const accessorView & view)
+    {
+        return view.componentType == 5126;
+    }
+
+    // UNSIGNED_BYTE or UNSIGNED_SHORT read as [0, 1]
+    bool isUnsignedNormalized(const accessorView & view)
+    {
+        return view.normalized && (view.componentType == 5121 || view.componentType == 5123);
+    }
+
+    // The accessor types glTF 2.0 allows for the attributes and indices we read;
+    // anything else would be read as garbage rather than converted
+    void validateAttributes(const accessorView & positions, const accessorView * texCoords, const accessorView * colors)
+    {
+        if (positions.components != 3 || !isFloat(positions))
+        {
+            throw std::runtime_error("glTF POSITION must be a float VEC3!");
+        }
+        if (texCoords && (texCoords->components != 2 || !(isFloat(*texCoords) || isUnsignedNormalized(*texCoords))))
+        {
+            throw std::runtime_error("glTF TEXCOORD_0 must be a float or normalized VEC2!");
+        }
+        if (colors && (colors->components < 3 || !(isFloat(*colors) || isUnsignedNormalized(*colors))))
+        {
+            throw std::runtime_error("glTF COLOR_0 must be a float or normalized VEC3 or VEC4!");
+        }
+    }
+
+    void validateIndices(const accessorView & indices)
+    {
+        bool unsignedInteger = indices.componentType == 5121 || indices.componentType == 5123 || indices.componentType == 5125;
+        if (indices.components != 1 || !unsignedInteger || indices.normalized)
+        {
+            throw std::runtime_error("glTF indices must be unsigned integer SCALARs!");
+        }
+    }
+
+    float readComponent(const accessorView & view, size_t element, int component)
+    {
+        const uint8_t * p = view.data + view.stride * element + componentSize(view.componentType) * static_cast<size_t>(component);
+        switch (view.componentType)
+        {
+            case 5120: { int8_t v; memcpy(&v, p, 1); return view.normalized ? std::max(v / 127.0f, -1.0f) : v; }
+            case 5121: { uint8_t v = *p; return view.normalized ? v / 255.0f : v; }
+            case 5122: { int16_t v; memcpy(&v, p, 2); return view.normalized ? std::max(v / 32767.0f, -1.0f) : v; }
+            case 5123: { uint16_t v; memcpy(&v, p, 2); return view.normalized ? v / 65535.0f : v; }
+            case 5125: { uint32_t v; memcpy(&v, p, 4); return static_cast<float>(v); }
+            default:   { float v; memcpy(&v, p, 4); return v; }
+        }
+    }
+
+    uint32_t readIndex(const accessorView & view, size_t element)
+    {
+        const uint8_t * p = view.data + view.stride * element;
+        switch (view.componentType)
+        {
+            case 5121: return *p;
+            case 5123: { uint16_t v; memcpy(&v, p, 2); return v; }
+            default:   { uint32_t v; memcpy(&v, p, 4); return v; }
+        }
+    }
+
+    glm::mat4 nodeTransform(const json & node)
+    {
+        glm::mat4 transform(1.0f);
+
+        const json * matrix = node.find("matrix");
+        if (matrix && matrix->size() == 16)
+        {
+            // glTF matrices are column major, like glm
+            for (int column = 0; column < 4; ++column)
+            {
+                for (int row = 0; row < 4; ++row)
+                {
+                    transform[column][row] = static_cast<float>(matrix->items[column * 4 + row].value);
+                }
+            }
+            return transform;
+        }
+
+        float t[3] = {0.0f, 0.0f, 0.0f};
+        float r[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        float s[3] = {1.0f, 1.0f, 1.0f};
+        const json * translation = node.find("translation");
+        const json * rotation = node.find("rotation");
+        const json * scale = node.find("scale");
+        for (int i = 0; i < 3 && translation && translation->size() == 3; ++i) t[i] = static_cast<float>(translation->items[i].value);
+        for (int i = 0; i < 4 && rotation && rotation->size() == 4; ++i) r[i] = static_cast<float>(rotation->items[i].value);
+        for (int i = 0; i < 3 && scale && scale->size() == 3; ++i) s[i] = static_cast<float>(scale->items[i].value);
+
+        // T * R * S, with R from the unit quaternion (x, y, z, w)
+        float x = r[0], y = r[1], z = r[2], w = r[3];
+        transform[0] = glm::vec4((1 - 2 * (y * y + z * z)) * s[0], (2 * (x * y + z * w)) * s[0], (2 * (x * z - y * w)) * s[0], 0.0f);
+        transform[1] = glm::vec4((2 * (x * y - z * w)) * s[1], (1 - 2 * (x * x + z * z)) * s[1], (2 * (y * z + x * w)) * s[1], 0.0f);
+        transform[2] = glm::vec4((2 * (x * z + y * w)) * s[2], (2 * (y * z - x * w)) * s[2], (1 - 2 * (x * x + y * y)) * s[2], 0.0f);
+        transform[3] = glm::vec4(t[0], t[1], t[2], 1.0f);
+        return transform;
+    }
+
+    float determinant3x3(const glm::mat4 & m)
+    {
+        return m[0][0] * (m[1][1] * m[2][2] - m[2][1] * m[1][2]) -
+               m[1][0] * (m[0][1] * m[2][2] - m[2][1] * m[0][2]) +
+               m[2][0] * (m[0][1] * m[1][2] - m[1][1] * m[0][2]);
+    }
+
+    void appendPrimitive(const json & document,
+                         const std::vector<std::vector<uint8_t>> & buffers,
+                         const json & primitive,
+                         const glm::mat4 & transform,
+                         std::vector<Vertex> & corners)
+    {
+        const json * attributes = primitive.find("attributes");
+        const json * position = attributes ? attributes->find("POSITION") : nullptr;
+        if (!position || primitive.numberOr("mode", 4) != 4)
+        {
+            return; // only triangle lists carry surfaces we can draw
+        }
+
+        accessorView positions = accessor(document, buffers, static_cast<size_t>(position->value));
+        accessorView texCoords;
+        accessorView colors;
+        const json * texCoord = attributes->find("TEXCOORD_0");
+        const json * color = attributes->find("COLOR_0");
+        if (texCoord)
+        {
+            texCoords = accessor(document, buffers, static_cast<size_t>(texCoord->value));
+        }
+        if (color)
+        {
+            colors = accessor(document, buffers, static_cast<size_t>(color->value));
+        }
+        validateAttributes(positions, texCoord ? &texCoords : nullptr, color ? &colors : nullptr);
+
+        std::vector<Vertex> vertices(positions.count);
+        for (size_t i = 0; i < positions.count; ++i)
+        {
+            glm::vec4 world = transform * glm::vec4(readComponent(positions, i, 0),
+                                                    readComponent(positions, i, 1),
+                                                    readComponent(positions, i, 2),
+                                                    1.0f);
+            vertices[i].pos = glm::vec3(world.x, world.y, world.z);
+            vertices[i].color = glm::vec3(1.0f, 1.0f, 1.0f);
+            vertices[i].texCoord = glm::vec2(0.0f, 0.0f);
+            if (i < colors.count)
+            {
+                vertices[i].color = glm::vec3(readComponent(colors, i, 0), readComponent(colors, i, 1), readComponent(colors, i, 2));
+            }
+            if (i < texCoords.count)
+            {
+                vertices[i].texCoord = glm::vec2(readComponent(texCoords, i, 0), readComponent(texCoords, i, 1));
+            }
+        }
+
+        // A mirroring transform turns the triangles inside out
+        bool flip = determinant3x3(transform) < 0.0f;
+
+        const json * indexAccessor = primitive.find("indices");
+        accessorView indices;
+        if (indexAccessor)
+        {
+            indices = accessor(document, buffers, static_cast<size_t>(indexAccessor->value));
+            validateIndices(indices);
+        }
+        size_t cornerCount = indexAccessor ? indices.count : positions.count;
+        for (size_t i = 0; i + 2 < cornerCount; i += 3)
+        {
+            uint32_t triangle[3];
+            for (size_t c = 0; c < 3; ++c)
+            {
+                triangle[c] = indexAccessor ? readIndex(indices, i + c) : static_cast<uint32_t>(i + c);
+                if (triangle[c] >= vertices.size())
+                {
+                    throw std::runtime_error("glTF index out of range!");
+                }
+            }
+            corners.push_back(vertices[triangle[0]]);
+            corners.push_back(vertices[triangle[flip ? 2 : 1]]);
+            corners.push_back(vertices[triangle[flip ? 1 : 2]]);
+        }
+    }
+
+    void appendNode(const json & document,
+                    const std::vector<std::vector<uint8_t>> & buffers,
+                    size_t nodeIndex,
+                    const glm::mat4 & parent,
+                    int depth,
+                    std::vector<Vertex> & corners)
+    {
+        const json * nodes = document.find("nodes");
+        if (!nodes || nodeIndex >= nodes->size() || depth > 64)
+        {
+            throw std::runtime_error("glTF node hierarchy is invalid!");
+        }
+        const json & node = nodes->items[nodeIndex];
+        glm::mat4 world = parent * nodeTransform(node);
+
+        const json * meshIndex = node.find("mesh");
+        const json * meshes = document.find("meshes");
+        if (meshIndex && meshes && static_cast<size_t>(meshIndex->value) < meshes->size())
+        {
+            const json * primitives = meshes->items[static_cast<size_t>(meshIndex->value)].find("primitives");
+            for (size_t i = 0; primitives && i < primitives->size(); ++i)
+            {
+                appendPrimitive(document, buffers, primitives->items[i], world, corners);
+            }
+        }
+
+        const json * children = node.find("children");
+        for (size_t i = 0; children && i < children->size(); ++i)
+        {
+            appendNode(document, buffers, static_cast<size_t>(children->items[i].value), world, depth + 1, corners);
+        }
+    }
+}
+
+meshLoader::vertexDeduplicator::vertexDeduplicator(size_t expectedVertices) :
+_count(0)
+{
+    size_t capacity = 64;
+    while (capacity < expectedVertices * 2)
+    {
+        capacity *= 2;
+    }
+    _slots.assign(capacity, emptySlot);
+}
+
+uint32_t meshLoader::vertexDeduplicator::insert(const Vertex & vertex, std::vector<Vertex> & vertices)
+{
+    size_t mask = _slots.size() - 1;
+    size_t slot = static_cast<size_t>(hashVertex(vertex)) & mask;
+
+    // Linear probing, the table is never more than half full
+    while (_slots[slot] != emptySlot)
+    {
+        if (memcmp(&vertices[_slots[slot]], &vertex, sizeof(Vertex)) == 0)
+        {
+            return _slots[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    uint32_t index = static_cast<uint32_t>(vertices.size());
+    vertices.push_back(vertex);
+    _slots[slot] = index;
+
+    if (++_count * 2 > _slots.size())
+    {
+        grow(vertices);
+    }
+    return index;
+}
+
+void meshLoader::vertexDeduplicator::grow(const std::vector<Vertex> & vertices)
+{
+    std::vector<uint32_t> old;
+    old.swap(_slots);
+    _slots.assign(old.size() * 2, emptySlot);
+
+    size_t mask = _slots.size() - 1;
+    for (uint32_t index : old)
+    {
+        if (index == emptySlot)
+        {
+            continue;
+        }
+        size_t slot = static_cast<size_t>(hashVertex(vertices[index])) & mask;
+        while (_slots[slot] != emptySlot)
+        {
+            slot = (slot + 1) & mask;
+        }
+        _slots[slot] = index;
+    }
+}
+
+meshLoader::mesh meshLoader::buildIndexed(const std::vector<Vertex> & corners)
+{
+    mesh result;
+    result.indices.reserve(corners.size());
+    // Typical meshes share each vertex between ~6 triangles
+    result.vertices.reserve(corners.size() / 4 + 16);
+
+    vertexDeduplicator deduplicator(corners.size() / 4);
+    for (const Vertex & corner : corners)
+    {
+        result.indices.push_back(deduplicator.insert(corner, result.vertices));
+    }
+    result.vertices.shrink_to_fit();
+    return result;
+}
+
+VkIndexType meshLoader::indexType(size_t vertexCount)
+{
+    // 0xFFFF stays free in case primitive restart is ever enabled
+    return vertexCount <= 0xFFFF ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+std::vector<uint8_t> meshLoader::packIndices(const std::vector<uint32_t> & indices, VkIndexType type)
+{
+    std::vector<uint8_t> packed;
+    if (type == VK_INDEX_TYPE_UINT16)
+    {
+        packed.resize(indices.size() * sizeof(uint16_t));
+        uint16_t * out = reinterpret_cast<uint16_t *>(packed.data());
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            out[i] = static_cast<uint16_t>(indices[i]);
+        }
+    }
+    else
+    {
+        packed.resize(indices.size() * sizeof(uint32_t));
+        memcpy(packed.data(), indices.data(), packed.size());
+    }
+    return packed;
+}
+
+meshLoader::mesh meshLoader::load(const uint8_t * data,
+                                  size_t size,
+                                  const std::string & name,
+                                  const bufferLoader & loadBuffer)
+{
+    if (endsWith(name, ".obj"))
+    {
+        return loadObj(data, size);
+    }
+    if (endsWith(name, ".gltf") || endsWith(name, ".glb"))
+    {
+        return loadGltf(data, size, loadBuffer);
+    }
+    throw std::runtime_error("unsupported mesh format " + name + "!");
+}
+
+meshLoader::mesh meshLoader::loadObj(const uint8_t * data, size_t size)
+{
+    // A terminated copy lets strtof/strtol run without bounds checks
+    std::string text(reinterpret_cast<const char *>(data), size);
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> colors;
+    std::vector<glm::vec2> texCoords;
+    std::vector<Vertex> corners;
+    std::vector<Vertex> face;
+
+    for (const char * p = text.c_str(); *p != '\0'; p = nextLine(p))
+    {
+        p = skipSpaces(p);
+        if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+        {
+            char * end;
+            glm::vec3 position;
+            position.x = strtof(p + 2, &end);
+            position.y = strtof(end, &end);
+            position.z = strtof(end, &end);
+            positions.push_back(position);
+
+            // Optional per-vertex color extension: v x y z r g b
+            const char * colorStart = skipSpaces(end);
+            glm::vec3 color(1.0f, 1.0f, 1.0f);
+            if (*colorStart != '\n' && *colorStart != '\0' && *colorStart != '#')
+            {
+                color.x = strtof(colorStart, &end);
+                color.y = strtof(end, &end);
+                color.z = strtof(end, &end);
+            }
+            colors.push_back(color);
+        }
+        else if (p[0] == 'v' && p[1] == 't')
+        {
+            char * end;
+            glm::vec2 texCoord;
+            texCoord.x = strtof(p + 2, &end);
+            // OBJ puts v = 0 at the bottom of the image, Vulkan samples from the top
+            texCoord.y = 1.0f - strtof(end, &end);
+            texCoords.push_back(texCoord);
+        }
+        else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+        {
+            face.clear();
+            const char * cursor = p + 2;
+            while (true)
+            {
+                cursor = skipSpaces(cursor);
+                if (*cursor == '\n' || *cursor == '\0' || *cursor == '#')
+                {
+                    break;
+                }
+
+                char * end;
+                long position = resolveObjIndex(strtol(cursor, &end, 10), positions.size());
+                if (end == cursor || position < 0)
+                {
+                    throw std::runtime_error("failed to parse obj face!");
+                }
+                long texCoord = -1;
+                if (*end == '/')
+                {
+                    const char * texCoordStart = end + 1;
+                    if (*texCoordStart != '/')
+                    {
+                        texCoord = resolveObjIndex(strtol(texCoordStart, &end, 10), texCoords.size());
+                    }
+                    else
+                    {
+                        end = const_cast<char *>(texCoordStart);
+                    }
+                    if (*end == '/')
+                    {
+                        strtol(end + 1, &end, 10); // normals are not part of Vertex
+                    }
+                }
+                cursor = end;
+
+                Vertex vertex;
+                vertex.pos = positions[static_cast<size_t>(position)];
+                vertex.color = colors[static_cast<size_t>(position)];
+                vertex.texCoord = texCoord >= 0 ? texCoords[static_cast<size_t>(texCoord)] : glm::vec2(0.0f, 0.0f);
+                face.push_back(vertex);
+            }
+
+            // Fan triangulation of convex polygons
+            for (size_t i = 2; i < face.size(); ++i)
+            {
+                corners.push_back(face[0]);
+                corners.push_back(face[i - 1]);
+                corners.push_back(face[i]);
+            }
+        }
+    }
+
+    if (corners.empty())
+    {
+        throw std::runtime_error("obj file contains no faces!");
+    }
+    return buildIndexed(corners);
+}
+
+meshLoader::mesh meshLoader::loadGltf(const uint8_t * data, size_t size, const bufferLoader & loadBuffer)
+{
+    const char * jsonBegin = reinterpret_cast<const char *>(data);
+    const char * jsonEnd = jsonBegin + size;
+    std::vector<uint8_t> binaryChunk;
+    bool binary = false;
+
+    // .glb: 12 byte header, then a JSON chunk and an optional BIN chunk
+    if (size >= 12 && memcmp(data, "glTF", 4) == 0)
+    {
+        binary = true;
+        size_t offset = 12;
+        while (offset + 8 <= size)
+        {
+            uint32_t chunkLength, chunkType;
+            memcpy(&chunkLength, data + offset, 4);
+            memcpy(&chunkType, data + offset + 4, 4);
+            offset += 8;
+            if (chunkLength > size - offset)
+            {
+                throw std::runtime_error("glb chunk runs past the end of the file!");
+            }
+            if (chunkType == 0x4E4F534A) // "JSON"
+            {
+                jsonBegin = reinterpret_cast<const char *>(data + offset);
+                jsonEnd = jsonBegin + chunkLength;
+            }
+            else if (chunkType == 0x004E4942) // "BIN\0"
+            {
+                binaryChunk.assign(data + offset, data + offset + chunkLength);
+            }
+            offset += (chunkLength + 3) & ~3u;
+        }
+    }
+
+    json document = jsonParser(jsonBegin, jsonEnd).parse();
+
+    std::vector<std::vector<uint8_t>> buffers;
+    const json * bufferList = document.find("buffers");
+    for (size_t i = 0; bufferList && i < bufferList->size(); ++i)
+    {
+        const json * uri = bufferList->items[i].find("uri");
+        std::vector<uint8_t> bytes;
+        if (!uri)
+        {
+            if (!binary || i != 0)
+            {
+                throw std::runtime_error("glTF buffer has no data!");
+            }
+            bytes = std::move(binaryChunk);
+        }
+        else if (uri->text.compare(0, 5, "data:") == 0)
+        {
+            size_t comma = uri->text.find(";base64,");
+            if (comma == std::string::npos || !decodeBase64(uri->text, comma + 8, bytes))
+            {
+                throw std::runtime_error("failed to decode glTF data uri!");
+            }
+        }
+        else if (!loadBuffer || !loadBuffer(uri->text, bytes))
+        {
+            throw std::runtime_error("failed to load glTF buffer " + uri->text + "!");
+        }
+        buffers.push_back(std::move(bytes));
+    }
+
+    std::vector<Vertex> corners;
+    glm::mat4 identity(1.0f);
+
+    const json * scenes = document.find("scenes");
+    size_t sceneIndex = static_cast<size_t>(document.numberOr("scene", 0));
+    if (scenes && sceneIndex < scenes->size())
+    {
+        const json * roots = scenes->items[sceneIndex].find("nodes");
+        for (size_t i = 0; roots && i < roots->size(); ++i)
+        {
+            appendNode(document, buffers, static_cast<size_t>(roots->items[i].value), identity, 0, corners);
+        }
+    }
+    else if (const json * meshes = document.find("meshes"))
+    {
+        // No scene: take every mesh as is
+        for (size_t m = 0; m < meshes->size(); ++m)
+        {
+            const json * primitives = meshes->items[m].find("primitives");
+            for (size_t i = 0; primitives && i < primitives->size(); ++i)
+            {
+                appendPrimitive(document, buffers, primitives->items[i], identity, corners);
+            }
+        }
+    }
+
+    if (corners.empty())
+    {
+        throw std::runtime_error("glTF file contains no triangles!");
+    }
+    return buildIndexed(corners);
+}
@@ -0,0 +1,68 @@
+//
+//  meshLoader.hpp
+//  vulkanTesting
+//
+
+#ifndef meshLoader_hpp
+#define meshLoader_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "vertex.hpp"
+
+namespace meshLoader {
+
+    // Indexed triangle list.  Indices are kept 32 bit while the mesh is processed,
+    // packIndices() narrows them for upload.
+    struct mesh {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    // Resolves a glTF buffer uri (relative to the .gltf) to its bytes
+    typedef std::function<bool(const std::string & uri, std::vector<uint8_t> & bytes)> bufferLoader;
+
+    // Loads .obj, .gltf or .glb, chosen from the extension of name.  Every node of the
+    // default glTF scene is flattened into one mesh with its world transform applied.
+    // Throws std::runtime_error if the file cannot be parsed.
+    mesh load(const uint8_t * data,
+              size_t size,
+              const std::string & name,
+              const bufferLoader & loadBuffer = bufferLoader());
+
+    mesh loadObj(const uint8_t * data, size_t size);
+
+    mesh loadGltf(const uint8_t * data, size_t size, const bufferLoader & loadBuffer = bufferLoader());
+
+    // Open addressing map from vertex contents to index.  One flat array of
+    // indices into the vertex list, no per-entry allocations.
+    class vertexDeduplicator
+    {
+    public:
+
+        explicit vertexDeduplicator(size_t expectedVertices);
+
+        // Index of vertex in vertices, appending it if it has not been seen before
+        uint32_t insert(const Vertex & vertex, std::vector<Vertex> & vertices);
+
+    private:
+        void grow(const std::vector<Vertex> & vertices);
+
+        std::vector<uint32_t> _slots;
+        size_t _count;
+    };
+
+    // Turns an unindexed triangle list into unique vertices and indices
+    mesh buildIndexed(const std::vector<Vertex> & corners);
+
+    // UINT16 whenever every index fits, halving the index buffer
+    VkIndexType indexType(size_t vertexCount);
+
+    std::vector<uint8_t> packIndices(const std::vector<uint32_t> & indices, VkIndexType type);
+}
+
+#endif /* meshLoader_hpp */
@@ -0,0 +1,422 @@
+//
+//  meshOptimizer.cpp
+//  vulkanTesting
+//
+
+#include "meshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const uint32_t unused = 0xFFFFFFFFu;
+
+    // FIFO cache simulated with timestamps: a vertex is resident while fewer than
+    // cacheSize misses have happened since it was last loaded.  Bumping the clock
+    // by cacheSize + 1 empties the cache without touching the array.
+    class fifoCache
+    {
+    public:
+        fifoCache(size_t vertexCount, unsigned cacheSize) :
+        _stamps(vertexCount, 0),
+        _cacheSize(cacheSize),
+        _clock(cacheSize + 1)
+        {
+
+        }
+
+        // True on a miss
+        bool access(uint32_t vertex)
+        {
+            if (_clock - _stamps[vertex] > _cacheSize)
+            {
+                _stamps[vertex] = _clock++;
+                return true;
+            }
+            return false;
+        }
+
+        bool resident(uint32_t vertex) const
+        {
+            return _clock - _stamps[vertex] <= _cacheSize;
+        }
+
+        uint32_t age(uint32_t vertex) const
+        {
+            return _clock - _stamps[vertex];
+        }
+
+        void flush()
+        {
+            _clock += _cacheSize + 1;
+        }
+
+    private:
+        std::vector<uint32_t> _stamps;
+        uint32_t _cacheSize;
+        uint32_t _clock;
+    };
+
+    struct cluster {
+        uint32_t firstTriangle;
+        uint32_t triangleCount;
+        float sortKey;
+    };
+}
+
+meshOptimizer::cacheStatistics meshOptimizer::analyzeVertexCache(const std::vector<uint32_t> & indices, size_t vertexCount, unsigned cacheSize)
+{
+    cacheStatistics result;
+    if (indices.empty())
+    {
+        return result;
+    }
+
+    fifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> used(vertexCount, false);
+    size_t uniqueVertices = 0;
+    for (uint32_t index : indices)
+    {
+        result.verticesTransformed += cache.access(index) ? 1 : 0;
+        if (!used[index])
+        {
+            used[index] = true;
+            ++uniqueVertices;
+        }
+    }
+
+    result.acmr = static_cast<float>(result.verticesTransformed) / static_cast<float>(indices.size() / 3);
+    result.atvr = static_cast<float>(result.verticesTransformed) / static_cast<float>(uniqueVertices);
+    return result;
+}
+
+meshOptimizer::fetchStatistics meshOptimizer::analyzeVertexFetch(const std::vector<uint32_t> & indices, size_t vertexCount, size_t vertexSize)
+{
+    const size_t lineSize = 64;
+    const size_t lineCount = 16;
+
+    fetchStatistics result;
+    if (indices.empty() || vertexCount == 0 || vertexSize == 0)
+    {
+        return result;
+    }
+
+    // Most recently used line first
+    std::vector<size_t> lines;
+    lines.reserve(lineCount + 1);
+
+    for (uint32_t index : indices)
+    {
+        size_t firstLine = index * vertexSize / lineSize;
+        size_t lastLine = ((index + 1) * vertexSize - 1) / lineSize;
+        for (size_t line = firstLine; line <= lastLine; ++line)
+        {
+            std::vector<size_t>::iterator found = std::find(lines.begin(), lines.end(), line);
+            if (found != lines.end())
+            {
+                lines.erase(found);
+            }
+            else
+            {
+                result.bytesFetched += lineSize;
+                if (lines.size() == lineCount)
+                {
+                    lines.pop_back();
+                }
+            }
+            lines.insert(lines.begin(), line);
+        }
+    }
+
+    result.overfetch = static_cast<float>(result.bytesFetched) / static_cast<float>(vertexCount * vertexSize);
+    return result;
+}
+
+std::vector<uint32_t> meshOptimizer::optimizeVertexCache(const std::vector<uint32_t> & indices,
+                                                         size_t vertexCount,
+                                                         unsigned cacheSize,
+                                                         std::vector<uint32_t> * hardBoundaries)
+{
+    size_t triangleCount = indices.size() / 3;
+    std::vector<uint32_t> result;
+    result.reserve(triangleCount * 3);
+    if (hardBoundaries)
+    {
+        hardBoundaries->clear();
+    }
+    if (triangleCount == 0)
+    {
+        return result;
+    }
+
+    // Vertex to triangle adjacency, flattened
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+    {
+        ++liveTriangles[indices[i]];
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    }
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+        {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    fifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+    uint32_t scanCursor = 0;
+
+    // Vertex whose remaining triangles are emitted next
+    uint32_t fanning = indices[0];
+    if (hardBoundaries)
+    {
+        hardBoundaries->push_back(0);
+    }
+
+    while (fanning != unused)
+    {
+        candidates.clear();
+        for (uint32_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; ++a)
+        {
+            uint32_t triangle = adjacency[a];
+            if (emitted[triangle])
+            {
+                continue;
+            }
+            emitted[triangle] = true;
+            for (int c = 0; c < 3; ++c)
+            {
+                uint32_t vertex = indices[triangle * 3 + c];
+                result.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                --liveTriangles[vertex];
+                cache.access(vertex);
+            }
+        }
+
+        // Prefer the candidate that will still be in the cache when its remaining
+        // triangles are drawn, and among those the one that entered it first
+        uint32_t best = unused;
+        int bestPriority = -1;
+        for (uint32_t vertex : candidates)
+        {
+            if (liveTriangles[vertex] == 0)
+            {
+                continue;
+            }
+            int priority = 0;
+            if (cache.age(vertex) + 2 * liveTriangles[vertex] <= cacheSize)
+            {
+                priority = static_cast<int>(cache.age(vertex));
+            }
+            if (priority > bestPriority)
+            {
+                best = vertex;
+                bestPriority = priority;
+            }
+        }
+
+        if (best == unused)
+        {
+            // Dead end: back up through recently emitted vertices first
+            while (!deadEnds.empty() && best == unused)
+            {
+                uint32_t vertex = deadEnds.back();
+                deadEnds.pop_back();
+                if (liveTriangles[vertex] > 0)
+                {
+                    best = vertex;
+                }
+            }
+            // Then fall back to input order, which starts from a cold cache
+            while (best == unused && scanCursor < vertexCount)
+            {
+                if (liveTriangles[scanCursor] > 0)
+                {
+                    best = scanCursor;
+                    if (hardBoundaries)
+                    {
+                        hardBoundaries->push_back(static_cast<uint32_t>(result.size() / 3));
+                    }
+                }
+                ++scanCursor;
+            }
+        }
+        fanning = best;
+    }
+
+    return result;
+}
+
+std::vector<uint32_t> meshOptimizer::optimizeOverdraw(const std::vector<uint32_t> & indices,
+                                                      const std::vector<Vertex> & vertices,
+                                                      const std::vector<uint32_t> & hardBoundaries,
+                                                      float threshold,
+                                                      unsigned cacheSize)
+{
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    if (triangleCount == 0)
+    {
+        return indices;
+    }
+
+    std::vector<uint32_t> hard(hardBoundaries);
+    if (hard.empty() || hard[0] != 0)
+    {
+        hard.insert(hard.begin(), 0);
+    }
+    hard.push_back(triangleCount);
+
+    // Split every hard cluster where stopping costs at most threshold times its ACMR
+    fifoCache cache(vertices.size(), cacheSize);
+    std::vector<cluster> clusters;
+    for (size_t h = 0; h + 1 < hard.size(); ++h)
+    {
+        uint32_t begin = hard[h];
+        uint32_t end = hard[h + 1];
+        if (begin >= end)
+        {
+            continue;
+        }
+
+        cache.flush();
+        uint32_t hardMisses = 0;
+        for (uint32_t i = begin * 3; i < end * 3; ++i)
+        {
+            hardMisses += cache.access(indices[i]) ? 1 : 0;
+        }
+        float hardAcmr = static_cast<float>(hardMisses) / static_cast<float>(end - begin);
+
+        cache.flush();
+        uint32_t start = begin;
+        uint32_t misses = 0;
+        for (uint32_t t = begin; t < end; ++t)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                misses += cache.access(indices[t * 3 + c]) ? 1 : 0;
+            }
+            float acmr = static_cast<float>(misses) / static_cast<float>(t + 1 - start);
+            if (t + 1 < end && acmr <= threshold * hardAcmr)
+            {
+                clusters.push_back({start, t + 1 - start, 0.0f});
+                start = t + 1;
+                misses = 0;
+                cache.flush();
+            }
+        }
+        clusters.push_back({start, end - start, 0.0f});
+    }
+
+    // Area weighted centroids and normals
+    std::vector<float> clusterData(clusters.size() * 7, 0.0f); // centroid xyz, normal xyz, area
+    float meshCentroid[3] = {0.0f, 0.0f, 0.0f};
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusters.size(); ++c)
+    {
+        float * data = &clusterData[c * 7];
+        for (uint32_t t = clusters[c].firstTriangle; t < clusters[c].firstTriangle + clusters[c].triangleCount; ++t)
+        {
+            const Vertex & a = vertices[indices[t * 3 + 0]];
+            const Vertex & b = vertices[indices[t * 3 + 1]];
+            const Vertex & d = vertices[indices[t * 3 + 2]];
+            float e1[3] = {b.pos.x - a.pos.x, b.pos.y - a.pos.y, b.pos.z - a.pos.z};
+            float e2[3] = {d.pos.x - a.pos.x, d.pos.y - a.pos.y, d.pos.z - a.pos.z};
+            float normal[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                               e1[2] * e2[0] - e1[0] * e2[2],
+                               e1[0] * e2[1] - e1[1] * e2[0]};
+            float area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+            data[0] += (a.pos.x + b.pos.x + d.pos.x) / 3.0f * area;
+            data[1] += (a.pos.y + b.pos.y + d.pos.y) / 3.0f * area;
+            data[2] += (a.pos.z + b.pos.z + d.pos.z) / 3.0f * area;
+            data[3] += normal[0];
+            data[4] += normal[1];
+            data[5] += normal[2];
+            data[6] += area;
+        }
+        for (int i = 0; i < 3; ++i)
+        {
+            meshCentroid[i] += data[i];
+        }
+        meshArea += data[6];
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        meshCentroid[i] = meshArea > 0.0f ? meshCentroid[i] / meshArea : 0.0f;
+    }
+
+    // Occlusion potential: how far the cluster sits out along its own normal
+    for (size_t c = 0; c < clusters.size(); ++c)
+    {
+        const float * data = &clusterData[c * 7];
+        float normalLength = std::sqrt(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+        if (data[6] <= 0.0f || normalLength <= 0.0f)
+        {
+            continue;
+        }
+        float key = 0.0f;
+        for (int i = 0; i < 3; ++i)
+        {
+            key += (data[i] / data[6] - meshCentroid[i]) * data[3 + i] / normalLength;
+        }
+        clusters[c].sortKey = key;
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const cluster & a, const cluster & b) {
+        return a.sortKey > b.sortKey;
+    });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (const cluster & c : clusters)
+    {
+        result.insert(result.end(), indices.begin() + c.firstTriangle * 3, indices.begin() + (c.firstTriangle + c.triangleCount) * 3);
+    }
+    return result;
+}
+
+void meshOptimizer::optimizeVertexFetch(meshLoader::mesh & mesh)
+{
+    std::vector<uint32_t> remap(mesh.vertices.size(), unused);
+    std::vector<Vertex> ordered;
+    ordered.reserve(mesh.vertices.size());
+
+    for (uint32_t & index : mesh.indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = static_cast<uint32_t>(ordered.size());
+            ordered.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(ordered);
+}
+
+meshOptimizer::report meshOptimizer::optimize(meshLoader::mesh & mesh, float overdrawThreshold)
+{
+    report result;
+    result.cacheBefore = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+    result.fetchBefore = analyzeVertexFetch(mesh.indices, mesh.vertices.size(), sizeof(Vertex));
+
+    std::vector<uint32_t> hardBoundaries;
+    mesh.indices = optimizeVertexCache(mesh.indices, mesh.vertices.size(), 16, &hardBoundaries);
+    mesh.indices = optimizeOverdraw(mesh.indices, mesh.vertices, hardBoundaries, overdrawThreshold);
+    optimizeVertexFetch(mesh);
+
+    result.cacheAfter = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+    result.fetchAfter = analyzeVertexFetch(mesh.indices, mesh.vertices.size(), sizeof(Vertex));
+    return result;
+}
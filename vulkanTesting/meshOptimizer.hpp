@@ -0,0 +1,66 @@
+//
+//  meshOptimizer.hpp
+//  vulkanTesting
+//
+
+#ifndef meshOptimizer_hpp
+#define meshOptimizer_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "meshLoader.hpp"
+
+// Triangle and vertex reordering for indexed triangle lists.  Pure CPU, run once
+// when a mesh is loaded or baked; none of it changes what is drawn, only the order.
+namespace meshOptimizer {
+
+    // Post-transform cache behaviour, simulated as a FIFO of cacheSize vertices
+    struct cacheStatistics {
+        size_t verticesTransformed = 0;
+        float acmr = 0.0f; // transformed vertices per triangle, 0.5 is the ideal for large grids
+        float atvr = 0.0f; // transformed vertices per unique vertex, 1.0 is the ideal
+    };
+
+    // Vertex fetch behaviour, simulated with 64 byte lines in a small LRU cache
+    struct fetchStatistics {
+        size_t bytesFetched = 0;
+        float overfetch = 0.0f; // bytes fetched per byte of vertex data, 1.0 is the ideal
+    };
+
+    struct report {
+        cacheStatistics cacheBefore;
+        cacheStatistics cacheAfter;
+        fetchStatistics fetchBefore;
+        fetchStatistics fetchAfter;
+    };
+
+    cacheStatistics analyzeVertexCache(const std::vector<uint32_t> & indices, size_t vertexCount, unsigned cacheSize = 16);
+
+    fetchStatistics analyzeVertexFetch(const std::vector<uint32_t> & indices, size_t vertexCount, size_t vertexSize);
+
+    // Tipsify (Sander et al. 2007).  Linear time.  hardBoundaries receives the first
+    // triangle of every run that started with a cold cache, for optimizeOverdraw.
+    std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t> & indices,
+                                              size_t vertexCount,
+                                              unsigned cacheSize = 16,
+                                              std::vector<uint32_t> * hardBoundaries = nullptr);
+
+    // Splits the cache optimized order into clusters whose ACMR stays within threshold
+    // of the original and draws the most outward facing clusters first, so the front
+    // of the mesh tends to land in the depth buffer before what it hides.
+    std::vector<uint32_t> optimizeOverdraw(const std::vector<uint32_t> & indices,
+                                           const std::vector<Vertex> & vertices,
+                                           const std::vector<uint32_t> & hardBoundaries,
+                                           float threshold = 1.05f,
+                                           unsigned cacheSize = 16);
+
+    // Renumbers vertices in the order the indices first use them and drops unused ones
+    void optimizeVertexFetch(meshLoader::mesh & mesh);
+
+    // All three passes in order, with before/after statistics
+    report optimize(meshLoader::mesh & mesh, float overdrawThreshold = 1.05f);
+}
+
+#endif /* meshOptimizer_hpp */
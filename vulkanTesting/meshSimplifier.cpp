@@ -0,0 +1,424 @@
+//
+//  meshSimplifier.cpp
+//  vulkanTesting
+//
+
+#include "meshSimplifier.hpp"
+#include "meshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+    // Sum of weighted squared distances to planes, as the upper triangle of a symmetric
+    // 4x4 matrix.  Dividing by the total weight keeps the error in squared model units.
+    struct quadric {
+        double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+        double b2 = 0.0, bc = 0.0, bd = 0.0;
+        double c2 = 0.0, cd = 0.0;
+        double d2 = 0.0;
+        double weight = 0.0;
+
+        void addPlane(double a, double b, double c, double d, double planeWeight)
+        {
+            a2 += a * a * planeWeight; ab += a * b * planeWeight; ac += a * c * planeWeight; ad += a * d * planeWeight;
+            b2 += b * b * planeWeight; bc += b * c * planeWeight; bd += b * d * planeWeight;
+            c2 += c * c * planeWeight; cd += c * d * planeWeight;
+            d2 += d * d * planeWeight;
+            weight += planeWeight;
+        }
+
+        void add(const quadric & other)
+        {
+            a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+            b2 += other.b2; bc += other.bc; bd += other.bd;
+            c2 += other.c2; cd += other.cd;
+            d2 += other.d2;
+            weight += other.weight;
+        }
+
+        double error(const glm::vec3 & p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double sum = a2 * x * x + b2 * y * y + c2 * z * z +
+                         2.0 * (ab * x * y + ac * x * z + bc * y * z) +
+                         2.0 * (ad * x + bd * y + cd * z) + d2;
+            return weight > 0.0 ? std::max(sum, 0.0) / weight : 0.0;
+        }
+    };
+
+    struct collapse {
+        uint32_t from; // position group that disappears
+        uint32_t to;   // position group it moves onto
+        double cost;
+    };
+
+    glm::vec3 position(const std::vector<Vertex> & vertices, uint32_t vertex)
+    {
+        return vertices[vertex].pos;
+    }
+
+    // canonical[v] is the lowest numbered vertex with v's position
+    std::vector<uint32_t> positionGroups(const std::vector<Vertex> & vertices)
+    {
+        std::vector<uint32_t> order(vertices.size());
+        std::iota(order.begin(), order.end(), 0);
+        auto less = [&vertices](uint32_t a, uint32_t b) {
+            const glm::vec3 pa = vertices[a].pos, pb = vertices[b].pos;
+            if (pa.x != pb.x) return pa.x < pb.x;
+            if (pa.y != pb.y) return pa.y < pb.y;
+            if (pa.z != pb.z) return pa.z < pb.z;
+            return a < b;
+        };
+        std::sort(order.begin(), order.end(), less);
+
+        std::vector<uint32_t> canonical(vertices.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            bool samePosition = i > 0 && glm::vec3(vertices[order[i]].pos) == glm::vec3(vertices[order[i - 1]].pos);
+            canonical[order[i]] = samePosition ? canonical[order[i - 1]] : order[i];
+        }
+        return canonical;
+    }
+
+    // Edges of the position graph used by anything but exactly two triangles
+    void lockBorders(const std::vector<uint32_t> & indices, const std::vector<uint32_t> & canonical, std::vector<uint8_t> & locked)
+    {
+        std::vector<std::pair<uint32_t, uint32_t>> edges;
+        edges.reserve(indices.size());
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                uint32_t a = canonical[indices[i + corner]];
+                uint32_t b = canonical[indices[i + (corner + 1) % 3]];
+                edges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        for (size_t i = 0; i < edges.size();)
+        {
+            size_t run = i;
+            while (run < edges.size() && edges[run] == edges[i])
+            {
+                ++run;
+            }
+            if (run - i != 2)
+            {
+                locked[edges[i].first] = 1;
+                locked[edges[i].second] = 1;
+            }
+            i = run;
+        }
+    }
+
+    float attributeDistance(const Vertex & a, const Vertex & b)
+    {
+        glm::vec3 color = glm::vec3(a.color) - glm::vec3(b.color);
+        glm::vec2 texCoord = glm::vec2(a.texCoord) - glm::vec2(b.texCoord);
+        return glm::dot(color, color) + glm::dot(texCoord, texCoord);
+    }
+}
+
+std::vector<uint32_t> meshSimplifier::simplify(const std::vector<uint32_t> & indices,
+                                               const std::vector<Vertex> & vertices,
+                                               size_t targetIndexCount,
+                                               float targetError,
+                                               float * resultError)
+{
+    std::vector<uint32_t> result(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+    if (resultError)
+    {
+        *resultError = 0.0f;
+    }
+    if (result.size() <= targetIndexCount)
+    {
+        return result;
+    }
+
+    size_t vertexCount = vertices.size();
+    std::vector<uint32_t> canonical = positionGroups(vertices);
+
+    // Vertices of each position group, to pick the matching one after a collapse
+    std::vector<uint32_t> wedgeOffsets(vertexCount + 1, 0);
+    for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        ++wedgeOffsets[canonical[vertex] + 1];
+    }
+    std::partial_sum(wedgeOffsets.begin(), wedgeOffsets.end(), wedgeOffsets.begin());
+    std::vector<uint32_t> wedges(vertexCount);
+    std::vector<uint32_t> wedgeFill(wedgeOffsets.begin(), wedgeOffsets.end() - 1);
+    for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        wedges[wedgeFill[canonical[vertex]]++] = static_cast<uint32_t>(vertex);
+    }
+
+    // Moving a seam vertex would tear the attributes apart, moving a border one the outline
+    std::vector<uint8_t> locked(vertexCount, 0);
+    for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        if (wedgeOffsets[vertex + 1] - wedgeOffsets[vertex] > 1)
+        {
+            locked[vertex] = 1;
+        }
+    }
+    lockBorders(result, canonical, locked);
+
+    std::vector<quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        glm::vec3 a = position(vertices, result[i]);
+        glm::vec3 b = position(vertices, result[i + 1]);
+        glm::vec3 c = position(vertices, result[i + 2]);
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float area = glm::length(normal);
+        if (area == 0.0f)
+        {
+            continue;
+        }
+        normal = normal / area;
+        double d = -glm::dot(normal, a);
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            quadrics[canonical[result[i + corner]]].addPlane(normal.x, normal.y, normal.z, d, area);
+        }
+    }
+
+    double maximumCost = static_cast<double>(targetError) * targetError;
+    double worstCost = 0.0;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    std::vector<collapse> collapses;
+
+    // Passes of independent collapses: an edge is skipped when a neighbouring collapse
+    // already happened this pass, and the topology is rebuilt in between
+    while (result.size() > targetIndexCount)
+    {
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (uint32_t index : result)
+        {
+            ++adjacencyOffsets[canonical[index] + 1];
+        }
+        std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+        adjacency.resize(result.size());
+        std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < result.size(); ++i)
+        {
+            adjacency[adjacencyFill[canonical[result[i]]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        edges.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                uint32_t a = canonical[result[i + corner]];
+                uint32_t b = canonical[result[i + (corner + 1) % 3]];
+                edges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        collapses.clear();
+        for (const std::pair<uint32_t, uint32_t> & edge : edges)
+        {
+            quadric combined = quadrics[edge.first];
+            combined.add(quadrics[edge.second]);
+            double infinity = std::numeric_limits<double>::infinity();
+            double firstOntoSecond = locked[edge.first] ? infinity : combined.error(position(vertices, edge.second));
+            double secondOntoFirst = locked[edge.second] ? infinity : combined.error(position(vertices, edge.first));
+            if (firstOntoSecond == infinity && secondOntoFirst == infinity)
+            {
+                continue;
+            }
+            if (firstOntoSecond <= secondOntoFirst)
+            {
+                collapses.push_back({edge.first, edge.second, firstOntoSecond});
+            }
+            else
+            {
+                collapses.push_back({edge.second, edge.first, secondOntoFirst});
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const collapse & a, const collapse & b) {
+            return a.cost < b.cost;
+        });
+
+        std::iota(remap.begin(), remap.end(), 0);
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+        size_t removed = 0;
+        size_t applied = 0;
+
+        for (const collapse & candidate : collapses)
+        {
+            if (candidate.cost > maximumCost || removed >= trianglesToRemove)
+            {
+                break;
+            }
+            if (touched[candidate.from] || touched[candidate.to])
+            {
+                continue;
+            }
+
+            // Triangles around from must keep their orientation once it sits on to
+            glm::vec3 target = position(vertices, candidate.to);
+            size_t collapsing = 0;
+            bool flips = false;
+            for (uint32_t k = adjacencyOffsets[candidate.from]; k < adjacencyOffsets[candidate.from + 1] && !flips; ++k)
+            {
+                uint32_t triangle = adjacency[k];
+                uint32_t corners[3];
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    corners[corner] = canonical[remap[result[triangle * 3 + corner]]];
+                }
+                if (corners[0] == corners[1] || corners[1] == corners[2] || corners[0] == corners[2])
+                {
+                    continue;
+                }
+                if (corners[0] == candidate.to || corners[1] == candidate.to || corners[2] == candidate.to)
+                {
+                    ++collapsing;
+                    continue;
+                }
+
+                glm::vec3 before[3];
+                glm::vec3 after[3];
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    before[corner] = position(vertices, corners[corner]);
+                    after[corner] = corners[corner] == candidate.from ? target : before[corner];
+                }
+                glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                // Turning a triangle by more than ~80 degrees counts too, a few such steps flip it
+                flips = glm::dot(normalBefore, normalAfter) <= 0.2f * glm::length(normalBefore) * glm::length(normalAfter);
+            }
+            if (flips)
+            {
+                continue;
+            }
+
+            // from has a single vertex, it is not a seam.  Use to's closest match.
+            uint32_t best = wedges[wedgeOffsets[candidate.to]];
+            float bestDistance = std::numeric_limits<float>::max();
+            for (uint32_t k = wedgeOffsets[candidate.to]; k < wedgeOffsets[candidate.to + 1]; ++k)
+            {
+                float distance = attributeDistance(vertices[candidate.from], vertices[wedges[k]]);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = wedges[k];
+                }
+            }
+
+            remap[candidate.from] = best;
+            quadrics[candidate.to].add(quadrics[candidate.from]);
+            touched[candidate.from] = 1;
+            touched[candidate.to] = 1;
+            removed += collapsing;
+            worstCost = std::max(worstCost, candidate.cost);
+            ++applied;
+        }
+
+        if (applied == 0)
+        {
+            break;
+        }
+
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            uint32_t a = remap[result[i]];
+            uint32_t b = remap[result[i + 1]];
+            uint32_t c = remap[result[i + 2]];
+            if (canonical[a] == canonical[b] || canonical[b] == canonical[c] || canonical[a] == canonical[c])
+            {
+                continue;
+            }
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (resultError)
+    {
+        *resultError = static_cast<float>(std::sqrt(worstCost));
+    }
+    return result;
+}
+
+meshSimplifier::lodChain meshSimplifier::buildLodChain(const meshLoader::mesh & mesh, uint32_t maxLevels, float reduction)
+{
+    lodChain chain;
+    chain.indices = mesh.indices;
+    chain.levels.push_back({0, static_cast<uint32_t>(mesh.indices.size()), 0.0f});
+    if (mesh.vertices.empty())
+    {
+        return chain;
+    }
+
+    // Coarse levels are only drawn when the object is small on screen, so the cap
+    // is generous; it only stops the simplifier from destroying the silhouette
+    glm::vec3 low = mesh.vertices[0].pos;
+    glm::vec3 high = low;
+    for (const Vertex & vertex : mesh.vertices)
+    {
+        low = glm::min(low, glm::vec3(vertex.pos));
+        high = glm::max(high, glm::vec3(vertex.pos));
+    }
+    float maxError = glm::length(high - low) * 0.05f;
+
+    float target = static_cast<float>(mesh.indices.size());
+    size_t previousCount = mesh.indices.size();
+    for (uint32_t level = 1; level < maxLevels; ++level)
+    {
+        // Each level starts from the full mesh so its error is measured against it
+        target *= reduction;
+        float error = 0.0f;
+        std::vector<uint32_t> simplified = simplify(mesh.indices, mesh.vertices, static_cast<size_t>(target) / 3 * 3, maxError, &error);
+
+        // Locked borders and seams put a floor under the triangle count
+        if (simplified.empty() || simplified.size() * 10 > previousCount * 9)
+        {
+            break;
+        }
+
+        simplified = meshOptimizer::optimizeVertexCache(simplified, mesh.vertices.size());
+        chain.levels.push_back({static_cast<uint32_t>(chain.indices.size()),
+                                static_cast<uint32_t>(simplified.size()),
+                                std::max(error, chain.levels.back().error)});
+        chain.indices.insert(chain.indices.end(), simplified.begin(), simplified.end());
+        previousCount = simplified.size();
+    }
+    return chain;
+}
+
+uint32_t meshSimplifier::selectLod(const lodChain & chain, float pixelsPerUnit, float pixelThreshold, uint32_t currentLevel)
+{
+    // Fraction of the threshold a coarser level has to be under before switching to it
+    const float hysteresis = 0.75f;
+
+    uint32_t level = 0;
+    for (uint32_t i = 1; i < chain.levels.size(); ++i)
+    {
+        float limit = i > currentLevel ? pixelThreshold * hysteresis : pixelThreshold;
+        if (chain.levels[i].error * pixelsPerUnit > limit)
+        {
+            break;
+        }
+        level = i;
+    }
+    return level;
+}
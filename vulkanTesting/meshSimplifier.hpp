@@ -0,0 +1,54 @@
+//
+//  meshSimplifier.hpp
+//  vulkanTesting
+//
+
+#ifndef meshSimplifier_hpp
+#define meshSimplifier_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "meshLoader.hpp"
+
+// Level of detail generation by edge collapse with quadric error metrics
+// (Garland & Heckbert 1997).  Edges collapse onto one of their endpoints instead
+// of an optimal new position, so every level indexes the original vertices and
+// the whole chain shares one vertex buffer.
+namespace meshSimplifier {
+
+    // Collapses the cheapest edges until the index count drops to targetIndexCount or
+    // the next collapse would move the surface further than targetError (model units).
+    // Open borders and attribute seams (one position, several vertices) stay put.
+    // resultError receives the largest error introduced, in model units.
+    std::vector<uint32_t> simplify(const std::vector<uint32_t> & indices,
+                                   const std::vector<Vertex> & vertices,
+                                   size_t targetIndexCount,
+                                   float targetError,
+                                   float * resultError = nullptr);
+
+    struct lod {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float error; // model units, 0 for the full detail level
+    };
+
+    // Every level back to back in one index buffer, finest first
+    struct lodChain {
+        std::vector<uint32_t> indices;
+        std::vector<lod> levels;
+    };
+
+    // Each level aims for reduction times the triangles of the one before, stopping at
+    // maxLevels or when the mesh no longer simplifies.  Levels are cache optimized.
+    lodChain buildLodChain(const meshLoader::mesh & mesh, uint32_t maxLevels = 6, float reduction = 0.5f);
+
+    // Coarsest level whose error stays under pixelThreshold on screen.  pixelsPerUnit is
+    // the projected size of one model unit at the object's distance.  Moving to a
+    // coarser level needs a margin below the threshold, so an object sitting near
+    // a switching distance does not flicker between two levels.
+    uint32_t selectLod(const lodChain & chain, float pixelsPerUnit, float pixelThreshold, uint32_t currentLevel);
+}
+
+#endif /* meshSimplifier_hpp */
@@ -0,0 +1,209 @@
+//
+//  meshlet.cpp
+//  vulkanTesting
+//
+
+#include "meshlet.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    // Ritter's sphere: good to within a few percent of the minimal one and linear
+    void boundingSphere(const std::vector<glm::vec3> & points, glm::vec3 & center, float & radius)
+    {
+        auto farthest = [&points](const glm::vec3 & from) {
+            size_t best = 0;
+            float bestDistance = -1.0f;
+            for (size_t i = 0; i < points.size(); ++i)
+            {
+                glm::vec3 offset = points[i] - from;
+                float distance = glm::dot(offset, offset);
+                if (distance > bestDistance)
+                {
+                    bestDistance = distance;
+                    best = i;
+                }
+            }
+            return points[best];
+        };
+
+        glm::vec3 a = farthest(points[0]);
+        glm::vec3 b = farthest(a);
+        center = (a + b) * 0.5f;
+        radius = glm::length(b - a) * 0.5f;
+
+        for (const glm::vec3 & point : points)
+        {
+            float distance = glm::length(point - center);
+            if (distance > radius)
+            {
+                float grownRadius = (radius + distance) * 0.5f;
+                center = center + (point - center) * ((grownRadius - radius) / distance);
+                radius = grownRadius;
+            }
+        }
+    }
+
+    void computeBounds(const std::vector<Vertex> & vertices, const uint32_t * indices, uint32_t indexCount, meshlet::cluster & cluster)
+    {
+        std::vector<glm::vec3> points;
+        points.reserve(indexCount);
+        glm::vec3 normalSum(0.0f);
+        std::vector<glm::vec3> normals;
+        normals.reserve(indexCount / 3);
+
+        for (uint32_t i = 0; i < indexCount; i += 3)
+        {
+            glm::vec3 a = vertices[indices[i]].pos;
+            glm::vec3 b = vertices[indices[i + 1]].pos;
+            glm::vec3 c = vertices[indices[i + 2]].pos;
+            points.push_back(a);
+            points.push_back(b);
+            points.push_back(c);
+
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float length = glm::length(normal);
+            // Degenerate triangles are never drawn, so they do not widen the cone
+            if (length > 0.0f)
+            {
+                normals.push_back(normal / length);
+                normalSum = normalSum + normals.back();
+            }
+        }
+
+        glm::vec3 center;
+        float radius;
+        boundingSphere(points, center, radius);
+        cluster.center = center;
+        cluster.radius = radius;
+
+        cluster.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+        cluster.coneCutoff = 1.0f;
+
+        float sumLength = glm::length(normalSum);
+        if (normals.empty() || sumLength == 0.0f)
+        {
+            return;
+        }
+        glm::vec3 axis = normalSum / sumLength;
+        float minimumDot = 1.0f;
+        for (const glm::vec3 & normal : normals)
+        {
+            minimumDot = std::min(minimumDot, glm::dot(axis, normal));
+        }
+        cluster.coneAxis = axis;
+        // Cones wider than a hemisphere can never be entirely backfacing
+        if (minimumDot > 0.0f)
+        {
+            // The test compares against the sine of the cone's half angle
+            cluster.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+        }
+    }
+}
+
+meshlet::clusterSet meshlet::build(const meshLoader::mesh & mesh, uint32_t vertexLimit, uint32_t triangleLimit)
+{
+    return build(mesh.indices, mesh.vertices, vertexLimit, triangleLimit);
+}
+
+meshlet::clusterSet meshlet::build(const std::vector<uint32_t> & indices,
+                                   const std::vector<Vertex> & vertices,
+                                   uint32_t vertexLimit,
+                                   uint32_t triangleLimit)
+{
+    clusterSet result;
+    result.indices.reserve(indices.size());
+
+    // Cluster that last referenced each vertex, so membership is one lookup
+    std::vector<uint32_t> owner(vertices.size(), 0xFFFFFFFFu);
+    uint32_t currentIndex = 0;
+    cluster current = {};
+
+    auto newVertices = [&](const uint32_t * triangle) {
+        uint32_t count = 0;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            bool repeated = (corner > 0 && triangle[corner] == triangle[0]) || (corner > 1 && triangle[corner] == triangle[1]);
+            if (owner[triangle[corner]] != currentIndex && !repeated)
+            {
+                ++count;
+            }
+        }
+        return count;
+    };
+
+    auto finish = [&]() {
+        computeBounds(vertices, result.indices.data() + current.indexOffset, current.indexCount, current);
+        result.clusters.push_back(current);
+        current = cluster();
+        current.indexOffset = static_cast<uint32_t>(result.indices.size());
+        ++currentIndex;
+    };
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const uint32_t * triangle = &indices[i];
+
+        uint32_t added = newVertices(triangle);
+        if (current.indexCount > 0 &&
+            (current.vertexCount + added > vertexLimit || current.indexCount / 3 + 1 > triangleLimit))
+        {
+            finish();
+            added = newVertices(triangle);
+        }
+
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            owner[triangle[corner]] = currentIndex;
+            result.indices.push_back(triangle[corner]);
+        }
+        current.vertexCount += added;
+        current.indexCount += 3;
+    }
+    if (current.indexCount > 0)
+    {
+        finish();
+    }
+
+    return result;
+}
+
+std::vector<meshlet::gpuCluster> meshlet::pack(const clusterSet & clusterSet)
+{
+    std::vector<gpuCluster> packed(clusterSet.clusters.size());
+    for (size_t i = 0; i < clusterSet.clusters.size(); ++i)
+    {
+        const cluster & source = clusterSet.clusters[i];
+        gpuCluster & destination = packed[i];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            destination.sphere[axis] = source.center[axis];
+            destination.cone[axis] = source.coneAxis[axis];
+        }
+        destination.sphere[3] = source.radius;
+        destination.cone[3] = source.coneCutoff;
+        destination.indexOffset = source.indexOffset;
+        destination.indexCount = source.indexCount;
+        destination.padding[0] = 0;
+        destination.padding[1] = 0;
+    }
+    return packed;
+}
+
+bool meshlet::isVisible(const cluster & cluster, const float planes[6][4], const float cameraPosition[3])
+{
+    for (int plane = 0; plane < 6; ++plane)
+    {
+        float distance = planes[plane][0] * cluster.center[0] +
+                         planes[plane][1] * cluster.center[1] +
+                         planes[plane][2] * cluster.center[2] + planes[plane][3];
+        if (distance < -cluster.radius)
+        {
+            return false;
+        }
+    }
+
+    glm::vec3 toCluster = glm::vec3(cluster.center) - glm::vec3(cameraPosition[0], cameraPosition[1], cameraPosition[2]);
+    return glm::dot(toCluster, glm::vec3(cluster.coneAxis)) < cluster.coneCutoff * glm::length(toCluster) + cluster.radius;
+}
@@ -0,0 +1,101 @@
+//
+//  meshlet.hpp
+//  vulkanTesting
+//
+
+#ifndef meshlet_hpp
+#define meshlet_hpp
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_aligned.hpp>
+
+#include "meshLoader.hpp"
+
+// Splits an indexed mesh into small clusters of triangles with bounds that can be
+// culled as a unit: a bounding sphere for the frustum test and a normal cone for
+// the backface test.  The builder is pure CPU and runs when the mesh is loaded;
+// the per frame test runs on the GPU in shaders/cull.comp, isVisible is the same
+// test for tools and debugging.
+namespace meshlet {
+
+    // Limits that suit both the post-transform cache and a 64 wide workgroup
+    const uint32_t maxVertices = 64;
+    const uint32_t maxTriangles = 124;
+
+    struct cluster {
+        uint32_t indexOffset;  // into clusterSet::indices
+        uint32_t indexCount;   // three per triangle
+        uint32_t vertexCount;  // unique vertices referenced
+        glm::packed_vec3 center;
+        float radius;
+        // Every triangle is backfacing for a viewer at p when
+        // dot(center - p, coneAxis) >= coneCutoff * |center - p| + radius.
+        // coneCutoff is 1 when the normals spread too far for the test to ever pass.
+        glm::packed_vec3 coneAxis;
+        float coneCutoff;
+    };
+
+    struct clusterSet {
+        std::vector<cluster> clusters;
+        // Triangles of every cluster back to back, indexing the mesh's vertices
+        std::vector<uint32_t> indices;
+    };
+
+    // Layout of one element of the cluster storage buffer read by cull.comp (std430)
+    struct gpuCluster {
+        float sphere[4];  // center, radius
+        float cone[4];    // axis, cutoff
+        uint32_t indexOffset;
+        uint32_t indexCount;
+        uint32_t padding[2];
+    };
+
+    static_assert(sizeof(gpuCluster) == 48, "gpuCluster must match Cluster in cull.comp");
+
+    // Greedy in index order, so run it after meshOptimizer to get compact clusters
+    clusterSet build(const meshLoader::mesh & mesh,
+                     uint32_t vertexLimit = maxVertices,
+                     uint32_t triangleLimit = maxTriangles);
+
+    // Same for part of an index buffer, e.g. one level of a LOD chain
+    clusterSet build(const std::vector<uint32_t> & indices,
+                     const std::vector<Vertex> & vertices,
+                     uint32_t vertexLimit = maxVertices,
+                     uint32_t triangleLimit = maxTriangles);
+
+    std::vector<gpuCluster> pack(const clusterSet & clusterSet);
+
+    // planes are normalized, inside is dot(xyz, p) + w >= 0.  Both in model space.
+    bool isVisible(const cluster & cluster, const float planes[6][4], const float cameraPosition[3]);
+
+    // Frustum planes in the space modelViewProjection maps from, normalized.  The near
+    // plane is -w <= z, which is exact for OpenGL depth and conservative for Vulkan's.
+    // A template so each translation unit passes its own glm matrix type.
+    template <typename Matrix>
+    void frustumPlanes(const Matrix & modelViewProjection, float planes[6][4])
+    {
+        for (int plane = 0; plane < 6; ++plane)
+        {
+            int row = plane / 2;
+            float sign = (plane % 2 == 0) ? 1.0f : -1.0f;
+            for (int column = 0; column < 4; ++column)
+            {
+                planes[plane][column] = modelViewProjection[column][3] + sign * modelViewProjection[column][row];
+            }
+            float length = std::sqrt(planes[plane][0] * planes[plane][0] +
+                                     planes[plane][1] * planes[plane][1] +
+                                     planes[plane][2] * planes[plane][2]);
+            for (int column = 0; column < 4; ++column)
+            {
+                planes[plane][column] /= length;
+            }
+        }
+    }
+}
+
+#endif /* meshlet_hpp */
@@ -0,0 +1,931 @@
+//
+//  renderGraph.cpp
+//  vulkanTesting
+//
+
+#include "renderGraph.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+    struct usageInfo {
+        VkPipelineStageFlags stages;
+        VkAccessFlags readAccess;
+        VkAccessFlags writeAccess; // 0 when the usage cannot write
+        VkImageLayout readLayout;
+        VkImageLayout writeLayout;
+        VkImageUsageFlags readImageUsage;
+        VkImageUsageFlags writeImageUsage;
+    };
+
+    // Indexed by renderGraph::usage
+    const usageInfo usages[] = {
+        // colorAttachment, written with the read so blending and LOAD_OP_LOAD work
+        {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+         VK_ACCESS_COLOR_ATTACHMENT_READ_BIT,
+         VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+         VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+         VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT},
+        // depthAttachment
+        {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+         VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+         VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+         VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT},
+        // fragmentSampled
+        {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+         VK_ACCESS_SHADER_READ_BIT,
+         0,
+         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+         VK_IMAGE_LAYOUT_UNDEFINED,
+         VK_IMAGE_USAGE_SAMPLED_BIT,
+         0},
+        // computeSampled
+        {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+         VK_ACCESS_SHADER_READ_BIT,
+         0,
+         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+         VK_IMAGE_LAYOUT_UNDEFINED,
+         VK_IMAGE_USAGE_SAMPLED_BIT,
+         0},
+        // storage
+        {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+         VK_ACCESS_SHADER_READ_BIT,
+         VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+         VK_IMAGE_LAYOUT_GENERAL,
+         VK_IMAGE_LAYOUT_GENERAL,
+         VK_IMAGE_USAGE_STORAGE_BIT,
+         VK_IMAGE_USAGE_STORAGE_BIT},
+        // transfer
+        {VK_PIPELINE_STAGE_TRANSFER_BIT,
+         VK_ACCESS_TRANSFER_READ_BIT,
+         VK_ACCESS_TRANSFER_WRITE_BIT,
+         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+         VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+         VK_IMAGE_USAGE_TRANSFER_DST_BIT},
+        // indirectBuffer
+        {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, 0,
+         VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED, 0, 0},
+        // indexBuffer
+        {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, 0,
+         VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED, 0, 0},
+        // vertexBuffer
+        {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, 0,
+         VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED, 0, 0}
+    };
+
+    // Only writes have to be made available to later accesses
+    const VkAccessFlags writeAccessMask = VK_ACCESS_SHADER_WRITE_BIT |
+                                          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                          VK_ACCESS_TRANSFER_WRITE_BIT |
+                                          VK_ACCESS_HOST_WRITE_BIT |
+                                          VK_ACCESS_MEMORY_WRITE_BIT;
+
+    // What the barriers have done to a resource so far in the frame
+    struct resourceState {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags writeStages = 0;  // last write, or what a later access must wait for
+        VkAccessFlags writeAccess = 0;
+        VkPipelineStageFlags readStages = 0;   // reads since then
+        VkPipelineStageFlags visibleStages = 0; // stages and access the last write is visible to
+        VkAccessFlags visibleAccess = 0;
+        bool started = false;
+    };
+
+    uint32_t findMemoryType(const VkPhysicalDeviceMemoryProperties & memoryProperties, uint32_t typeBits)
+    {
+        // device local first, transient images never leave the GPU
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+        {
+            if ((typeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+            {
+                return i;
+            }
+        }
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+        {
+            if (typeBits & (1u << i))
+            {
+                return i;
+            }
+        }
+        throw std::runtime_error("failed to find suitable memory type for render graph!");
+    }
+
+    std::string hex(uint32_t value)
+    {
+        std::ostringstream out;
+        out << "0x" << std::hex << value;
+        return out.str();
+    }
+}
+
+const uint32_t renderGraph::noBlock = ~0u;
+
+bool renderGraph::barrier::operator==(const barrier & other) const
+{
+    return target == other.target &&
+           srcStages == other.srcStages &&
+           srcAccess == other.srcAccess &&
+           dstStages == other.dstStages &&
+           dstAccess == other.dstAccess &&
+           oldLayout == other.oldLayout &&
+           newLayout == other.newLayout;
+}
+
+renderGraph::renderGraph()
+{
+}
+
+void renderGraph::clear()
+{
+    _resources.clear();
+    _passes.clear();
+    _steps.clear();
+    _finalBarriers.clear();
+    _blocks.clear();
+}
+
+renderGraph::resource renderGraph::addResource(const std::string & name, bool isImage, bool imported)
+{
+    resourceInfo info;
+    info.name = name;
+    info.isImage = isImage;
+    info.imported = imported;
+    info.output = false;
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    info.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    info.initialStages = 0;
+    info.initialAccess = 0;
+    info.imageUsage = 0;
+    info.firstStep = 0;
+    info.lastStep = 0;
+    info.block = noBlock;
+    info.previousInBlock = noBlock;
+    info.image = VK_NULL_HANDLE;
+    info.view = VK_NULL_HANDLE;
+    info.buffer = VK_NULL_HANDLE;
+    _resources.push_back(info);
+    return static_cast<resource>(_resources.size() - 1);
+}
+
+renderGraph::resource renderGraph::importImage(const std::string & name,
+                                               const imageDescription & description,
+                                               VkImageLayout initialLayout,
+                                               VkImageLayout finalLayout,
+                                               VkPipelineStageFlags initialStages)
+{
+    resource image = addResource(name, true, true);
+    _resources[image].description = description;
+    _resources[image].initialLayout = initialLayout;
+    _resources[image].finalLayout = finalLayout;
+    _resources[image].initialStages = initialStages;
+    return image;
+}
+
+renderGraph::resource renderGraph::importBuffer(const std::string & name,
+                                                VkPipelineStageFlags initialStages,
+                                                VkAccessFlags initialAccess)
+{
+    resource buffer = addResource(name, false, true);
+    _resources[buffer].initialStages = initialStages;
+    _resources[buffer].initialAccess = initialAccess;
+    return buffer;
+}
+
+renderGraph::resource renderGraph::createImage(const std::string & name, const imageDescription & description)
+{
+    resource image = addResource(name, true, false);
+    _resources[image].description = description;
+    return image;
+}
+
+renderGraph::pass renderGraph::addPass(const std::string & name, recordFunction record)
+{
+    passInfo info;
+    info.name = name;
+    info.record = record;
+    info.culled = false;
+    _passes.push_back(info);
+    return static_cast<pass>(_passes.size() - 1);
+}
+
+void renderGraph::read(pass aPass, resource aResource, usage aUsage)
+{
+    use(aPass, aResource, aUsage, false);
+}
+
+void renderGraph::write(pass aPass, resource aResource, usage aUsage)
+{
+    use(aPass, aResource, aUsage, true);
+}
+
+void renderGraph::use(pass aPass, resource aResource, usage aUsage, bool write)
+{
+    const usageInfo & info = usages[aUsage];
+    if (write && info.writeAccess == 0)
+    {
+        throw std::runtime_error("render graph pass " + _passes[aPass].name + " cannot write " + _resources[aResource].name + " with a read only usage!");
+    }
+    if (_resources[aResource].isImage && info.readLayout == VK_IMAGE_LAYOUT_UNDEFINED)
+    {
+        throw std::runtime_error("render graph pass " + _passes[aPass].name + " uses image " + _resources[aResource].name + " as a buffer!");
+    }
+
+    access anAccess;
+    anAccess.target = aResource;
+    anAccess.write = write;
+    anAccess.stages = info.stages;
+    anAccess.accessMask = write ? info.writeAccess : info.readAccess;
+    anAccess.layout = _resources[aResource].isImage ? (write ? info.writeLayout : info.readLayout) : VK_IMAGE_LAYOUT_UNDEFINED;
+    _resources[aResource].imageUsage |= write ? info.writeImageUsage : info.readImageUsage;
+
+    // a second use of the same resource in a pass folds into the first
+    for (access & existing : _passes[aPass].accesses)
+    {
+        if (existing.target == aResource)
+        {
+            if (existing.layout != anAccess.layout)
+            {
+                throw std::runtime_error("render graph pass " + _passes[aPass].name + " needs " + _resources[aResource].name + " in two layouts!");
+            }
+            existing.write = existing.write || write;
+            existing.stages |= anAccess.stages;
+            existing.accessMask |= anAccess.accessMask;
+            return;
+        }
+    }
+    _passes[aPass].accesses.push_back(anAccess);
+}
+
+void renderGraph::markOutput(resource aResource)
+{
+    _resources[aResource].output = true;
+}
+
+void renderGraph::cullAndSchedule()
+{
+    size_t passCount = _passes.size();
+
+    // Passes are declared in an order that works, so the accesses are resolved in
+    // it.  Reads and writes after a write need the writer; writes after reads, and
+    // reads in another layout, need the readers finished but do not need them to
+    // exist.
+    std::vector<std::vector<pass>> producers(passCount);
+    std::vector<std::vector<pass>> dependencies(passCount);
+    std::vector<int64_t> lastWriter(_resources.size(), -1);
+    std::vector<std::vector<pass>> readers(_resources.size());
+    std::vector<VkImageLayout> readLayout(_resources.size(), VK_IMAGE_LAYOUT_UNDEFINED);
+    for (pass p = 0; p < passCount; ++p)
+    {
+        for (const access & anAccess : _passes[p].accesses)
+        {
+            if (lastWriter[anAccess.target] >= 0)
+            {
+                producers[p].push_back(static_cast<pass>(lastWriter[anAccess.target]));
+                dependencies[p].push_back(static_cast<pass>(lastWriter[anAccess.target]));
+            }
+            if (anAccess.write)
+            {
+                dependencies[p].insert(dependencies[p].end(), readers[anAccess.target].begin(), readers[anAccess.target].end());
+                readers[anAccess.target].clear();
+                lastWriter[anAccess.target] = p;
+            }
+            else
+            {
+                if (!readers[anAccess.target].empty() && readLayout[anAccess.target] != anAccess.layout)
+                {
+                    dependencies[p].insert(dependencies[p].end(), readers[anAccess.target].begin(), readers[anAccess.target].end());
+                    readers[anAccess.target].clear();
+                }
+                readers[anAccess.target].push_back(p);
+                readLayout[anAccess.target] = anAccess.layout;
+            }
+        }
+    }
+
+    // keep whatever leads to a write of an imported or output resource
+    std::vector<pass> live;
+    for (pass p = 0; p < passCount; ++p)
+    {
+        _passes[p].culled = true;
+        for (const access & anAccess : _passes[p].accesses)
+        {
+            const resourceInfo & target = _resources[anAccess.target];
+            if (anAccess.write && (target.imported || target.output))
+            {
+                live.push_back(p);
+                _passes[p].culled = false;
+                break;
+            }
+        }
+    }
+    while (!live.empty())
+    {
+        pass p = live.back();
+        live.pop_back();
+        for (pass producer : producers[p])
+        {
+            if (_passes[producer].culled)
+            {
+                _passes[producer].culled = false;
+                live.push_back(producer);
+            }
+        }
+    }
+
+    // each pass goes one step after the latest pass it depends on
+    std::vector<uint32_t> stepOf(passCount, 0);
+    uint32_t stepCount = 0;
+    for (pass p = 0; p < passCount; ++p)
+    {
+        if (_passes[p].culled)
+        {
+            continue;
+        }
+        for (pass dependency : dependencies[p])
+        {
+            if (!_passes[dependency].culled)
+            {
+                stepOf[p] = std::max(stepOf[p], stepOf[dependency] + 1);
+            }
+        }
+        stepCount = std::max(stepCount, stepOf[p] + 1);
+    }
+
+    _steps.assign(stepCount, step());
+    for (pass p = 0; p < passCount; ++p)
+    {
+        if (!_passes[p].culled)
+        {
+            _steps[stepOf[p]].passes.push_back(p);
+        }
+    }
+}
+
+void renderGraph::assignMemory(const std::vector<VkMemoryRequirements> & requirements)
+{
+    _blocks.clear();
+
+    // lifetimes in steps
+    std::vector<resource> transients;
+    for (resource r = 0; r < _resources.size(); ++r)
+    {
+        resourceInfo & info = _resources[r];
+        info.block = noBlock;
+        info.previousInBlock = noBlock;
+        if (info.imported)
+        {
+            continue;
+        }
+
+        bool used = false;
+        for (uint32_t s = 0; s < _steps.size(); ++s)
+        {
+            for (pass p : _steps[s].passes)
+            {
+                for (const access & anAccess : _passes[p].accesses)
+                {
+                    if (anAccess.target == r)
+                    {
+                        info.firstStep = used ? info.firstStep : s;
+                        info.lastStep = s;
+                        used = true;
+                    }
+                }
+            }
+        }
+        if (used)
+        {
+            transients.push_back(r);
+        }
+    }
+
+    // Largest first, each into the first block whose memory types fit and whose
+    // residents are all dead before it starts or born after it ends
+    auto requirementOf = [&](resource r) {
+        VkMemoryRequirements unknown = {0, 1, ~0u};
+        return r < requirements.size() ? requirements[r] : unknown;
+    };
+    std::stable_sort(transients.begin(), transients.end(), [&](resource a, resource b) {
+        return requirementOf(a).size > requirementOf(b).size;
+    });
+    for (resource r : transients)
+    {
+        VkMemoryRequirements requirement = requirementOf(r);
+        resourceInfo & info = _resources[r];
+
+        uint32_t chosen = noBlock;
+        for (uint32_t b = 0; b < _blocks.size() && chosen == noBlock; ++b)
+        {
+            if ((_blocks[b].memoryTypeBits & requirement.memoryTypeBits) == 0)
+            {
+                continue;
+            }
+            bool overlaps = false;
+            for (resource resident : _blocks[b].residents)
+            {
+                const resourceInfo & other = _resources[resident];
+                overlaps = overlaps || !(other.lastStep < info.firstStep || info.lastStep < other.firstStep);
+            }
+            if (!overlaps)
+            {
+                chosen = b;
+            }
+        }
+        if (chosen == noBlock)
+        {
+            memoryBlock block;
+            block.size = 0;
+            block.alignment = 1;
+            block.memoryTypeBits = ~0u;
+            block.stages = 0;
+            block.writeAccess = 0;
+            block.memory = VK_NULL_HANDLE;
+            _blocks.push_back(block);
+            chosen = static_cast<uint32_t>(_blocks.size() - 1);
+        }
+
+        memoryBlock & block = _blocks[chosen];
+        block.size = std::max(block.size, requirement.size);
+        block.alignment = std::max(block.alignment, requirement.alignment);
+        block.memoryTypeBits &= requirement.memoryTypeBits;
+        block.residents.push_back(r);
+        info.block = chosen;
+    }
+
+    for (const step & aStep : _steps)
+    {
+        for (pass p : aStep.passes)
+        {
+            for (const access & anAccess : _passes[p].accesses)
+            {
+                uint32_t block = _resources[anAccess.target].block;
+                if (!_resources[anAccess.target].imported && block != noBlock)
+                {
+                    _blocks[block].stages |= anAccess.stages;
+                    _blocks[block].writeAccess |= anAccess.write ? anAccess.accessMask & writeAccessMask : 0;
+                }
+            }
+        }
+    }
+
+    // the resident before each one, whose last use its first use must wait for
+    for (memoryBlock & block : _blocks)
+    {
+        std::sort(block.residents.begin(), block.residents.end(), [&](resource a, resource b) {
+            return _resources[a].firstStep < _resources[b].firstStep;
+        });
+        for (size_t i = 1; i < block.residents.size(); ++i)
+        {
+            _resources[block.residents[i]].previousInBlock = block.residents[i - 1];
+        }
+    }
+}
+
+void renderGraph::buildBarriers()
+{
+    std::vector<resourceState> states(_resources.size());
+    for (resource r = 0; r < _resources.size(); ++r)
+    {
+        if (_resources[r].imported)
+        {
+            states[r].layout = _resources[r].initialLayout;
+            states[r].writeStages = _resources[r].initialStages;
+            states[r].writeAccess = _resources[r].initialAccess;
+            states[r].started = true;
+        }
+    }
+
+    for (step & aStep : _steps)
+    {
+        aStep.barriers.clear();
+        for (pass p : aStep.passes)
+        {
+            for (const access & anAccess : _passes[p].accesses)
+            {
+                const resourceInfo & info = _resources[anAccess.target];
+                resourceState & state = states[anAccess.target];
+
+                // A transient starts with undefined contents, after the image that
+                // used its memory before it.  The first one in a block follows the
+                // previous frame, which may still be in flight.
+                if (!state.started)
+                {
+                    if (info.previousInBlock != noBlock)
+                    {
+                        const resourceState & previous = states[info.previousInBlock];
+                        state.writeStages = previous.writeStages | previous.readStages;
+                        state.writeAccess = previous.writeAccess;
+                    }
+                    else if (info.block != noBlock)
+                    {
+                        state.writeStages = _blocks[info.block].stages;
+                        state.writeAccess = _blocks[info.block].writeAccess;
+                    }
+                    state.started = true;
+                }
+
+                bool layoutChange = info.isImage && state.layout != anAccess.layout;
+                bool visible = (anAccess.stages & ~state.visibleStages) == 0 && (anAccess.accessMask & ~state.visibleAccess) == 0;
+
+                bool needed = false;
+                VkPipelineStageFlags srcStages = state.writeStages;
+                if (anAccess.write)
+                {
+                    // after every earlier read and write, or the layout change
+                    needed = layoutChange || ((state.writeStages | state.readStages) & ~VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT) != 0;
+                    srcStages |= state.readStages;
+                }
+                else if (layoutChange)
+                {
+                    needed = true;
+                    srcStages |= state.readStages;
+                }
+                else
+                {
+                    needed = (state.writeStages & ~VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT) != 0 && !visible;
+                }
+
+                if (needed)
+                {
+                    barrier aBarrier;
+                    aBarrier.target = anAccess.target;
+                    aBarrier.srcStages = srcStages != 0 ? srcStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+                    aBarrier.srcAccess = state.writeAccess;
+                    aBarrier.dstStages = anAccess.stages;
+                    aBarrier.dstAccess = anAccess.accessMask;
+                    aBarrier.oldLayout = info.isImage ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+                    aBarrier.newLayout = info.isImage ? anAccess.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+
+                    // passes of one step reading the same resource share its barrier
+                    bool merged = false;
+                    for (barrier & existing : aStep.barriers)
+                    {
+                        if (existing.target == aBarrier.target)
+                        {
+                            if (existing.newLayout != aBarrier.newLayout)
+                            {
+                                throw std::runtime_error("render graph needs " + info.name + " in two layouts at once!");
+                            }
+                            existing.dstStages |= aBarrier.dstStages;
+                            existing.dstAccess |= aBarrier.dstAccess;
+                            merged = true;
+                        }
+                    }
+                    if (!merged)
+                    {
+                        aStep.barriers.push_back(aBarrier);
+                    }
+                }
+
+                if (anAccess.write)
+                {
+                    state.writeStages = anAccess.stages;
+                    state.writeAccess = anAccess.accessMask & writeAccessMask;
+                    state.readStages = 0;
+                    state.visibleStages = anAccess.stages;
+                    state.visibleAccess = anAccess.accessMask;
+                }
+                else if (layoutChange)
+                {
+                    // the transition is a write later readers wait for through this read
+                    state.writeStages = anAccess.stages;
+                    state.writeAccess = 0;
+                    state.readStages = anAccess.stages;
+                    state.visibleStages = anAccess.stages;
+                    state.visibleAccess = anAccess.accessMask;
+                }
+                else
+                {
+                    state.readStages |= anAccess.stages;
+                    if (needed)
+                    {
+                        state.visibleStages |= anAccess.stages;
+                        state.visibleAccess |= anAccess.accessMask;
+                    }
+                }
+                state.layout = anAccess.layout;
+            }
+        }
+    }
+
+    _finalBarriers.clear();
+    for (resource r = 0; r < _resources.size(); ++r)
+    {
+        const resourceInfo & info = _resources[r];
+        const resourceState & state = states[r];
+        if (!info.isImage || !info.imported || info.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || info.finalLayout == state.layout)
+        {
+            continue;
+        }
+
+        VkPipelineStageFlags usedStages = state.writeStages | state.readStages;
+
+        barrier aBarrier;
+        aBarrier.target = r;
+        aBarrier.srcStages = usedStages != 0 ? usedStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+        aBarrier.srcAccess = state.writeAccess;
+        aBarrier.dstStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        aBarrier.dstAccess = 0;
+        aBarrier.oldLayout = state.layout;
+        aBarrier.newLayout = info.finalLayout;
+        _finalBarriers.push_back(aBarrier);
+    }
+}
+
+void renderGraph::compile(const std::vector<VkMemoryRequirements> & requirements)
+{
+    cullAndSchedule();
+    assignMemory(requirements);
+    buildBarriers();
+}
+
+void renderGraph::allocate(VkDevice & device, const VkPhysicalDeviceMemoryProperties & memoryProperties)
+{
+    std::vector<VkMemoryRequirements> requirements(_resources.size(), VkMemoryRequirements());
+    for (resource r = 0; r < _resources.size(); ++r)
+    {
+        resourceInfo & info = _resources[r];
+        if (info.imported || info.imageUsage == 0)
+        {
+            continue;
+        }
+
+        // aliased images start undefined every time, so no initial layout matters
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = info.description.extent.width;
+        imageInfo.extent.height = info.description.extent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = info.description.mipLevels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = info.description.format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = info.imageUsage;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateImage(device, &imageInfo, nullptr, &info.image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render graph image " + info.name + "!");
+        }
+        vkGetImageMemoryRequirements(device, info.image, &requirements[r]);
+    }
+
+    compile(requirements);
+
+    for (memoryBlock & block : _blocks)
+    {
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = block.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memoryProperties, block.memoryTypeBits);
+
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate render graph memory!");
+        }
+    }
+
+    for (resource r = 0; r < _resources.size(); ++r)
+    {
+        resourceInfo & info = _resources[r];
+        if (info.imported || info.image == VK_NULL_HANDLE)
+        {
+            continue;
+        }
+        if (info.block == noBlock)
+        {
+            // every pass using it was culled
+            vkDestroyImage(device, info.image, nullptr);
+            info.image = VK_NULL_HANDLE;
+            continue;
+        }
+
+        vkBindImageMemory(device, info.image, _blocks[info.block].memory, 0);
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = info.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = info.description.format;
+        viewInfo.subresourceRange.aspectMask = info.description.aspect;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = info.description.mipLevels;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(device, &viewInfo, nullptr, &info.view) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render graph image view " + info.name + "!");
+        }
+    }
+}
+
+void renderGraph::destroy(VkDevice & device)
+{
+    for (resourceInfo & info : _resources)
+    {
+        if (info.imported)
+        {
+            continue;
+        }
+        if (info.view != VK_NULL_HANDLE)
+        {
+            vkDestroyImageView(device, info.view, nullptr);
+            info.view = VK_NULL_HANDLE;
+        }
+        if (info.image != VK_NULL_HANDLE)
+        {
+            vkDestroyImage(device, info.image, nullptr);
+            info.image = VK_NULL_HANDLE;
+        }
+    }
+    for (memoryBlock & block : _blocks)
+    {
+        if (block.memory != VK_NULL_HANDLE)
+        {
+            vkFreeMemory(device, block.memory, nullptr);
+            block.memory = VK_NULL_HANDLE;
+        }
+    }
+}
+
+void renderGraph::bindImage(resource aResource, VkImage image)
+{
+    _resources[aResource].image = image;
+}
+
+void renderGraph::bindBuffer(resource aResource, VkBuffer buffer)
+{
+    _resources[aResource].buffer = buffer;
+}
+
+void renderGraph::recordBarriers(VkCommandBuffer commandBuffer, const std::vector<barrier> & barriers) const
+{
+    if (barriers.empty())
+    {
+        return;
+    }
+
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    for (const barrier & aBarrier : barriers)
+    {
+        const resourceInfo & info = _resources[aBarrier.target];
+        srcStages |= aBarrier.srcStages;
+        dstStages |= aBarrier.dstStages;
+
+        if (info.isImage)
+        {
+            VkImageMemoryBarrier imageBarrier = {};
+            imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imageBarrier.srcAccessMask = aBarrier.srcAccess;
+            imageBarrier.dstAccessMask = aBarrier.dstAccess;
+            imageBarrier.oldLayout = aBarrier.oldLayout;
+            imageBarrier.newLayout = aBarrier.newLayout;
+            imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.image = info.image;
+            imageBarrier.subresourceRange.aspectMask = info.description.aspect;
+            imageBarrier.subresourceRange.baseMipLevel = 0;
+            imageBarrier.subresourceRange.levelCount = info.description.mipLevels;
+            imageBarrier.subresourceRange.baseArrayLayer = 0;
+            imageBarrier.subresourceRange.layerCount = 1;
+            imageBarriers.push_back(imageBarrier);
+        }
+        else
+        {
+            VkBufferMemoryBarrier bufferBarrier = {};
+            bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            bufferBarrier.srcAccessMask = aBarrier.srcAccess;
+            bufferBarrier.dstAccessMask = aBarrier.dstAccess;
+            bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.buffer = info.buffer;
+            bufferBarrier.offset = 0;
+            bufferBarrier.size = VK_WHOLE_SIZE;
+            bufferBarriers.push_back(bufferBarrier);
+        }
+    }
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         srcStages, dstStages,
+                         0 /* dependency flags */,
+                         0 /* memory barrier count */, nullptr,
+                         static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+                         static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+void renderGraph::execute(VkCommandBuffer commandBuffer, uint32_t imageIndex) const
+{
+    for (const step & aStep : _steps)
+    {
+        recordBarriers(commandBuffer, aStep.barriers);
+        for (pass p : aStep.passes)
+        {
+            _passes[p].record(commandBuffer, imageIndex);
+        }
+    }
+    recordBarriers(commandBuffer, _finalBarriers);
+}
+
+const std::vector<renderGraph::step> & renderGraph::getSteps() const
+{
+    return _steps;
+}
+
+const std::vector<renderGraph::barrier> & renderGraph::getFinalBarriers() const
+{
+    return _finalBarriers;
+}
+
+bool renderGraph::isCulled(pass aPass) const
+{
+    return _passes[aPass].culled;
+}
+
+uint32_t renderGraph::getMemoryBlock(resource aResource) const
+{
+    return _resources[aResource].block;
+}
+
+size_t renderGraph::getMemoryBlockCount() const
+{
+    return _blocks.size();
+}
+
+VkImage renderGraph::getImage(resource aResource) const
+{
+    return _resources[aResource].image;
+}
+
+VkImageView renderGraph::getImageView(resource aResource) const
+{
+    return _resources[aResource].view;
+}
+
+const std::string & renderGraph::getName(resource aResource) const
+{
+    return _resources[aResource].name;
+}
+
+std::string renderGraph::describe() const
+{
+    std::ostringstream out;
+    auto describeBarriers = [&](const std::vector<barrier> & barriers) {
+        for (const barrier & aBarrier : barriers)
+        {
+            out << "    barrier " << _resources[aBarrier.target].name
+                << " stages " << hex(aBarrier.srcStages) << " -> " << hex(aBarrier.dstStages)
+                << " access " << hex(aBarrier.srcAccess) << " -> " << hex(aBarrier.dstAccess);
+            if (_resources[aBarrier.target].isImage)
+            {
+                out << " layout " << aBarrier.oldLayout << " -> " << aBarrier.newLayout;
+            }
+            out << std::endl;
+        }
+    };
+
+    for (size_t s = 0; s < _steps.size(); ++s)
+    {
+        out << "step " << s << std::endl;
+        describeBarriers(_steps[s].barriers);
+        for (pass p : _steps[s].passes)
+        {
+            out << "    pass " << _passes[p].name << std::endl;
+        }
+    }
+    out << "final" << std::endl;
+    describeBarriers(_finalBarriers);
+
+    for (const passInfo & info : _passes)
+    {
+        if (info.culled)
+        {
+            out << "culled " << info.name << std::endl;
+        }
+    }
+    for (size_t b = 0; b < _blocks.size(); ++b)
+    {
+        out << "memory block " << b << ", " << _blocks[b].size << " bytes:";
+        for (resource r : _blocks[b].residents)
+        {
+            out << " " << _resources[r].name;
+        }
+        out << std::endl;
+    }
+    return out.str();
+}
@@ -0,0 +1,226 @@
+//
+//  renderGraph.hpp
+//  vulkanTesting
+//
+
+#ifndef renderGraph_hpp
+#define renderGraph_hpp
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+// Frame graph.  Passes declare which images and buffers they read and write and
+// how; compile() then works out the synchronization instead of it being written
+// by hand:
+//
+//   - passes that contribute nothing to an imported resource or one marked as an
+//     output are culled
+//   - the remaining passes are grouped into steps, each pass in the first step
+//     after everything it depends on, so the passes of a step are independent
+//   - every step gets one batch of image and buffer barriers covering all of its
+//     passes, with the layout transitions they need
+//   - transient images whose lifetimes do not overlap share memory, and the first
+//     one in a block waits for the block's use by the frame before
+//
+// Compiling needs no device, so the barrier lists can be checked on the CPU (see
+// tools/renderGraphCheck).  allocate() creates the transient images and compiles
+// with their real memory requirements.
+class renderGraph
+{
+public:
+    typedef uint32_t resource;
+    typedef uint32_t pass;
+
+    // Records a pass.  imageIndex is whatever execute() was given.
+    typedef std::function<void(VkCommandBuffer commandBuffer, uint32_t imageIndex)> recordFunction;
+
+    // How a pass uses a resource, which fixes the stages, access and image layout
+    enum usage {
+        colorAttachment,
+        depthAttachment,   // read: depth test only, in the read only layout
+        fragmentSampled,   // read only
+        computeSampled,    // read only
+        storage,           // compute shader, write includes reads such as atomics
+        transfer,          // read: copy source, write: copy destination
+        indirectBuffer,    // read only
+        indexBuffer,       // read only
+        vertexBuffer       // read only
+    };
+
+    struct imageDescription {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent = {0, 0};
+        VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        uint32_t mipLevels = 1; // barriers always cover every level
+    };
+
+    // Buffers keep VK_IMAGE_LAYOUT_UNDEFINED in both layouts
+    struct barrier {
+        resource target;
+        VkPipelineStageFlags srcStages;
+        VkAccessFlags srcAccess;
+        VkPipelineStageFlags dstStages;
+        VkAccessFlags dstAccess;
+        VkImageLayout oldLayout;
+        VkImageLayout newLayout;
+
+        bool operator==(const barrier & other) const;
+    };
+
+    // Passes that do not depend on each other, run after one vkCmdPipelineBarrier
+    struct step {
+        std::vector<barrier> barriers;
+        std::vector<pass> passes;
+    };
+
+    renderGraph();
+
+    // Forgets every pass and resource.  Call destroy() first if allocated.
+    void clear();
+
+    // An image owned elsewhere, e.g. a swap chain image, bound with bindImage before
+    // execute.  It is in initialLayout when the frame starts, after initialStages
+    // (the stage an acquire semaphore waits at), and left in finalLayout.
+    resource importImage(const std::string & name,
+                         const imageDescription & description,
+                         VkImageLayout initialLayout,
+                         VkImageLayout finalLayout,
+                         VkPipelineStageFlags initialStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+    // Its first use waits for nothing unless initialStages is given.  initialAccess
+    // makes earlier writes visible, e.g. the previous frame's, on the same queue.
+    resource importBuffer(const std::string & name,
+                          VkPipelineStageFlags initialStages = 0,
+                          VkAccessFlags initialAccess = 0);
+
+    // Created by allocate(), contents do not survive the frame
+    resource createImage(const std::string & name, const imageDescription & description);
+
+    pass addPass(const std::string & name, recordFunction record);
+
+    // Throws for a usage that cannot write, e.g. writing an index buffer
+    void read(pass aPass, resource aResource, usage aUsage);
+
+    void write(pass aPass, resource aResource, usage aUsage);
+
+    // Keeps the passes writing it even though nothing reads it in the graph
+    void markOutput(resource aResource);
+
+    // requirements, indexed by resource, decide which transient images can share a
+    // block of memory; without them only lifetimes are considered
+    void compile(const std::vector<VkMemoryRequirements> & requirements = std::vector<VkMemoryRequirements>());
+
+    // Creates the transient images, compiles against their memory requirements and
+    // binds one allocation per memory block
+    void allocate(VkDevice & device, const VkPhysicalDeviceMemoryProperties & memoryProperties);
+
+    void destroy(VkDevice & device);
+
+    void bindImage(resource aResource, VkImage image);
+
+    void bindBuffer(resource aResource, VkBuffer buffer);
+
+    // Records every step: its barriers, then its passes
+    void execute(VkCommandBuffer commandBuffer, uint32_t imageIndex) const;
+
+    const std::vector<step> & getSteps() const;
+
+    // Into the imported images' final layouts
+    const std::vector<barrier> & getFinalBarriers() const;
+
+    bool isCulled(pass aPass) const;
+
+    // Memory block of a transient image, noBlock for anything else
+    uint32_t getMemoryBlock(resource aResource) const;
+
+    size_t getMemoryBlockCount() const;
+
+    VkImage getImage(resource aResource) const;
+
+    VkImageView getImageView(resource aResource) const;
+
+    const std::string & getName(resource aResource) const;
+
+    // Steps, passes and barriers, for logs and failed checks
+    std::string describe() const;
+
+    static const uint32_t noBlock;
+
+private:
+    struct resourceInfo {
+        std::string name;
+        bool isImage;
+        bool imported;
+        bool output;
+        imageDescription description;
+        VkImageLayout initialLayout;
+        VkImageLayout finalLayout;
+        VkPipelineStageFlags initialStages;
+        VkAccessFlags initialAccess;
+        VkImageUsageFlags imageUsage; // everything the passes do with a transient image
+
+        // first and last step of a transient image, its block and the image that
+        // used the block before it
+        uint32_t firstStep;
+        uint32_t lastStep;
+        uint32_t block;
+        uint32_t previousInBlock;
+
+        VkImage image;
+        VkImageView view;
+        VkBuffer buffer;
+    };
+
+    struct access {
+        resource target;
+        bool write;
+        VkPipelineStageFlags stages;
+        VkAccessFlags accessMask;
+        VkImageLayout layout;
+    };
+
+    struct passInfo {
+        std::string name;
+        recordFunction record;
+        std::vector<access> accesses;
+        bool culled;
+    };
+
+    struct memoryBlock {
+        VkDeviceSize size;
+        VkDeviceSize alignment;
+        uint32_t memoryTypeBits;
+        std::vector<resource> residents;
+        // every stage and write of the residents, which the previous frame may still
+        // be doing when the first resident starts
+        VkPipelineStageFlags stages;
+        VkAccessFlags writeAccess;
+        VkDeviceMemory memory;
+    };
+
+    resource addResource(const std::string & name, bool isImage, bool imported);
+
+    void use(pass aPass, resource aResource, usage aUsage, bool write);
+
+    void cullAndSchedule();
+
+    void assignMemory(const std::vector<VkMemoryRequirements> & requirements);
+
+    void buildBarriers();
+
+    void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<barrier> & barriers) const;
+
+private:
+    std::vector<resourceInfo> _resources;
+    std::vector<passInfo> _passes;
+
+    std::vector<step> _steps;
+    std::vector<barrier> _finalBarriers;
+    std::vector<memoryBlock> _blocks;
+};
+
+#endif /* renderGraph_hpp */
@@ -1,3 +1,9 @@
 ../../vulkan_bin/glslangValidator -V shader.vert
 ../../vulkan_bin/glslangValidator -V shader.frag
+../../vulkan_bin/glslangValidator -V cull.comp -o cull.spv
+../../vulkan_bin/glslangValidator -V -DOCCLUSION_CULLING cull.comp -o cullOcclusion.spv
+../../vulkan_bin/glslangValidator -V hiz.comp -o hiz.spv
+../../vulkan_bin/glslangValidator -V depth.vert -o depth.spv
+../../vulkan_bin/glslangValidator -V upscale.vert -o upscaleVert.spv
+../../vulkan_bin/glslangValidator -V upscale.frag -o upscaleFrag.spv
 
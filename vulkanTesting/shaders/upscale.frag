@@ -0,0 +1,21 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Stretches the part of the scene image the frame was rendered into, its top
+// left corner scaled by upscale.scale, over the whole swap chain image.
+
+layout(binding = 0) uniform sampler2D scene;
+
+layout(push_constant) uniform Upscale {
+    vec2 scale;
+} upscale;
+
+layout(location = 0) in vec2 texCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    // Bilinear filtering must not reach past the rendered texels
+    vec2 limit = upscale.scale - 0.5 / vec2(textureSize(scene, 0));
+    outColor = texture(scene, min(texCoord * upscale.scale, limit));
+}
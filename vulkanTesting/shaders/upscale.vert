@@ -0,0 +1,12 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// One triangle covering the screen, no vertex buffer.  texCoord spans 0 to 1
+// over the screen.
+
+layout(location = 0) out vec2 texCoord;
+
+void main() {
+    texCoord = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(texCoord * 2.0 - 1.0, 0.0, 1.0);
+}
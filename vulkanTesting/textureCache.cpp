@@ -0,0 +1,354 @@
+//
+//  textureCache.cpp
+//  vulkanTesting
+//
+
+#include "textureCache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+namespace
+{
+    // Bump whenever the file layout or the decode/mip code changes so stale entries are ignored
+    const uint32_t CACHE_VERSION = 1;
+    const char CACHE_MAGIC[4] = { 'V', 'T', 'C', 'F' };
+    const uint64_t TEXEL_ALIGNMENT = 16;
+    const uint32_t MAX_MIP_LEVELS = 32;
+
+    struct cacheHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t width;
+        uint32_t height;
+        uint32_t format;
+        uint32_t mipCount;
+        uint64_t texelOffset; // from the start of the file
+        uint64_t texelSize;
+    };
+
+    uint64_t alignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    uint64_t cacheKey(const uint8_t * sourceData, size_t sourceSize, const textureCache::decodeSettings & settings)
+    {
+        // Only hash the settings fields explicitly so struct padding never leaks into the key
+        const uint32_t settingsBlob[3] = {
+            CACHE_VERSION,
+            static_cast<uint32_t>(textureCache::pixelFormat::rgba8Unorm),
+            settings.generateMips ? 1u : 0u
+        };
+
+        uint64_t key = textureCache::hashBytes(sourceData, sourceSize);
+        return textureCache::hashBytes(settingsBlob, sizeof(settingsBlob), key);
+    }
+
+    std::string cachePath(const std::string & cacheDirectory, uint64_t key)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.tex", static_cast<unsigned long long>(key));
+        return cacheDirectory + "/" + name;
+    }
+
+    // Lay out the mip chain for a width x height RGBA8 image
+    std::vector<textureCache::mipLevel> buildMipLayout(uint32_t width, uint32_t height, bool generateMips, uint64_t & texelSize)
+    {
+        std::vector<textureCache::mipLevel> mips;
+        texelSize = 0;
+
+        uint32_t mipWidth = width;
+        uint32_t mipHeight = height;
+        while (true)
+        {
+            textureCache::mipLevel level;
+            level.width = mipWidth;
+            level.height = mipHeight;
+            level.offset = texelSize;
+            level.size = static_cast<uint64_t>(mipWidth) * mipHeight * 4;
+            mips.push_back(level);
+
+            texelSize = alignUp(texelSize + level.size, TEXEL_ALIGNMENT);
+
+            if (!generateMips || (mipWidth == 1 && mipHeight == 1))
+            {
+                break;
+            }
+            mipWidth = std::max(1u, mipWidth / 2);
+            mipHeight = std::max(1u, mipHeight / 2);
+        }
+
+        return mips;
+    }
+
+    // 2x2 box filter from one RGBA8 level into the next.  Odd edges clamp to the last texel.
+    void downsample(const uint8_t * src, uint32_t srcWidth, uint32_t srcHeight,
+                    uint8_t * dst, uint32_t dstWidth, uint32_t dstHeight)
+    {
+        for (uint32_t y = 0; y < dstHeight; ++y)
+        {
+            uint32_t y0 = std::min(y * 2, srcHeight - 1);
+            uint32_t y1 = std::min(y * 2 + 1, srcHeight - 1);
+            const uint8_t * row0 = src + static_cast<size_t>(y0) * srcWidth * 4;
+            const uint8_t * row1 = src + static_cast<size_t>(y1) * srcWidth * 4;
+
+            for (uint32_t x = 0; x < dstWidth; ++x)
+            {
+                uint32_t x0 = std::min(x * 2, srcWidth - 1) * 4;
+                uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+                uint8_t * out = dst + (static_cast<size_t>(y) * dstWidth + x) * 4;
+
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    uint32_t sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                    out[c] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+    }
+
+    bool validHeader(const mappedFile & file, uint64_t key, const cacheHeader *& header, const textureCache::mipLevel *& mips)
+    {
+        if (file.size() < sizeof(cacheHeader))
+        {
+            return false;
+        }
+
+        header = reinterpret_cast<const cacheHeader *>(file.data());
+        if (memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+            header->version != CACHE_VERSION ||
+            header->key != key ||
+            header->mipCount == 0 || header->mipCount > MAX_MIP_LEVELS)
+        {
+            return false;
+        }
+
+        // Compared without adding the two, so huge values cannot wrap past the size
+        uint64_t tableEnd = sizeof(cacheHeader) + header->mipCount * sizeof(textureCache::mipLevel);
+        if (tableEnd > header->texelOffset ||
+            header->texelOffset % TEXEL_ALIGNMENT != 0 ||
+            header->texelOffset > file.size() ||
+            header->texelSize > file.size() - header->texelOffset)
+        {
+            return false;
+        }
+
+        // The layout follows from the size, so an entry that disagrees is damaged or foreign
+        if (header->format != static_cast<uint32_t>(textureCache::pixelFormat::rgba8Unorm) ||
+            header->width == 0 || header->height == 0)
+        {
+            return false;
+        }
+        uint64_t expectedTexelSize = 0;
+        std::vector<textureCache::mipLevel> expected = buildMipLayout(header->width, header->height, header->mipCount > 1, expectedTexelSize);
+        if (expected.size() != header->mipCount || expectedTexelSize != header->texelSize)
+        {
+            return false;
+        }
+
+        mips = reinterpret_cast<const textureCache::mipLevel *>(file.data() + sizeof(cacheHeader));
+        for (uint32_t i = 0; i < header->mipCount; ++i)
+        {
+            if (mips[i].width != expected[i].width || mips[i].height != expected[i].height ||
+                mips[i].offset != expected[i].offset || mips[i].size != expected[i].size)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool writeCacheFile(const std::string & path,
+                        const cacheHeader & header,
+                        const std::vector<textureCache::mipLevel> & mips,
+                        const std::vector<uint8_t> & texels)
+    {
+        // Write to a temporary name and rename so a crash never leaves a truncated entry behind
+        std::string tempPath = path + "." + std::to_string(getpid()) + ".tmp";
+        FILE * file = fopen(tempPath.c_str(), "wb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        size_t tableEnd = sizeof(cacheHeader) + mips.size() * sizeof(textureCache::mipLevel);
+        std::vector<uint8_t> padding(static_cast<size_t>(header.texelOffset) - tableEnd, 0);
+
+        bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                       fwrite(mips.data(), sizeof(textureCache::mipLevel), mips.size(), file) == mips.size() &&
+                       fwrite(padding.data(), 1, padding.size(), file) == padding.size() &&
+                       fwrite(texels.data(), 1, texels.size(), file) == texels.size();
+
+        written = (fclose(file) == 0) && written;
+
+        if (!written || rename(tempPath.c_str(), path.c_str()) != 0)
+        {
+            remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+}
+
+uint32_t textureCache::texture::width() const
+{
+    return _width;
+}
+
+uint32_t textureCache::texture::height() const
+{
+    return _height;
+}
+
+textureCache::pixelFormat textureCache::texture::format() const
+{
+    return _format;
+}
+
+const std::vector<textureCache::mipLevel> & textureCache::texture::mips() const
+{
+    return _mips;
+}
+
+const uint8_t * textureCache::texture::texels() const
+{
+    if (_file.isOpen())
+    {
+        return _file.data() + _fileTexelOffset;
+    }
+    return _decoded.data();
+}
+
+size_t textureCache::texture::texelSize() const
+{
+    if (_file.isOpen())
+    {
+        return _fileTexelSize;
+    }
+    return _decoded.size();
+}
+
+bool textureCache::texture::fromCache() const
+{
+    return _file.isOpen();
+}
+
+uint64_t textureCache::hashBytes(const void * data, size_t size, uint64_t seed)
+{
+    const uint8_t * bytes = static_cast<const uint8_t *>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void textureCache::generateMipChain(const uint8_t * rgba,
+                                    uint32_t width,
+                                    uint32_t height,
+                                    bool generateMips,
+                                    std::vector<mipLevel> & mips,
+                                    std::vector<uint8_t> & texels)
+{
+    uint64_t texelSize = 0;
+    mips = buildMipLayout(width, height, generateMips, texelSize);
+    texels.assign(static_cast<size_t>(texelSize), 0);
+
+    memcpy(texels.data(), rgba, static_cast<size_t>(mips[0].size));
+
+    for (size_t i = 1; i < mips.size(); ++i)
+    {
+        const mipLevel & src = mips[i - 1];
+        const mipLevel & dst = mips[i];
+        downsample(texels.data() + src.offset, src.width, src.height,
+                   texels.data() + dst.offset, dst.width, dst.height);
+    }
+}
+
+textureCache::texture textureCache::load(const std::string & sourcePath,
+                                         const std::string & cacheDirectory,
+                                         const decodeSettings & settings)
+{
+    mappedFile source;
+    if (!source.open(sourcePath))
+    {
+        throw std::runtime_error("failed to open texture " + sourcePath + "!");
+    }
+
+    return load(source.data(), source.size(), sourcePath, cacheDirectory, settings);
+}
+
+textureCache::texture textureCache::load(const uint8_t * sourceData,
+                                         size_t sourceSize,
+                                         const std::string & sourceName,
+                                         const std::string & cacheDirectory,
+                                         const decodeSettings & settings)
+{
+    uint64_t key = cacheKey(sourceData, sourceSize, settings);
+    std::string path = cachePath(cacheDirectory, key);
+
+    texture result;
+
+    // Warm path: the texels are already laid out for upload
+    mappedFile cached;
+    const cacheHeader * header = nullptr;
+    const mipLevel * cachedMips = nullptr;
+    if (cached.open(path) && validHeader(cached, key, header, cachedMips))
+    {
+        result._width = header->width;
+        result._height = header->height;
+        result._format = static_cast<pixelFormat>(header->format);
+        result._mips.assign(cachedMips, cachedMips + header->mipCount);
+        result._fileTexelOffset = static_cast<size_t>(header->texelOffset);
+        result._fileTexelSize = static_cast<size_t>(header->texelSize);
+        result._file = std::move(cached);
+        return result;
+    }
+
+    // Cold path: decode, build mips and write the cache entry for next time
+    int texWidth, texHeight, texChannels;
+    stbi_uc * pixels = stbi_load_from_memory(sourceData, static_cast<int>(sourceSize),
+                                             &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    if (!pixels)
+    {
+        throw std::runtime_error("failed to load texture image " + sourceName + "!");
+    }
+
+    result._width = static_cast<uint32_t>(texWidth);
+    result._height = static_cast<uint32_t>(texHeight);
+    generateMipChain(pixels, result._width, result._height, settings.generateMips, result._mips, result._decoded);
+    stbi_image_free(pixels);
+
+    cacheHeader newHeader = {};
+    memcpy(newHeader.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    newHeader.version = CACHE_VERSION;
+    newHeader.key = key;
+    newHeader.width = result._width;
+    newHeader.height = result._height;
+    newHeader.format = static_cast<uint32_t>(result._format);
+    newHeader.mipCount = static_cast<uint32_t>(result._mips.size());
+    newHeader.texelOffset = alignUp(sizeof(cacheHeader) + result._mips.size() * sizeof(mipLevel), TEXEL_ALIGNMENT);
+    newHeader.texelSize = result._decoded.size();
+
+    mkdir(cacheDirectory.c_str(), 0755);
+    if (!writeCacheFile(path, newHeader, result._mips, result._decoded))
+    {
+        std::cout << "failed to write texture cache entry " << path << std::endl;
+    }
+
+    return result;
+}
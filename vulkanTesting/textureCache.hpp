@@ -0,0 +1,103 @@
+//
+//  textureCache.hpp
+//  vulkanTesting
+//
+
+#ifndef textureCache_hpp
+#define textureCache_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mappedFile.hpp"
+
+// Derived-asset cache for textures.  The first load of a source image decodes it,
+// builds the mip chain and writes the texels in upload order to
+// <cacheDirectory>/<key>.tex.  Later loads map that file and hand the texels
+// straight to the staging buffer without touching the image decoder.
+namespace textureCache {
+
+    enum class pixelFormat : uint32_t {
+        rgba8Unorm = 0
+    };
+
+    // Everything that changes the decoded texels must be part of the cache key
+    struct decodeSettings {
+        bool generateMips = true;
+    };
+
+    struct mipLevel {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset; // from the start of texels()
+        uint64_t size;
+    };
+
+    class texture
+    {
+    public:
+
+        uint32_t width() const;
+
+        uint32_t height() const;
+
+        pixelFormat format() const;
+
+        const std::vector<mipLevel> & mips() const;
+
+        // All mip levels, tightly packed in the order given by mips()
+        const uint8_t * texels() const;
+
+        size_t texelSize() const;
+
+        // True if the texels came from the on-disk cache instead of the decoder
+        bool fromCache() const;
+
+    private:
+        friend texture load(const uint8_t * sourceData,
+                            size_t sourceSize,
+                            const std::string & sourceName,
+                            const std::string & cacheDirectory,
+                            const decodeSettings & settings);
+
+        uint32_t _width = 0;
+        uint32_t _height = 0;
+        pixelFormat _format = pixelFormat::rgba8Unorm;
+        std::vector<mipLevel> _mips;
+
+        // Exactly one of these backs texels()
+        mappedFile _file;
+        size_t _fileTexelOffset = 0;
+        size_t _fileTexelSize = 0;
+        std::vector<uint8_t> _decoded;
+    };
+
+    // Load sourcePath through the cache.  Throws if the source cannot be read or decoded.
+    // Failing to write the cache is not fatal, the texture is still returned.
+    texture load(const std::string & sourcePath,
+                 const std::string & cacheDirectory,
+                 const decodeSettings & settings = decodeSettings());
+
+    // Same, for an encoded image that is already in memory (e.g. inside an assetPack).
+    // sourceName is only used in error messages.
+    texture load(const uint8_t * sourceData,
+                 size_t sourceSize,
+                 const std::string & sourceName,
+                 const std::string & cacheDirectory,
+                 const decodeSettings & settings = decodeSettings());
+
+    // Copy rgba into texels as level 0 and box filter the rest of the chain down to 1x1.
+    // Level offsets are 16 byte aligned.
+    void generateMipChain(const uint8_t * rgba,
+                          uint32_t width,
+                          uint32_t height,
+                          bool generateMips,
+                          std::vector<mipLevel> & mips,
+                          std::vector<uint8_t> & texels);
+
+    // 64 bit FNV-1a, used for the cache key
+    uint64_t hashBytes(const void * data, size_t size, uint64_t seed = 14695981039346656037ULL);
+}
+
+#endif /* textureCache_hpp */
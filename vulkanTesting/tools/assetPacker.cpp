@@ -0,0 +1,151 @@
+//
+//  assetPacker.cpp
+//  vulkanTesting
+//
+//  Builds an assetPack from files under a root directory.  Entry names are the
+//  paths relative to the root, e.g. "shaders/vert.spv".  With no file list every
+//  file under the root is packed (hidden files and directories are skipped).
+//
+//  usage: assetPacker <output.pak> <rootDirectory> [--no-compress] [relative paths...]
+//
+//  For the desktop sample:
+//      assetPacker vulkanTesting/assets.pak vulkanTesting shaders/vert.spv shaders/frag.spv textures/logo.jpg
+//
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "../assetPack.hpp"
+
+namespace
+{
+    void listFiles(const std::string & root, const std::string & relative, std::vector<std::string> & files)
+    {
+        std::string directory = relative.empty() ? root : root + "/" + relative;
+        DIR * dir = opendir(directory.c_str());
+        if (dir == nullptr)
+        {
+            return;
+        }
+        while (dirent * item = readdir(dir))
+        {
+            std::string name = item->d_name;
+            if (name.empty() || name[0] == '.')
+            {
+                continue;
+            }
+
+            std::string childRelative = relative.empty() ? name : relative + "/" + name;
+            struct stat info;
+            if (stat((root + "/" + childRelative).c_str(), &info) != 0)
+            {
+                continue;
+            }
+            if (S_ISDIR(info.st_mode))
+            {
+                listFiles(root, childRelative, files);
+            }
+            else if (S_ISREG(info.st_mode))
+            {
+                files.push_back(childRelative);
+            }
+        }
+        closedir(dir);
+    }
+
+    bool readBytes(const std::string & path, std::vector<uint8_t> & bytes)
+    {
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (!file.is_open())
+        {
+            return false;
+        }
+        bytes.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        return file.good() || bytes.empty();
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc < 3)
+    {
+        std::cout << "usage: " << argv[0] << " <output.pak> <rootDirectory> [--no-compress] [relative paths...]" << std::endl;
+        return 1;
+    }
+
+    std::string outputPath = argv[1];
+    std::string root = argv[2];
+    bool compress = true;
+    std::vector<std::string> files;
+
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--no-compress")
+        {
+            compress = false;
+        }
+        else
+        {
+            files.push_back(argument);
+        }
+    }
+
+    if (files.empty())
+    {
+        listFiles(root, "", files);
+    }
+
+    std::vector<assetPack::source> sources;
+    size_t totalBytes = 0;
+    for (const std::string & name : files)
+    {
+        assetPack::source source;
+        source.name = name;
+        if (!readBytes(root + "/" + name, source.bytes))
+        {
+            std::cout << "failed to read " << root << "/" << name << std::endl;
+            return 1;
+        }
+        totalBytes += source.bytes.size();
+        sources.push_back(std::move(source));
+    }
+
+    if (!assetPack::write(outputPath, sources, compress))
+    {
+        std::cout << "failed to write " << outputPath << std::endl;
+        return 1;
+    }
+
+    // Read it back so a bad pack never goes unnoticed
+    assetPack pack;
+    if (!pack.open(outputPath))
+    {
+        std::cout << "failed to reopen " << outputPath << std::endl;
+        return 1;
+    }
+    for (const assetPack::source & source : sources)
+    {
+        std::vector<char> bytes;
+        if (!pack.read(source.name, bytes) ||
+            bytes.size() != source.bytes.size() ||
+            !std::equal(bytes.begin(), bytes.end(), reinterpret_cast<const char *>(source.bytes.data())))
+        {
+            std::cout << "verification failed for " << source.name << std::endl;
+            return 1;
+        }
+    }
+
+    struct stat packInfo;
+    stat(outputPath.c_str(), &packInfo);
+    std::cout << "packed " << sources.size() << " files, " << totalBytes << " bytes into "
+              << outputPath << " (" << packInfo.st_size << " bytes)" << std::endl;
+    return 0;
+}
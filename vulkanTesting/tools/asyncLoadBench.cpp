@@ -0,0 +1,173 @@
+//
+//  asyncLoadBench.cpp
+//  vulkanTesting
+//
+//  Reads every file under a directory one blocking read at a time (what
+//  shaderReader::readFile does) and then all at once through asyncFileLoader.
+//  Before each cold pass the files are dropped from the page cache where the
+//  platform allows it, so the numbers reflect the disk rather than memcpy.
+//
+//  usage: asyncLoadBench <directory> [--queue-depth N] [--threads N]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../asyncFileLoader.hpp"
+#include "../shaderReader.hpp"
+
+namespace
+{
+    void listFiles(const std::string & directory, std::vector<std::string> & files)
+    {
+        DIR * dir = opendir(directory.c_str());
+        if (dir == nullptr)
+        {
+            return;
+        }
+        while (dirent * item = readdir(dir))
+        {
+            std::string name = item->d_name;
+            if (name.empty() || name[0] == '.')
+            {
+                continue;
+            }
+
+            std::string path = directory + "/" + name;
+            struct stat info;
+            if (stat(path.c_str(), &info) != 0)
+            {
+                continue;
+            }
+            if (S_ISDIR(info.st_mode))
+            {
+                listFiles(path, files);
+            }
+            else if (S_ISREG(info.st_mode))
+            {
+                files.push_back(path);
+            }
+        }
+        closedir(dir);
+    }
+
+    void dropFromPageCache(const std::vector<std::string> & files)
+    {
+#ifdef POSIX_FADV_DONTNEED
+        for (const std::string & path : files)
+        {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd >= 0)
+            {
+                fdatasync(fd);
+                posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+                close(fd);
+            }
+        }
+#else
+        (void)files;
+#endif
+    }
+
+    double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    double blockingPass(const std::vector<std::string> & files, size_t & bytes)
+    {
+        bytes = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const std::string & path : files)
+        {
+            bytes += shaderReader::readFile(path).size();
+        }
+        return elapsedMs(start);
+    }
+
+    double asyncPass(asyncFileLoader & loader, const std::vector<std::string> & files, size_t & bytes, size_t & failures)
+    {
+        bytes = 0;
+        failures = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<std::future<asyncFileLoader::result>> pending = loader.read(files);
+        for (std::future<asyncFileLoader::result> & future : pending)
+        {
+            asyncFileLoader::result loaded = future.get();
+            bytes += loaded.bytes.size();
+            failures += loaded.ok() ? 0 : 1;
+        }
+        return elapsedMs(start);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "usage: " << argv[0] << " <directory> [--queue-depth N] [--threads N]" << std::endl;
+        return 1;
+    }
+
+    std::string directory = argv[1];
+    unsigned queueDepth = 64;
+    unsigned threadCount = 0;
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        std::string argument = argv[i];
+        if (argument == "--queue-depth")
+        {
+            queueDepth = static_cast<unsigned>(std::atoi(argv[i + 1]));
+        }
+        else if (argument == "--threads")
+        {
+            threadCount = static_cast<unsigned>(std::atoi(argv[i + 1]));
+        }
+    }
+
+    std::vector<std::string> files;
+    listFiles(directory, files);
+    if (files.empty())
+    {
+        std::cout << "no files under " << directory << std::endl;
+        return 1;
+    }
+
+    asyncFileLoader loader(queueDepth, threadCount);
+
+    size_t blockingBytes = 0;
+    size_t asyncBytes = 0;
+    size_t failures = 0;
+
+    dropFromPageCache(files);
+    double blockingCold = blockingPass(files, blockingBytes);
+    double blockingWarm = blockingPass(files, blockingBytes);
+
+    dropFromPageCache(files);
+    double asyncCold = asyncPass(loader, files, asyncBytes, failures);
+    double asyncWarm = asyncPass(loader, files, asyncBytes, failures);
+
+    if (failures != 0 || asyncBytes != blockingBytes)
+    {
+        std::cout << failures << " async reads failed, " << asyncBytes << " of " << blockingBytes << " bytes read" << std::endl;
+        return 1;
+    }
+
+    std::cout << files.size() << " files, " << blockingBytes << " bytes, async backend "
+              << (loader.usingIoUring() ? "io_uring" : "thread pool") << std::endl;
+    std::cout << "blocking cold : " << blockingCold << " ms" << std::endl;
+    std::cout << "blocking warm : " << blockingWarm << " ms" << std::endl;
+    std::cout << "async cold    : " << asyncCold << " ms" << std::endl;
+    std::cout << "async warm    : " << asyncWarm << " ms" << std::endl;
+    std::cout << "cold speedup  : " << blockingCold / std::max(asyncCold, 0.001) << "x" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+//
+//  benchMesh.hpp
+//  vulkanTesting
+//
+//  Input meshes shared by the mesh benches: a generated sphere, or a model
+//  file loaded and optimized the same way the application does it.
+//
+
+#ifndef benchMesh_hpp
+#define benchMesh_hpp
+
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../meshLoader.hpp"
+#include "../meshOptimizer.hpp"
+
+namespace benchMesh
+{
+    // Unit sphere, counter clockwise seen from outside
+    inline meshLoader::mesh sphere(uint32_t segments)
+    {
+        meshLoader::mesh mesh;
+        uint32_t rings = segments / 2;
+        for (uint32_t ring = 0; ring <= rings; ++ring)
+        {
+            float theta = 3.14159265f * ring / rings;
+            for (uint32_t segment = 0; segment <= segments; ++segment)
+            {
+                float phi = 2.0f * 3.14159265f * segment / segments;
+                Vertex vertex;
+                vertex.pos = glm::vec3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+                vertex.color = glm::vec3(1.0f, 1.0f, 1.0f);
+                vertex.texCoord = glm::vec2(static_cast<float>(segment) / segments, static_cast<float>(ring) / rings);
+                mesh.vertices.push_back(vertex);
+            }
+        }
+        for (uint32_t ring = 0; ring < rings; ++ring)
+        {
+            for (uint32_t segment = 0; segment < segments; ++segment)
+            {
+                uint32_t corner = ring * (segments + 1) + segment;
+                uint32_t below = corner + segments + 1;
+                mesh.indices.insert(mesh.indices.end(), {corner, below, corner + 1});
+                mesh.indices.insert(mesh.indices.end(), {corner + 1, below, below + 1});
+            }
+        }
+        return mesh;
+    }
+
+    // Reads and parses modelPath, printing its name, or prints why it could not
+    inline bool load(const std::string & modelPath, meshLoader::mesh & mesh)
+    {
+        std::ifstream file(modelPath, std::ios::ate | std::ios::binary);
+        if (!file.is_open())
+        {
+            std::cout << "failed to open " << modelPath << std::endl;
+            return false;
+        }
+        std::vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        mesh = meshLoader::load(bytes.data(), bytes.size(), modelPath);
+        std::cout << modelPath << std::endl;
+        return true;
+    }
+
+    // The model at modelPath, or a sphere when there is none, optimized in the
+    // same order the application builds from
+    inline bool prepare(const std::string & modelPath, uint32_t sphereSegments, meshLoader::mesh & mesh)
+    {
+        if (modelPath.empty())
+        {
+            mesh = sphere(sphereSegments);
+            std::cout << "sphere with " << sphereSegments << " segments" << std::endl;
+        }
+        else if (!load(modelPath, mesh))
+        {
+            return false;
+        }
+        meshOptimizer::optimize(mesh);
+        return true;
+    }
+}
+
+#endif /* benchMesh_hpp */
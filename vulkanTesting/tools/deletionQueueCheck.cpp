@@ -0,0 +1,225 @@
+//
+//  deletionQueueCheck.cpp
+//  vulkanTesting
+//
+//  Checks deletionQueue against drawFrame's fence protocol on a simulated GPU.
+//  Every frame uses the live objects; between frames some are retired, stamped
+//  with the frames submitted so far, and new ones take their place.  After the
+//  wait on a frame's fence the frames up to the one that last used that fence
+//  are collected, as in drawFrame.  Checked: no object is destroyed before every
+//  frame that used it has finished, none waits more than the frames in flight,
+//  destroys run in the order they were pushed, flush destroys everything
+//  exactly once, and the directed cases for out of order frames and destroys
+//  that push more.  Nothing touches a device.
+//  Exit code 2 means a check failed.
+//
+//  usage: deletionQueueCheck [--frames N] [--verbose]
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../deletionQueue.hpp"
+
+namespace
+{
+    // Same as the application
+    const uint64_t framesInFlight = 2;
+
+    bool verbose = false;
+
+    // xorshift, deterministic
+    uint32_t randomState = 0x2545F491u;
+    uint32_t random()
+    {
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        return randomState;
+    }
+
+    bool check(const std::string & name, bool passed)
+    {
+        std::cout << (passed ? "  ok      " : "  FAILED  ") << name << std::endl;
+        return passed;
+    }
+
+    struct object {
+        uint64_t lastFrame = 0; // last frame submitted while it was live, 1 based
+        uint64_t retiredFrame = 0;
+        uint64_t destroyedFrame = 0;
+        int destroyCount = 0;
+    };
+
+    bool simulatedFrames(size_t frameCount)
+    {
+        deletionQueue queue;
+        std::vector<object> objects(8);
+        std::vector<size_t> live = {0, 1, 2, 3, 4, 5, 6, 7};
+        std::vector<size_t> pushOrder;
+        std::vector<size_t> destroyOrder;
+
+        // times in milliseconds, finishes[n] is when frame n + 1 finished on the GPU
+        std::vector<double> finishes;
+        double now = 0.0;
+        uint64_t frameNumber = 0;
+        bool early = false;
+        uint64_t longestWait = 0;
+
+        // retire a few objects and replace them, as a resize or a streamed out mesh would
+        auto retireSome = [&]() {
+            size_t retiring = random() % 8 == 0 ? 1 + random() % 3 : 0;
+            for (size_t r = 0; r < retiring && !live.empty(); ++r)
+            {
+                size_t slot = random() % live.size();
+                size_t id = live[slot];
+                live.erase(live.begin() + slot);
+                objects[id].retiredFrame = frameNumber;
+                pushOrder.push_back(id);
+                queue.push(frameNumber, [&, id]() {
+                    object & anObject = objects[id];
+                    // every frame that used it has finished by now
+                    if (anObject.lastFrame > 0 && finishes[anObject.lastFrame - 1] > now)
+                    {
+                        early = true;
+                    }
+                    anObject.destroyedFrame = frameNumber;
+                    anObject.destroyCount++;
+                    destroyOrder.push_back(id);
+                });
+
+                objects.push_back(object());
+                live.push_back(objects.size() - 1);
+            }
+        };
+
+        for (size_t frame = 0; frame < frameCount; ++frame)
+        {
+            // wait on the fence of the frame framesInFlight back
+            if (frameNumber >= framesInFlight)
+            {
+                now = std::max(now, finishes[frameNumber - framesInFlight]);
+            }
+            uint64_t completedFrame = frameNumber + 1 >= framesInFlight ? frameNumber + 1 - framesInFlight : 0;
+            queue.collect(completedFrame);
+
+            // on acquire, as an out of date swap chain would
+            retireSome();
+
+            // record and submit, the GPU runs frames back to back
+            now += 2.0 + random() % 4;
+            frameNumber++;
+            for (size_t id : live)
+            {
+                objects[id].lastFrame = frameNumber;
+            }
+            double start = std::max(now, finishes.empty() ? 0.0 : finishes.back());
+            finishes.push_back(start + 4.0 + random() % 12);
+
+            // after presenting, as a resize would
+            retireSome();
+        }
+
+        for (const object & anObject : objects)
+        {
+            if (anObject.destroyCount > 0)
+            {
+                longestWait = std::max(longestWait, anObject.destroyedFrame - anObject.retiredFrame);
+            }
+        }
+        size_t pending = queue.size();
+        size_t retired = pushOrder.size();
+
+        // shutdown, after the device has gone idle
+        now = finishes.back();
+        queue.flush();
+
+        bool once = true;
+        for (size_t id : pushOrder)
+        {
+            once &= objects[id].destroyCount == 1;
+        }
+        for (size_t id : live)
+        {
+            once &= objects[id].destroyCount == 0;
+        }
+
+        if (verbose)
+        {
+            std::cout << "    " << frameCount << " frames, " << retired << " objects retired, "
+                      << pending << " still pending at shutdown, longest wait " << longestWait << " frames" << std::endl;
+        }
+
+        bool passed = check("no object destroyed while a frame using it was in flight", !early);
+        passed &= check("destroyed within the frames in flight", longestWait <= framesInFlight);
+        passed &= check("destroyed in the order retired", destroyOrder == pushOrder);
+        passed &= check("flush destroys every retired object once", once && queue.empty());
+        return passed;
+    }
+
+    bool directed()
+    {
+        deletionQueue queue;
+        std::vector<int> destroyed;
+
+        queue.push(5, [&]() { destroyed.push_back(5); });
+        // an older frame behind a newer one waits for it
+        queue.push(3, [&]() { destroyed.push_back(3); });
+        queue.collect(4);
+        bool passed = check("older frame waits for the newer one before it", destroyed.empty() && queue.size() == 2);
+
+        queue.collect(5);
+        passed &= check("collect runs the completed frames in order", destroyed == std::vector<int>({5, 3}) && queue.empty());
+
+        // a destroy that retires more, say a frame buffer then its image views
+        destroyed.clear();
+        queue.push(7, [&]() {
+            destroyed.push_back(7);
+            queue.push(8, [&]() { destroyed.push_back(8); });
+        });
+        queue.collect(7);
+        passed &= check("destroys can push more", destroyed == std::vector<int>({7}) && queue.size() == 1);
+        queue.collect(8);
+        passed &= check("pushed destroys run with their frame", destroyed == std::vector<int>({7, 8}) && queue.empty());
+
+        destroyed.clear();
+        queue.push(0, [&]() { destroyed.push_back(0); });
+        queue.collect(0);
+        passed &= check("frame 0 means no frame used the objects", destroyed == std::vector<int>({0}));
+        return passed;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    size_t frameCount = 10000;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--frames" && i + 1 < argc)
+        {
+            frameCount = std::max<size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+        }
+        else if (argument == "--verbose")
+        {
+            verbose = true;
+        }
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [--frames N] [--verbose]" << std::endl;
+            return 1;
+        }
+    }
+
+    bool passed = true;
+    passed &= simulatedFrames(frameCount);
+    passed &= directed();
+
+    std::cout << (passed ? "every object outlived the frames that used it" : "deletion queue check failed") << std::endl;
+    return passed ? 0 : 2;
+}
@@ -0,0 +1,196 @@
+//
+//  dynamicResolutionBench.cpp
+//  vulkanTesting
+//
+//  Runs the dynamic resolution controller against a simulated GPU whose frame
+//  time grows with the pixel count, through a light, a heavy and again a light
+//  load.  Measurements arrive two frames late and the scale snaps to the steps
+//  the application records command buffers for, as in HelloTriangleApplication.
+//  Checked: light load renders at full size, heavy load gets back under the frame
+//  budget within a second and stays there without dropping far below the
+//  target, and full size returns once the load is light again.
+//  Exit code 2 means a check failed.
+//
+//  usage: dynamicResolutionBench [--target MS] [--heavy LOAD] [--verbose]
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../dynamicResolution.hpp"
+
+namespace
+{
+    // Same as the application
+    const uint32_t resolutionSteps = 9;
+    const size_t framesInFlight = 2;
+
+    const float budgetMilliseconds = 1000.0f / 60.0f;
+
+    // Full size frame at load 1: fixed work plus work proportional to the pixels
+    const float fixedMilliseconds = 2.0f;
+    const float pixelMilliseconds = 8.0f;
+
+    // Frames given to settle after a load change, one second at 60 Hz
+    const size_t settleFrames = 60;
+
+    struct phase {
+        std::string name;
+        float load;
+        size_t frames;
+    };
+
+    struct phaseResult {
+        std::vector<float> milliseconds; // after settling
+        float meanScale;
+        uint32_t lastStep;
+        uint32_t lowestStep;
+    };
+
+    // xorshift, deterministic noise of a few percent
+    uint32_t noiseState = 0x2545F491u;
+    float noise()
+    {
+        noiseState ^= noiseState << 13;
+        noiseState ^= noiseState >> 17;
+        noiseState ^= noiseState << 5;
+        return 0.95f + 0.1f * (noiseState & 0xFFFF) / 65535.0f;
+    }
+
+    float percentile(std::vector<float> values, float fraction)
+    {
+        if (values.empty())
+        {
+            return 0.0f;
+        }
+        std::sort(values.begin(), values.end());
+        return values[std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()))];
+    }
+
+    float mean(const std::vector<float> & values)
+    {
+        float sum = 0.0f;
+        for (float value : values)
+        {
+            sum += value;
+        }
+        return values.empty() ? 0.0f : sum / values.size();
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    dynamicResolution::settings settings;
+    float heavyLoad = 2.5f;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--target" && i + 1 < argc)
+        {
+            settings.targetMilliseconds = static_cast<float>(std::atof(argv[++i]));
+        }
+        else if (argument == "--heavy" && i + 1 < argc)
+        {
+            heavyLoad = static_cast<float>(std::atof(argv[++i]));
+        }
+        else if (argument == "--verbose")
+        {
+            verbose = true;
+        }
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [--target MS] [--heavy LOAD] [--verbose]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<phase> phases = {
+        {"light", 1.0f, 300},
+        {"heavy", heavyLoad, 600},
+        {"light again", 1.0f, 600}
+    };
+
+    dynamicResolution controller(settings);
+    std::deque<float> pending; // frames rendered but not read back yet
+    uint32_t step = resolutionSteps - 1;
+    std::vector<phaseResult> results;
+    size_t frame = 0;
+
+    for (const phase & aPhase : phases)
+    {
+        phaseResult result;
+        result.meanScale = 0.0f;
+        result.lowestStep = step;
+        for (size_t i = 0; i < aPhase.frames; ++i, ++frame)
+        {
+            float scale = controller.stepScale(step, resolutionSteps);
+            float milliseconds = (fixedMilliseconds + pixelMilliseconds * scale * scale * aPhase.load) * noise();
+            pending.push_back(milliseconds);
+
+            // the fence of the frame framesInFlight back has signaled
+            if (pending.size() > framesInFlight)
+            {
+                controller.update(pending.front());
+                pending.pop_front();
+                step = controller.step(resolutionSteps);
+            }
+
+            if (i >= settleFrames)
+            {
+                result.milliseconds.push_back(milliseconds);
+            }
+            result.meanScale += scale / aPhase.frames;
+            result.lowestStep = std::min(result.lowestStep, step);
+            if (verbose && frame % 20 == 0)
+            {
+                std::cout << "frame " << std::setw(5) << frame << "  " << std::fixed << std::setprecision(2)
+                          << std::setw(6) << milliseconds << " ms  scale " << scale << std::endl;
+            }
+        }
+        result.lastStep = step;
+        results.push_back(result);
+
+        size_t overBudget = std::count_if(result.milliseconds.begin(), result.milliseconds.end(), [](float milliseconds) {
+            return milliseconds > budgetMilliseconds;
+        });
+        std::cout << std::left << std::setw(12) << aPhase.name << std::right << std::fixed << std::setprecision(2)
+                  << " load " << aPhase.load
+                  << "  mean " << std::setw(6) << mean(result.milliseconds) << " ms"
+                  << "  p95 " << std::setw(6) << percentile(result.milliseconds, 0.95f) << " ms"
+                  << "  mean scale " << result.meanScale
+                  << "  over budget " << overBudget << std::endl;
+    }
+
+    bool passed = true;
+    if (results[0].lowestStep != resolutionSteps - 1)
+    {
+        std::cout << "light load did not stay at full size" << std::endl;
+        passed = false;
+    }
+    if (percentile(results[1].milliseconds, 0.95f) > budgetMilliseconds)
+    {
+        std::cout << "heavy load did not stay under the " << budgetMilliseconds << " ms budget" << std::endl;
+        passed = false;
+    }
+    if (mean(results[1].milliseconds) < 0.75f * settings.targetMilliseconds)
+    {
+        std::cout << "heavy load dropped further than needed" << std::endl;
+        passed = false;
+    }
+    if (results[2].lastStep != resolutionSteps - 1)
+    {
+        std::cout << "full size did not return after the heavy load" << std::endl;
+        passed = false;
+    }
+
+    std::cout << (passed ? "dynamic resolution held the budget" : "dynamic resolution check failed") << std::endl;
+    return passed ? 0 : 2;
+}
@@ -0,0 +1,256 @@
+//
+//  latencyBench.cpp
+//  vulkanTesting
+//
+//  Input to photon latency of each framePacer mode, on a simulated CPU, GPU and
+//  60 Hz display.  The loop is drawFrame's: wait for the fence of the frame two
+//  back, sleep until the pacer's input time, acquire, sample input, record and
+//  submit.  Photons are when scan out of the frame starts: on GPU completion
+//  with IMMEDIATE, at the next vertical blank with MAILBOX (unless a newer frame
+//  replaced it first), after the frames queued before it with FIFO.  Acquire
+//  waits for the image's previous frame to leave the screen or the mailbox.
+//  Checked for every load: low latency is never slower from input to photon
+//  than throughput and keeps at least 90% of its frame rate, and power save
+//  stays at or under its frame rate cap.
+//  Exit code 2 means a check failed.
+//
+//  usage: latencyBench [--margin MS] [--frames N] [--verbose]
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../framePacer.hpp"
+
+namespace
+{
+    // Same as the application
+    const size_t framesInFlight = 2;
+
+    const double refreshSeconds = 1.0 / 60.0;
+
+    // Frames before the measurements start, for the smoothed times to settle
+    const size_t warmupFrames = 60;
+
+    struct load {
+        std::string name;
+        float cpuMilliseconds; // input sampled to submit
+        float gpuMilliseconds;
+    };
+
+    struct result {
+        std::vector<float> latencies; // milliseconds, frames that reached the screen
+        float framesPerSecond; // rendered, MAILBOX drops some before the screen
+        float meanSleepMilliseconds;
+    };
+
+    // xorshift, deterministic noise of up to 10%
+    uint32_t noiseState = 0x2545F491u;
+    float noise()
+    {
+        noiseState ^= noiseState << 13;
+        noiseState ^= noiseState >> 17;
+        noiseState ^= noiseState << 5;
+        return 0.9f + 0.2f * (noiseState & 0xFFFF) / 65535.0f;
+    }
+
+    double nextVerticalBlank(double time)
+    {
+        // a frame finishing right on a blank makes it
+        return std::ceil(time / refreshSeconds - 1e-9) * refreshSeconds;
+    }
+
+    float percentile(std::vector<float> values, float fraction)
+    {
+        if (values.empty())
+        {
+            return 0.0f;
+        }
+        std::sort(values.begin(), values.end());
+        return values[std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()))];
+    }
+
+    float mean(const std::vector<float> & values)
+    {
+        float sum = 0.0f;
+        for (float value : values)
+        {
+            sum += value;
+        }
+        return values.empty() ? 0.0f : sum / values.size();
+    }
+
+    result run(framePacer::settings settings, const load & aLoad, size_t frameCount, bool verbose)
+    {
+        framePacer pacer(settings);
+
+        VkSurfaceCapabilitiesKHR capabilities = {};
+        capabilities.minImageCount = 2;
+        capabilities.maxImageCount = 8;
+        std::vector<VkPresentModeKHR> availableModes = {
+            VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR
+        };
+        VkPresentModeKHR presentMode = pacer.choosePresentMode(availableModes);
+        size_t imageCount = pacer.chooseImageCount(capabilities);
+
+        std::vector<double> inputs(frameCount);
+        std::vector<double> starts(frameCount);
+        std::vector<double> finishes(frameCount);
+        std::vector<double> fifoPhotons(frameCount); // FIFO only, every frame is shown
+        double now = 0.0;
+        double sleep = 0.0;
+
+        for (size_t frame = 0; frame < frameCount; ++frame)
+        {
+            if (frame >= framesInFlight)
+            {
+                size_t completed = frame - framesInFlight;
+                bool waited = finishes[completed] > now;
+                now = std::max(now, finishes[completed]);
+                // timestamps, as the application reads them after the fence
+                pacer.gpuTime(static_cast<float>((finishes[completed] - starts[completed]) * 1000.0));
+                pacer.frameCompleted(now, waited);
+            }
+
+            double inputTime = pacer.inputTime(now);
+            if (frame >= warmupFrames)
+            {
+                sleep += inputTime - now;
+            }
+            now = inputTime;
+
+            // the image's last frame has to have been replaced, on screen or in the mailbox
+            if (frame + 1 >= imageCount)
+            {
+                size_t replacing = frame + 1 - imageCount;
+                now = std::max(now, presentMode == VK_PRESENT_MODE_FIFO_KHR ? fifoPhotons[replacing] : finishes[replacing]);
+            }
+
+            inputs[frame] = now;
+            pacer.inputSampled(now);
+            now += aLoad.cpuMilliseconds * noise() / 1000.0;
+            pacer.frameSubmitted(now);
+
+            starts[frame] = std::max(now, frame > 0 ? finishes[frame - 1] : 0.0);
+            finishes[frame] = starts[frame] + aLoad.gpuMilliseconds * noise() / 1000.0;
+            double earliest = frame > 0 ? fifoPhotons[frame - 1] + refreshSeconds : 0.0;
+            fifoPhotons[frame] = nextVerticalBlank(std::max(finishes[frame], earliest));
+        }
+
+        result aResult;
+        for (size_t frame = warmupFrames; frame < frameCount; ++frame)
+        {
+            double photon = fifoPhotons[frame];
+            if (presentMode == VK_PRESENT_MODE_IMMEDIATE_KHR)
+            {
+                photon = finishes[frame];
+            }
+            else if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+            {
+                photon = nextVerticalBlank(finishes[frame]);
+                if (frame + 1 < frameCount && finishes[frame + 1] <= photon)
+                {
+                    continue; // replaced before the blank
+                }
+            }
+            aResult.latencies.push_back(static_cast<float>((photon - inputs[frame]) * 1000.0));
+
+            if (verbose && frame % 60 == 0)
+            {
+                std::cout << "    frame " << std::setw(5) << frame << std::fixed << std::setprecision(2)
+                          << "  input " << std::setw(8) << inputs[frame] * 1000.0 << " ms"
+                          << "  gpu done " << std::setw(8) << finishes[frame] * 1000.0 << " ms"
+                          << "  photon " << std::setw(8) << photon * 1000.0 << " ms" << std::endl;
+            }
+        }
+
+        double span = finishes[frameCount - 1] - finishes[warmupFrames];
+        aResult.framesPerSecond = static_cast<float>((frameCount - 1 - warmupFrames) / span);
+        aResult.meanSleepMilliseconds = static_cast<float>(sleep * 1000.0 / (frameCount - warmupFrames));
+        return aResult;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    framePacer::settings settings;
+    size_t frameCount = 1200;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--margin" && i + 1 < argc)
+        {
+            settings.marginMilliseconds = static_cast<float>(std::atof(argv[++i]));
+        }
+        else if (argument == "--frames" && i + 1 < argc)
+        {
+            frameCount = std::max<size_t>(std::strtoul(argv[++i], nullptr, 10), warmupFrames + 60);
+        }
+        else if (argument == "--verbose")
+        {
+            verbose = true;
+        }
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [--margin MS] [--frames N] [--verbose]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<load> loads = {
+        {"balanced", 4.0f, 10.0f},
+        {"gpu bound", 4.0f, 20.0f},
+        {"cpu bound", 12.0f, 6.0f}
+    };
+    std::vector<framePacer::mode> modes = {framePacer::lowLatency, framePacer::throughput, framePacer::powerSave};
+
+    bool passed = true;
+    for (const load & aLoad : loads)
+    {
+        std::cout << aLoad.name << ": cpu " << aLoad.cpuMilliseconds << " ms, gpu " << aLoad.gpuMilliseconds << " ms" << std::endl;
+
+        std::vector<result> results;
+        for (framePacer::mode aMode : modes)
+        {
+            settings.latencyMode = aMode;
+            results.push_back(run(settings, aLoad, frameCount, verbose));
+
+            const result & aResult = results.back();
+            std::cout << "  " << std::left << std::setw(12) << framePacer::modeName(aMode) << std::right << std::fixed << std::setprecision(2)
+                      << "  input to photon mean " << std::setw(6) << mean(aResult.latencies) << " ms"
+                      << "  p95 " << std::setw(6) << percentile(aResult.latencies, 0.95f) << " ms"
+                      << "  " << std::setw(6) << aResult.framesPerSecond << " fps"
+                      << "  paced " << std::setw(5) << aResult.meanSleepMilliseconds << " ms/frame" << std::endl;
+        }
+
+        const result & lowLatency = results[0];
+        const result & throughput = results[1];
+        const result & powerSave = results[2];
+        if (mean(lowLatency.latencies) > mean(throughput.latencies))
+        {
+            std::cout << "  low latency mode was slower to the screen than throughput" << std::endl;
+            passed = false;
+        }
+        if (lowLatency.framesPerSecond < 0.9f * throughput.framesPerSecond)
+        {
+            std::cout << "  low latency mode lost more than 10% of the frame rate" << std::endl;
+            passed = false;
+        }
+        if (powerSave.framesPerSecond > 1.01f * 1000.0f / settings.powerSaveFrameMilliseconds)
+        {
+            std::cout << "  power save mode ran over its frame rate cap" << std::endl;
+            passed = false;
+        }
+    }
+
+    std::cout << (passed ? "frame pacing kept latency down" : "frame pacing check failed") << std::endl;
+    return passed ? 0 : 2;
+}
@@ -0,0 +1,125 @@
+//
+//  lodBench.cpp
+//  vulkanTesting
+//
+//  Builds the LOD chain for a model (or a generated sphere) and prints the
+//  triangle count and error of every level, then the level selectLod picks as
+//  the object moves away from a 1080p camera with a 45 degree field of view.
+//  The chain is checked: indices must be valid, every level smaller than the
+//  one before, errors must not decrease, and the selection must only get
+//  coarser with distance.  Exit code 2 means a check failed.
+//
+//  usage: lodBench [model.obj|.gltf|.glb] [--sphere N] [--levels L] [--pixels P]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../meshLoader.hpp"
+#include "../meshSimplifier.hpp"
+#include "benchMesh.hpp"
+
+int main(int argc, char ** argv)
+{
+    std::string modelPath;
+    uint32_t sphereSegments = 256;
+    uint32_t maxLevels = 6;
+    float pixelThreshold = 1.0f;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--sphere" && i + 1 < argc)
+        {
+            sphereSegments = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if (argument == "--levels" && i + 1 < argc)
+        {
+            maxLevels = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if (argument == "--pixels" && i + 1 < argc)
+        {
+            pixelThreshold = static_cast<float>(std::atof(argv[++i]));
+        }
+        else if (argument[0] != '-')
+        {
+            modelPath = argument;
+        }
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [model.obj|.gltf|.glb] [--sphere N] [--levels L] [--pixels P]" << std::endl;
+            return 1;
+        }
+    }
+
+    meshLoader::mesh mesh;
+    if (!benchMesh::prepare(modelPath, sphereSegments, mesh))
+    {
+        return 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    meshSimplifier::lodChain chain = meshSimplifier::buildLodChain(mesh, maxLevels);
+    double buildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << chain.levels.size() << " levels built in " << std::fixed << std::setprecision(2) << buildMs << " ms" << std::endl;
+
+    bool valid = std::all_of(chain.indices.begin(), chain.indices.end(), [&mesh](uint32_t index) {
+        return index < mesh.vertices.size();
+    });
+    for (size_t level = 0; level < chain.levels.size(); ++level)
+    {
+        const meshSimplifier::lod & lod = chain.levels[level];
+        std::cout << "lod " << level << ": " << std::setw(8) << lod.indexCount / 3 << " triangles, error "
+                  << std::setprecision(5) << lod.error << std::endl;
+        valid = valid && lod.indexCount % 3 == 0 && lod.firstIndex + lod.indexCount <= chain.indices.size();
+        if (level > 0)
+        {
+            valid = valid && lod.indexCount < chain.levels[level - 1].indexCount && lod.error >= chain.levels[level - 1].error;
+        }
+    }
+    if (!valid)
+    {
+        std::cout << "LOD chain is inconsistent" << std::endl;
+        return 2;
+    }
+
+    // pixelsPerUnit for a 1080 pixel tall viewport with a 45 degree vertical field of view
+    const float projectionScale = 1080.0f / (2.0f * std::tan(0.5f * 45.0f * 3.14159265f / 180.0f));
+    glm::vec3 low = mesh.vertices[0].pos;
+    glm::vec3 high = low;
+    for (const Vertex & vertex : mesh.vertices)
+    {
+        low = glm::min(low, glm::vec3(vertex.pos));
+        high = glm::max(high, glm::vec3(vertex.pos));
+    }
+    float size = glm::length(high - low);
+
+    uint32_t current = 0;
+    uint32_t previous = 0;
+    size_t drawn = 0;
+    size_t full = 0;
+    for (float distance = size; distance <= size * 256.0f; distance *= 1.25f)
+    {
+        current = meshSimplifier::selectLod(chain, projectionScale / distance, pixelThreshold, current);
+        if (current < previous)
+        {
+            std::cout << "selection got finer while moving away" << std::endl;
+            return 2;
+        }
+        if (current != previous || distance == size)
+        {
+            std::cout << "  from " << std::setprecision(1) << distance / size << " x size: lod " << current << std::endl;
+        }
+        drawn += chain.levels[current].indexCount / 3;
+        full += chain.levels[0].indexCount / 3;
+        previous = current;
+    }
+    std::cout << "triangles drawn over the sweep: " << std::setprecision(1) << 100.0 * drawn / std::max<size_t>(full, 1) << "%" << std::endl;
+    return 0;
+}
@@ -0,0 +1,161 @@
+//
+//  meshOptimizerBench.cpp
+//  vulkanTesting
+//
+//  Runs meshOptimizer::optimize on a model (or a generated grid with its
+//  triangles shuffled, the worst case for the cache) and prints ACMR/ATVR and
+//  vertex fetch overfetch before and after.  The result is checked: the same
+//  triangles with the same winding must come out, and the cache must not get
+//  worse.  Exit code 2 means a check failed.
+//
+//  usage: meshOptimizerBench [model.obj|.gltf|.glb] [--grid N] [--threshold T]
+//
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../meshLoader.hpp"
+#include "../meshOptimizer.hpp"
+#include "benchMesh.hpp"
+
+namespace
+{
+    meshLoader::mesh shuffledGrid(uint32_t size)
+    {
+        meshLoader::mesh grid;
+        for (uint32_t y = 0; y <= size; ++y)
+        {
+            for (uint32_t x = 0; x <= size; ++x)
+            {
+                Vertex vertex;
+                vertex.pos = glm::vec3(static_cast<float>(x), static_cast<float>(y), 0.0f);
+                vertex.color = glm::vec3(1.0f, 1.0f, 1.0f);
+                vertex.texCoord = glm::vec2(static_cast<float>(x) / size, static_cast<float>(y) / size);
+                grid.vertices.push_back(vertex);
+            }
+        }
+
+        std::vector<std::array<uint32_t, 3>> triangles;
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                uint32_t corner = y * (size + 1) + x;
+                triangles.push_back({{corner, corner + 1, corner + size + 2}});
+                triangles.push_back({{corner, corner + size + 2, corner + size + 1}});
+            }
+        }
+        std::shuffle(triangles.begin(), triangles.end(), std::mt19937(7));
+        for (const std::array<uint32_t, 3> & triangle : triangles)
+        {
+            grid.indices.insert(grid.indices.end(), triangle.begin(), triangle.end());
+        }
+        return grid;
+    }
+
+    // Triangles by vertex contents, rotated so the smallest corner comes first (keeps the winding)
+    std::vector<std::array<Vertex, 3>> canonicalTriangles(const meshLoader::mesh & mesh)
+    {
+        auto less = [](const Vertex & a, const Vertex & b) {
+            return memcmp(&a, &b, sizeof(Vertex)) < 0;
+        };
+
+        std::vector<std::array<Vertex, 3>> triangles;
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            std::array<Vertex, 3> triangle = {{mesh.vertices[mesh.indices[i]], mesh.vertices[mesh.indices[i + 1]], mesh.vertices[mesh.indices[i + 2]]}};
+            while (less(triangle[1], triangle[0]) || less(triangle[2], triangle[0]))
+            {
+                std::rotate(triangle.begin(), triangle.begin() + 1, triangle.end());
+            }
+            triangles.push_back(triangle);
+        }
+        std::sort(triangles.begin(), triangles.end(), [](const std::array<Vertex, 3> & a, const std::array<Vertex, 3> & b) {
+            return memcmp(a.data(), b.data(), sizeof(a)) < 0;
+        });
+        return triangles;
+    }
+
+    void printRow(const char * label, const meshOptimizer::cacheStatistics & cache, const meshOptimizer::fetchStatistics & fetch)
+    {
+        std::cout << label << std::fixed << std::setprecision(3)
+                  << " acmr " << cache.acmr << "  atvr " << cache.atvr << "  overfetch " << fetch.overfetch << std::endl;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    std::string modelPath;
+    uint32_t gridSize = 128;
+    float threshold = 1.05f;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--grid" && i + 1 < argc)
+        {
+            gridSize = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if (argument == "--threshold" && i + 1 < argc)
+        {
+            threshold = static_cast<float>(std::atof(argv[++i]));
+        }
+        else if (argument[0] != '-')
+        {
+            modelPath = argument;
+        }
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [model.obj|.gltf|.glb] [--grid N] [--threshold T]" << std::endl;
+            return 1;
+        }
+    }
+
+    meshLoader::mesh mesh;
+    if (modelPath.empty())
+    {
+        mesh = shuffledGrid(gridSize);
+        std::cout << "shuffled " << gridSize << "x" << gridSize << " grid" << std::endl;
+    }
+    else if (!benchMesh::load(modelPath, mesh))
+    {
+        return 1;
+    }
+
+    std::vector<std::array<Vertex, 3>> before = canonicalTriangles(mesh);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    meshOptimizer::report report = meshOptimizer::optimize(mesh, threshold);
+    double optimizeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::cout << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3 << " triangles, optimized in "
+              << std::setprecision(2) << std::fixed << optimizeMs << " ms" << std::endl;
+    printRow("before:", report.cacheBefore, report.fetchBefore);
+    printRow("after: ", report.cacheAfter, report.fetchAfter);
+
+    bool indicesValid = std::all_of(mesh.indices.begin(), mesh.indices.end(), [&mesh](uint32_t index) {
+        return index < mesh.vertices.size();
+    });
+    std::vector<std::array<Vertex, 3>> after = canonicalTriangles(mesh);
+    bool sameTriangles = after.size() == before.size() &&
+                         memcmp(after.data(), before.data(), after.size() * sizeof(after[0])) == 0;
+    if (!indicesValid || !sameTriangles)
+    {
+        std::cout << "optimized mesh does not contain the original triangles" << std::endl;
+        return 2;
+    }
+    if (report.cacheAfter.acmr > report.cacheBefore.acmr)
+    {
+        std::cout << "vertex cache got worse" << std::endl;
+        return 2;
+    }
+    return 0;
+}
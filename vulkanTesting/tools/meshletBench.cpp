@@ -0,0 +1,180 @@
+//
+//  meshletBench.cpp
+//  vulkanTesting
+//
+//  Splits a model (or a generated sphere) into meshlets and prints cluster
+//  statistics and how much the frustum and cone tests cull from cameras orbiting
+//  it.  The result is checked: the clusters must hold the original triangles
+//  within the limits, every sphere must contain its vertices, and a culled
+//  cluster must not contain a front facing triangle inside the frustum.  Exit
+//  code 2 means a check failed.
+//
+//  usage: meshletBench [model.obj|.gltf|.glb] [--sphere N] [--vertices V] [--triangles T]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../meshLoader.hpp"
+#include "../meshlet.hpp"
+#include "benchMesh.hpp"
+
+namespace
+{
+    bool outsidePlane(const float plane[4], const glm::vec3 & point)
+    {
+        return plane[0] * point.x + plane[1] * point.y + plane[2] * point.z + plane[3] < 0.0f;
+    }
+
+    // What the cull may remove: triangles facing away or entirely outside one plane
+    bool mayCull(const meshLoader::mesh & mesh, const uint32_t * triangle, const float planes[6][4], const glm::vec3 & camera)
+    {
+        glm::vec3 a = mesh.vertices[triangle[0]].pos;
+        glm::vec3 b = mesh.vertices[triangle[1]].pos;
+        glm::vec3 c = mesh.vertices[triangle[2]].pos;
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float scale = std::max(glm::length(normal), 1e-12f) * std::max(glm::length(a - camera), 1e-12f);
+        if (glm::dot(normal, a - camera) >= -1e-4f * scale)
+        {
+            return true;
+        }
+        for (int plane = 0; plane < 6; ++plane)
+        {
+            if (outsidePlane(planes[plane], a) && outsidePlane(planes[plane], b) && outsidePlane(planes[plane], c))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    std::string modelPath;
+    uint32_t sphereSegments = 256;
+    uint32_t vertexLimit = meshlet::maxVertices;
+    uint32_t triangleLimit = meshlet::maxTriangles;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--sphere" && i + 1 < argc)
+        {
+            sphereSegments = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if (argument == "--vertices" && i + 1 < argc)
+        {
+            vertexLimit = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if (argument == "--triangles" && i + 1 < argc)
+        {
+            triangleLimit = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if (argument[0] != '-')
+        {
+            modelPath = argument;
+        }
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [model.obj|.gltf|.glb] [--sphere N] [--vertices V] [--triangles T]" << std::endl;
+            return 1;
+        }
+    }
+
+    meshLoader::mesh mesh;
+    if (!benchMesh::prepare(modelPath, sphereSegments, mesh))
+    {
+        return 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    meshlet::clusterSet clusterSet = meshlet::build(mesh, vertexLimit, triangleLimit);
+    double buildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    size_t vertexTotal = 0;
+    size_t coneUsable = 0;
+    bool valid = clusterSet.indices == mesh.indices;
+    for (const meshlet::cluster & cluster : clusterSet.clusters)
+    {
+        vertexTotal += cluster.vertexCount;
+        coneUsable += cluster.coneCutoff < 1.0f ? 1 : 0;
+        valid = valid && cluster.vertexCount <= vertexLimit && cluster.indexCount / 3 <= triangleLimit;
+        for (uint32_t i = 0; i < cluster.indexCount; ++i)
+        {
+            glm::vec3 position = mesh.vertices[clusterSet.indices[cluster.indexOffset + i]].pos;
+            valid = valid && glm::length(position - glm::vec3(cluster.center)) <= cluster.radius * 1.0001f + 1e-6f;
+        }
+    }
+
+    size_t clusterCount = clusterSet.clusters.size();
+    std::cout << clusterCount << " meshlets from " << mesh.indices.size() / 3 << " triangles in "
+              << std::fixed << std::setprecision(2) << buildMs << " ms, "
+              << static_cast<float>(mesh.indices.size() / 3) / std::max<size_t>(clusterCount, 1) << " triangles and "
+              << static_cast<float>(vertexTotal) / std::max<size_t>(clusterCount, 1) << " vertices per meshlet, "
+              << coneUsable << " with a usable cone" << std::endl;
+    if (!valid)
+    {
+        std::cout << "meshlets do not match the mesh" << std::endl;
+        return 2;
+    }
+
+    // Cameras orbiting at three times the bounding radius, looking at the center
+    glm::vec3 low = mesh.vertices[0].pos;
+    glm::vec3 high = low;
+    for (const Vertex & vertex : mesh.vertices)
+    {
+        low = glm::min(low, glm::vec3(vertex.pos));
+        high = glm::max(high, glm::vec3(vertex.pos));
+    }
+    glm::vec3 center = (low + high) * 0.5f;
+    float distance = glm::length(high - low) * 1.5f;
+
+    const int views = 8;
+    for (int view = 0; view < views; ++view)
+    {
+        float angle = 2.0f * 3.14159265f * view / views;
+        glm::vec3 camera = center + glm::vec3(std::cos(angle), std::sin(angle), 0.5f) * distance;
+        glm::mat4 viewMatrix = glm::lookAt(camera, center + glm::vec3(std::cos(angle * 3.0f), 0.0f, 0.0f) * (distance * 0.2f), glm::vec3(0.0f, 0.0f, 1.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(30.0f), 1.0f, 0.1f, distance * 4.0f);
+        glm::mat4 viewProjection = projection * viewMatrix;
+
+        float planes[6][4];
+        meshlet::frustumPlanes(viewProjection, planes);
+        float cameraPosition[3] = {camera.x, camera.y, camera.z};
+
+        size_t visibleClusters = 0;
+        size_t visibleTriangles = 0;
+        for (const meshlet::cluster & cluster : clusterSet.clusters)
+        {
+            if (meshlet::isVisible(cluster, planes, cameraPosition))
+            {
+                ++visibleClusters;
+                visibleTriangles += cluster.indexCount / 3;
+                continue;
+            }
+            for (uint32_t i = 0; i < cluster.indexCount; i += 3)
+            {
+                if (!mayCull(mesh, &clusterSet.indices[cluster.indexOffset + i], planes, camera))
+                {
+                    std::cout << "view " << view << " culled a visible triangle" << std::endl;
+                    return 2;
+                }
+            }
+        }
+        std::cout << "view " << view << ": " << visibleClusters << "/" << clusterCount << " meshlets, "
+                  << std::setprecision(1) << 100.0f * visibleTriangles / std::max<size_t>(mesh.indices.size() / 3, 1)
+                  << "% of triangles drawn" << std::endl;
+    }
+    return 0;
+}
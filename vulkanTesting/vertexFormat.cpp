@@ -0,0 +1,478 @@
+//
+//  vertexFormat.cpp
+//  vulkanTesting
+//
+
+#include "vertexFormat.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VERTEX_FORMAT_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define VERTEX_FORMAT_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    uint16_t halfScalar(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000u;
+        uint32_t magnitude = bits & 0x7FFFFFFFu;
+
+        if (magnitude >= 0x7F800000u)
+        {
+            return static_cast<uint16_t>(sign | (magnitude > 0x7F800000u ? 0x7E00u : 0x7C00u)); // NaN or infinity
+        }
+        if (magnitude >= 0x477FF000u)
+        {
+            return static_cast<uint16_t>(sign | 0x7C00u); // rounds past the largest half
+        }
+        if (magnitude < 0x38800000u)
+        {
+            // Subnormal half: scale so the result is the integer mantissa, rounded to nearest even
+            float scaled;
+            memcpy(&scaled, &magnitude, sizeof(scaled));
+            return static_cast<uint16_t>(sign | static_cast<uint32_t>(std::nearbyint(scaled * 16777216.0f)));
+        }
+
+        // Rebias the exponent from 127 to 15 and round the mantissa to 10 bits, ties to even
+        uint32_t rebased = magnitude - 0x38000000u;
+        rebased += 0x0FFFu + ((rebased >> 13) & 1u);
+        return static_cast<uint16_t>(sign | (rebased >> 13));
+    }
+
+    float clamp01(float value)
+    {
+        return value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f; // NaN lands on 0
+    }
+
+    float signNotZero(float value)
+    {
+        return value >= 0.0f ? 1.0f : -1.0f;
+    }
+
+    void octahedralScalar(const float * in, int16_t * out)
+    {
+        float x = in[0], y = in[1], z = in[2];
+        float sum = std::fabs(x) + std::fabs(y) + std::fabs(z);
+        float scale = sum > 0.0f ? 1.0f / sum : 0.0f;
+        x *= scale;
+        y *= scale;
+        z *= scale;
+        if (z < 0.0f)
+        {
+            float foldedX = (1.0f - std::fabs(y)) * signNotZero(x);
+            float foldedY = (1.0f - std::fabs(x)) * signNotZero(y);
+            x = foldedX;
+            y = foldedY;
+        }
+        out[0] = static_cast<int16_t>(std::nearbyint(std::max(-1.0f, std::min(1.0f, x)) * 32767.0f));
+        out[1] = static_cast<int16_t>(std::nearbyint(std::max(-1.0f, std::min(1.0f, y)) * 32767.0f));
+    }
+
+#ifdef VERTEX_FORMAT_X86
+    bool cpuHasF16c()
+    {
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        {
+            return false;
+        }
+        // VEX encoded instructions also need the OS to save the AVX registers
+        if ((ecx & bit_F16C) == 0 || (ecx & bit_OSXSAVE) == 0 || (ecx & bit_AVX) == 0)
+        {
+            return false;
+        }
+        unsigned xcrLow, xcrHigh;
+        __asm__("xgetbv" : "=a"(xcrLow), "=d"(xcrHigh) : "c"(0));
+        return (xcrLow & 6u) == 6u;
+    }
+
+    const bool hasF16c = cpuHasF16c();
+
+    __attribute__((target("avx,f16c")))
+    size_t floatToHalfF16c(const float * in, uint16_t * out, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), halves);
+        }
+        return i;
+    }
+
+    __m128i roundToInt(__m128 value, float scale)
+    {
+        // cvtps rounds to nearest even under the default MXCSR
+        return _mm_cvtps_epi32(_mm_mul_ps(value, _mm_set1_ps(scale)));
+    }
+
+    __m128 clamp01(__m128 value)
+    {
+        // max returns its second operand for NaN, so NaN lands on 0
+        return _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    }
+#endif
+}
+
+vertexFormat::layout & vertexFormat::layout::add(attributeSource source, attributeFormat format, uint32_t location)
+{
+    attribute added;
+    added.source = source;
+    added.format = format;
+    added.location = location;
+    added.offset = (_stride + 3u) & ~3u;
+    _attributes.push_back(added);
+    _stride = added.offset + formatSize(format);
+    return *this;
+}
+
+uint32_t vertexFormat::layout::stride() const
+{
+    return (_stride + 3u) & ~3u;
+}
+
+const std::vector<vertexFormat::attribute> & vertexFormat::layout::attributes() const
+{
+    return _attributes;
+}
+
+VkVertexInputBindingDescription vertexFormat::layout::getBindingDescription(uint32_t binding) const
+{
+    VkVertexInputBindingDescription bindingDescription = {};
+
+    bindingDescription.binding = binding;
+    bindingDescription.stride = stride();
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return bindingDescription;
+}
+
+std::vector<VkVertexInputAttributeDescription> vertexFormat::layout::getAttributeDescriptions(uint32_t binding) const
+{
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions(_attributes.size());
+    for (size_t i = 0; i < _attributes.size(); ++i)
+    {
+        attributeDescriptions[i].binding = binding;
+        attributeDescriptions[i].location = _attributes[i].location;
+        attributeDescriptions[i].format = vulkanFormat(_attributes[i].format);
+        attributeDescriptions[i].offset = _attributes[i].offset;
+    }
+    return attributeDescriptions;
+}
+
+uint32_t vertexFormat::formatSize(attributeFormat format)
+{
+    switch (format)
+    {
+        case attributeFormat::float32x2: return 8;
+        case attributeFormat::float32x3: return 12;
+        case attributeFormat::float16x2: return 4;
+        case attributeFormat::float16x4: return 8;
+        case attributeFormat::unorm8x4: return 4;
+        case attributeFormat::unorm16x2: return 4;
+        case attributeFormat::snorm16x2Octahedral: return 4;
+    }
+    return 0;
+}
+
+VkFormat vertexFormat::vulkanFormat(attributeFormat format)
+{
+    switch (format)
+    {
+        case attributeFormat::float32x2: return VK_FORMAT_R32G32_SFLOAT;
+        case attributeFormat::float32x3: return VK_FORMAT_R32G32B32_SFLOAT;
+        case attributeFormat::float16x2: return VK_FORMAT_R16G16_SFLOAT;
+        case attributeFormat::float16x4: return VK_FORMAT_R16G16B16A16_SFLOAT;
+        case attributeFormat::unorm8x4: return VK_FORMAT_R8G8B8A8_UNORM;
+        case attributeFormat::unorm16x2: return VK_FORMAT_R16G16_UNORM;
+        case attributeFormat::snorm16x2Octahedral: return VK_FORMAT_R16G16_SNORM;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+vertexFormat::layout vertexFormat::full()
+{
+    constexpr std::array<VkVertexInputAttributeDescription, 3> vertexAttributes = vertexInput::attributeDescriptions();
+    // add() packs the attributes back to back, so the struct's fields have to be packed too
+    static_assert(vertexInput::packed &&
+                  vertexAttributes[0].format == VK_FORMAT_R32G32B32_SFLOAT &&
+                  vertexAttributes[1].format == VK_FORMAT_R32G32B32_SFLOAT &&
+                  vertexAttributes[2].format == VK_FORMAT_R32G32_SFLOAT,
+                  "full() must stay byte for byte the Vertex struct");
+
+    layout result;
+    result.add(attributeSource::position, attributeFormat::float32x3, 0)
+          .add(attributeSource::color, attributeFormat::float32x3, 1)
+          .add(attributeSource::texCoord, attributeFormat::float32x2, 2);
+    return result;
+}
+
+vertexFormat::layout vertexFormat::compact(const std::vector<Vertex> & vertices)
+{
+    float minimum[3] = {0.0f, 0.0f, 0.0f};
+    float maximum[3] = {0.0f, 0.0f, 0.0f};
+    float largest = 0.0f;
+    bool uvInRange = true;
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        const Vertex & vertex = vertices[i];
+        const float position[3] = {vertex.pos.x, vertex.pos.y, vertex.pos.z};
+        for (int c = 0; c < 3; ++c)
+        {
+            minimum[c] = i == 0 ? position[c] : std::min(minimum[c], position[c]);
+            maximum[c] = i == 0 ? position[c] : std::max(maximum[c], position[c]);
+            largest = std::max(largest, std::fabs(position[c]));
+        }
+        uvInRange = uvInRange &&
+                    vertex.texCoord.x >= 0.0f && vertex.texCoord.x <= 1.0f &&
+                    vertex.texCoord.y >= 0.0f && vertex.texCoord.y <= 1.0f;
+    }
+    float diagonal = std::sqrt((maximum[0] - minimum[0]) * (maximum[0] - minimum[0]) +
+                               (maximum[1] - minimum[1]) * (maximum[1] - minimum[1]) +
+                               (maximum[2] - minimum[2]) * (maximum[2] - minimum[2]));
+
+    // A half keeps 11 significant bits, so its error grows with the distance from
+    // the origin.  Allow up to 1/1000 of the mesh size.
+    bool halfPositions = largest / 2048.0f <= diagonal / 1000.0f && largest < 65504.0f;
+
+    layout result;
+    result.add(attributeSource::position, halfPositions ? attributeFormat::float16x4 : attributeFormat::float32x3, 0)
+          .add(attributeSource::color, attributeFormat::unorm8x4, 1)
+          .add(attributeSource::texCoord, uvInRange ? attributeFormat::unorm16x2 : attributeFormat::float16x2, 2);
+    return result;
+}
+
+vertexFormat::layout vertexFormat::positionOnly(const layout & source)
+{
+    layout result;
+    for (const attribute & item : source.attributes())
+    {
+        if (item.source == attributeSource::position)
+        {
+            result.add(item.source, item.format, item.location);
+        }
+    }
+    return result;
+}
+
+std::vector<uint8_t> vertexFormat::encode(const std::vector<Vertex> & vertices,
+                                          const layout & layout,
+                                          const std::vector<glm::packed_vec3> & normals)
+{
+    size_t count = vertices.size();
+    size_t stride = layout.stride();
+    std::vector<uint8_t> encoded(count * stride, 0);
+
+    std::vector<float> source;
+    std::vector<uint8_t> converted;
+
+    for (const attribute & item : layout.attributes())
+    {
+        if (item.source == attributeSource::normal && normals.size() < count)
+        {
+            continue; // nothing to encode, left as zero
+        }
+
+        // Gather the attribute as floats, padding to 4 components with 1 where the format needs it
+        size_t components = item.source == attributeSource::texCoord ? 2 : 3;
+        bool padToFour = item.format == attributeFormat::float16x4 || item.format == attributeFormat::unorm8x4;
+        size_t sourceWidth = padToFour ? 4 : components;
+        source.resize(count * sourceWidth);
+        for (size_t i = 0; i < count; ++i)
+        {
+            float * out = &source[i * sourceWidth];
+            const Vertex & vertex = vertices[i];
+            switch (item.source)
+            {
+                case attributeSource::position: out[0] = vertex.pos.x; out[1] = vertex.pos.y; out[2] = vertex.pos.z; break;
+                case attributeSource::color: out[0] = vertex.color.x; out[1] = vertex.color.y; out[2] = vertex.color.z; break;
+                case attributeSource::texCoord: out[0] = vertex.texCoord.x; out[1] = vertex.texCoord.y; break;
+                case attributeSource::normal: out[0] = normals[i].x; out[1] = normals[i].y; out[2] = normals[i].z; break;
+            }
+            if (padToFour)
+            {
+                out[3] = 1.0f;
+            }
+        }
+
+        size_t size = formatSize(item.format);
+        converted.resize(count * size);
+        switch (item.format)
+        {
+            case attributeFormat::float32x2:
+            case attributeFormat::float32x3:
+                memcpy(converted.data(), source.data(), converted.size());
+                break;
+            case attributeFormat::float16x2:
+            case attributeFormat::float16x4:
+                floatToHalf(source.data(), reinterpret_cast<uint16_t *>(converted.data()), source.size());
+                break;
+            case attributeFormat::unorm8x4:
+                floatToUnorm8(source.data(), converted.data(), source.size());
+                break;
+            case attributeFormat::unorm16x2:
+                floatToUnorm16(source.data(), reinterpret_cast<uint16_t *>(converted.data()), source.size());
+                break;
+            case attributeFormat::snorm16x2Octahedral:
+                encodeOctahedral(source.data(), reinterpret_cast<int16_t *>(converted.data()), count);
+                break;
+        }
+
+        // Interleave
+        for (size_t i = 0; i < count; ++i)
+        {
+            memcpy(&encoded[i * stride + item.offset], &converted[i * size], size);
+        }
+    }
+    return encoded;
+}
+
+void vertexFormat::floatToHalf(const float * in, uint16_t * out, size_t count)
+{
+    size_t i = 0;
+#if defined(VERTEX_FORMAT_X86)
+    if (hasF16c)
+    {
+        i = floatToHalfF16c(in, out, count);
+    }
+#elif defined(VERTEX_FORMAT_NEON)
+    for (; i + 4 <= count; i += 4)
+    {
+        vst1_u16(out + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in + i))));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        out[i] = halfScalar(in[i]);
+    }
+}
+
+void vertexFormat::floatToUnorm8(const float * in, uint8_t * out, size_t count)
+{
+    size_t i = 0;
+#if defined(VERTEX_FORMAT_X86)
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i a = roundToInt(clamp01(_mm_loadu_ps(in + i)), 255.0f);
+        __m128i b = roundToInt(clamp01(_mm_loadu_ps(in + i + 4)), 255.0f);
+        __m128i c = roundToInt(clamp01(_mm_loadu_ps(in + i + 8)), 255.0f);
+        __m128i d = roundToInt(clamp01(_mm_loadu_ps(in + i + 12)), 255.0f);
+        __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), bytes);
+    }
+#elif defined(VERTEX_FORMAT_NEON)
+    float32x4_t zero = vdupq_n_f32(0.0f);
+    float32x4_t one = vdupq_n_f32(1.0f);
+    for (; i + 8 <= count; i += 8)
+    {
+        uint32x4_t a = vcvtnq_u32_f32(vmulq_n_f32(vminq_f32(vmaxq_f32(vld1q_f32(in + i), zero), one), 255.0f));
+        uint32x4_t b = vcvtnq_u32_f32(vmulq_n_f32(vminq_f32(vmaxq_f32(vld1q_f32(in + i + 4), zero), one), 255.0f));
+        vst1_u8(out + i, vmovn_u16(vcombine_u16(vmovn_u32(a), vmovn_u32(b))));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        out[i] = static_cast<uint8_t>(std::nearbyint(clamp01(in[i]) * 255.0f));
+    }
+}
+
+void vertexFormat::floatToUnorm16(const float * in, uint16_t * out, size_t count)
+{
+    size_t i = 0;
+#if defined(VERTEX_FORMAT_X86)
+    // SSE2 only packs signed, so shift into the signed range and flip the top bit back
+    const __m128i bias = _mm_set1_epi32(32768);
+    const __m128i flip = _mm_set1_epi16(static_cast<short>(0x8000));
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i a = _mm_sub_epi32(roundToInt(clamp01(_mm_loadu_ps(in + i)), 65535.0f), bias);
+        __m128i b = _mm_sub_epi32(roundToInt(clamp01(_mm_loadu_ps(in + i + 4)), 65535.0f), bias);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_xor_si128(_mm_packs_epi32(a, b), flip));
+    }
+#elif defined(VERTEX_FORMAT_NEON)
+    float32x4_t zero = vdupq_n_f32(0.0f);
+    float32x4_t one = vdupq_n_f32(1.0f);
+    for (; i + 4 <= count; i += 4)
+    {
+        uint32x4_t a = vcvtnq_u32_f32(vmulq_n_f32(vminq_f32(vmaxq_f32(vld1q_f32(in + i), zero), one), 65535.0f));
+        vst1_u16(out + i, vmovn_u32(a));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        out[i] = static_cast<uint16_t>(std::nearbyint(clamp01(in[i]) * 65535.0f));
+    }
+}
+
+void vertexFormat::encodeOctahedral(const float * in, int16_t * out, size_t count)
+{
+    size_t i = 0;
+#if defined(VERTEX_FORMAT_X86)
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= count; i += 4)
+    {
+        // Deinterleave four xyz triples
+        const float * p = in + i * 3;
+        __m128 x = _mm_setr_ps(p[0], p[3], p[6], p[9]);
+        __m128 y = _mm_setr_ps(p[1], p[4], p[7], p[10]);
+        __m128 z = _mm_setr_ps(p[2], p[5], p[8], p[11]);
+
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, x), _mm_andnot_ps(signMask, y)), _mm_andnot_ps(signMask, z));
+        __m128 nonZero = _mm_cmpgt_ps(sum, _mm_setzero_ps());
+        __m128 scale = _mm_and_ps(_mm_div_ps(one, sum), nonZero);
+        x = _mm_mul_ps(x, scale);
+        y = _mm_mul_ps(y, scale);
+        z = _mm_mul_ps(z, scale);
+
+        // Fold the lower hemisphere over the diagonals
+        __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+        __m128 signX = _mm_or_ps(_mm_and_ps(x, signMask), one);
+        __m128 signY = _mm_or_ps(_mm_and_ps(y, signMask), one);
+        __m128 foldedX = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, y)), signX);
+        __m128 foldedY = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, x)), signY);
+        x = _mm_or_ps(_mm_and_ps(lower, foldedX), _mm_andnot_ps(lower, x));
+        y = _mm_or_ps(_mm_and_ps(lower, foldedY), _mm_andnot_ps(lower, y));
+
+        __m128 minusOne = _mm_set1_ps(-1.0f);
+        __m128i qx = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(x, minusOne), one), _mm_set1_ps(32767.0f)));
+        __m128i qy = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(y, minusOne), one), _mm_set1_ps(32767.0f)));
+        __m128i packedX = _mm_packs_epi32(qx, qx);
+        __m128i packedY = _mm_packs_epi32(qy, qy);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 2), _mm_unpacklo_epi16(packedX, packedY));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        octahedralScalar(in + i * 3, out + i * 2);
+    }
+}
+
+float vertexFormat::halfToFloat(uint16_t half)
+{
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1Fu;
+    uint32_t mantissa = half & 0x3FFu;
+
+    float result;
+    if (exponent == 0)
+    {
+        result = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -result : result;
+    }
+
+    uint32_t bits = exponent == 31 ? (sign | 0x7F800000u | (mantissa << 13))
+                                   : (sign | ((exponent + 112u) << 23) | (mantissa << 13));
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
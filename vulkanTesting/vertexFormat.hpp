@@ -0,0 +1,102 @@
+//
+//  vertexFormat.hpp
+//  vulkanTesting
+//
+
+#ifndef vertexFormat_hpp
+#define vertexFormat_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "vertex.hpp"
+
+// Describes how Vertex attributes are stored in the vertex buffer, from full
+// 32 bit floats down to quantized formats, and encodes vertices to match.
+// The input assembler expands every format here back to floats, so the same
+// vertex shader works with any layout.
+namespace vertexFormat {
+
+    enum class attributeFormat {
+        float32x2,
+        float32x3,
+        float16x2,
+        float16x4,           // three components plus w = 1, half floats have no 3 wide format that must be supported
+        unorm8x4,            // fourth component is 1
+        unorm16x2,
+        snorm16x2Octahedral, // unit vector folded onto an octahedron, decode in the shader
+    };
+
+    enum class attributeSource {
+        position,
+        color,
+        texCoord,
+        normal,
+    };
+
+    struct attribute {
+        attributeSource source;
+        attributeFormat format;
+        uint32_t location;
+        uint32_t offset;
+    };
+
+    class layout
+    {
+    public:
+
+        // Appends an attribute after the previous one, 4 byte aligned
+        layout & add(attributeSource source, attributeFormat format, uint32_t location);
+
+        uint32_t stride() const;
+
+        const std::vector<attribute> & attributes() const;
+
+        VkVertexInputBindingDescription getBindingDescription(uint32_t binding = 0) const;
+
+        std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(uint32_t binding = 0) const;
+
+    private:
+        std::vector<attribute> _attributes;
+        uint32_t _stride = 0;
+    };
+
+    uint32_t formatSize(attributeFormat format);
+
+    VkFormat vulkanFormat(attributeFormat format);
+
+    // Byte for byte the Vertex struct, 32 bytes
+    layout full();
+
+    // 16 bytes when the mesh allows it: half positions, 8 bit colors and 16 bit UVs.
+    // Positions stay 32 bit when the mesh sits so far from the origin that half
+    // precision would be visible, UVs become halves when they tile outside [0, 1].
+    layout compact(const std::vector<Vertex> & vertices);
+
+    // Just the position of source, in the same format and location, for passes that
+    // only need depth.  The same format keeps the positions bit for bit equal.
+    layout positionOnly(const layout & source);
+
+    // normals is only read when the layout has a normal attribute, one per vertex.
+    // Packed like Vertex, so the type is the same with and without aligned gentypes.
+    std::vector<uint8_t> encode(const std::vector<Vertex> & vertices,
+                                const layout & layout,
+                                const std::vector<glm::packed_vec3> & normals = std::vector<glm::packed_vec3>());
+
+    // Bulk conversions used by encode.  SSE2/F16C on x86, NEON on ARM, scalar otherwise.
+    void floatToHalf(const float * in, uint16_t * out, size_t count);
+
+    void floatToUnorm8(const float * in, uint8_t * out, size_t count);
+
+    void floatToUnorm16(const float * in, uint16_t * out, size_t count);
+
+    // in holds xyz triples, out receives two snorm16 values per normal
+    void encodeOctahedral(const float * in, int16_t * out, size_t count);
+
+    float halfToFloat(uint16_t half);
+}
+
+#endif /* vertexFormat_hpp */
@@ -0,0 +1,234 @@
+//
+//  vertexLayout.hpp
+//  vulkanTesting
+//
+
+#ifndef vertexLayout_hpp
+#define vertexLayout_hpp
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_aligned.hpp>
+
+// Vertex input descriptions generated at compile time from a field list, so a
+// struct and its VkVertexInputAttributeDescriptions cannot drift apart:
+//
+//     typedef vertexLayout::layout<Vertex,
+//                                  VERTEX_LAYOUT_FIELD(Vertex, pos),
+//                                  VERTEX_LAYOUT_FIELD(Vertex, color)> vertexInput;
+//
+//     vertexInput::bindingDescription(0);
+//     vertexInput::attributeDescriptions(0);  // constexpr std::array, locations 0, 1
+//
+// Formats come from the member types through formatOf.  A member type without a
+// mapping, a misaligned member or an overlap fails to compile.
+namespace vertexLayout {
+
+    template <typename T>
+    struct formatOf {
+        static_assert(sizeof(T) == 0, "no VkFormat mapping for this vertex attribute type, add a formatOf specialization");
+    };
+
+#define VERTEX_LAYOUT_FORMAT(type, vkFormat, componentType) \
+    template <> struct formatOf<type> { \
+        static constexpr VkFormat format = vkFormat; \
+        typedef componentType component; \
+    };
+
+    VERTEX_LAYOUT_FORMAT(float, VK_FORMAT_R32_SFLOAT, float)
+    VERTEX_LAYOUT_FORMAT(glm::vec2, VK_FORMAT_R32G32_SFLOAT, float)
+    VERTEX_LAYOUT_FORMAT(glm::vec3, VK_FORMAT_R32G32B32_SFLOAT, float)
+    VERTEX_LAYOUT_FORMAT(glm::vec4, VK_FORMAT_R32G32B32A32_SFLOAT, float)
+    VERTEX_LAYOUT_FORMAT(uint32_t, VK_FORMAT_R32_UINT, uint32_t)
+    VERTEX_LAYOUT_FORMAT(glm::uvec2, VK_FORMAT_R32G32_UINT, uint32_t)
+    VERTEX_LAYOUT_FORMAT(glm::uvec4, VK_FORMAT_R32G32B32A32_UINT, uint32_t)
+    VERTEX_LAYOUT_FORMAT(int32_t, VK_FORMAT_R32_SINT, int32_t)
+    VERTEX_LAYOUT_FORMAT(glm::ivec4, VK_FORMAT_R32G32B32A32_SINT, int32_t)
+
+    // The packed types are only distinct from the defaults when GLM honours aligned
+    // gentypes, which it can ignore even with GLM_FORCE_DEFAULT_ALIGNED_GENTYPES defined
+#if defined(GLM_CONFIG_ALIGNED_GENTYPES) && GLM_CONFIG_ALIGNED_GENTYPES == GLM_ENABLE
+    VERTEX_LAYOUT_FORMAT(glm::packed_vec2, VK_FORMAT_R32G32_SFLOAT, float)
+    VERTEX_LAYOUT_FORMAT(glm::packed_vec3, VK_FORMAT_R32G32B32_SFLOAT, float)
+    VERTEX_LAYOUT_FORMAT(glm::packed_vec4, VK_FORMAT_R32G32B32A32_SFLOAT, float)
+#endif
+
+    // Quantized storage: raw bits in the struct, expanded to floats by the input assembler
+    struct half2 { uint16_t bits[2]; };
+    struct half4 { uint16_t bits[4]; };
+    struct unorm8x4 { uint8_t value[4]; };
+    struct unorm16x2 { uint16_t value[2]; };
+    struct snorm16x2 { int16_t value[2]; };
+
+    VERTEX_LAYOUT_FORMAT(half2, VK_FORMAT_R16G16_SFLOAT, uint16_t)
+    VERTEX_LAYOUT_FORMAT(half4, VK_FORMAT_R16G16B16A16_SFLOAT, uint16_t)
+    VERTEX_LAYOUT_FORMAT(unorm8x4, VK_FORMAT_R8G8B8A8_UNORM, uint8_t)
+    VERTEX_LAYOUT_FORMAT(unorm16x2, VK_FORMAT_R16G16_UNORM, uint16_t)
+    VERTEX_LAYOUT_FORMAT(snorm16x2, VK_FORMAT_R16G16_SNORM, int16_t)
+
+#undef VERTEX_LAYOUT_FORMAT
+
+    template <typename Struct, typename Member, size_t Offset>
+    struct field {
+        typedef Member type;
+        static constexpr VkFormat format = formatOf<Member>::format;
+        static constexpr uint32_t offset = static_cast<uint32_t>(Offset);
+        static constexpr uint32_t size = sizeof(Member);
+
+        static_assert(std::is_trivially_copyable<Member>::value, "vertex attributes must be trivially copyable");
+        static_assert(Offset + sizeof(Member) <= sizeof(Struct), "vertex attribute lies outside its struct");
+        static_assert(Offset % alignof(typename formatOf<Member>::component) == 0,
+                      "vertex attribute offset is not aligned to its component size");
+    };
+
+    namespace detail {
+
+        // Fields must be listed in memory order and must not overlap
+        template <typename... Fields>
+        struct ordered : std::true_type {};
+
+        template <typename First, typename Second, typename... Rest>
+        struct ordered<First, Second, Rest...> :
+            std::integral_constant<bool, First::offset + First::size <= Second::offset && ordered<Second, Rest...>::value> {};
+
+        // Each field starts where the previous one ends
+        template <typename... Fields>
+        struct contiguous : std::true_type {};
+
+        template <typename First, typename Second, typename... Rest>
+        struct contiguous<First, Second, Rest...> :
+            std::integral_constant<bool, First::offset + First::size == Second::offset && contiguous<Second, Rest...>::value> {};
+
+        template <size_t... Values>
+        struct sum : std::integral_constant<size_t, 0> {};
+
+        template <size_t First, size_t... Rest>
+        struct sum<First, Rest...> : std::integral_constant<size_t, First + sum<Rest...>::value> {};
+    }
+
+    template <typename Struct, typename... Fields>
+    struct layout {
+        static_assert(sizeof...(Fields) > 0, "a vertex layout needs at least one field");
+        static_assert(detail::ordered<Fields...>::value, "vertex layout fields overlap or are not in memory order");
+        static_assert(std::is_standard_layout<Struct>::value, "offsetof needs a standard layout vertex struct");
+
+        static constexpr uint32_t attributeCount = sizeof...(Fields);
+        static constexpr uint32_t stride = sizeof(Struct);
+
+        // The fields fill the struct back to back from offset 0, with no padding
+        // and nothing left out
+        static constexpr bool packed = detail::contiguous<Fields...>::value && detail::sum<Fields::size...>::value == stride;
+
+        static constexpr VkVertexInputBindingDescription bindingDescription(uint32_t binding = 0,
+                                                                          VkVertexInputRate inputRate = VK_VERTEX_INPUT_RATE_VERTEX)
+        {
+            return VkVertexInputBindingDescription{binding, stride, inputRate};
+        }
+
+        // One location per field, starting at firstLocation
+        static constexpr std::array<VkVertexInputAttributeDescription, sizeof...(Fields)> attributeDescriptions(uint32_t binding = 0,
+                                                                                                                 uint32_t firstLocation = 0)
+        {
+            return build(binding, firstLocation, std::index_sequence_for<Fields...>());
+        }
+
+    private:
+        template <size_t... Index>
+        static constexpr std::array<VkVertexInputAttributeDescription, sizeof...(Fields)> build(uint32_t binding,
+                                                                                                 uint32_t firstLocation,
+                                                                                                 std::index_sequence<Index...>)
+        {
+            return {{VkVertexInputAttributeDescription{firstLocation + static_cast<uint32_t>(Index), binding, Fields::format, Fields::offset}...}};
+        }
+    };
+
+    // std140 base alignment of the types we put in uniform blocks
+    template <typename T> struct std140Alignment;
+    template <> struct std140Alignment<float> : std::integral_constant<size_t, 4> {};
+    template <> struct std140Alignment<int32_t> : std::integral_constant<size_t, 4> {};
+    template <> struct std140Alignment<uint32_t> : std::integral_constant<size_t, 4> {};
+    template <> struct std140Alignment<glm::vec2> : std::integral_constant<size_t, 8> {};
+    template <> struct std140Alignment<glm::vec3> : std::integral_constant<size_t, 16> {};
+    template <> struct std140Alignment<glm::vec4> : std::integral_constant<size_t, 16> {};
+    template <> struct std140Alignment<glm::mat4> : std::integral_constant<size_t, 16> {};
+
+    // Array elements are rounded up to 16 bytes, so only 16 byte elements match C++
+    template <typename T, size_t N> struct std140Alignment<T[N]> : std::integral_constant<size_t, 16> {
+        static_assert(sizeof(T) % 16 == 0, "std140 array elements have a 16 byte stride, use vec4 elements");
+    };
+
+    // Bytes std140 gives a member, which is not sizeof when aligned gentypes pad a vec3
+    // to 16: std140 packs a following scalar into the vec3's last 4 bytes
+    template <typename T> struct std140Size;
+    template <> struct std140Size<float> : std::integral_constant<size_t, 4> {};
+    template <> struct std140Size<int32_t> : std::integral_constant<size_t, 4> {};
+    template <> struct std140Size<uint32_t> : std::integral_constant<size_t, 4> {};
+    template <> struct std140Size<glm::vec2> : std::integral_constant<size_t, 8> {};
+    template <> struct std140Size<glm::vec3> : std::integral_constant<size_t, 12> {};
+    template <> struct std140Size<glm::vec4> : std::integral_constant<size_t, 16> {};
+    template <> struct std140Size<glm::mat4> : std::integral_constant<size_t, 64> {};
+    template <typename T, size_t N> struct std140Size<T[N]> :
+        std::integral_constant<size_t, N * ((std140Size<T>::value + 15) / 16 * 16)> {};
+
+    template <typename Struct, typename Member, size_t Offset>
+    struct uniformField {
+        static_assert(Offset % std140Alignment<Member>::value == 0,
+                      "uniform member is not at its std140 offset, add alignas() or reorder the block");
+        static constexpr size_t offset = Offset;
+        static constexpr size_t alignment = std140Alignment<Member>::value;
+        static constexpr size_t end = Offset + std140Size<Member>::value;
+    };
+
+    namespace detail {
+
+        template <size_t... Ends>
+        struct maximum : std::integral_constant<size_t, 0> {};
+
+        template <size_t First, size_t... Rest>
+        struct maximum<First, Rest...> :
+            std::integral_constant<size_t, (First > maximum<Rest...>::value ? First : maximum<Rest...>::value)> {};
+
+        constexpr size_t alignUp(size_t value, size_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        // Each member at the first offset std140 allows after the previous one ends,
+        // so a member missing from the list shows up as a gap
+        template <size_t End, typename... Fields>
+        struct std140Packed : std::true_type {};
+
+        template <size_t End, typename First, typename... Rest>
+        struct std140Packed<End, First, Rest...> :
+            std::integral_constant<bool, First::offset == alignUp(End, First::alignment) && std140Packed<First::end, Rest...>::value> {};
+    }
+
+    // Naming a member instantiates its check, so this compiles only if every listed
+    // member sits where std140 expects it, in order, with no unlisted member between
+    // two listed ones or after the last.  Only a member small enough to fit in
+    // std140's own alignment padding could still go unnoticed.
+    template <typename Struct, typename... Fields>
+    struct std140Block {
+        static_assert(detail::maximum<Fields::end...>::value <= sizeof(Struct), "uniform member lies outside its struct");
+        static_assert(sizeof(Struct) % 16 == 0, "std140 blocks are padded to 16 bytes, pad the struct to match");
+        static_assert(detail::std140Packed<0, Fields...>::value,
+                      "uniform members are out of order, missing from the list or not where std140 puts them");
+        static_assert(detail::alignUp(detail::maximum<Fields::end...>::value, 16) == sizeof(Struct),
+                      "the struct has members after the last listed one");
+        static constexpr bool valid = true;
+    };
+}
+
+#define VERTEX_LAYOUT_FIELD(Struct, member) \
+    vertexLayout::field<Struct, decltype(Struct::member), offsetof(Struct, member)>
+
+#define UNIFORM_LAYOUT_FIELD(Struct, member) \
+    vertexLayout::uniformField<Struct, decltype(Struct::member), offsetof(Struct, member)>
+
+#endif /* vertexLayout_hpp */